@@ -0,0 +1,282 @@
+#include "adapter-selection.h"
+
+#include "webgpu-utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+// Requested when the adapter supports them
+const WGPUFeatureName kOptionalFeatures[] = {
+    WGPUFeatureName_TimestampQuery, // GPU profiler scopes
+    WGPUFeatureName_ShaderF16,
+    WGPUFeatureName_IndirectFirstInstance,
+#ifdef WEBGPU_BACKEND_DAWN
+    // Lets job threads create encoders while the main thread uses the device
+    WGPUFeatureName_ImplicitDeviceSynchronization,
+#endif
+};
+
+double typeRank(WGPUAdapterType type)
+{
+    switch (type) {
+    case WGPUAdapterType_DiscreteGPU: return 3;
+    case WGPUAdapterType_IntegratedGPU: return 2;
+    case WGPUAdapterType_CPU: return 1;
+    default: return 0;
+    }
+}
+
+double backendRank(WGPUBackendType backend)
+{
+    switch (backend) {
+    case WGPUBackendType_D3D12:
+    case WGPUBackendType_Metal:
+    case WGPUBackendType_Vulkan: return 3;
+    case WGPUBackendType_D3D11: return 2;
+    case WGPUBackendType_OpenGL:
+    case WGPUBackendType_OpenGLES: return 1;
+    default: return 0;
+    }
+}
+
+std::string toLower(std::string_view text)
+{
+    std::string lower(text);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) {
+        return char(std::tolower((unsigned char) c));
+    });
+    return lower;
+}
+
+bool canPresent(WGPUSurface surface, WGPUAdapter adapter)
+{
+    WGPUSurfaceCapabilities capabilities = WGPU_SURFACE_CAPABILITIES_INIT;
+    bool                    supported =
+        wgpuSurfaceGetCapabilities(surface, adapter, &capabilities) ==
+            WGPUStatus_Success &&
+        capabilities.formatCount > 0;
+    wgpuSurfaceCapabilitiesFreeMembers(capabilities);
+    return supported;
+}
+
+AdapterCandidate describe(WGPUAdapter adapter)
+{
+    AdapterCandidate candidate;
+    candidate.adapter = adapter;
+
+    WGPUAdapterInfo info = WGPU_ADAPTER_INFO_INIT;
+    if (wgpuAdapterGetInfo(adapter, &info) == WGPUStatus_Success) {
+        candidate.name        = toStdStringView(info.device);
+        candidate.vendor      = toStdStringView(info.vendor);
+        candidate.description = toStdStringView(info.description);
+        candidate.backend     = info.backendType;
+        candidate.type        = info.adapterType;
+        candidate.vendorId    = info.vendorID;
+        candidate.deviceId    = info.deviceID;
+        wgpuAdapterInfoFreeMembers(info);
+    }
+    wgpuAdapterGetLimits(adapter, &candidate.limits);
+    candidate.limits.nextInChain = nullptr;
+    candidate.score              = scoreAdapter(candidate);
+    return candidate;
+}
+
+} // namespace
+
+double scoreAdapter(const AdapterCandidate& candidate)
+{
+    const WGPULimits& limits = candidate.limits;
+    // Each log2 term is below 64, so limits never outweigh the backend
+    double limitScore =
+        std::log2(double(limits.maxBufferSize) + 1) +
+        std::log2(double(limits.maxStorageBufferBindingSize) + 1) +
+        std::log2(double(limits.maxComputeWorkgroupStorageSize) + 1) +
+        std::log2(double(limits.maxComputeInvocationsPerWorkgroup) + 1) +
+        std::log2(double(limits.maxTextureDimension2D) + 1);
+    return typeRank(candidate.type) * 1e6 +
+           backendRank(candidate.backend) * 1e4 + limitScore;
+}
+
+const char* backendName(WGPUBackendType backend)
+{
+    switch (backend) {
+    case WGPUBackendType_Null: return "null";
+    case WGPUBackendType_WebGPU: return "webgpu";
+    case WGPUBackendType_D3D11: return "d3d11";
+    case WGPUBackendType_D3D12: return "d3d12";
+    case WGPUBackendType_Metal: return "metal";
+    case WGPUBackendType_Vulkan: return "vulkan";
+    case WGPUBackendType_OpenGL: return "opengl";
+    case WGPUBackendType_OpenGLES: return "opengles";
+    default: return "undefined";
+    }
+}
+
+const char* adapterTypeName(WGPUAdapterType type)
+{
+    switch (type) {
+    case WGPUAdapterType_DiscreteGPU: return "discrete";
+    case WGPUAdapterType_IntegratedGPU: return "integrated";
+    case WGPUAdapterType_CPU: return "cpu";
+    default: return "unknown";
+    }
+}
+
+AdapterList::~AdapterList()
+{
+    for (AdapterCandidate& candidate : m_candidates) {
+        wgpuAdapterRelease(candidate.adapter);
+    }
+}
+
+void AdapterList::enumerate(
+    WGPUInstance              instance,
+    WGPURequestAdapterOptions options)
+{
+    std::vector<WGPUAdapter> adapters;
+#ifdef WEBGPU_BACKEND_DAWN
+    adapters.resize(wgpuInstanceEnumerateAdapters(instance, &options, nullptr));
+    adapters.resize(
+        wgpuInstanceEnumerateAdapters(instance, &options, adapters.data()));
+#else
+    for (WGPUPowerPreference preference :
+         {WGPUPowerPreference_HighPerformance, WGPUPowerPreference_LowPower}) {
+        options.powerPreference = preference;
+        if (WGPUAdapter adapter = requestAdapterSync(instance, &options)) {
+            adapters.push_back(adapter);
+        }
+    }
+#endif
+
+    for (WGPUAdapter adapter : adapters) {
+        AdapterCandidate candidate = describe(adapter);
+        bool             duplicate = std::any_of(
+            m_candidates.begin(),
+            m_candidates.end(),
+            [&](const AdapterCandidate& other) {
+                return other.adapter == adapter ||
+                       (other.backend == candidate.backend &&
+                        other.vendorId == candidate.vendorId &&
+                        other.deviceId == candidate.deviceId &&
+                        other.name == candidate.name);
+            });
+        if (duplicate || (options.compatibleSurface &&
+                          !canPresent(options.compatibleSurface, adapter))) {
+            wgpuAdapterRelease(adapter);
+            continue;
+        }
+        m_candidates.push_back(std::move(candidate));
+    }
+
+    std::stable_sort(
+        m_candidates.begin(),
+        m_candidates.end(),
+        [](const AdapterCandidate& a, const AdapterCandidate& b) {
+            return a.score > b.score;
+        });
+}
+
+const AdapterCandidate* AdapterList::select(std::string_view override) const
+{
+    if (m_candidates.empty())
+        return nullptr;
+    if (override.empty())
+        return &m_candidates.front();
+
+    bool numeric = std::all_of(override.begin(), override.end(), [](char c) {
+        return std::isdigit((unsigned char) c);
+    });
+    if (numeric) {
+        size_t index = std::strtoul(std::string(override).c_str(), nullptr, 10);
+        if (index < m_candidates.size())
+            return &m_candidates[index];
+    }
+    else {
+        std::string pattern = toLower(override);
+        for (const AdapterCandidate& candidate : m_candidates) {
+            std::string text = toLower(
+                candidate.name + ' ' + candidate.vendor + ' ' +
+                candidate.description + ' ' + backendName(candidate.backend) +
+                ' ' + adapterTypeName(candidate.type));
+            if (text.find(pattern) != std::string::npos)
+                return &candidate;
+        }
+    }
+    std::cerr << "No adapter matches '" << override
+              << "', using the best ranked one\n";
+    return &m_candidates.front();
+}
+
+void AdapterList::print(std::ostream& out) const
+{
+    for (size_t i = 0; i < m_candidates.size(); ++i) {
+        const AdapterCandidate& candidate = m_candidates[i];
+        out << i << ": " << candidate.name << " (" << candidate.vendor << ", "
+            << backendName(candidate.backend) << ", "
+            << adapterTypeName(candidate.type) << ")"
+            << " score " << candidate.score << ", maxBufferSize "
+            << candidate.limits.maxBufferSize
+            << ", maxStorageBufferBindingSize "
+            << candidate.limits.maxStorageBufferBindingSize << '\n';
+    }
+}
+
+std::string adapterOverride(std::string_view cliValue)
+{
+    if (!cliValue.empty())
+        return std::string(cliValue);
+    const char* value = std::getenv(kAdapterEnvVar);
+    return value ? value : "";
+}
+
+void DeviceRequirements::apply(WGPUDeviceDescriptor& deviceDesc) const
+{
+    deviceDesc.requiredFeatureCount = features.size();
+    deviceDesc.requiredFeatures     = features.data();
+    deviceDesc.requiredLimits       = &limits;
+}
+
+DeviceRequirements maximalRequirements(WGPUAdapter adapter)
+{
+    DeviceRequirements requirements;
+    for (WGPUFeatureName feature : kOptionalFeatures) {
+        if (wgpuAdapterHasFeature(adapter, feature)) {
+            requirements.features.push_back(feature);
+        }
+    }
+    if (wgpuAdapterGetLimits(adapter, &requirements.limits) !=
+        WGPUStatus_Success) {
+        // Keep the defaults
+        requirements.limits = WGPU_LIMITS_INIT;
+    }
+    requirements.limits.nextInChain = nullptr;
+    return requirements;
+}
+
+CapabilityProfile queryCapabilities(
+    const AdapterCandidate& adapter,
+    WGPUDevice              device)
+{
+    CapabilityProfile profile;
+    profile.adapterName = adapter.name;
+    profile.backend     = adapter.backend;
+    profile.adapterType = adapter.type;
+    wgpuDeviceGetLimits(device, &profile.limits);
+    profile.limits.nextInChain = nullptr;
+
+    profile.shaderF16 = wgpuDeviceHasFeature(device, WGPUFeatureName_ShaderF16);
+    profile.timestampQuery =
+        wgpuDeviceHasFeature(device, WGPUFeatureName_TimestampQuery);
+    profile.indirectFirstInstance =
+        wgpuDeviceHasFeature(device, WGPUFeatureName_IndirectFirstInstance);
+#ifdef WEBGPU_BACKEND_DAWN
+    profile.implicitSynchronization = wgpuDeviceHasFeature(
+        device, WGPUFeatureName_ImplicitDeviceSynchronization);
+#endif
+    return profile;
+}
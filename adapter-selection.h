@@ -0,0 +1,119 @@
+#ifndef ADAPTER_SELECTION_H
+#define ADAPTER_SELECTION_H
+
+#include <webgpu/webgpu.h>
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Environment variable that picks the adapter when no --adapter option is
+ * given, see AdapterList::select().
+ */
+constexpr const char* kAdapterEnvVar = "WGPUTEST_ADAPTER";
+
+/**
+ * An available adapter and what it is ranked on.
+ */
+struct AdapterCandidate
+{
+    WGPUAdapter     adapter = nullptr; // owned by the AdapterList
+    std::string     name;
+    std::string     vendor;
+    std::string     description;
+    WGPUBackendType backend  = WGPUBackendType_Undefined;
+    WGPUAdapterType type     = WGPUAdapterType_Unknown;
+    uint32_t        vendorId = 0;
+    uint32_t        deviceId = 0;
+    WGPULimits      limits   = WGPU_LIMITS_INIT;
+    double          score    = 0;
+};
+
+/**
+ * Higher is better: discrete over integrated over CPU adapters, then
+ * D3D12/Metal/Vulkan over D3D11 over OpenGL, then the larger limits.
+ */
+double scoreAdapter(const AdapterCandidate& candidate);
+
+const char* backendName(WGPUBackendType backend);
+const char* adapterTypeName(WGPUAdapterType type);
+
+/**
+ * The adapters matching a set of request options, best ranked first.
+ */
+class AdapterList
+{
+public:
+    AdapterList() = default;
+    ~AdapterList();
+
+    AdapterList(const AdapterList&)            = delete;
+    AdapterList& operator=(const AdapterList&) = delete;
+
+    // Dawn enumerates every adapter matching the backend and fallback
+    // options; other implementations are asked for their high-performance
+    // and low-power adapters. With a compatibleSurface, adapters that
+    // cannot present to it are left out.
+    void enumerate(WGPUInstance instance, WGPURequestAdapterOptions options);
+
+    const std::vector<AdapterCandidate>& candidates() const
+    {
+        return m_candidates;
+    }
+
+    // `override` is either an index in candidates() or a case-insensitive
+    // substring of the name, vendor, description, backend or type (e.g.
+    // "nvidia", "vulkan", "integrated"). Empty picks the best ranked one.
+    // Null if there is no adapter at all.
+    const AdapterCandidate* select(std::string_view override) const;
+
+    void print(std::ostream& out) const;
+
+private:
+    std::vector<AdapterCandidate> m_candidates;
+};
+
+/**
+ * `cliValue` if not empty, otherwise the value of kAdapterEnvVar.
+ */
+std::string adapterOverride(std::string_view cliValue);
+
+/**
+ * What to ask of an adapter: all of its supported limits, rather than the
+ * defaults, and the optional features below that it has.
+ */
+struct DeviceRequirements
+{
+    std::vector<WGPUFeatureName> features;
+    WGPULimits                   limits = WGPU_LIMITS_INIT;
+
+    // Point `deviceDesc` at the members, which must outlive the request
+    void apply(WGPUDeviceDescriptor& deviceDesc) const;
+};
+
+DeviceRequirements maximalRequirements(WGPUAdapter adapter);
+
+/**
+ * What the device ended up with, for code paths to specialize on.
+ */
+struct CapabilityProfile
+{
+    std::string     adapterName;
+    WGPUBackendType backend     = WGPUBackendType_Undefined;
+    WGPUAdapterType adapterType = WGPUAdapterType_Unknown;
+    WGPULimits      limits      = WGPU_LIMITS_INIT;
+
+    bool shaderF16             = false;
+    bool timestampQuery        = false;
+    bool indirectFirstInstance = false;
+    // Dawn only: encoders may be created from several threads
+    bool implicitSynchronization = false;
+};
+
+CapabilityProfile queryCapabilities(
+    const AdapterCandidate& adapter,
+    WGPUDevice              device);
+
+#endif // ADAPTER_SELECTION_H
@@ -1,16 +1,108 @@
 #ifndef APPLICATION_H
 #define APPLICATION_H
 
+#include "adapter-selection.h"
+#include "buffer-allocator.h"
+#include "event-thread.h"
+#include "frame-arena.h"
+#include "frame-capture.h"
+#include "frame-scheduler.h"
+#include "gpu-profiler.h"
+#include "gpu-resources.h"
+#include "job-system.h"
+#include "metrics.h"
+#include "parallel-recorder.h"
+#include "pipeline-cache.h"
+#include "pipeline-loader.h"
+#include "render-bundle-cache.h"
+#include "staging-belt.h"
+#include "webgpu-async.h"
 #include "webgpu-utils.h"
 
 #include <GLFW/glfw3.h>
 #include <glfw3webgpu.h>
 #include <webgpu/webgpu.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Startup options of the Application.
+ */
+struct ApplicationOptions
+{
+    // Render into an offscreen texture instead of a GLFW window surface, so
+    // that the application runs without a display
+    bool     headless = false;
+    uint32_t width    = 640;
+    uint32_t height   = 480;
+    // Backend requested for the adapter; Null and Vulkan + forceFallback
+    // (SwiftShader) work on machines without a GPU
+    WGPUBackendType backend              = WGPUBackendType_Undefined;
+    bool            forceFallbackAdapter = false;
+    // Adapter index or name, see AdapterList::select(); empty falls back to
+    // the WGPUTEST_ADAPTER environment variable, then to the best ranked one
+    std::string adapter;
+    // Where compiled shader/pipeline blobs are persisted across runs; empty
+    // disables the on-disk cache
+    std::string cacheDirectory = ".wgpu-cache";
+    // Frames the CPU may queue ahead of the GPU (1 to 3): fewer lower the
+    // latency, more smooth out CPU time spikes
+    uint32_t framesInFlight = 2;
+    // Preferred present mode, see selectPresentMode()
+    WGPUPresentMode presentMode = WGPUPresentMode_Fifo;
+    // Frame-rate cap, 0 for none
+    double maxFps = 0;
+    // Threads recording commands, including the main one; 0 uses all cores
+    uint32_t jobThreads = 0;
+    // If set, the profiler trace is written there (Chrome trace JSON) on
+    // terminate()
+    std::string tracePath;
+    // WGSL file of the background pass (vs_main, fs_main), built in if empty
+    std::string backgroundShader;
+    // Recompile the shader files when they change, see PipelineLoader
+    bool hotReload = false;
+    // Headless only: every frame is written to framePath(capturePattern, i)
+    // as a PNG, see FrameCapture
+    std::string capturePattern;
+    // If set, the runtime metrics are written there every metricsInterval
+    // seconds, see MetricsExporter; the window title shows their summary
+    std::string   metricsPath;
+    MetricsFormat metricsFormat   = MetricsFormat::JsonLines;
+    double        metricsInterval = 1;
+};
+
+/**
+ * Device losses the Application recovered from, see
+ * Application::recoverDevice(). Times are those of the last recovery.
+ */
+struct DeviceRecoveryStats
+{
+    uint32_t losses     = 0;
+    uint32_t recoveries = 0;
+    // Requesting the new device and configuring the target
+    double deviceMs = -1;
+    // Recreating the pipelines, render bundles and per-frame objects, and
+    // running the onDeviceRestored() callbacks
+    double rebuildMs = -1;
+    // From the loss being noticed to the next frame presented
+    double timeToFrameMs = -1;
+};
 
 class Application
 {
+    // Frames whose per-frame allocations may still be read by the GPU
+    static constexpr uint32_t kMaxFramesInFlight   = 3;
+    static constexpr uint64_t kFrameAllocatorBytes = 1 << 20;
+    // Staging bytes uploaded per frame at most, see StagingBelt
+    static constexpr uint64_t kUploadBudgetBytes = 32 << 20;
+
     // We put here all the variables that are shared between init and main loop
     // All these can be initialized to nullptr
     GLFWwindow*    m_window   = nullptr;
@@ -19,61 +111,523 @@ class Application
     wgpu::Queue    m_queue    = nullptr; // NEW
     wgpu::Surface  m_surface  = nullptr; // NEW
 
+    ApplicationOptions m_options;
+    // Services the instance (processEvents, futures) off the render loop.
+    // Null when the device lacks ImplicitDeviceSynchronization: the render
+    // loop then processes the events itself.
+    std::unique_ptr<EventThread> m_events;
+    // Window events, stamped by the GLFW callbacks, and those of this frame
+    InputQueue              m_input;
+    std::vector<InputEvent> m_frameInput;
+    // Adapter, limits and optional features the device was created with
+    CapabilityProfile m_capabilities;
+    // Resources dropped while in-flight frames may still use them, and the
+    // accounting of GPU memory
+    std::unique_ptr<DeferredReleaseQueue> m_resources;
+
+    // Render target used instead of the surface in headless mode
+    GpuTexture          m_offscreenTexture;
+    wgpu::TextureFormat m_targetFormat = wgpu::TextureFormat::Undefined;
+
+    // Bounds the frames in flight, which makes per-frame resources safe to
+    // reuse every kMaxFramesInFlight frames
+    std::unique_ptr<FrameScheduler> m_scheduler;
+
+    // Per-frame uniform/storage data, bound with dynamic offsets
+    std::unique_ptr<FrameRingAllocator> m_frameAllocator;
+    // Long-lived vertex and index data
+    std::unique_ptr<BlockAllocator> m_geometryAllocator;
+    // Buffer and texture uploads, copied at the start of the frame
+    std::unique_ptr<StagingBelt> m_uploads;
+    uint64_t                     m_frameIndex = 0;
+
+    std::unique_ptr<BlobCache>        m_blobCache;
+    std::unique_ptr<PipelineRegistry> m_pipelines;
+    std::unique_ptr<GpuProfiler>      m_profiler;
+    // Pipelines compiled in the background
+    std::unique_ptr<PipelineLoader> m_pipelineLoader;
+    // Drawn behind the static draws once it is compiled
+    PipelineLoader::Id m_backgroundPipeline = PipelineLoader::kNone;
+
+    // From the start of initialize() to the first frame presented
+    std::chrono::steady_clock::time_point m_initStart;
+    double                                m_timeToFirstFrameMs = -1;
+
+    // Static draws of the main pass, recorded once and replayed every frame
+    std::unique_ptr<RenderBundleCache> m_renderBundles;
+    RenderBundleTarget                 m_mainPassTarget;
+
+    // Command recording is spread over the job threads; everything is
+    // submitted from the main thread through m_recorder
+    std::unique_ptr<JobSystem>        m_jobs;
+    std::unique_ptr<ParallelRecorder> m_recorder;
+
+    // Writes the offscreen frames to disk, encoded on the job threads
+    std::unique_ptr<FrameCapture> m_capture;
+
+    // Null unless ApplicationOptions::metricsPath is set
+    std::unique_ptr<MetricsExporter> m_metrics;
+
+    // Set by the device-lost callback, on the event thread; the device is
+    // replaced by the render thread at the start of the next frame
+    std::atomic<WGPUDevice>               m_lostDevice = nullptr;
+    std::chrono::steady_clock::time_point m_lostAt;
+    DeviceRecoveryStats                   m_recoveryStats;
+    // Recreate what the application owns on the new device
+    std::vector<std::function<void()>> m_restoreCallbacks;
+
 public:
     // Initialize everything and return true if it went all right
-    bool initialize()
+    bool initialize(const ApplicationOptions& options = {})
     {
-        // Open window
-        glfwInit();
-        glfwWindowHint(
-            GLFW_CLIENT_API,
-            GLFW_NO_API); // <-- extra info for glfwCreateWindow
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-        m_window = glfwCreateWindow(640, 480, "Learn WebGPU", nullptr, nullptr);
+        m_options   = options;
+        m_initStart = std::chrono::steady_clock::now();
 
-        // Create instance ('instance' is now declared at the class level)
-        m_instance = wgpu::createInstance();
+        if (!m_options.headless) {
+            // Open window
+            glfwInit();
+            glfwWindowHint(
+                GLFW_CLIENT_API,
+                GLFW_NO_API); // <-- extra info for glfwCreateWindow
+            glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+            m_window = glfwCreateWindow(
+                m_options.width,
+                m_options.height,
+                "Learn WebGPU",
+                nullptr,
+                nullptr);
+        }
 
-        // Get adapter
-        std::cout << "Requesting adapter..." << std::endl;
-        m_surface = glfwCreateWindowWGPUSurface(m_instance, m_window);
+        // Create instance ('instance' is now declared at the class level).
+        // Timed waits let the *Sync helpers block on futures instead of
+        // polling.
+        m_instance = createInstanceWithTimedWait();
+        if (!m_options.headless) {
+            m_surface = glfwCreateWindowWGPUSurface(m_instance, m_window);
+        }
+        // Let the device reuse the blobs compiled by previous runs
+        if (!m_options.cacheDirectory.empty()) {
+            m_blobCache = std::make_unique<BlobCache>(m_options.cacheDirectory);
+        }
+        m_resources = std::make_unique<DeferredReleaseQueue>(m_instance);
+
+        // The pipelines need the target format, configured along with the
+        // device; they then compile while the rest is set up
+        bool configured = createDevice();
+        if (!m_device) {
+            return false;
+        }
+        updateEventThread();
+        if (m_window) {
+            installInputCallbacks();
+        }
+        m_mainPassTarget.colorFormats = {m_targetFormat};
+        m_pipelineLoader =
+            std::make_unique<PipelineLoader>(m_instance, m_device);
+        if (m_options.hotReload) {
+            m_pipelineLoader->enableHotReload();
+        }
+        if (configured) {
+            m_backgroundPipeline = m_pipelineLoader->addRenderPipeline(
+                backgroundSpec(), m_options.backgroundShader);
+        }
+
+        m_pipelines     = std::make_unique<PipelineRegistry>(m_device);
+        m_renderBundles = std::make_unique<RenderBundleCache>(m_device);
+        m_jobs          = std::make_unique<JobSystem>(m_options.jobThreads);
+        createFrameObjects();
+        if (!m_options.metricsPath.empty()) {
+            m_metrics = std::make_unique<MetricsExporter>(
+                m_options.metricsPath,
+                m_options.metricsFormat,
+                m_options.metricsInterval);
+        }
+
+        return configured;
+    }
+
+    // Uninitialize everything that was initialized
+    void terminate()
+    {
+        waitForIdle();
+        m_metrics.reset();
+        m_scheduler.reset();
+        if (m_profiler && !m_options.tracePath.empty()) {
+            m_profiler->writeChromeTrace(m_options.tracePath);
+        }
+        m_profiler.reset();
+        m_renderBundles.reset();
+        m_recorder.reset();
+        m_capture.reset();
+        m_jobs.reset();
+        m_pipelineLoader.reset();
+        m_pipelines.reset();
+        m_uploads.reset();
+        m_geometryAllocator.reset();
+        m_frameAllocator.reset();
+        m_offscreenTexture.reset();
+        // After the objects that watch futures with it
+        m_events.reset();
+        if (m_queue) {
+            m_resources->flush(m_queue);
+        }
+        m_resources.reset();
+        if (m_surface && m_device) {
+            m_surface.unconfigure();
+        }
+        if (m_queue) {
+            m_queue.release();
+        }
+        if (m_surface) {
+            m_surface.release();
+        }
+        if (m_device) {
+            m_device.release();
+        }
+        if (m_window) {
+            glfwDestroyWindow(m_window);
+            glfwTerminate();
+        }
+    }
+
+    // Draw a frame and handle events
+    void mainLoop()
+    {
+        if (!m_device) {
+            return; // lost, and could not be replaced
+        }
+        if (m_lostDevice.load() == WGPUDevice(m_device) && !recoverDevice()) {
+            return;
+        }
+        MetricTimer frameTimer(MetricHistogram::FrameMs);
+        // Wait for a frame slot first so that the input is as fresh as
+        // possible when the frame is presented
+        m_scheduler->beginFrame();
+        m_resources->collect();
+        if (m_window) {
+            glfwPollEvents();
+        }
+        // The instance events are processed by m_events, if any: then only
+        // run the completion callbacks sent to this thread
+        if (m_events) {
+            m_events->dispatch();
+        }
+        processEvents();
+        // Pipelines compiled or reloaded since the previous frame are
+        // swapped in here, never in the middle of one
+        m_pipelineLoader->update();
+        if (m_capture) {
+            m_capture->poll();
+        }
+        m_frameInput = m_input.take();
+        if (!m_frameInput.empty()) {
+            m_scheduler->setInputTime(m_frameInput.front().time);
+        }
+
+        wgpu::TextureView targetView = getNextTargetView();
+        if (!targetView) return; // no surface texture, we skip this frame
+        m_frameAllocator->beginFrame(m_frameIndex);
+        m_uploads->beginFrame();
+        m_profiler->beginFrame();
+        {
+            auto        encodeScope = m_profiler->cpuScope("Encode");
+            MetricTimer encodeTimer(MetricHistogram::EncodeMs);
+            // The frame is submitted at once by m_recorder, its passes
+            // recorded in the encoder of their stage; transient descriptors
+            // come from the arena of the frame
+            wgpu::CommandEncoder encoder =
+                m_recorder->encoder(SubmitStage::Render);
+            FrameArena& arena = m_recorder->arena();
+            auto* renderPassDesc =
+                arena.make<wgpu::RenderPassDescriptor>(1, wgpu::Default);
+            auto* colorAttachments =
+                arena.make<wgpu::RenderPassColorAttachment>(1, wgpu::Default);
+
+            colorAttachments[0].view = targetView;
+            colorAttachments[0].loadOp = wgpu::LoadOp::Clear;
+            colorAttachments[0].storeOp = wgpu::StoreOp::Store;
+            colorAttachments[0].clearValue = wgpu::Color{ 0.5, 0.5, 0.5, 1.0 };
+
+            renderPassDesc->colorAttachmentCount = 1;
+            renderPassDesc->colorAttachments = colorAttachments;
+            renderPassDesc->timestampWrites =
+                m_profiler->passTimestampWrites("Main pass");
+
+            wgpu::RenderPassEncoder renderPass = encoder.beginRenderPass(*renderPassDesc);
+            // Skipped until its pipeline is compiled, rather than waited for
+            if (WGPURenderPipeline background =
+                    m_pipelineLoader->renderPipeline(m_backgroundPipeline)) {
+                wgpuRenderPassEncoderSetPipeline(renderPass, background);
+                wgpuRenderPassEncoderDraw(renderPass, 3, 1, 0, 0);
+            }
+            // Static draws are replayed from render bundles, dynamic draws
+            // go after them
+            m_renderBundles->execute(renderPass, m_mainPassTarget);
+            renderPass.end();
+            renderPass.release();
+            m_profiler->resolve(encoder);
+            if (m_capture) {
+                m_capture->capture(
+                    m_recorder->encoder(SubmitStage::Readback),
+                    m_offscreenTexture.get(),
+                    m_frameIndex);
+            }
+        }
+
+        // The uploads go first, then everything recorded for this frame, in
+        // a single submit
+        {
+            auto submitScope = m_profiler->cpuScope("Submit");
+            m_frameAllocator->flush(m_queue);
+            m_recorder->append(m_uploads->finish(), SubmitStage::Upload);
+            m_recorder->submit(m_queue);
+            m_uploads->onSubmitted(m_queue);
+        }
+        m_profiler->onSubmitted();
+        m_scheduler->onSubmitted();
+        if (m_capture) {
+            m_capture->onSubmitted();
+        }
+        m_resources->onSubmitted(m_queue);
+        ++m_frameIndex;
+        // At the end of the frame
+        targetView.release();
+#ifndef __EMSCRIPTEN__
+        if (m_surface) {
+            wgpuSurfacePresent(m_surface);
+        }
+#endif
+        m_scheduler->onPresented();
+        countMetric(MetricCounter::Frames);
+        // Recorded before the export, which then includes this frame
+        frameTimer.stop();
+        // Aggregated once per frame, exported every interval
+        if (m_metrics && m_metrics->onFrame() && m_window) {
+            std::string title = "Learn WebGPU - " + m_metrics->summary();
+            glfwSetWindowTitle(m_window, title.c_str());
+        }
+        if (m_timeToFirstFrameMs < 0) {
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - m_initStart;
+            m_timeToFirstFrameMs = elapsed.count();
+        }
+        if (m_recoveryStats.recoveries > 0 &&
+            m_recoveryStats.timeToFrameMs < 0) {
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - m_lostAt;
+            m_recoveryStats.timeToFrameMs = elapsed.count();
+        }
+    }
+
+    // Return true as long as the main loop should keep on running
+    bool isRunning() const
+    {
+        if (!m_device) {
+            return false; // lost, and could not be replaced
+        }
+        // Headless runs are bounded by the caller (e.g. the frame benchmark)
+        return m_options.headless || !glfwWindowShouldClose(m_window);
+    }
+
+    // Block until all the submitted work is done on the GPU
+    void waitForIdle()
+    {
+        if (m_scheduler) {
+            m_scheduler->waitForIdle();
+        }
+    }
+
+    // Adapter, limits and optional features, for code paths to specialize
+    const CapabilityProfile& capabilities() const { return m_capabilities; }
+
+    // Frame pacing, frames in flight and the latency samples of the frames
+    FrameScheduler& scheduler() { return *m_scheduler; }
+
+    wgpu::Texture offscreenTexture() const
+    {
+        return wgpu::Texture(m_offscreenTexture.get());
+    }
+
+    // Watch futures from here to have them completed off the render loop.
+    // Null when the device lacks ImplicitDeviceSynchronization.
+    EventThread* events() { return m_events.get(); }
+
+    // Input events handled by the current frame, oldest first
+    const std::vector<InputEvent>& input() const { return m_frameInput; }
+
+    // Drop GpuResources freely, they are destroyed once the GPU is done
+    // with them; also accounts the GPU memory of the allocators
+    DeferredReleaseQueue& resources() { return *m_resources; }
+
+    FrameRingAllocator& frameAllocator() { return *m_frameAllocator; }
+
+    BlockAllocator& geometryAllocator() { return *m_geometryAllocator; }
+
+    // Uploads made during a frame are submitted before its commands
+    StagingBelt& uploads() { return *m_uploads; }
+
+    PipelineRegistry& pipelines() { return *m_pipelines; }
+
+    // Pipelines compiled off the render thread and reloaded on changes
+    PipelineLoader& pipelineLoader() { return *m_pipelineLoader; }
+
+    // Milliseconds from initialize() to the first frame presented, -1 before
+    double timeToFirstFrameMs() const { return m_timeToFirstFrameMs; }
 
+    GpuProfiler& profiler() { return *m_profiler; }
+
+    // Register static draws of the main pass here
+    RenderBundleCache& renderBundles() { return *m_renderBundles; }
+
+    JobSystem& jobs() { return *m_jobs; }
+
+    // Must only be used from the thread running mainLoop()
+    ParallelRecorder& recorder() { return *m_recorder; }
+
+    // Null unless ApplicationOptions::capturePattern is set
+    FrameCapture* frameCapture() { return m_capture.get(); }
+
+    // Null unless ApplicationOptions::metricsPath is set
+    MetricsExporter* metrics() { return m_metrics.get(); }
+
+    // Destroy the device as a driver reset or a GPU removal would, to test
+    // the recovery: it is replaced at the start of a next frame
+    void loseDevice() { wgpuDeviceDestroy(m_device); }
+
+    // Fire the AllowProcessEvents callbacks (device lost, errors) now,
+    // unless the event thread already does; mainLoop() calls it too
+    void processEvents()
+    {
+        if (!m_events) {
+            wgpuInstanceProcessEvents(m_instance);
+        }
+    }
+
+    // True from the device-lost callback until the device is replaced
+    bool deviceLost() const
+    {
+        return m_device && m_lostDevice.load() == WGPUDevice(m_device);
+    }
+
+    // Called after the device was replaced, once the pipelines and the
+    // per-frame objects are recreated: buffers, textures and bind groups
+    // owned by the caller must be created again from their CPU copies
+    void onDeviceRestored(std::function<void()> callback)
+    {
+        m_restoreCallbacks.push_back(std::move(callback));
+    }
+
+    DeviceRecoveryStats recoveryStats() const { return m_recoveryStats; }
+
+private:
+    // Stamp window events as they are reported and queue them for the
+    // next frame
+    static void pushInput(GLFWwindow* window, InputEvent event)
+    {
+        event.time = std::chrono::steady_clock::now();
+        static_cast<Application*>(glfwGetWindowUserPointer(window))
+            ->m_input.push(event);
+    }
+
+    void installInputCallbacks()
+    {
+        glfwSetWindowUserPointer(m_window, this);
+        glfwSetKeyCallback(
+            m_window,
+            [](GLFWwindow* window, int key, int, int action, int mods) {
+                InputEvent event;
+                event.type   = InputEvent::Type::Key;
+                event.code   = key;
+                event.action = action;
+                event.mods   = mods;
+                pushInput(window, event);
+            });
+        glfwSetMouseButtonCallback(
+            m_window, [](GLFWwindow* window, int button, int action, int mods) {
+                InputEvent event;
+                event.type   = InputEvent::Type::MouseButton;
+                event.code   = button;
+                event.action = action;
+                event.mods   = mods;
+                pushInput(window, event);
+            });
+        glfwSetCursorPosCallback(
+            m_window, [](GLFWwindow* window, double x, double y) {
+                InputEvent event;
+                event.type = InputEvent::Type::CursorMove;
+                event.x    = x;
+                event.y    = y;
+                pushInput(window, event);
+            });
+        glfwSetScrollCallback(
+            m_window, [](GLFWwindow* window, double x, double y) {
+                InputEvent event;
+                event.type = InputEvent::Type::Scroll;
+                event.x    = x;
+                event.y    = y;
+                pushInput(window, event);
+            });
+    }
+
+    // Get the adapter, request the device and configure the render target
+    // with it. Returns false if the target could not be configured;
+    // m_device is null if there is no device at all.
+    bool createDevice()
+    {
+        // Get adapter: the best ranked one among those that can render to
+        // the surface, unless one is asked for. Enumerated on every call,
+        // an adapter only creates one device.
+        std::cout << "Requesting adapter..." << std::endl;
         wgpu::RequestAdapterOptions adapterOpts = wgpu::Default;
-        adapterOpts.compatibleSurface = m_surface;
-        //                              ^^^^^^^^^ Use the surface here
+        adapterOpts.backendType          = m_options.backend;
+        adapterOpts.forceFallbackAdapter = m_options.forceFallbackAdapter;
+        if (m_surface) {
+            adapterOpts.compatibleSurface = m_surface;
+            //                              ^^^^^^^^^ Use the surface here
+        }
 
-        wgpu::Adapter adapter = requestAdapterSync(m_instance, &adapterOpts);
-        std::cout << "Got adapter: " << adapter << std::endl;
+        AdapterList adapters;
+        adapters.enumerate(m_instance, adapterOpts);
+        const AdapterCandidate* candidate =
+            adapters.select(adapterOverride(m_options.adapter));
+        if (!candidate) {
+            return false;
+        }
+        // Owned by 'adapters', released at the end of createDevice()
+        wgpu::Adapter adapter = candidate->adapter;
+        std::cout << "Got adapter: " << candidate->name << " ("
+                  << backendName(candidate->backend) << ", "
+                  << adapterTypeName(candidate->type) << ")" << std::endl;
 
         std::cout << "Requesting device..." << std::endl;
         wgpu::DeviceDescriptor deviceDesc = wgpu::Default;
         // Any name works here, that's your call
         deviceDesc.label = wgpu::StringView("My Device");
-        std::vector<wgpu::FeatureName> features;
-        // No required feature for now
-        deviceDesc.requiredFeatureCount = features.size();
-        deviceDesc.requiredFeatures     = (WGPUFeatureName*)features.data();
-        // Make sure 'features' lives until the call to
-        // wgpuAdapterRequestDevice!
-        wgpu::Limits requiredLimits = wgpu::Default;
-        // We leave 'requiredLimits' untouched for now
-        deviceDesc.requiredLimits = &requiredLimits;
-        // Make sure that the 'requiredLimits' variable lives until the call to
+        // Everything the adapter supports: its limits rather than the
+        // defaults, and the optional features (timestamp queries, f16,
+        // indirect first instance...)
+        DeviceRequirements requirements = maximalRequirements(adapter);
+        requirements.apply(deviceDesc);
+        // Make sure that 'requirements' lives until the call to
         // wgpuAdapterRequestDevice!
         deviceDesc.defaultQueue.label = wgpu::StringView("The Default Queue");
         auto onDeviceLost             = [](const WGPUDevice*     device,
                                WGPUDeviceLostReason  reason,
                                struct WGPUStringView message,
-                               void* /* userdata1 */,
+                               void*                 userdata1,
                                void* /* userdata2 */
                             ) {
-            // All we do is display a message when the device is lost
             std::cout << "Device " << device << " was lost: reason " << reason
                       << " (" << wgpu::StringView(message) << ")" << std::endl;
+            // A device that failed to be created was never used
+            if (reason != WGPUDeviceLostReason_FailedCreation) {
+                static_cast<Application*>(userdata1)->m_lostDevice = *device;
+            }
         };
         deviceDesc.deviceLostCallbackInfo.callback = onDeviceLost;
         deviceDesc.deviceLostCallbackInfo.mode =
             WGPUCallbackMode_AllowProcessEvents;
+        deviceDesc.deviceLostCallbackInfo.userdata1 = this;
         auto onDeviceError = [](const WGPUDevice*     device,
                                 WGPUErrorType         type,
                                 struct WGPUStringView message,
@@ -85,20 +639,191 @@ public:
                       << std::endl;
         };
         deviceDesc.uncapturedErrorCallbackInfo.callback = onDeviceError;
+        BlobCacheChain blobCacheChain;
+        if (m_blobCache) {
+            chainBlobCache(deviceDesc, *m_blobCache, blobCacheChain);
+        }
         // NB: 'device' is now declared at the class level
         m_device = requestDeviceSync(m_instance, adapter, &deviceDesc);
         std::cout << "Got device: " << m_device << std::endl;
+        if (!m_device) {
+            return false;
+        }
+        m_capabilities = queryCapabilities(*candidate, m_device);
 
         // The variable 'queue' is now declared at the class level
         // (do NOT prefix this line with 'WGPUQueue' otherwise it'd shadow the
         // class attribute)
         m_queue = m_device.getQueue();
+        return m_options.headless ? createOffscreenTarget() :
+                                    configureSurface(adapter);
+    }
+
+    // The per-frame objects, all bound to the device
+    void createFrameObjects()
+    {
+        m_scheduler = std::make_unique<FrameScheduler>(
+            m_instance,
+            m_queue,
+            std::clamp(m_options.framesInFlight, 1u, kMaxFramesInFlight),
+            m_options.maxFps);
+        m_frameAllocator = std::make_unique<FrameRingAllocator>(
+            m_device, kFrameAllocatorBytes, kMaxFramesInFlight);
+        m_geometryAllocator = std::make_unique<BlockAllocator>(
+            m_device, WGPUBufferUsage_Vertex | WGPUBufferUsage_Index);
+        m_uploads = std::make_unique<StagingBelt>(
+            m_instance, m_device, 8 << 20, kUploadBudgetBytes);
+        m_frameAllocator->setMemoryTracker(&m_resources->memory());
+        m_geometryAllocator->setMemoryTracker(&m_resources->memory());
+        m_uploads->setMemoryTracker(&m_resources->memory());
+        m_profiler = std::make_unique<GpuProfiler>(
+            m_instance, m_device, 32, kMaxFramesInFlight);
+        m_uploads->setEventThread(m_events.get());
+        m_profiler->setEventThread(m_events.get());
+
+        m_recorder = std::make_unique<ParallelRecorder>(*m_jobs, m_device);
+        if (!m_options.capturePattern.empty() && m_offscreenTexture) {
+            // One more staging buffer than frames in flight: the oldest
+            // copy is mapped by the time it is reused
+            m_capture = std::make_unique<FrameCapture>(
+                m_instance,
+                m_device,
+                *m_jobs,
+                m_options.capturePattern,
+                kMaxFramesInFlight + 1);
+            m_capture->setEventThread(m_events.get());
+        }
+    }
+
+    // The event thread uses the device while the render thread does, which
+    // needs ImplicitDeviceSynchronization
+    void updateEventThread()
+    {
+        if (!m_capabilities.implicitSynchronization) {
+            m_events.reset();
+        }
+        else if (!m_events) {
+            m_events = std::make_unique<EventThread>(m_instance);
+        }
+    }
+
+    // Replace the lost device without restarting: the instance, window,
+    // surface, blob cache, event and job threads are kept. Everything
+    // created on the lost device is released, a new one is requested, then
+    // the pipelines and render bundles are recreated from their retained
+    // specs, mostly from the blob cache, along with the per-frame objects.
+    // Returns false, with a null m_device, if there is no device anymore.
+    bool recoverDevice()
+    {
+        using Clock = std::chrono::steady_clock;
+        using Ms    = std::chrono::duration<double, std::milli>;
 
+        m_lostAt = Clock::now();
+        ++m_recoveryStats.losses;
+        // The loss is reported once per device
+        m_lostDevice = nullptr;
+        std::cout << "Recovering from the loss of the device..." << std::endl;
+
+        // What was pending on the lost device completes, mostly with errors
+        m_capture.reset();
+        m_recorder.reset();
+        m_profiler.reset();
+        m_scheduler.reset();
+        m_uploads.reset();
+        m_geometryAllocator.reset();
+        m_frameAllocator.reset();
+        m_offscreenTexture.reset();
+        m_resources->flush(m_queue);
+        if (m_surface) {
+            m_surface.unconfigure();
+        }
+        m_queue.release();
+        m_device.release();
+        m_queue  = nullptr;
+        m_device = nullptr;
+
+        bool configured = createDevice();
+        if (!configured) {
+            if (m_device) {
+                m_queue.release();
+                m_device.release();
+            }
+            m_queue  = nullptr;
+            m_device = nullptr;
+            std::cerr << "Could not recover from the device loss" << std::endl;
+            return false;
+        }
+        updateEventThread();
+        Clock::time_point rebuildStart = Clock::now();
+        // Another adapter may prefer another surface format
+        m_mainPassTarget.colorFormats = {m_targetFormat};
+        m_pipelineLoader->setColorFormats(
+            m_backgroundPipeline, backgroundSpec().colorFormats);
+        m_pipelineLoader->setDevice(m_device);
+        m_pipelines->setDevice(m_device);
+        m_renderBundles->setDevice(m_device);
+        createFrameObjects();
+        for (const std::function<void()>& callback : m_restoreCallbacks) {
+            callback();
+        }
+
+        ++m_recoveryStats.recoveries;
+        m_recoveryStats.deviceMs      = Ms(rebuildStart - m_lostAt).count();
+        m_recoveryStats.rebuildMs     = Ms(Clock::now() - rebuildStart).count();
+        m_recoveryStats.timeToFrameMs = -1;
+        return true;
+    }
+
+    // A full-screen triangle behind the static draws
+    RenderPipelineSpec backgroundSpec() const
+    {
+        RenderPipelineSpec spec;
+        spec.label = "Background";
+        if (m_options.backgroundShader.empty()) {
+            spec.shaderSource = R"(
+@vertex
+fn vs_main(@builtin(vertex_index) index : u32) -> @builtin(position) vec4f {
+    let uv = vec2f(f32((index << 1u) & 2u), f32(index & 2u));
+    return vec4f(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+
+@fragment
+fn fs_main(@builtin(position) position : vec4f) -> @location(0) vec4f {
+    let shade = 0.45 + 0.05 * sin(position.y / 64.0);
+    return vec4f(shade, shade, shade, 1.0);
+}
+)";
+        }
+        spec.colorFormats = {m_targetFormat};
+        return spec;
+    }
+
+    bool createOffscreenTarget()
+    {
+        m_targetFormat = wgpu::TextureFormat::RGBA8Unorm;
+        wgpu::TextureDescriptor textureDesc = wgpu::Default;
+        textureDesc.label = wgpu::StringView("Offscreen target");
+        textureDesc.dimension = wgpu::TextureDimension::_2D;
+        textureDesc.size = {m_options.width, m_options.height, 1};
+        textureDesc.format = m_targetFormat;
+        textureDesc.usage =
+            wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::CopySrc;
+        textureDesc.mipLevelCount = 1;
+        textureDesc.sampleCount = 1;
+        m_offscreenTexture = m_resources->createTexture(m_device, textureDesc);
+        if (!m_offscreenTexture) {
+            return false;
+        }
+        return true;
+    }
+
+    bool configureSurface(wgpu::Adapter adapter)
+    {
         wgpu::SurfaceConfiguration config = wgpu::Default;
 
         // Configuration of the textures created for the underlying swap chain
-        config.width = 640;
-        config.height = 480;
+        config.width = m_options.width;
+        config.height = m_options.height;
         config.device = m_device;
         // We initialize an empty capability struct:
         wgpu::SurfaceCapabilities capabilities = wgpu::Default;
@@ -113,80 +838,42 @@ public:
         // From the capabilities, we get the preferred format: it is always the first one!
         // (NB: There is always at least 1 format if the GetCapabilities was successful)
         config.format = capabilities.formats[0];
+        m_targetFormat = config.format;
+
+        config.presentMode = selectPresentMode(
+            capabilities.presentModes,
+            capabilities.presentModeCount,
+            m_options.presentMode);
+        std::cout << "Present mode: " << presentModeName(config.presentMode)
+                  << std::endl;
 
         // We no longer need to access the capabilities, so we release their memory.
         capabilities.freeMembers();
-        config.presentMode = wgpu::PresentMode::Fifo;
         config.alphaMode = wgpu::CompositeAlphaMode::Auto;
 
         m_surface.configure(config); // NEW
-
-        // We no longer need to access the adapter
-        adapter.release();
-
         return true;
     }
 
-    // Uninitialize everything that was initialized
-    void terminate()
-    {
-        m_surface.unconfigure();
-        m_queue.release();
-        m_surface.release();
-        m_device.release();
-        glfwDestroyWindow(m_window);
-        glfwTerminate();
-    }
-
-    // Draw a frame and handle events
-    void mainLoop()
+    wgpu::TextureView getNextTargetView()
     {
-        glfwPollEvents();
-        m_instance.processEvents();
-
-        wgpu::TextureView targetView = getNextSurfaceView();
-        if (!targetView) return; // no surface texture, we skip this frame
-        wgpu::CommandEncoderDescriptor encoderDesc = wgpu::Default;
-        encoderDesc.label = wgpu::StringView("My command encoder");
-        wgpu::CommandEncoder encoder = m_device.createCommandEncoder(encoderDesc);
-        wgpu::RenderPassDescriptor renderPassDesc = wgpu::Default;
-        wgpu::RenderPassColorAttachment colorAttachment = wgpu::Default;
-
-        colorAttachment.view = targetView;
-        colorAttachment.loadOp = wgpu::LoadOp::Clear;
-        colorAttachment.storeOp = wgpu::StoreOp::Store;
-        colorAttachment.clearValue = wgpu::Color{ 0.5, 0.5, 0.5, 1.0 };
-
-        renderPassDesc.colorAttachmentCount = 1;
-        renderPassDesc.colorAttachments = &colorAttachment;
-
-        wgpu::RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
-        // Use the render pass here (we do nothing with the render pass for now)
-        renderPass.end();
-        renderPass.release();
-        wgpu::CommandBufferDescriptor cmdBufferDescriptor = wgpu::Default;
-        cmdBufferDescriptor.label = wgpu::StringView("Command buffer");
-        wgpu::CommandBuffer command = encoder.finish(cmdBufferDescriptor);
-        encoder.release();
-
-        // Finally submit the command queue
-        m_queue.submit(command);
-        command.release();
-        // At the end of the frame
-        targetView.release();
-#ifndef __EMSCRIPTEN__
-        wgpuSurfacePresent(m_surface);
-#endif
+        if (m_offscreenTexture) {
+            wgpu::TextureViewDescriptor viewDescriptor = wgpu::Default;
+            viewDescriptor.label = wgpu::StringView("Offscreen texture view");
+            viewDescriptor.dimension = wgpu::TextureViewDimension::_2D;
+            return offscreenTexture().createView(viewDescriptor);
+        }
+        return getNextSurfaceView();
     }
 
-    // Return true as long as the main loop should keep on running
-    bool isRunning() const { return !glfwWindowShouldClose(m_window); }
-
-private:
     wgpu::TextureView getNextSurfaceView()
     {
         wgpu::SurfaceTexture surfaceTexture = wgpu::Default;
-        m_surface.getCurrentTexture(&surfaceTexture);
+        {
+            // Blocks while the presentation engine has no image free
+            MetricTimer waitTimer(MetricHistogram::SurfaceWaitMs);
+            m_surface.getCurrentTexture(&surfaceTexture);
+        }
         if (
             surfaceTexture.status != wgpu::SurfaceGetCurrentTextureStatus::SuccessOptimal &&
             surfaceTexture.status != wgpu::SurfaceGetCurrentTextureStatus::SuccessSuboptimal
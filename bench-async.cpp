@@ -0,0 +1,179 @@
+#include "microbench.h"
+#include "webgpu-async.h"
+#include "webgpu-utils.h"
+
+// Measures how long requestAdapterSync, requestDeviceSync and
+// fetchBufferDataSync wait, compared with the former implementation that
+// polled wgpuInstanceProcessEvents every 200 ms.
+
+namespace {
+
+constexpr unsigned int kLegacyPollMs = 200;
+
+struct LegacyRequest
+{
+    bool  ended  = false;
+    void* result = nullptr;
+};
+
+void legacyWait(WGPUInstance instance, const LegacyRequest& request)
+{
+    wgpuInstanceProcessEvents(instance);
+    while (!request.ended) {
+        sleepForMilliseconds(kLegacyPollMs);
+        wgpuInstanceProcessEvents(instance);
+    }
+}
+
+WGPUAdapter legacyRequestAdapter(
+    WGPUInstance                     instance,
+    WGPURequestAdapterOptions const* options)
+{
+    LegacyRequest                  request;
+    WGPURequestAdapterCallbackInfo callbackInfo = {
+        nullptr,
+        WGPUCallbackMode_AllowProcessEvents,
+        [](WGPURequestAdapterStatus status,
+           WGPUAdapter              adapter,
+           WGPUStringView,
+           void* userdata1,
+           void*) {
+            auto& request  = *reinterpret_cast<LegacyRequest*>(userdata1);
+            request.result = status == WGPURequestAdapterStatus_Success ?
+                                 adapter :
+                                 nullptr;
+            request.ended  = true;
+        },
+        &request,
+        nullptr};
+    wgpuInstanceRequestAdapter(instance, options, callbackInfo);
+    legacyWait(instance, request);
+    return reinterpret_cast<WGPUAdapter>(request.result);
+}
+
+WGPUDevice legacyRequestDevice(WGPUInstance instance, WGPUAdapter adapter)
+{
+    LegacyRequest                 request;
+    WGPUDeviceDescriptor          deviceDesc   = WGPU_DEVICE_DESCRIPTOR_INIT;
+    WGPURequestDeviceCallbackInfo callbackInfo = {
+        nullptr,
+        WGPUCallbackMode_AllowProcessEvents,
+        [](WGPURequestDeviceStatus status,
+           WGPUDevice              device,
+           WGPUStringView,
+           void* userdata1,
+           void*) {
+            auto& request  = *reinterpret_cast<LegacyRequest*>(userdata1);
+            request.result = status == WGPURequestDeviceStatus_Success ?
+                                 device :
+                                 nullptr;
+            request.ended  = true;
+        },
+        &request,
+        nullptr};
+    wgpuAdapterRequestDevice(adapter, &deviceDesc, callbackInfo);
+    legacyWait(instance, request);
+    return reinterpret_cast<WGPUDevice>(request.result);
+}
+
+void legacyMapRead(WGPUInstance instance, WGPUBuffer buffer)
+{
+    LegacyRequest             request;
+    WGPUBufferMapCallbackInfo callbackInfo = WGPU_BUFFER_MAP_CALLBACK_INFO_INIT;
+    callbackInfo.mode                      = WGPUCallbackMode_AllowProcessEvents;
+    callbackInfo.callback = [](WGPUMapAsyncStatus, WGPUStringView, void* u, void*) {
+        reinterpret_cast<LegacyRequest*>(u)->ended = true;
+    };
+    callbackInfo.userdata1 = &request;
+    wgpuBufferMapAsync(
+        buffer, WGPUMapMode_Read, 0, WGPU_WHOLE_MAP_SIZE, callbackInfo);
+    legacyWait(instance, request);
+    wgpuBufferUnmap(buffer);
+}
+
+// Record and submit a small copy into `readback` so that mapping it has to
+// wait for the queue
+void submitCopy(const BenchContext& ctx, WGPUBuffer source, WGPUBuffer readback)
+{
+    WGPUCommandEncoder encoder =
+        wgpuDeviceCreateCommandEncoder(ctx.device, nullptr);
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, source, 0, readback, 0, 256);
+    WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+    wgpuQueueSubmit(ctx.queue, 1, &commands);
+    wgpuCommandBufferRelease(commands);
+    wgpuCommandEncoderRelease(encoder);
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "async-wait",
+    "adapter/device request and buffer readback wait, 200 ms polling vs "
+    "WaitAny futures")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+
+    WGPURequestAdapterOptions adapterOpts = WGPU_REQUEST_ADAPTER_OPTIONS_INIT;
+    fillAdapterOptions(opts, adapterOpts);
+
+    WGPUBufferDescriptor sourceDesc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    sourceDesc.usage = WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst;
+    sourceDesc.size  = 256;
+    WGPUBuffer source = wgpuDeviceCreateBuffer(ctx.device, &sourceDesc);
+
+    WGPUBufferDescriptor readbackDesc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    readbackDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+    readbackDesc.size  = 256;
+    WGPUBuffer readback = wgpuDeviceCreateBuffer(ctx.device, &readbackDesc);
+
+    std::vector<double> legacyAdapter, legacyDevice, legacyReadback;
+    std::vector<double> futureAdapter, futureDevice, futureReadback;
+
+    for (unsigned int i = 0; i < opts.iterations; ++i) {
+        auto        start   = std::chrono::steady_clock::now();
+        WGPUAdapter adapter = legacyRequestAdapter(ctx.instance, &adapterOpts);
+        legacyAdapter.push_back(elapsedMs(start));
+
+        start             = std::chrono::steady_clock::now();
+        WGPUDevice device = legacyRequestDevice(ctx.instance, adapter);
+        legacyDevice.push_back(elapsedMs(start));
+        wgpuDeviceRelease(device);
+        wgpuAdapterRelease(adapter);
+
+        submitCopy(ctx, source, readback);
+        start = std::chrono::steady_clock::now();
+        legacyMapRead(ctx.instance, readback);
+        legacyReadback.push_back(elapsedMs(start));
+
+        start   = std::chrono::steady_clock::now();
+        adapter = requestAdapterSync(ctx.instance, &adapterOpts);
+        futureAdapter.push_back(elapsedMs(start));
+
+        WGPUDeviceDescriptor deviceDesc = WGPU_DEVICE_DESCRIPTOR_INIT;
+        start  = std::chrono::steady_clock::now();
+        device = requestDeviceSync(ctx.instance, adapter, &deviceDesc);
+        futureDevice.push_back(elapsedMs(start));
+        wgpuDeviceRelease(device);
+        wgpuAdapterRelease(adapter);
+
+        submitCopy(ctx, source, readback);
+        start = std::chrono::steady_clock::now();
+        fetchBufferDataSync(ctx.instance, readback, [](const void*) {});
+        futureReadback.push_back(elapsedMs(start));
+    }
+
+    wgpuBufferRelease(readback);
+    wgpuBufferRelease(source);
+
+    BenchReport report("async-wait");
+    report.addSeries("legacy_request_adapter_ms", std::move(legacyAdapter));
+    report.addSeries("legacy_request_device_ms", std::move(legacyDevice));
+    report.addSeries("legacy_readback_ms", std::move(legacyReadback));
+    report.addSeries("future_request_adapter_ms", std::move(futureAdapter));
+    report.addSeries("future_request_device_ms", std::move(futureDevice));
+    report.addSeries("future_readback_ms", std::move(futureReadback));
+    return report.write(opts) ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include "binding-cache.h"
+#include "microbench.h"
+#include "webgpu-utils.h"
+
+#include <vector>
+
+// CPU cost of the binding objects of a frame of draws, each draw asking for
+// its sampler, bind group layout, pipeline layout and bind group: created
+// and released every time versus served by a BindingCache.
+
+namespace {
+
+constexpr uint32_t kDrawsPerFrame = 1000;
+constexpr uint32_t kUniformSlots  = 64; // distinct buffer offsets
+constexpr uint32_t kSamplerKinds  = 4;
+constexpr uint64_t kUniformStride = 256;
+constexpr uint64_t kUniformSize   = 64;
+
+struct DrawBindings
+{
+    WGPUSampler         sampler         = nullptr;
+    WGPUBindGroupLayout bindGroupLayout = nullptr;
+    WGPUPipelineLayout  pipelineLayout  = nullptr;
+    WGPUBindGroup       bindGroup       = nullptr;
+
+    void release()
+    {
+        wgpuBindGroupRelease(bindGroup);
+        wgpuPipelineLayoutRelease(pipelineLayout);
+        wgpuBindGroupLayoutRelease(bindGroupLayout);
+        wgpuSamplerRelease(sampler);
+    }
+};
+
+// The requests of draw `i`, as a renderer without its own caching would
+// issue them
+DrawBindings requestBindings(
+    WGPUDevice    device,
+    WGPUBuffer    uniforms,
+    uint32_t      i,
+    BindingCache* cache)
+{
+    DrawBindings bindings;
+
+    uint32_t              samplerKind = i % kSamplerKinds;
+    WGPUSamplerDescriptor samplerDesc = WGPU_SAMPLER_DESCRIPTOR_INIT;
+    samplerDesc.magFilter             = WGPUFilterMode_Linear;
+    samplerDesc.minFilter             = WGPUFilterMode_Linear;
+    samplerDesc.mipmapFilter          = WGPUMipmapFilterMode_Linear;
+    if (samplerKind & 1) {
+        samplerDesc.addressModeU = WGPUAddressMode_Repeat;
+    }
+    if (samplerKind & 2) {
+        samplerDesc.maxAnisotropy = 4;
+    }
+    bindings.sampler = createSampler(device, &samplerDesc, cache);
+
+    WGPUBindGroupLayoutEntry layoutEntries[2] = {
+        WGPU_BIND_GROUP_LAYOUT_ENTRY_INIT,
+        WGPU_BIND_GROUP_LAYOUT_ENTRY_INIT};
+    layoutEntries[0].binding     = 0;
+    layoutEntries[0].visibility  = WGPUShaderStage_Vertex;
+    layoutEntries[0].buffer.type = WGPUBufferBindingType_Uniform;
+    layoutEntries[0].buffer.minBindingSize = kUniformSize;
+    layoutEntries[1].binding               = 1;
+    layoutEntries[1].visibility            = WGPUShaderStage_Fragment;
+    layoutEntries[1].sampler.type = WGPUSamplerBindingType_Filtering;
+    WGPUBindGroupLayoutDescriptor layoutDesc =
+        WGPU_BIND_GROUP_LAYOUT_DESCRIPTOR_INIT;
+    layoutDesc.entryCount = 2;
+    layoutDesc.entries    = layoutEntries;
+    bindings.bindGroupLayout =
+        createBindGroupLayout(device, &layoutDesc, cache);
+
+    WGPUPipelineLayoutDescriptor pipelineLayoutDesc =
+        WGPU_PIPELINE_LAYOUT_DESCRIPTOR_INIT;
+    pipelineLayoutDesc.bindGroupLayoutCount = 1;
+    pipelineLayoutDesc.bindGroupLayouts     = &bindings.bindGroupLayout;
+    bindings.pipelineLayout =
+        createPipelineLayout(device, &pipelineLayoutDesc, cache);
+
+    WGPUBindGroupEntry entries[2] = {
+        WGPU_BIND_GROUP_ENTRY_INIT, WGPU_BIND_GROUP_ENTRY_INIT};
+    entries[0].binding = 0;
+    entries[0].buffer  = uniforms;
+    entries[0].offset  = (i % kUniformSlots) * kUniformStride;
+    entries[0].size    = kUniformSize;
+    entries[1].binding = 1;
+    entries[1].sampler = bindings.sampler;
+    WGPUBindGroupDescriptor bindGroupDesc = WGPU_BIND_GROUP_DESCRIPTOR_INIT;
+    bindGroupDesc.layout                  = bindings.bindGroupLayout;
+    bindGroupDesc.entryCount              = 2;
+    bindGroupDesc.entries                 = entries;
+    bindings.bindGroup = createBindGroup(device, &bindGroupDesc, cache);
+
+    return bindings;
+}
+
+double runFrame(BenchContext& ctx, WGPUBuffer uniforms, BindingCache* cache)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kDrawsPerFrame; ++i) {
+        requestBindings(ctx.device, uniforms, i, cache).release();
+    }
+    return elapsedMs(start);
+}
+
+double hitRate(const BindingCache::Counters& counters)
+{
+    uint64_t requests = counters.hits + counters.misses;
+    return requests > 0 ? double(counters.hits) / requests : 0.0;
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "binding-cache",
+    "1000 draws of sampler/layouts/bind group requests, uncached vs cached")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+
+    WGPUBufferDescriptor bufferDesc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    bufferDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+    bufferDesc.size  = kUniformSlots * kUniformStride;
+    WGPUBuffer uniforms = wgpuDeviceCreateBuffer(ctx.device, &bufferDesc);
+
+    std::vector<double> uncachedMs, cachedMs;
+    BindingCache        cache(ctx.device);
+    // Warm up both paths, the first cached frame creates everything
+    runFrame(ctx, uniforms, nullptr);
+    double firstFrameMs = runFrame(ctx, uniforms, &cache);
+    for (unsigned int i = 0; i < opts.iterations; ++i) {
+        uncachedMs.push_back(runFrame(ctx, uniforms, nullptr));
+        cachedMs.push_back(runFrame(ctx, uniforms, &cache));
+    }
+    BindingCache::Stats stats = cache.stats();
+
+    BenchReport report("binding-cache");
+    report.addValue("draws_per_frame", kDrawsPerFrame);
+    report.addSeries("uncached_frame_ms", std::move(uncachedMs));
+    report.addValue("cached_first_frame_ms", firstFrameMs);
+    report.addSeries("cached_frame_ms", std::move(cachedMs));
+    report.addValue("sampler_hit_rate", hitRate(stats.samplers));
+    report.addValue(
+        "bind_group_layout_hit_rate", hitRate(stats.bindGroupLayouts));
+    report.addValue("pipeline_layout_hit_rate", hitRate(stats.pipelineLayouts));
+    report.addValue("bind_group_hit_rate", hitRate(stats.bindGroups));
+    report.addValue("cached_bind_groups", stats.bindGroups.size);
+
+    cache.clear();
+    wgpuBufferRelease(uniforms);
+    return report.write(opts) ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#include "buffer-allocator.h"
+#include "microbench.h"
+
+#include <cstring>
+#include <vector>
+
+// Per-frame uniform data for many draws: one buffer per draw versus
+// sub-allocations of the FrameRingAllocator uploaded in one writeBuffer.
+
+namespace {
+
+constexpr uint32_t kDrawsPerFrame = 10000;
+constexpr uint64_t kUniformSize   = 64;
+
+} // namespace
+
+MICROBENCHMARK(
+    "buffer-allocator",
+    "10k per-draw uniforms per frame, one buffer each vs FrameRingAllocator")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+
+    float               uniforms[kUniformSize / sizeof(float)] = {};
+    std::vector<double> perBufferMs, ringMs;
+
+    for (unsigned int frame = 0; frame < opts.iterations; ++frame) {
+        auto                    start = std::chrono::steady_clock::now();
+        std::vector<WGPUBuffer> buffers;
+        buffers.reserve(kDrawsPerFrame);
+        for (uint32_t draw = 0; draw < kDrawsPerFrame; ++draw) {
+            WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+            desc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+            desc.size  = kUniformSize;
+            WGPUBuffer buffer = wgpuDeviceCreateBuffer(ctx.device, &desc);
+            wgpuQueueWriteBuffer(
+                ctx.queue, buffer, 0, uniforms, sizeof(uniforms));
+            buffers.push_back(buffer);
+        }
+        wgpuQueueSubmit(ctx.queue, 0, nullptr);
+        for (WGPUBuffer buffer : buffers) {
+            wgpuBufferRelease(buffer);
+        }
+        perBufferMs.push_back(elapsedMs(start));
+    }
+
+    FrameRingAllocator ring(ctx.device, kDrawsPerFrame * 256, 3);
+    for (unsigned int frame = 0; frame < opts.iterations; ++frame) {
+        auto start = std::chrono::steady_clock::now();
+        ring.beginFrame(frame);
+        for (uint32_t draw = 0; draw < kDrawsPerFrame; ++draw) {
+            RingAllocation allocation = ring.allocate(kUniformSize);
+            std::memcpy(allocation.data, uniforms, sizeof(uniforms));
+        }
+        ring.flush(ctx.queue);
+        wgpuQueueSubmit(ctx.queue, 0, nullptr);
+        ringMs.push_back(elapsedMs(start));
+    }
+
+    AllocatorStats stats = ring.stats();
+
+    BenchReport report("buffer-allocator");
+    report.addSeries("per_buffer_frame_ms", std::move(perBufferMs));
+    report.addSeries("ring_frame_ms", std::move(ringMs));
+    report.addValue("ring_bytes_used", (double) stats.bytesUsed);
+    report.addValue("ring_bytes_padding", (double) stats.bytesPadding);
+    report.addValue("ring_bytes_reserved", (double) stats.bytesReserved);
+    report.addValue("ring_buffer_count", stats.bufferCount);
+    return report.write(opts) ? 0 : 1;
+}
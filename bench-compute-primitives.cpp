@@ -0,0 +1,269 @@
+#include "compute-primitives.h"
+#include "microbench.h"
+#include "webgpu-async.h"
+#include "webgpu-utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <execution>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Throughput of the GPU compute primitives on 1M values, against the
+// parallel standard algorithms on the CPU. The GPU results are read back and
+// compared with the CPU ones; the Null backend runs no shaders, so the
+// comparison is skipped there.
+
+namespace {
+
+constexpr uint32_t kCount = 1 << 20;
+
+const char* kCompactPredicate = "x >= 128u";
+
+// Encode with `record`, submit and wait for the GPU; return the elapsed ms
+double runOnGpu(
+    const BenchContext&                            ctx,
+    const std::function<void(WGPUCommandEncoder)>& record)
+{
+    auto               start = std::chrono::steady_clock::now();
+    WGPUCommandEncoder encoder =
+        wgpuDeviceCreateCommandEncoder(ctx.device, nullptr);
+    record(encoder);
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, nullptr);
+    wgpuCommandEncoderRelease(encoder);
+    wgpuQueueSubmit(ctx.queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+    onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+    return elapsedMs(start);
+}
+
+std::vector<uint32_t> download(
+    const BenchContext& ctx,
+    WGPUBuffer          buffer,
+    uint32_t            count)
+{
+    std::vector<uint32_t> result(count);
+    if (count == 0)
+        return result;
+    uint64_t             size = uint64_t(count) * sizeof(uint32_t);
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    desc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+    desc.size  = size;
+    WGPUBuffer readback = wgpuDeviceCreateBuffer(ctx.device, &desc);
+    runOnGpu(ctx, [&](WGPUCommandEncoder encoder) {
+        wgpuCommandEncoderCopyBufferToBuffer(
+            encoder, buffer, 0, readback, 0, size);
+    });
+    fetchBufferDataSync(ctx.instance, readback, [&](const void* data) {
+        std::memcpy(result.data(), data, size);
+    });
+    wgpuBufferRelease(readback);
+    return result;
+}
+
+// Time `cpu` and `gpu` over the iterations, after one untimed run of each
+// (pipeline creation, first touch of the memory)
+void measure(
+    const BenchOptions&                            opts,
+    const BenchContext&                            ctx,
+    BenchReport&                                   report,
+    const std::string&                             name,
+    const std::function<void()>&                   cpu,
+    const std::function<void()>&                   prepare,
+    const std::function<void(WGPUCommandEncoder)>& gpu)
+{
+    std::vector<double> cpuMs, gpuMs;
+    for (unsigned int i = 0; i <= opts.iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        cpu();
+        double cpuTime = elapsedMs(start);
+
+        if (prepare) {
+            prepare();
+            onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+        }
+        double gpuTime = runOnGpu(ctx, gpu);
+        if (i > 0) {
+            cpuMs.push_back(cpuTime);
+            gpuMs.push_back(gpuTime);
+        }
+    }
+    double gpuMean = computeSampleStats(gpuMs).mean;
+    if (gpuMean > 0) {
+        report.addValue(name + "_gpu_melems_per_s", kCount / gpuMean / 1e3);
+    }
+    report.addSeries(name + "_cpu_ms", std::move(cpuMs));
+    report.addSeries(name + "_gpu_ms", std::move(gpuMs));
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "compute-primitives",
+    "reduce/scan/compaction/radix sort of 1M u32 vs parallel std algorithms")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+    bool check = opts.backend != WGPUBackendType_Null;
+
+    std::vector<uint32_t>           input(kCount);
+    std::mt19937                    random(42);
+    std::uniform_int_distribution<> distribution(0, 255);
+    for (uint32_t& value : input) {
+        value = distribution(random);
+    }
+    std::vector<uint32_t> indices(kCount);
+    std::iota(indices.begin(), indices.end(), 0u);
+
+    uint64_t        size  = uint64_t(kCount) * sizeof(uint32_t);
+    WGPUBufferUsage usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc |
+                            WGPUBufferUsage_CopyDst;
+
+    WGPUBuffer data    = ctx.createBuffer(usage, size, input.data(), "Input");
+    WGPUBuffer result  = ctx.createBuffer(usage, size, nullptr, "Result");
+    WGPUBuffer counter = ctx.createBuffer(usage, 4, nullptr, "Counter");
+    WGPUBuffer keys    = ctx.createBuffer(usage, size, nullptr, "Keys");
+    WGPUBuffer values  = ctx.createBuffer(usage, size, nullptr, "Values");
+
+    PipelineRegistry  registry(ctx.device);
+    ComputePrimitives primitives(ctx.device, registry);
+
+    BenchReport report("compute-primitives");
+    report.addValue("count", kCount);
+    report.addValue("workgroup_size", primitives.workgroupSize());
+    bool allCorrect = true;
+    auto verify     = [&](const std::string& name, bool correct) {
+        report.addValue(name + "_correct", correct);
+        allCorrect = allCorrect && correct;
+    };
+
+    // Reduce
+    uint32_t cpuSum = 0;
+    measure(
+        opts,
+        ctx,
+        report,
+        "reduce",
+        [&] {
+            cpuSum =
+                std::reduce(std::execution::par, input.begin(), input.end());
+        },
+        {},
+        [&](WGPUCommandEncoder encoder) {
+            primitives.reduce(encoder, data, result, kCount);
+        });
+    if (check) {
+        verify("reduce", download(ctx, result, 1)[0] == cpuSum);
+    }
+
+    // Exclusive scan; std::exclusive_scan is the baseline since the GPU scan
+    // is exclusive too
+    std::vector<uint32_t> cpuScan(kCount);
+    std::pair<const char*, ComputePrimitives::ScanAlgorithm> scans[] = {
+        {"scan_lookback", ComputePrimitives::ScanAlgorithm::DecoupledLookback},
+        {"scan_reduce_then_scan",
+         ComputePrimitives::ScanAlgorithm::ReduceThenScan}};
+    for (auto [name, algorithm] : scans) {
+        measure(
+            opts,
+            ctx,
+            report,
+            name,
+            [&] {
+                std::exclusive_scan(
+                    std::execution::par,
+                    input.begin(),
+                    input.end(),
+                    cpuScan.begin(),
+                    0u);
+            },
+            {},
+            [&](WGPUCommandEncoder encoder) {
+                primitives.exclusiveScan(
+                    encoder, data, result, kCount, algorithm);
+            });
+        if (check) {
+            verify(name, download(ctx, result, kCount) == cpuScan);
+        }
+    }
+
+    // Stream compaction
+    std::vector<uint32_t> cpuCompact(kCount);
+    size_t                cpuKept = 0;
+    measure(
+        opts,
+        ctx,
+        report,
+        "compact",
+        [&] {
+            cpuKept = std::copy_if(
+                          std::execution::par,
+                          input.begin(),
+                          input.end(),
+                          cpuCompact.begin(),
+                          [](uint32_t x) { return x >= 128; }) -
+                      cpuCompact.begin();
+        },
+        {},
+        [&](WGPUCommandEncoder encoder) {
+            primitives.compact(
+                encoder, data, result, counter, kCount, kCompactPredicate);
+        });
+    if (check) {
+        uint32_t gpuKept = download(ctx, counter, 1)[0];
+        cpuCompact.resize(cpuKept);
+        verify(
+            "compact",
+            gpuKept == cpuKept && download(ctx, result, gpuKept) == cpuCompact);
+    }
+
+    // Key/value sort, the values being the original indices. Sorting the
+    // pairs orders equal keys by index, which is what a stable sort gives.
+    std::vector<std::pair<uint32_t, uint32_t>> cpuPairs(kCount);
+    measure(
+        opts,
+        ctx,
+        report,
+        "sort",
+        [&] {
+            for (uint32_t i = 0; i < kCount; ++i) {
+                cpuPairs[i] = {input[i], i};
+            }
+            std::sort(std::execution::par, cpuPairs.begin(), cpuPairs.end());
+        },
+        [&] {
+            wgpuQueueWriteBuffer(ctx.queue, keys, 0, input.data(), size);
+            wgpuQueueWriteBuffer(ctx.queue, values, 0, indices.data(), size);
+        },
+        [&](WGPUCommandEncoder encoder) {
+            primitives.radixSort(encoder, keys, values, kCount);
+        });
+    if (check) {
+        std::vector<uint32_t> gpuKeys   = download(ctx, keys, kCount);
+        std::vector<uint32_t> gpuValues = download(ctx, values, kCount);
+        bool                  sorted    = true;
+        for (uint32_t i = 0; i < kCount && sorted; ++i) {
+            sorted = gpuKeys[i] == cpuPairs[i].first &&
+                     gpuValues[i] == cpuPairs[i].second;
+        }
+        verify("sort", sorted);
+    }
+
+    for (WGPUBuffer buffer : {data, result, counter, keys, values}) {
+        wgpuBufferRelease(buffer);
+    }
+    if (!report.write(opts))
+        return 1;
+    if (!allCorrect) {
+        std::cerr << "GPU results differ from the CPU ones" << std::endl;
+        return 1;
+    }
+    return 0;
+}
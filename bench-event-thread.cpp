@@ -0,0 +1,128 @@
+#include "event-thread.h"
+#include "microbench.h"
+
+#include <thread>
+#include <vector>
+
+// Latency from submitting a copy into a mappable buffer to noticing that its
+// mapping is done, at several frame rates: polled at frame boundaries by the
+// render loop, as processEvents() in mainLoop did, versus observed by the
+// EventThread.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint64_t kBufferSize = 1 << 20;
+
+double msBetween(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// Submit a copy into `readback` and request its mapping
+Future<AsyncStatus> submitReadback(
+    const BenchContext& ctx,
+    WGPUBuffer          source,
+    WGPUBuffer          readback)
+{
+    WGPUCommandEncoder encoder =
+        wgpuDeviceCreateCommandEncoder(ctx.device, nullptr);
+    wgpuCommandEncoderCopyBufferToBuffer(
+        encoder, source, 0, readback, 0, kBufferSize);
+    WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+    wgpuQueueSubmit(ctx.queue, 1, &commands);
+    wgpuCommandBufferRelease(commands);
+    wgpuCommandEncoderRelease(encoder);
+    return mapBufferAsync(
+        ctx.instance, readback, WGPUMapMode_Read, 0, kBufferSize);
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "event-thread",
+    "map completion latency, polled per frame vs EventThread, 30-240 fps")
+{
+    // The event thread uses the device while this thread submits
+    WGPUDeviceDescriptor deviceDesc = WGPU_DEVICE_DESCRIPTOR_INIT;
+#ifdef WEBGPU_BACKEND_DAWN
+    WGPUFeatureName features[] = {
+        WGPUFeatureName_ImplicitDeviceSynchronization};
+    deviceDesc.requiredFeatureCount = 1;
+    deviceDesc.requiredFeatures     = features;
+#endif
+    BenchContext ctx;
+    if (!ctx.open(opts, &deviceDesc)) {
+        return 1;
+    }
+
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    desc.usage                = WGPUBufferUsage_CopySrc;
+    desc.size                 = kBufferSize;
+    WGPUBuffer source         = wgpuDeviceCreateBuffer(ctx.device, &desc);
+
+    desc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+    WGPUBuffer readback = wgpuDeviceCreateBuffer(ctx.device, &desc);
+
+    BenchReport report("event-thread");
+    EventThread events(ctx.instance);
+
+    for (double fps : {30.0, 60.0, 120.0, 240.0}) {
+        auto frame = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / fps));
+        std::vector<double> polledMs;
+        std::vector<double> threadMs;
+        std::vector<double> dispatchedMs;
+
+        // The render loop checks the future once per frame
+        for (uint32_t i = 0; i < opts.iterations; ++i) {
+            Clock::time_point   submitted = Clock::now();
+            Future<AsyncStatus> mapped =
+                submitReadback(ctx, source, readback);
+            Clock::time_point boundary = submitted;
+            do {
+                boundary += frame;
+                std::this_thread::sleep_until(boundary);
+            } while (!mapped.wait(0));
+            polledMs.push_back(msBetween(submitted, Clock::now()));
+            wgpuBufferUnmap(readback);
+        }
+
+        // The event thread stamps the completion; the callback still runs
+        // at the next frame boundary
+        for (uint32_t i = 0; i < opts.iterations; ++i) {
+            Clock::time_point   submitted = Clock::now();
+            Clock::time_point   completed;
+            bool                done = false;
+            Future<AsyncStatus> mapped =
+                submitReadback(ctx, source, readback);
+            events.watch(mapped, [&](Clock::time_point completedAt) {
+                completed = completedAt;
+                done      = true;
+            });
+            Clock::time_point boundary = submitted;
+            while (!done) {
+                boundary += frame;
+                std::this_thread::sleep_until(boundary);
+                events.dispatch();
+            }
+            threadMs.push_back(msBetween(submitted, completed));
+            dispatchedMs.push_back(msBetween(submitted, Clock::now()));
+            wgpuBufferUnmap(readback);
+        }
+
+        std::string prefix = std::to_string(int(fps)) + "fps_";
+        report.addSeries(prefix + "polled_ms", std::move(polledMs));
+        report.addSeries(prefix + "event_thread_ms", std::move(threadMs));
+        report.addSeries(
+            prefix + "event_thread_dispatched_ms", std::move(dispatchedMs));
+    }
+
+    EventThread::Stats stats = events.stats();
+    report.addValue("process_events_calls", (double) stats.processCalls);
+
+    wgpuBufferRelease(readback);
+    wgpuBufferRelease(source);
+    return report.write(opts) ? 0 : 1;
+}
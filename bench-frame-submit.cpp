@@ -0,0 +1,189 @@
+#include "job-system.h"
+#include "microbench.h"
+#include "parallel-recorder.h"
+#include "webgpu-async.h"
+
+#include <string>
+#include <vector>
+
+// A frame of 16 subsystems, 4 per stage (uploads, compute, render,
+// readback), each recording a little work: every subsystem with its own
+// encoder, labelled with a heap string, and its own queue submit, versus
+// the stage encoders of a ParallelRecorder, labels from its frame arena,
+// and one submit.
+
+namespace {
+
+constexpr uint32_t kSubsystemsPerStage = 4;
+constexpr uint32_t kBufferSize         = 4096;
+constexpr uint32_t kTargetSize         = 64;
+
+struct Resources
+{
+    WGPUBuffer      source   = nullptr;
+    WGPUBuffer      storage  = nullptr;
+    WGPUBuffer      readback = nullptr;
+    WGPUTexture     texture  = nullptr;
+    WGPUTextureView target   = nullptr;
+};
+
+void recordWork(
+    const Resources&   resources,
+    SubmitStage        stage,
+    uint32_t           subsystem,
+    WGPUCommandEncoder encoder,
+    WGPUStringView     label)
+{
+    uint64_t offset = subsystem * 256;
+    switch (stage) {
+    case SubmitStage::Upload:
+        wgpuCommandEncoderCopyBufferToBuffer(
+            encoder, resources.source, offset, resources.storage, offset, 256);
+        break;
+    case SubmitStage::Compute:
+        wgpuCommandEncoderClearBuffer(
+            encoder, resources.storage, offset + 2048, 256);
+        break;
+    case SubmitStage::Render: {
+        WGPURenderPassColorAttachment colorAttachment =
+            WGPU_RENDER_PASS_COLOR_ATTACHMENT_INIT;
+        colorAttachment.view       = resources.target;
+        colorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
+        colorAttachment.loadOp     = WGPULoadOp_Clear;
+        colorAttachment.storeOp    = WGPUStoreOp_Store;
+        WGPURenderPassDescriptor passDesc = WGPU_RENDER_PASS_DESCRIPTOR_INIT;
+        passDesc.label                    = label;
+        passDesc.colorAttachmentCount     = 1;
+        passDesc.colorAttachments         = &colorAttachment;
+        WGPURenderPassEncoder pass =
+            wgpuCommandEncoderBeginRenderPass(encoder, &passDesc);
+        wgpuRenderPassEncoderEnd(pass);
+        wgpuRenderPassEncoderRelease(pass);
+        break;
+    }
+    case SubmitStage::Readback:
+        wgpuCommandEncoderCopyBufferToBuffer(
+            encoder,
+            resources.storage,
+            offset,
+            resources.readback,
+            offset,
+            256);
+        break;
+    case SubmitStage::Count:
+        break;
+    }
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "frame-submit",
+    "16 subsystems per frame, one submit each vs one batched submit")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+
+    Resources resources;
+    resources.source = ctx.createBuffer(
+        WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst, kBufferSize);
+    resources.storage = ctx.createBuffer(
+        WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc |
+            WGPUBufferUsage_CopyDst,
+        kBufferSize);
+    resources.readback = ctx.createBuffer(
+        WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, kBufferSize);
+    WGPUTextureDescriptor textureDesc = WGPU_TEXTURE_DESCRIPTOR_INIT;
+    textureDesc.usage         = WGPUTextureUsage_RenderAttachment;
+    textureDesc.dimension     = WGPUTextureDimension_2D;
+    textureDesc.size          = {kTargetSize, kTargetSize, 1};
+    textureDesc.format        = WGPUTextureFormat_RGBA8Unorm;
+    textureDesc.mipLevelCount = 1;
+    textureDesc.sampleCount   = 1;
+    resources.texture = wgpuDeviceCreateTexture(ctx.device, &textureDesc);
+    resources.target  = wgpuTextureCreateView(resources.texture, nullptr);
+
+    constexpr size_t kStageCount = size_t(SubmitStage::Count);
+
+    // One encoder and one submit per subsystem
+    std::vector<double> separateMs, separateSubmitMs;
+    for (unsigned int i = 0; i < opts.iterations; ++i) {
+        auto   start    = std::chrono::steady_clock::now();
+        double submitMs = 0;
+        for (size_t stage = 0; stage < kStageCount; ++stage) {
+            for (uint32_t j = 0; j < kSubsystemsPerStage; ++j) {
+                std::string label = "Subsystem " + std::to_string(j);
+                WGPUCommandEncoderDescriptor encoderDesc =
+                    WGPU_COMMAND_ENCODER_DESCRIPTOR_INIT;
+                encoderDesc.label = {label.data(), label.size()};
+                WGPUCommandEncoder encoder =
+                    wgpuDeviceCreateCommandEncoder(ctx.device, &encoderDesc);
+                recordWork(
+                    resources,
+                    SubmitStage(stage),
+                    j,
+                    encoder,
+                    encoderDesc.label);
+                WGPUCommandBuffer commands =
+                    wgpuCommandEncoderFinish(encoder, nullptr);
+                wgpuCommandEncoderRelease(encoder);
+
+                auto submitStart = std::chrono::steady_clock::now();
+                wgpuQueueSubmit(ctx.queue, 1, &commands);
+                submitMs += elapsedMs(submitStart);
+                wgpuCommandBufferRelease(commands);
+            }
+        }
+        separateMs.push_back(elapsedMs(start));
+        separateSubmitMs.push_back(submitMs);
+        onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+    }
+
+    // Shared stage encoders, one submit
+    JobSystem           jobs(1);
+    ParallelRecorder    recorder(jobs, ctx.device);
+    std::vector<double> batchedMs, batchedSubmitMs;
+    for (unsigned int i = 0; i < opts.iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t stage = 0; stage < kStageCount; ++stage) {
+            for (uint32_t j = 0; j < kSubsystemsPerStage; ++j) {
+                WGPUStringView label = recorder.arena().label("Subsystem ", j);
+                recordWork(
+                    resources,
+                    SubmitStage(stage),
+                    j,
+                    recorder.encoder(SubmitStage(stage)),
+                    label);
+            }
+        }
+        double submitted = recorder.stats().submitMs;
+        recorder.submit(ctx.queue);
+        batchedMs.push_back(elapsedMs(start));
+        batchedSubmitMs.push_back(recorder.stats().submitMs - submitted);
+        onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+    }
+    ParallelRecorder::Stats stats = recorder.stats();
+
+    BenchReport report("frame-submit");
+    report.addValue("subsystems", kSubsystemsPerStage * kStageCount);
+    report.addSeries("separate_frame_ms", std::move(separateMs));
+    report.addSeries("separate_submit_ms", std::move(separateSubmitMs));
+    report.addSeries("batched_frame_ms", std::move(batchedMs));
+    report.addSeries("batched_submit_ms", std::move(batchedSubmitMs));
+    report.addValue(
+        "batched_command_buffers_per_submit",
+        stats.submits > 0 ? double(stats.commandBuffers) / stats.submits : 0);
+    report.addValue("arena_peak_bytes", recorder.arena().stats().peakBytes);
+    report.addValue(
+        "arena_heap_allocations", recorder.arena().stats().heapAllocations);
+
+    wgpuTextureViewRelease(resources.target);
+    wgpuTextureDestroy(resources.texture);
+    wgpuTextureRelease(resources.texture);
+    wgpuBufferRelease(resources.source);
+    wgpuBufferRelease(resources.storage);
+    wgpuBufferRelease(resources.readback);
+    return report.write(opts) ? 0 : 1;
+}
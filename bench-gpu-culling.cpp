@@ -0,0 +1,455 @@
+#include "gpu-culling.h"
+#include "microbench.h"
+#include "pipeline-cache.h"
+#include "webgpu-async.h"
+#include "webgpu-utils.h"
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+// A field of 100k instances of two meshes seen by a turning camera: CPU
+// frustum culling with one drawIndexed per visible instance, versus
+// GpuCuller with one drawIndexedIndirect per mesh, with and without Hi-Z
+// occlusion culling. Reports the CPU time to cull and encode a frame and
+// the submit-to-done time of the frame.
+
+namespace {
+
+constexpr uint32_t kInstanceCount = 100000;
+constexpr uint32_t kTargetSize    = 512;
+constexpr float    kFieldSize     = 400;
+
+using Matrix = std::array<float, 16>; // column-major
+
+const char* kShaderHeader = R"(
+@group(0) @binding(0) var<uniform> viewProj: mat4x4f;
+@group(0) @binding(1) var<storage, read> instances: array<vec4f>;
+
+struct VertexOutput {
+    @builtin(position) position: vec4f,
+    @location(0) shade: f32,
+}
+)";
+
+const char* kDirectIndexSource = R"(
+fn instanceIndex(i: u32) -> u32 {
+    return i;
+}
+)";
+
+const char* kCulledIndexSource = R"(
+@group(1) @binding(0) var<storage, read> visible: array<u32>;
+
+fn instanceIndex(i: u32) -> u32 {
+    return visible[i];
+}
+)";
+
+const char* kShaderBody = R"(
+@vertex
+fn vs_main(
+    @location(0) position: vec3f,
+    @builtin(instance_index) i: u32
+) -> VertexOutput {
+    let instance = instances[instanceIndex(i)];
+    var out: VertexOutput;
+    out.position = viewProj * vec4f(instance.xyz + position * instance.w, 1.0);
+    out.shade = 0.5 + 0.5 * normalize(position).y;
+    return out;
+}
+
+@fragment
+fn fs_main(in: VertexOutput) -> @location(0) vec4f {
+    return vec4f(vec3f(in.shade), 1.0);
+}
+)";
+
+Matrix multiply(const Matrix& a, const Matrix& b)
+{
+    Matrix result = {};
+    for (int col = 0; col < 4; ++col) {
+        for (int row = 0; row < 4; ++row) {
+            for (int k = 0; k < 4; ++k) {
+                result[col * 4 + row] += a[k * 4 + row] * b[col * 4 + k];
+            }
+        }
+    }
+    return result;
+}
+
+// Camera at the origin turned by `yaw` around y, looking down -z
+Matrix viewProjection(float yaw)
+{
+    const float near  = 0.5f;
+    const float far   = 1000.0f;
+    const float focal = 1.0f / std::tan(0.5f * 1.0472f); // 60 degrees
+
+    Matrix projection = {};
+    projection[0]     = focal;
+    projection[5]     = focal;
+    projection[10]    = far / (near - far);
+    projection[11]    = -1;
+    projection[14]    = near * far / (near - far);
+
+    Matrix view = {};
+    view[0]     = std::cos(yaw);
+    view[2]     = std::sin(yaw);
+    view[5]     = 1;
+    view[8]     = -std::sin(yaw);
+    view[10]    = std::cos(yaw);
+    view[15]    = 1;
+    return multiply(projection, view);
+}
+
+// A cube and an octahedron in one vertex and index buffer
+struct Geometry
+{
+    std::vector<float>    positions;
+    std::vector<uint32_t> indices;
+    std::vector<CullMesh> meshes;
+};
+
+Geometry createGeometry()
+{
+    Geometry geometry;
+    for (int i = 0; i < 8; ++i) {
+        geometry.positions.push_back(i & 1 ? 0.577f : -0.577f);
+        geometry.positions.push_back(i & 2 ? 0.577f : -0.577f);
+        geometry.positions.push_back(i & 4 ? 0.577f : -0.577f);
+    }
+    geometry.indices = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                        2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+    geometry.meshes.push_back({36, 0, 0});
+
+    const float octahedron[] = {1, 0, 0, -1, 0, 0, 0, 1, 0,
+                                0, -1, 0, 0, 0, 1, 0, 0, -1};
+    geometry.positions.insert(
+        geometry.positions.end(), std::begin(octahedron), std::end(octahedron));
+    const uint32_t faces[] = {0, 2, 4, 4, 2, 1, 1, 2, 5, 5, 2, 0,
+                              4, 3, 0, 1, 3, 4, 5, 3, 1, 0, 3, 5};
+    geometry.meshes.push_back({24, uint32_t(geometry.indices.size()), 8});
+    geometry.indices.insert(
+        geometry.indices.end(), std::begin(faces), std::end(faces));
+    return geometry;
+}
+
+struct Scene
+{
+    WGPUBuffer         vertices   = nullptr;
+    WGPUBuffer         indices    = nullptr;
+    WGPUBuffer         instances  = nullptr;
+    WGPUBuffer         viewProj   = nullptr;
+    WGPUBindGroup      bindGroup  = nullptr;
+    WGPURenderPipeline direct     = nullptr;
+    WGPURenderPipeline culled     = nullptr;
+    WGPUTexture        depth      = nullptr;
+    WGPUTextureView    depthView  = nullptr;
+    WGPUTextureView    targetView = nullptr;
+};
+
+enum class Path { CpuCulling, GpuCulling, GpuOcclusion };
+
+struct FrameTimes
+{
+    double cpuMs = 0; // cull and encode
+    double gpuMs = 0; // submit to done
+};
+
+FrameTimes renderFrame(
+    const BenchContext&                ctx,
+    const Scene&                       scene,
+    GpuCuller&                         culler,
+    const Geometry&                    geometry,
+    const std::vector<InstanceBounds>& bounds,
+    const std::vector<uint32_t>&       meshOf,
+    Path                               path,
+    float                              yaw)
+{
+    auto   start    = std::chrono::steady_clock::now();
+    Matrix viewProj = viewProjection(yaw);
+    wgpuQueueWriteBuffer(
+        ctx.queue, scene.viewProj, 0, viewProj.data(), sizeof(Matrix));
+
+    WGPUCommandEncoder encoder =
+        wgpuDeviceCreateCommandEncoder(ctx.device, nullptr);
+    if (path != Path::CpuCulling) {
+        GpuCuller::View view;
+        view.viewProj  = viewProj;
+        view.occlusion = path == Path::GpuOcclusion;
+        culler.cull(encoder, view);
+    }
+
+    WGPURenderPassColorAttachment colorAttachment =
+        WGPU_RENDER_PASS_COLOR_ATTACHMENT_INIT;
+    colorAttachment.view       = scene.targetView;
+    colorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
+    colorAttachment.loadOp     = WGPULoadOp_Clear;
+    colorAttachment.storeOp    = WGPUStoreOp_Store;
+    WGPURenderPassDepthStencilAttachment depthAttachment =
+        WGPU_RENDER_PASS_DEPTH_STENCIL_ATTACHMENT_INIT;
+    depthAttachment.view            = scene.depthView;
+    depthAttachment.depthLoadOp     = WGPULoadOp_Clear;
+    depthAttachment.depthStoreOp    = WGPUStoreOp_Store;
+    depthAttachment.depthClearValue = 1.0f;
+    WGPURenderPassDescriptor passDesc = WGPU_RENDER_PASS_DESCRIPTOR_INIT;
+    passDesc.colorAttachmentCount     = 1;
+    passDesc.colorAttachments         = &colorAttachment;
+    passDesc.depthStencilAttachment   = &depthAttachment;
+    WGPURenderPassEncoder pass =
+        wgpuCommandEncoderBeginRenderPass(encoder, &passDesc);
+    wgpuRenderPassEncoderSetVertexBuffer(
+        pass, 0, scene.vertices, 0, WGPU_WHOLE_SIZE);
+    wgpuRenderPassEncoderSetIndexBuffer(
+        pass, scene.indices, WGPUIndexFormat_Uint32, 0, WGPU_WHOLE_SIZE);
+    wgpuRenderPassEncoderSetBindGroup(pass, 0, scene.bindGroup, 0, nullptr);
+
+    if (path == Path::CpuCulling) {
+        wgpuRenderPassEncoderSetPipeline(pass, scene.direct);
+        FrustumPlanes planes = extractFrustumPlanes(viewProj);
+        for (uint32_t i = 0; i < bounds.size(); ++i) {
+            if (sphereInFrustum(planes, bounds[i])) {
+                const CullMesh& mesh = geometry.meshes[meshOf[i]];
+                wgpuRenderPassEncoderDrawIndexed(
+                    pass,
+                    mesh.indexCount,
+                    1,
+                    mesh.firstIndex,
+                    mesh.baseVertex,
+                    i);
+            }
+        }
+    }
+    else {
+        wgpuRenderPassEncoderSetPipeline(pass, scene.culled);
+        culler.draw(pass, 1);
+    }
+    wgpuRenderPassEncoderEnd(pass);
+    wgpuRenderPassEncoderRelease(pass);
+    if (path == Path::GpuOcclusion) {
+        culler.buildHiZ(encoder, scene.depth);
+    }
+
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, nullptr);
+    wgpuCommandEncoderRelease(encoder);
+    FrameTimes times;
+    times.cpuMs = elapsedMs(start);
+
+    auto submitted = std::chrono::steady_clock::now();
+    wgpuQueueSubmit(ctx.queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+    onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+    times.gpuMs = elapsedMs(submitted);
+    return times;
+}
+
+// Sum of the instance counts written by the last cull
+uint32_t readVisibleCount(const BenchContext& ctx, const GpuCuller& culler)
+{
+    uint64_t size = culler.meshCount() * sizeof(DrawIndexedIndirectArgs);
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    desc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+    desc.size  = size;
+    WGPUBuffer readback = wgpuDeviceCreateBuffer(ctx.device, &desc);
+    WGPUCommandEncoder encoder =
+        wgpuDeviceCreateCommandEncoder(ctx.device, nullptr);
+    wgpuCommandEncoderCopyBufferToBuffer(
+        encoder, culler.indirectBuffer(), 0, readback, 0, size);
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, nullptr);
+    wgpuQueueSubmit(ctx.queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+    wgpuCommandEncoderRelease(encoder);
+
+    uint32_t visible = 0;
+    fetchBufferDataSync(ctx.instance, readback, [&](const void* data) {
+        auto args = static_cast<const DrawIndexedIndirectArgs*>(data);
+        for (uint32_t i = 0; i < culler.meshCount(); ++i) {
+            visible += args[i].instanceCount;
+        }
+    });
+    wgpuBufferRelease(readback);
+    return visible;
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "gpu-culling",
+    "100k instances, CPU culling + direct draws vs GPU culling + indirect")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+
+    Geometry                    geometry = createGeometry();
+    std::vector<InstanceBounds> bounds(kInstanceCount);
+    std::vector<uint32_t>       meshOf(kInstanceCount);
+
+    std::mt19937                          random(42);
+    std::uniform_real_distribution<float> position(
+        -0.5f * kFieldSize, 0.5f * kFieldSize);
+    std::uniform_real_distribution<float> radius(0.5f, 2.0f);
+    for (uint32_t i = 0; i < kInstanceCount; ++i) {
+        bounds[i].center[0] = position(random);
+        bounds[i].center[1] = position(random) * 0.25f;
+        bounds[i].center[2] = position(random);
+        bounds[i].radius    = radius(random);
+        meshOf[i]           = i % 2;
+    }
+
+    PipelineRegistry registry(ctx.device);
+    GpuCuller        culler(ctx.device, registry);
+    culler.setScene(ctx.queue, geometry.meshes, bounds, meshOf);
+
+    Scene scene;
+    scene.vertices = ctx.createBuffer(
+        WGPUBufferUsage_Vertex,
+        geometry.positions.size() * sizeof(float),
+        geometry.positions.data());
+    scene.indices = ctx.createBuffer(
+        WGPUBufferUsage_Index,
+        geometry.indices.size() * sizeof(uint32_t),
+        geometry.indices.data());
+    scene.instances = ctx.createBuffer(
+        WGPUBufferUsage_Storage,
+        bounds.size() * sizeof(InstanceBounds),
+        bounds.data());
+    Matrix identity = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    scene.viewProj  = ctx.createBuffer(
+        WGPUBufferUsage_Uniform, sizeof(Matrix), identity.data());
+
+    WGPUBindGroupLayoutEntry layoutEntries[2] = {
+        WGPU_BIND_GROUP_LAYOUT_ENTRY_INIT, WGPU_BIND_GROUP_LAYOUT_ENTRY_INIT};
+    layoutEntries[0].binding     = 0;
+    layoutEntries[0].visibility  = WGPUShaderStage_Vertex;
+    layoutEntries[0].buffer.type = WGPUBufferBindingType_Uniform;
+    layoutEntries[1].binding     = 1;
+    layoutEntries[1].visibility  = WGPUShaderStage_Vertex;
+    layoutEntries[1].buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+    WGPUBindGroupLayoutDescriptor layoutDesc =
+        WGPU_BIND_GROUP_LAYOUT_DESCRIPTOR_INIT;
+    layoutDesc.entryCount = 2;
+    layoutDesc.entries    = layoutEntries;
+    WGPUBindGroupLayout sceneLayout =
+        wgpuDeviceCreateBindGroupLayout(ctx.device, &layoutDesc);
+
+    WGPUBindGroupEntry entries[2] = {
+        WGPU_BIND_GROUP_ENTRY_INIT, WGPU_BIND_GROUP_ENTRY_INIT};
+    entries[0].binding = 0;
+    entries[0].buffer  = scene.viewProj;
+    entries[0].size    = sizeof(Matrix);
+    entries[1].binding = 1;
+    entries[1].buffer  = scene.instances;
+    entries[1].size    = bounds.size() * sizeof(InstanceBounds);
+    WGPUBindGroupDescriptor bindGroupDesc = WGPU_BIND_GROUP_DESCRIPTOR_INIT;
+    bindGroupDesc.layout                  = sceneLayout;
+    bindGroupDesc.entryCount              = 2;
+    bindGroupDesc.entries                 = entries;
+    scene.bindGroup = wgpuDeviceCreateBindGroup(ctx.device, &bindGroupDesc);
+
+    WGPUBindGroupLayout groupLayouts[] = {sceneLayout, culler.visibleLayout()};
+    WGPUPipelineLayoutDescriptor pipelineLayoutDesc =
+        WGPU_PIPELINE_LAYOUT_DESCRIPTOR_INIT;
+    pipelineLayoutDesc.bindGroupLayoutCount = 1;
+    pipelineLayoutDesc.bindGroupLayouts     = groupLayouts;
+    WGPUPipelineLayout directLayout =
+        wgpuDeviceCreatePipelineLayout(ctx.device, &pipelineLayoutDesc);
+    pipelineLayoutDesc.bindGroupLayoutCount = 2;
+    WGPUPipelineLayout culledLayout =
+        wgpuDeviceCreatePipelineLayout(ctx.device, &pipelineLayoutDesc);
+
+    RenderPipelineSpec spec;
+    spec.colorFormats  = {WGPUTextureFormat_RGBA8Unorm};
+    spec.depthFormat   = WGPUTextureFormat_Depth32Float;
+    spec.vertexBuffers = {
+        {3 * sizeof(float),
+         WGPUVertexStepMode_Vertex,
+         {{WGPUVertexFormat_Float32x3, 0, 0}}}};
+
+    spec.label = "Direct draws";
+    spec.shaderSource =
+        std::string(kShaderHeader) + kDirectIndexSource + kShaderBody;
+    spec.layout  = directLayout;
+    scene.direct = registry.renderPipeline(spec);
+
+    spec.label = "Culled draws";
+    spec.shaderSource =
+        std::string(kShaderHeader) + kCulledIndexSource + kShaderBody;
+    spec.layout  = culledLayout;
+    scene.culled = registry.renderPipeline(spec);
+
+    WGPUTextureDescriptor textureDesc = WGPU_TEXTURE_DESCRIPTOR_INIT;
+    textureDesc.usage         = WGPUTextureUsage_RenderAttachment;
+    textureDesc.dimension     = WGPUTextureDimension_2D;
+    textureDesc.size          = {kTargetSize, kTargetSize, 1};
+    textureDesc.format        = WGPUTextureFormat_RGBA8Unorm;
+    textureDesc.mipLevelCount = 1;
+    textureDesc.sampleCount   = 1;
+    WGPUTexture target = wgpuDeviceCreateTexture(ctx.device, &textureDesc);
+    scene.targetView   = wgpuTextureCreateView(target, nullptr);
+
+    // Read by the Hi-Z reduction
+    textureDesc.usage = WGPUTextureUsage_RenderAttachment |
+                        WGPUTextureUsage_TextureBinding;
+    textureDesc.format = WGPUTextureFormat_Depth32Float;
+    scene.depth        = wgpuDeviceCreateTexture(ctx.device, &textureDesc);
+    scene.depthView    = wgpuTextureCreateView(scene.depth, nullptr);
+
+    BenchReport report("gpu-culling");
+    const std::pair<Path, const char*> paths[] = {
+        {Path::CpuCulling, "cpu_culling"},
+        {Path::GpuCulling, "gpu_culling"},
+        {Path::GpuOcclusion, "gpu_occlusion"}};
+    for (const auto& [path, name] : paths) {
+        std::vector<double> cpuMs;
+        std::vector<double> gpuMs;
+        // The first frame creates the pipelines and, for occlusion, the
+        // first Hi-Z pyramid
+        renderFrame(ctx, scene, culler, geometry, bounds, meshOf, path, 0);
+        for (uint32_t frame = 0; frame < opts.iterations; ++frame) {
+            FrameTimes times = renderFrame(
+                ctx,
+                scene,
+                culler,
+                geometry,
+                bounds,
+                meshOf,
+                path,
+                0.01f * float(frame));
+            cpuMs.push_back(times.cpuMs);
+            gpuMs.push_back(times.gpuMs);
+        }
+        report.addSeries(std::string(name) + "_cpu_ms", std::move(cpuMs));
+        report.addSeries(std::string(name) + "_gpu_ms", std::move(gpuMs));
+        if (path != Path::CpuCulling) {
+            report.addValue(
+                std::string(name) + "_visible", readVisibleCount(ctx, culler));
+        }
+    }
+
+    // Visible after CPU culling of the last frame, to check the GPU count
+    FrustumPlanes planes = extractFrustumPlanes(
+        viewProjection(0.01f * float(opts.iterations - 1)));
+    uint32_t cpuVisible = 0;
+    for (const InstanceBounds& instance : bounds) {
+        cpuVisible += sphereInFrustum(planes, instance) ? 1 : 0;
+    }
+    report.addValue("cpu_culling_visible", cpuVisible);
+    report.addValue("hiz_levels", culler.hiZLevels());
+
+    wgpuTextureViewRelease(scene.depthView);
+    wgpuTextureRelease(scene.depth);
+    wgpuTextureViewRelease(scene.targetView);
+    wgpuTextureRelease(target);
+    wgpuPipelineLayoutRelease(culledLayout);
+    wgpuPipelineLayoutRelease(directLayout);
+    wgpuBindGroupRelease(scene.bindGroup);
+    wgpuBindGroupLayoutRelease(sceneLayout);
+    for (WGPUBuffer buffer :
+         {scene.vertices, scene.indices, scene.instances, scene.viewProj}) {
+        wgpuBufferRelease(buffer);
+    }
+    return report.write(opts) ? 0 : 1;
+}
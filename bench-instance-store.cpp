@@ -0,0 +1,166 @@
+#include "instance-store.h"
+#include "microbench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+// Per-frame transform and bounds update of 1M dynamic instances: an
+// array-of-structs scene composed one object at a time versus the
+// InstanceStore kernels at each SIMD width the CPU supports, then the
+// upload of 1% of the instances moving in clusters through the dirty
+// ranges.
+
+namespace {
+
+constexpr uint32_t kInstanceCount = 1000000;
+constexpr uint32_t kClusterCount  = 10;
+constexpr uint32_t kClusterSize   = kInstanceCount / 100 / kClusterCount;
+
+// A typical scene object: the transform shares cache lines with the rest
+struct Object
+{
+    std::array<float, 3> position = {};
+    std::array<float, 4> rotation = {0, 0, 0, 1};
+    std::array<float, 3> scale    = {1, 1, 1};
+    float                radius   = 1;
+    std::array<float, 3> velocity = {};
+    uint32_t             mesh     = 0;
+    uint32_t             flags    = 0;
+    char                 name[32] = {};
+};
+
+void composeObjects(
+    const std::vector<Object>&      objects,
+    std::vector<InstanceTransform>& transforms,
+    std::vector<InstanceBounds>&    bounds)
+{
+    for (size_t i = 0; i < objects.size(); ++i) {
+        const Object& o = objects[i];
+
+        auto [x, y, z, w] = o.rotation;
+        auto [sx, sy, sz] = o.scale;
+
+        std::array<wgsl::vec4f, 3>& rows = transforms[i].rows;
+        rows[0] = {{(1 - 2 * (y * y + z * z)) * sx,
+                    2 * (x * y - w * z) * sy,
+                    2 * (x * z + w * y) * sz,
+                    o.position[0]}};
+        rows[1] = {{2 * (x * y + w * z) * sx,
+                    (1 - 2 * (x * x + z * z)) * sy,
+                    2 * (y * z - w * x) * sz,
+                    o.position[1]}};
+        rows[2] = {{2 * (x * z - w * y) * sx,
+                    2 * (y * z + w * x) * sy,
+                    (1 - 2 * (x * x + y * y)) * sz,
+                    o.position[2]}};
+
+        float scale = std::max({std::abs(sx), std::abs(sy), std::abs(sz)});
+        bounds[i]   = {
+            {o.position[0], o.position[1], o.position[2]}, o.radius * scale};
+    }
+}
+
+InstanceState randomState(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> unit(-1, 1);
+
+    InstanceState state;
+    state.position = {unit(rng) * 500, unit(rng) * 500, unit(rng) * 500};
+    std::array<float, 4> q = {unit(rng), unit(rng), unit(rng), unit(rng)};
+    float length =
+        std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (float& value : q) {
+        value /= length;
+    }
+    state.rotation = q;
+    float scale    = 0.5f + (unit(rng) + 1) * 0.5f;
+    state.scale    = {scale, scale, scale};
+    return state;
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "instance-store",
+    "1M instance transforms, AoS scalar vs SoA InstanceStore per SIMD width")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+
+    std::mt19937        rng(42);
+    std::vector<Object> objects(kInstanceCount);
+    InstanceStore       store(ctx.device, kInstanceCount);
+    for (Object& object : objects) {
+        InstanceState state = randomState(rng);
+        object.position     = state.position;
+        object.rotation     = state.rotation;
+        object.scale        = state.scale;
+        store.add(state);
+    }
+    store.update(ctx.queue);
+
+    BenchReport report("instance-store");
+    report.addValue("instances", kInstanceCount);
+
+    std::vector<InstanceTransform> transforms(kInstanceCount);
+    std::vector<InstanceBounds>    bounds(kInstanceCount);
+    std::vector<double>            aosMs;
+    for (uint32_t i = 0; i < opts.iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        composeObjects(objects, transforms, bounds);
+        aosMs.push_back(elapsedMs(start));
+    }
+    report.addSeries("aos_compose_ms", std::move(aosMs));
+
+    // Every instance dirty: the kernels, then the full upload
+    for (SimdLevel level :
+         {SimdLevel::Scalar, SimdLevel::Sse, SimdLevel::Avx2}) {
+        if (level > bestSimdLevel()) {
+            continue;
+        }
+        store.setSimdLevel(level);
+        std::vector<double> composeMs, updateMs;
+        for (uint32_t i = 0; i < opts.iterations; ++i) {
+            double composed = store.stats().composeMs;
+            auto   start    = std::chrono::steady_clock::now();
+            store.markDirty(0, kInstanceCount);
+            store.update(ctx.queue);
+            updateMs.push_back(elapsedMs(start));
+            composeMs.push_back(store.stats().composeMs - composed);
+        }
+        std::string name = simdLevelName(level);
+        report.addSeries(name + "_compose_ms", std::move(composeMs));
+        report.addSeries(name + "_update_ms", std::move(updateMs));
+    }
+
+    // 1% of the instances move, in clusters: only their blocks are composed
+    // and uploaded
+    store.setSimdLevel(bestSimdLevel());
+    std::uniform_int_distribution<uint32_t> cluster(
+        0, kInstanceCount - kClusterSize);
+    std::vector<double> dirtyMs;
+    uint64_t            bytes = store.stats().bytes;
+    for (uint32_t i = 0; i < opts.iterations; ++i) {
+        auto   start = std::chrono::steady_clock::now();
+        float* x     = store.column(InstanceColumn::PositionX);
+        for (uint32_t c = 0; c < kClusterCount; ++c) {
+            uint32_t first = cluster(rng);
+            for (uint32_t j = first; j < first + kClusterSize; ++j) {
+                x[j] += 0.1f;
+            }
+            store.markDirty(first, kClusterSize);
+        }
+        store.update(ctx.queue);
+        dirtyMs.push_back(elapsedMs(start));
+    }
+    report.addSeries("dirty_1pct_update_ms", std::move(dirtyMs));
+    report.addValue(
+        "dirty_1pct_bytes_per_frame",
+        double(store.stats().bytes - bytes) / std::max(opts.iterations, 1u));
+    return report.write(opts) ? 0 : 1;
+}
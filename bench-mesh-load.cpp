@@ -0,0 +1,200 @@
+#include "mesh-asset.h"
+#include "microbench.h"
+#include "webgpu-async.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Loading a mesh into GPU buffers: parsing an OBJ file with iostreams into
+// vectors, then writeBuffer, versus mapping the converted binary asset and
+// copying its sections into mappedAtCreation buffers. On Linux each load
+// runs in a child process so that its peak RSS can be read on its own.
+
+namespace {
+
+// Grid of kGridSize^2 vertices, about 20 MB of OBJ text
+constexpr uint32_t kGridSize = 400;
+
+struct LoadSample
+{
+    double ms        = -1;
+    long   peakRssKb = 0; // 0 if unknown
+};
+
+void writeGridObj(const std::filesystem::path& path)
+{
+    FILE* file = std::fopen(path.string().c_str(), "w");
+    if (!file)
+        return;
+    float scale = 1.f / (kGridSize - 1);
+    for (uint32_t y = 0; y < kGridSize; ++y) {
+        for (uint32_t x = 0; x < kGridSize; ++x) {
+            std::fprintf(
+                file,
+                "v %f %f %f\nvt %f %f\nvn 0 0 1\n",
+                x * scale,
+                y * scale,
+                0.01f * ((x * 7 + y * 13) % 17),
+                x * scale,
+                y * scale);
+        }
+    }
+    for (uint32_t y = 0; y + 1 < kGridSize; ++y) {
+        for (uint32_t x = 0; x + 1 < kGridSize; ++x) {
+            uint32_t i = y * kGridSize + x + 1;
+            uint32_t j = i + kGridSize;
+            std::fprintf(
+                file,
+                "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n",
+                i, i, i, i + 1, i + 1, i + 1, j + 1, j + 1, j + 1, j, j, j);
+        }
+    }
+    std::fclose(file);
+}
+
+bool loadText(const BenchContext& ctx, const std::filesystem::path& path)
+{
+    MeshData mesh;
+    if (!loadObj(path, mesh))
+        return false;
+    GpuMesh gpuMesh;
+    gpuMesh.vertexBuffer = ctx.createBuffer(
+        WGPUBufferUsage_Vertex,
+        mesh.vertices.size() * sizeof(MeshVertex),
+        mesh.vertices.data());
+    gpuMesh.indexBuffer = ctx.createBuffer(
+        WGPUBufferUsage_Index,
+        mesh.indices.size() * sizeof(uint32_t),
+        mesh.indices.data());
+    onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+    gpuMesh.release();
+    return true;
+}
+
+bool loadMapped(const BenchContext& ctx, const std::filesystem::path& path)
+{
+    MeshAsset asset;
+    if (!asset.open(path))
+        return false;
+    GpuMesh gpuMesh = uploadMeshAsset(ctx.device, asset);
+    bool    loaded  = bool(gpuMesh);
+    onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+    gpuMesh.release();
+    return loaded;
+}
+
+using LoadFunction = std::function<bool(const BenchContext&)>;
+
+LoadSample timeLoad(const BenchOptions& opts, const LoadFunction& load)
+{
+    LoadSample   sample;
+    BenchContext ctx;
+    if (ctx.open(opts)) {
+        auto start = std::chrono::steady_clock::now();
+        if (load(ctx)) {
+            sample.ms = elapsedMs(start);
+        }
+    }
+    return sample;
+}
+
+// Run the load in a fresh process with its own device
+LoadSample runIsolated(const BenchOptions& opts, const LoadFunction& load)
+{
+#ifdef __linux__
+    int fds[2];
+    if (pipe(fds) != 0)
+        return {};
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        double  ms      = timeLoad(opts, load).ms;
+        ssize_t written = write(fds[1], &ms, sizeof(ms));
+        _exit(written == sizeof(ms) ? 0 : 1);
+    }
+    close(fds[1]);
+    LoadSample sample;
+    if (pid > 0) {
+        if (read(fds[0], &sample.ms, sizeof(sample.ms)) != sizeof(sample.ms)) {
+            sample.ms = -1;
+        }
+        int           status = 0;
+        struct rusage usage  = {};
+        wait4(pid, &status, 0, &usage);
+        sample.peakRssKb = usage.ru_maxrss;
+    }
+    close(fds[0]);
+    return sample;
+#else
+    return timeLoad(opts, load);
+#endif
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "mesh-load",
+    "160k-vertex mesh from OBJ text vs memory-mapped binary asset, time + RSS")
+{
+    std::filesystem::path directory =
+        std::filesystem::temp_directory_path() / "wgputest-mesh-load";
+    std::filesystem::create_directories(directory);
+    std::filesystem::path objPath   = directory / "grid.obj";
+    std::filesystem::path assetPath = directory / "grid.wgm";
+
+    writeGridObj(objPath);
+    auto convertStart = std::chrono::steady_clock::now();
+    if (!convertMeshFile(objPath, assetPath)) {
+        std::cerr << "Could not convert the benchmark mesh" << std::endl;
+        return 1;
+    }
+    double convertMs = elapsedMs(convertStart);
+
+    std::vector<double> textMs, mappedMs;
+    long                baseRss = 0, textRss = 0, mappedRss = 0;
+    for (unsigned int i = 0; i < opts.iterations; ++i) {
+        LoadSample base = runIsolated(opts, [](const BenchContext&) {
+            return true;
+        });
+        LoadSample text = runIsolated(opts, [&](const BenchContext& ctx) {
+            return loadText(ctx, objPath);
+        });
+        LoadSample mapped = runIsolated(opts, [&](const BenchContext& ctx) {
+            return loadMapped(ctx, assetPath);
+        });
+        if (text.ms < 0 || mapped.ms < 0) {
+            std::cerr << "Mesh loading failed" << std::endl;
+            return 1;
+        }
+        textMs.push_back(text.ms);
+        mappedMs.push_back(mapped.ms);
+        baseRss   = std::max(baseRss, base.peakRssKb);
+        textRss   = std::max(textRss, text.peakRssKb);
+        mappedRss = std::max(mappedRss, mapped.peakRssKb);
+    }
+
+    BenchReport report("mesh-load");
+    report.addValue("vertices", kGridSize * kGridSize);
+    report.addValue("obj_bytes", std::filesystem::file_size(objPath));
+    report.addValue("asset_bytes", std::filesystem::file_size(assetPath));
+    report.addValue("convert_ms", convertMs);
+    report.addSeries("text_load_ms", std::move(textMs));
+    report.addSeries("mapped_load_ms", std::move(mappedMs));
+    // Peak RSS of a process that only creates the device, and of the loads
+    report.addValue("device_peak_rss_kb", baseRss);
+    report.addValue("text_peak_rss_kb", textRss);
+    report.addValue("mapped_peak_rss_kb", mappedRss);
+
+    std::filesystem::remove_all(directory);
+    return report.write(opts) ? 0 : 1;
+}
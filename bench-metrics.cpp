@@ -0,0 +1,114 @@
+#include "metrics.h"
+#include "microbench.h"
+
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Overhead of the runtime metrics: the cost of countMetric(),
+// recordMetric() and MetricTimer on one thread and on several at once,
+// next to a counter shared by all the threads (one atomic fetch_add), then
+// the once-per-frame aggregation and export, as a share of a 60 fps frame.
+
+namespace {
+
+constexpr uint32_t kEventsPerThread = 1000000;
+constexpr uint32_t kThreadCount     = 4;
+constexpr double   kFrameBudgetMs   = 1000.0 / 60;
+
+std::atomic<uint64_t> sharedCounter{0};
+
+// Nanoseconds per event, with `threads` threads each running `event`
+// kEventsPerThread times
+template<typename Event>
+double runThreads(uint32_t threads, Event event)
+{
+    auto                     start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&event] {
+            for (uint32_t i = 0; i < kEventsPerThread; ++i) {
+                event(i);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return elapsedMs(start) * 1e6 / kEventsPerThread;
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "metrics",
+    "per-thread metrics vs a shared atomic counter, and export per frame")
+{
+    auto countEvent  = [](uint32_t) { countMetric(MetricCounter::Submits); };
+    auto sharedEvent = [](uint32_t) {
+        sharedCounter.fetch_add(1, std::memory_order_relaxed);
+    };
+    auto recordEvent = [](uint32_t i) {
+        recordMetric(MetricHistogram::EncodeMs, (i & 1023) * 1e-3);
+    };
+    auto timerEvent  = [](uint32_t) {
+        MetricTimer timer(MetricHistogram::EncodeMs);
+    };
+
+    std::vector<double> countNs, sharedNs, recordNs, timerNs;
+    std::vector<double> contendedCountNs, contendedSharedNs;
+    for (unsigned int i = 0; i < opts.iterations; ++i) {
+        countNs.push_back(runThreads(1, countEvent));
+        sharedNs.push_back(runThreads(1, sharedEvent));
+        recordNs.push_back(runThreads(1, recordEvent));
+        timerNs.push_back(runThreads(1, timerEvent));
+        contendedCountNs.push_back(runThreads(kThreadCount, countEvent));
+        contendedSharedNs.push_back(runThreads(kThreadCount, sharedEvent));
+    }
+
+    // Exporting at every frame, the worst case: the slots of all the
+    // threads above are summed each time
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::vector<double>   jsonMs, prometheusMs;
+    {
+        MetricsExporter json(
+            (directory / "wgputest-metrics.jsonl").string(),
+            MetricsFormat::JsonLines,
+            0);
+        MetricsExporter prometheus(
+            (directory / "wgputest-metrics.prom").string(),
+            MetricsFormat::Prometheus,
+            0);
+        for (unsigned int i = 0; i < opts.iterations; ++i) {
+            countMetric(MetricCounter::Frames);
+            auto start = std::chrono::steady_clock::now();
+            json.onFrame();
+            jsonMs.push_back(elapsedMs(start));
+
+            start = std::chrono::steady_clock::now();
+            prometheus.onFrame();
+            prometheusMs.push_back(elapsedMs(start));
+        }
+    }
+    std::filesystem::remove(directory / "wgputest-metrics.jsonl");
+    std::filesystem::remove(directory / "wgputest-metrics.prom");
+
+    BenchReport report("metrics");
+    report.addValue("enabled", kMetricsEnabled);
+    report.addValue("threads", kThreadCount);
+    report.addSeries("count_ns", std::move(countNs));
+    report.addSeries("shared_atomic_ns", std::move(sharedNs));
+    report.addSeries("record_ns", std::move(recordNs));
+    report.addSeries("timer_ns", std::move(timerNs));
+    report.addSeries("contended_count_ns", std::move(contendedCountNs));
+    report.addSeries(
+        "contended_shared_atomic_ns", std::move(contendedSharedNs));
+    SampleStats jsonStats = computeSampleStats(jsonMs);
+    report.addSeries("export_json_ms", std::move(jsonMs));
+    report.addSeries("export_prometheus_ms", std::move(prometheusMs));
+    report.addValue(
+        "export_json_frame_percent", jsonStats.mean / kFrameBudgetMs * 100);
+    return report.write(opts) ? 0 : 1;
+}
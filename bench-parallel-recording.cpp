@@ -0,0 +1,194 @@
+#include "job-system.h"
+#include "microbench.h"
+#include "parallel-recorder.h"
+#include "pipeline-cache.h"
+#include "webgpu-async.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Scaling of the CPU encode time of a frame of many draws with the number of
+// recording threads, as render bundles executed in one pass and as command
+// buffers submitted in one batch.
+
+namespace {
+
+constexpr uint32_t kThreadCounts[] = {1, 2, 4, 8};
+constexpr uint32_t kDrawCount      = 40000;
+constexpr uint32_t kChunkCount     = 32;
+constexpr uint32_t kTargetSize     = 256;
+
+const char* kShaderSource = R"(
+@vertex
+fn vs_main(
+    @builtin(vertex_index) v: u32,
+    @builtin(instance_index) i: u32
+) -> @builtin(position) vec4f {
+    let cell = vec2f(f32(i % 200u), f32(i / 200u % 200u)) / 100.0 - 1.0;
+    let corner = vec2f(f32(v % 2u), f32(v / 2u)) * 0.01;
+    return vec4f(cell + corner, 0.0, 1.0);
+}
+
+@fragment
+fn fs_main() -> @location(0) vec4f {
+    return vec4f(0.0, 0.5, 1.0, 1.0);
+}
+)";
+
+struct Frame
+{
+    BenchContext&      ctx;
+    WGPURenderPipeline pipeline = nullptr;
+    WGPUTextureView    target   = nullptr;
+    RenderBundleTarget bundleTarget;
+};
+
+// Draws [begin, end) of the chunk, one instance each
+void chunkRange(uint32_t chunk, uint32_t& begin, uint32_t& end)
+{
+    uint32_t perChunk = (kDrawCount + kChunkCount - 1) / kChunkCount;
+    begin             = std::min(chunk * perChunk, kDrawCount);
+    end               = std::min(begin + perChunk, kDrawCount);
+}
+
+WGPURenderPassEncoder beginPass(
+    WGPUCommandEncoder encoder,
+    WGPUTextureView    target,
+    WGPULoadOp         loadOp)
+{
+    WGPURenderPassColorAttachment colorAttachment =
+        WGPU_RENDER_PASS_COLOR_ATTACHMENT_INIT;
+    colorAttachment.view       = target;
+    colorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
+    colorAttachment.loadOp     = loadOp;
+    colorAttachment.storeOp    = WGPUStoreOp_Store;
+    WGPURenderPassDescriptor passDesc = WGPU_RENDER_PASS_DESCRIPTOR_INIT;
+    passDesc.colorAttachmentCount     = 1;
+    passDesc.colorAttachments         = &colorAttachment;
+    return wgpuCommandEncoderBeginRenderPass(encoder, &passDesc);
+}
+
+// Record the chunks as bundles on the job threads, execute them in one pass
+double encodeWithBundles(const Frame& frame, ParallelRecorder& recorder)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    const std::vector<WGPURenderBundle>& bundles = recorder.recordBundles(
+        frame.bundleTarget,
+        kChunkCount,
+        [&](uint32_t chunk, WGPURenderBundleEncoder encoder) {
+            uint32_t begin, end;
+            chunkRange(chunk, begin, end);
+            wgpuRenderBundleEncoderSetPipeline(encoder, frame.pipeline);
+            for (uint32_t i = begin; i < end; ++i) {
+                wgpuRenderBundleEncoderDraw(encoder, 4, 1, 0, i);
+            }
+        });
+
+    WGPUCommandEncoder encoder =
+        wgpuDeviceCreateCommandEncoder(frame.ctx.device, nullptr);
+    WGPURenderPassEncoder pass =
+        beginPass(encoder, frame.target, WGPULoadOp_Clear);
+    wgpuRenderPassEncoderExecuteBundles(pass, bundles.size(), bundles.data());
+    wgpuRenderPassEncoderEnd(pass);
+    wgpuRenderPassEncoderRelease(pass);
+    recorder.append(wgpuCommandEncoderFinish(encoder, nullptr));
+    wgpuCommandEncoderRelease(encoder);
+    return elapsedMs(start);
+}
+
+// Record one command buffer per chunk on the job threads
+double encodeWithCommandBuffers(const Frame& frame, ParallelRecorder& recorder)
+{
+    auto start = std::chrono::steady_clock::now();
+    recorder.recordCommandBuffers(
+        kChunkCount, [&](uint32_t chunk, WGPUCommandEncoder encoder) {
+            uint32_t begin, end;
+            chunkRange(chunk, begin, end);
+            // Chunks are submitted in order, so only the first one clears
+            WGPURenderPassEncoder pass = beginPass(
+                encoder,
+                frame.target,
+                chunk == 0 ? WGPULoadOp_Clear : WGPULoadOp_Load);
+            wgpuRenderPassEncoderSetPipeline(pass, frame.pipeline);
+            for (uint32_t i = begin; i < end; ++i) {
+                wgpuRenderPassEncoderDraw(pass, 4, 1, 0, i);
+            }
+            wgpuRenderPassEncoderEnd(pass);
+            wgpuRenderPassEncoderRelease(pass);
+        });
+    return elapsedMs(start);
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "parallel-recording",
+    "40k draws encoded on 1/2/4/8 threads, bundles and command buffers")
+{
+    WGPUDeviceDescriptor deviceDesc = WGPU_DEVICE_DESCRIPTOR_INIT;
+#ifdef WEBGPU_BACKEND_DAWN
+    WGPUFeatureName features[] = {
+        WGPUFeatureName_ImplicitDeviceSynchronization};
+    deviceDesc.requiredFeatureCount = 1;
+    deviceDesc.requiredFeatures     = features;
+#endif
+    BenchContext ctx;
+    if (!ctx.open(opts, &deviceDesc)) {
+        return 1;
+    }
+
+    PipelineRegistry   registry(ctx.device);
+    RenderPipelineSpec spec;
+    spec.label        = "Parallel recording benchmark";
+    spec.shaderSource = kShaderSource;
+    spec.colorFormats = {WGPUTextureFormat_RGBA8Unorm};
+    spec.topology     = WGPUPrimitiveTopology_TriangleStrip;
+
+    WGPUTextureDescriptor textureDesc = WGPU_TEXTURE_DESCRIPTOR_INIT;
+    textureDesc.usage         = WGPUTextureUsage_RenderAttachment;
+    textureDesc.dimension     = WGPUTextureDimension_2D;
+    textureDesc.size          = {kTargetSize, kTargetSize, 1};
+    textureDesc.format        = WGPUTextureFormat_RGBA8Unorm;
+    textureDesc.mipLevelCount = 1;
+    textureDesc.sampleCount   = 1;
+    WGPUTexture texture = wgpuDeviceCreateTexture(ctx.device, &textureDesc);
+
+    Frame frame{
+        ctx,
+        registry.renderPipeline(spec),
+        wgpuTextureCreateView(texture, nullptr),
+        {}};
+    frame.bundleTarget.colorFormats = {WGPUTextureFormat_RGBA8Unorm};
+
+    BenchReport report("parallel-recording");
+    report.addValue("draws", kDrawCount);
+    report.addValue("chunks", kChunkCount);
+    report.addValue("parallel", supportsParallelRecording(ctx.device));
+    for (uint32_t threads : kThreadCounts) {
+        JobSystem        jobs(threads);
+        ParallelRecorder recorder(jobs, ctx.device);
+
+        std::vector<double> bundleMs, commandMs;
+        for (unsigned int i = 0; i < opts.iterations; ++i) {
+            bundleMs.push_back(encodeWithBundles(frame, recorder));
+            recorder.submit(ctx.queue);
+            onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+
+            commandMs.push_back(encodeWithCommandBuffers(frame, recorder));
+            recorder.submit(ctx.queue);
+            onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+        }
+
+        std::string suffix = "_" + std::to_string(threads) + "t";
+        report.addSeries("bundle_encode_ms" + suffix, std::move(bundleMs));
+        report.addSeries("command_encode_ms" + suffix, std::move(commandMs));
+        report.addValue("stolen_jobs" + suffix, (double) jobs.stolenJobs());
+    }
+
+    wgpuTextureViewRelease(frame.target);
+    wgpuTextureDestroy(texture);
+    wgpuTextureRelease(texture);
+    return report.write(opts) ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#include "microbench.h"
+#include "pipeline-cache.h"
+
+#include <filesystem>
+#include <string>
+
+// Startup cost of creating a set of pipelines on a fresh device, with an
+// empty (cold) versus populated (warm) on-disk blob cache.
+
+namespace {
+
+constexpr uint32_t kPipelineCount = 32;
+
+const char* kShaderTemplate = R"(
+@vertex
+fn vs_main(@builtin(vertex_index) i: u32) -> @builtin(position) vec4f {
+    let x = f32(i % 2u) * 0.5 + VARIANT;
+    return vec4f(x, f32(i / 2u) * 0.5, 0.0, 1.0);
+}
+
+@fragment
+fn fs_main() -> @location(0) vec4f {
+    return vec4f(VARIANT, 0.5, 0.5, 1.0);
+}
+)";
+
+RenderPipelineSpec makeSpec(uint32_t variant)
+{
+    std::string source = kShaderTemplate;
+    std::string value  = std::to_string(variant * 0.001);
+    for (size_t pos = source.find("VARIANT"); pos != std::string::npos;
+         pos        = source.find("VARIANT", pos)) {
+        source.replace(pos, 7, value);
+    }
+    RenderPipelineSpec spec;
+    spec.label        = "Startup pipeline " + std::to_string(variant);
+    spec.shaderSource = std::move(source);
+    spec.colorFormats = {WGPUTextureFormat_RGBA8Unorm};
+    return spec;
+}
+
+// Create a device going through `cache` and build all the pipelines.
+// Return the elapsed time in ms, or a negative value on failure.
+double startup(const BenchOptions& opts, BlobCache& cache, uint64_t& hits)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    WGPUDeviceDescriptor deviceDesc = WGPU_DEVICE_DESCRIPTOR_INIT;
+    BlobCacheChain       chain;
+    chainBlobCache(deviceDesc, cache, chain);
+
+    BenchContext ctx;
+    if (!ctx.open(opts, &deviceDesc))
+        return -1;
+
+    PipelineRegistry registry(ctx.device);
+    for (uint32_t i = 0; i < kPipelineCount; ++i) {
+        registry.renderPipeline(makeSpec(i));
+    }
+    // Identical requests must be served from memory
+    for (uint32_t i = 0; i < kPipelineCount; ++i) {
+        registry.renderPipeline(makeSpec(i));
+    }
+    hits += registry.stats().hits;
+    return elapsedMs(start);
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "pipeline-cache",
+    "device + 32 pipelines startup with a cold vs warm on-disk blob cache")
+{
+    BlobCache cache(
+        std::filesystem::temp_directory_path() / "wgputest-bench-cache");
+
+    std::vector<double> coldMs, warmMs;
+    uint64_t            registryHits = 0;
+    for (unsigned int i = 0; i < opts.iterations; ++i) {
+        cache.clear();
+        double cold = startup(opts, cache, registryHits);
+        double warm = startup(opts, cache, registryHits);
+        if (cold < 0 || warm < 0) {
+            return 1;
+        }
+        coldMs.push_back(cold);
+        warmMs.push_back(warm);
+    }
+
+    BlobCache::Stats stats = cache.stats();
+    cache.clear();
+
+    BenchReport report("pipeline-cache");
+    report.addSeries("cold_startup_ms", std::move(coldMs));
+    report.addSeries("warm_startup_ms", std::move(warmMs));
+    report.addValue("blob_hits", (double) stats.hits);
+    report.addValue("blob_misses", (double) stats.misses);
+    report.addValue("blob_bytes_stored", (double) stats.bytesStored);
+    report.addValue("registry_hits", (double) registryHits);
+    return report.write(opts) ? 0 : 1;
+}
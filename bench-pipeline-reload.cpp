@@ -0,0 +1,314 @@
+#include "microbench.h"
+#include "pipeline-loader.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Time to first frame with a set of pipelines created synchronously before
+// it versus by the PipelineLoader, the first frame skipping the draws whose
+// pipeline is not ready. Then the frame times around the save of a shader
+// file: recompiled on the render thread versus hot reloaded in the
+// background and swapped in between two frames.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kPipelineCount = 64;
+constexpr uint32_t kTargetSize    = 256;
+// Each reload round saves the shader at kSaveFrame, then renders until
+// kRoundFrames, or longer until the reloaded pipeline is in use
+constexpr uint32_t kSaveFrame      = 5;
+constexpr uint32_t kRoundFrames    = 30;
+constexpr uint32_t kMaxRoundFrames = 1000;
+constexpr auto     kFramePeriod    = std::chrono::milliseconds(8);
+
+const char* kShaderTemplate = R"(
+@vertex
+fn vs_main(@builtin(vertex_index) i: u32) -> @builtin(position) vec4f {
+    let x = f32(i % 2u) * 0.5 + VARIANT;
+    return vec4f(x, f32(i / 2u) * 0.5, 0.0, 1.0);
+}
+
+@fragment
+fn fs_main() -> @location(0) vec4f {
+    return vec4f(VARIANT, 0.5, 0.5, 1.0);
+}
+)";
+
+// Every variant is a distinct pipeline, which no cache has seen
+std::string makeSource(uint32_t variant)
+{
+    std::string source = kShaderTemplate;
+    std::string value  = std::to_string(variant * 0.0001);
+    for (size_t pos = source.find("VARIANT"); pos != std::string::npos;
+         pos        = source.find("VARIANT", pos)) {
+        source.replace(pos, 7, value);
+    }
+    return source;
+}
+
+RenderPipelineSpec makeSpec(std::string source)
+{
+    RenderPipelineSpec spec;
+    spec.label        = "Reload pipeline";
+    spec.shaderSource = std::move(source);
+    spec.colorFormats = {WGPUTextureFormat_RGBA8Unorm};
+    return spec;
+}
+
+// Written next to the file then renamed over it, as editors save
+void saveShader(const std::filesystem::path& path, const std::string& source)
+{
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    std::ofstream(temporary, std::ios::binary) << source;
+    std::filesystem::rename(temporary, path);
+}
+
+std::string readShader(const std::filesystem::path& path)
+{
+    std::ifstream      file(path, std::ios::binary);
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    return stream.str();
+}
+
+struct Target
+{
+    WGPUTexture     texture = nullptr;
+    WGPUTextureView view    = nullptr;
+
+    explicit Target(const BenchContext& ctx)
+    {
+        WGPUTextureDescriptor textureDesc = WGPU_TEXTURE_DESCRIPTOR_INIT;
+        textureDesc.usage         = WGPUTextureUsage_RenderAttachment;
+        textureDesc.dimension     = WGPUTextureDimension_2D;
+        textureDesc.size          = {kTargetSize, kTargetSize, 1};
+        textureDesc.format        = WGPUTextureFormat_RGBA8Unorm;
+        textureDesc.mipLevelCount = 1;
+        textureDesc.sampleCount   = 1;
+        texture = wgpuDeviceCreateTexture(ctx.device, &textureDesc);
+        view    = wgpuTextureCreateView(texture, nullptr);
+    }
+
+    ~Target()
+    {
+        wgpuTextureViewRelease(view);
+        wgpuTextureRelease(texture);
+    }
+};
+
+// Draw with each pipeline that is not null, submit, and return the number
+// of draws
+uint32_t renderFrame(
+    const BenchContext&                    ctx,
+    const Target&                          target,
+    const std::vector<WGPURenderPipeline>& pipelines)
+{
+    WGPUCommandEncoder encoder =
+        wgpuDeviceCreateCommandEncoder(ctx.device, nullptr);
+    WGPURenderPassColorAttachment colorAttachment =
+        WGPU_RENDER_PASS_COLOR_ATTACHMENT_INIT;
+    colorAttachment.view       = target.view;
+    colorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
+    colorAttachment.loadOp     = WGPULoadOp_Clear;
+    colorAttachment.storeOp    = WGPUStoreOp_Store;
+    WGPURenderPassDescriptor passDesc = WGPU_RENDER_PASS_DESCRIPTOR_INIT;
+    passDesc.colorAttachmentCount     = 1;
+    passDesc.colorAttachments         = &colorAttachment;
+    WGPURenderPassEncoder pass =
+        wgpuCommandEncoderBeginRenderPass(encoder, &passDesc);
+
+    uint32_t drawn = 0;
+    for (WGPURenderPipeline pipeline : pipelines) {
+        if (pipeline) {
+            wgpuRenderPassEncoderSetPipeline(pass, pipeline);
+            wgpuRenderPassEncoderDraw(pass, 3, 1, 0, 0);
+            ++drawn;
+        }
+    }
+    wgpuRenderPassEncoderEnd(pass);
+    wgpuRenderPassEncoderRelease(pass);
+
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, nullptr);
+    wgpuCommandEncoderRelease(encoder);
+    wgpuQueueSubmit(ctx.queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+    return drawn;
+}
+
+void waitForGpu(const BenchContext& ctx)
+{
+    onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "pipeline-reload",
+    "time to first frame and reload frame times, sync vs PipelineLoader")
+{
+    BenchReport report("pipeline-reload");
+    uint32_t    variant = 0;
+
+    // Startup: open the device, create the pipelines and the render target,
+    // then present a first frame
+    std::vector<double> syncFirstMs;
+    std::vector<double> asyncFirstMs;
+    std::vector<double> asyncAllReadyMs;
+    std::vector<double> asyncFirstDraws;
+    for (uint32_t i = 0; i < opts.iterations; ++i) {
+        {
+            auto         start = Clock::now();
+            BenchContext ctx;
+            if (!ctx.open(opts)) {
+                return 1;
+            }
+            PipelineRegistry                registry(ctx.device);
+            std::vector<WGPURenderPipeline> pipelines;
+            for (uint32_t p = 0; p < kPipelineCount; ++p) {
+                pipelines.push_back(
+                    registry.renderPipeline(makeSpec(makeSource(variant++))));
+            }
+            Target target(ctx);
+            renderFrame(ctx, target, pipelines);
+            waitForGpu(ctx);
+            syncFirstMs.push_back(elapsedMs(start));
+        }
+        {
+            auto         start = Clock::now();
+            BenchContext ctx;
+            if (!ctx.open(opts)) {
+                return 1;
+            }
+            PipelineLoader                  loader(ctx.instance, ctx.device);
+            std::vector<PipelineLoader::Id> ids;
+            for (uint32_t p = 0; p < kPipelineCount; ++p) {
+                ids.push_back(
+                    loader.addRenderPipeline(makeSpec(makeSource(variant++))));
+            }
+            // The pipelines compile meanwhile
+            Target target(ctx);
+
+            loader.update();
+            std::vector<WGPURenderPipeline> pipelines;
+            for (PipelineLoader::Id id : ids) {
+                pipelines.push_back(loader.renderPipeline(id));
+            }
+            uint32_t drawn = renderFrame(ctx, target, pipelines);
+            waitForGpu(ctx);
+            asyncFirstMs.push_back(elapsedMs(start));
+            asyncFirstDraws.push_back(drawn);
+
+            loader.waitAll();
+            asyncAllReadyMs.push_back(elapsedMs(start));
+        }
+    }
+    report.addValue("pipelines", kPipelineCount);
+    report.addSeries("sync_first_frame_ms", std::move(syncFirstMs));
+    report.addSeries("async_first_frame_ms", std::move(asyncFirstMs));
+    report.addSeries("async_all_ready_ms", std::move(asyncAllReadyMs));
+    report.addSeries("async_first_frame_draws", std::move(asyncFirstDraws));
+
+    // Reload: paced frames, the shader is saved at kSaveFrame of every round
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+    Target                target(ctx);
+    std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "wgputest-bench-reload.wgsl";
+    saveShader(path, makeSource(variant++));
+
+    // The render thread reads the file and creates the pipeline
+    std::vector<double> syncFrameMs;
+    std::vector<double> syncMaxMs;
+    {
+        PipelineRegistry   registry(ctx.device);
+        RenderPipelineSpec spec     = makeSpec(readShader(path));
+        WGPURenderPipeline pipeline = registry.renderPipeline(spec);
+        for (uint32_t i = 0; i < opts.iterations; ++i) {
+            double            maxMs = 0;
+            Clock::time_point next  = Clock::now();
+            for (uint32_t frame = 0; frame < kRoundFrames; ++frame) {
+                if (frame == kSaveFrame) {
+                    saveShader(path, makeSource(variant++));
+                }
+                auto start = Clock::now();
+                if (frame == kSaveFrame) {
+                    spec.shaderSource = readShader(path);
+                    pipeline          = registry.renderPipeline(spec);
+                }
+                renderFrame(ctx, target, {pipeline});
+                double ms = elapsedMs(start);
+                syncFrameMs.push_back(ms);
+                maxMs = std::max(maxMs, ms);
+                next += kFramePeriod;
+                std::this_thread::sleep_until(next);
+            }
+            syncMaxMs.push_back(maxMs);
+            waitForGpu(ctx);
+        }
+    }
+
+    // The loader picks up the change and swaps the pipeline once compiled
+    std::vector<double> asyncFrameMs;
+    std::vector<double> asyncMaxMs;
+    std::vector<double> saveToSwapMs;
+    PipelineLoader::Stats stats;
+    {
+        PipelineLoader loader(ctx.instance, ctx.device);
+        loader.enableHotReload();
+        PipelineLoader::Id id = loader.addRenderPipeline(makeSpec({}), path);
+        loader.waitAll();
+        for (uint32_t i = 0; i < opts.iterations; ++i) {
+            uint64_t          swaps   = loader.stats().swaps;
+            bool              swapped = false;
+            double            maxMs   = 0;
+            Clock::time_point saved;
+            Clock::time_point next = Clock::now();
+            for (uint32_t frame = 0;
+                 frame < kRoundFrames || (!swapped && frame < kMaxRoundFrames);
+                 ++frame) {
+                if (frame == kSaveFrame) {
+                    saveShader(path, makeSource(variant++));
+                    saved = Clock::now();
+                }
+                auto start = Clock::now();
+                loader.update();
+                renderFrame(ctx, target, {loader.renderPipeline(id)});
+                double ms = elapsedMs(start);
+                asyncFrameMs.push_back(ms);
+                maxMs = std::max(maxMs, ms);
+                if (!swapped && loader.stats().swaps > swaps) {
+                    swapped = true;
+                    saveToSwapMs.push_back(
+                        std::chrono::duration<double, std::milli>(
+                            start - saved)
+                            .count());
+                }
+                next += kFramePeriod;
+                std::this_thread::sleep_until(next);
+            }
+            asyncMaxMs.push_back(maxMs);
+            waitForGpu(ctx);
+        }
+        stats = loader.stats();
+    }
+    std::filesystem::remove(path);
+
+    report.addSeries("sync_reload_frame_ms", std::move(syncFrameMs));
+    report.addSeries("sync_reload_max_frame_ms", std::move(syncMaxMs));
+    report.addSeries("async_reload_frame_ms", std::move(asyncFrameMs));
+    report.addSeries("async_reload_max_frame_ms", std::move(asyncMaxMs));
+    report.addSeries("async_save_to_swap_ms", std::move(saveToSwapMs));
+    report.addValue("async_reloads", (double) stats.reloads);
+    report.addValue("async_failed", (double) stats.failed);
+    return report.write(opts) ? 0 : 1;
+}
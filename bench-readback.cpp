@@ -0,0 +1,106 @@
+#include "microbench.h"
+#include "readback-ring.h"
+#include "webgpu-utils.h"
+
+#include <vector>
+
+// Per-frame readback of a buffer: blocking fetchBufferDataSync versus the
+// pipelined ReadbackRing at several depths.
+
+namespace {
+
+constexpr uint64_t kReadbackSize = 4 << 20;
+
+// Stands in for the work a frame does before reading back its results
+void writeFrame(const BenchContext& ctx, WGPUBuffer source, uint32_t frame)
+{
+    wgpuQueueWriteBuffer(ctx.queue, source, 0, &frame, sizeof(frame));
+}
+
+void submit(const BenchContext& ctx, WGPUCommandEncoder encoder)
+{
+    WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+    wgpuQueueSubmit(ctx.queue, 1, &commands);
+    wgpuCommandBufferRelease(commands);
+    wgpuCommandEncoderRelease(encoder);
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "readback",
+    "per-frame 4 MiB readback, fetchBufferDataSync vs ReadbackRing")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+
+    WGPUBuffer source = ctx.createBuffer(
+        WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst, kReadbackSize);
+    WGPUBuffer readback = ctx.createBuffer(
+        WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, kReadbackSize);
+
+    BenchReport report("readback");
+    uint32_t    checksum = 0;
+    auto        consume  = [&checksum](const void* data) {
+        checksum += *reinterpret_cast<const uint32_t*>(data);
+    };
+
+    std::vector<double> syncFrameMs;
+    auto                runStart = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < opts.iterations; ++frame) {
+        auto start = std::chrono::steady_clock::now();
+        writeFrame(ctx, source, frame);
+        WGPUCommandEncoder encoder =
+            wgpuDeviceCreateCommandEncoder(ctx.device, nullptr);
+        wgpuCommandEncoderCopyBufferToBuffer(
+            encoder, source, 0, readback, 0, kReadbackSize);
+        submit(ctx, encoder);
+        fetchBufferDataSync(ctx.instance, readback, consume);
+        syncFrameMs.push_back(elapsedMs(start));
+    }
+    double syncSeconds = elapsedMs(runStart) / 1000.0;
+    report.addSeries("sync_frame_ms", std::move(syncFrameMs));
+    report.addValue(
+        "sync_bytes_per_second",
+        opts.iterations * kReadbackSize / syncSeconds);
+
+    for (uint32_t depth : {1u, 2u, 3u, 4u}) {
+        ReadbackRing        ring(ctx.instance, ctx.device, depth);
+        std::vector<double> frameMs;
+        for (uint32_t frame = 0; frame < opts.iterations; ++frame) {
+            auto start = std::chrono::steady_clock::now();
+            ring.poll();
+            writeFrame(ctx, source, frame);
+            WGPUCommandEncoder encoder =
+                wgpuDeviceCreateCommandEncoder(ctx.device, nullptr);
+            ring.enqueueCopy(
+                encoder,
+                source,
+                0,
+                kReadbackSize,
+                [&consume](const void* data, uint64_t) {
+                    consume(data);
+                });
+            submit(ctx, encoder);
+            ring.onSubmitted();
+            frameMs.push_back(elapsedMs(start));
+        }
+        ring.flush();
+
+        std::string   prefix = "ring" + std::to_string(depth) + "_";
+        ReadbackStats stats  = ring.stats();
+        report.addSeries(prefix + "frame_ms", std::move(frameMs));
+        report.addValue(prefix + "bytes_per_second", stats.bytesPerSecond);
+        report.addValue(prefix + "mean_latency_ms", stats.meanLatencyMs);
+        report.addValue(prefix + "max_latency_ms", stats.maxLatencyMs);
+        report.addValue(prefix + "stalls", (double) stats.stalls);
+    }
+
+    wgpuBufferRelease(readback);
+    wgpuBufferRelease(source);
+
+    report.addValue("checksum", checksum);
+    return report.write(opts) ? 0 : 1;
+}
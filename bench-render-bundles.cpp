@@ -0,0 +1,218 @@
+#include "microbench.h"
+#include "pipeline-cache.h"
+#include "render-bundle-cache.h"
+#include "webgpu-async.h"
+
+#include <string>
+#include <vector>
+
+// CPU time to encode a frame of many static draws, recorded directly in the
+// render pass every frame versus replayed from a RenderBundleCache.
+
+namespace {
+
+constexpr uint32_t kDrawCounts[] = {10000, 50000};
+constexpr uint32_t kTargetSize   = 256;
+
+const char* kShaderSource = R"(
+@group(0) @binding(0) var<storage, read> offsets: array<vec4f>;
+
+@vertex
+fn vs_main(
+    @builtin(vertex_index) v: u32,
+    @builtin(instance_index) i: u32
+) -> @builtin(position) vec4f {
+    let corner = vec2f(f32(v % 2u), f32(v / 2u)) * 0.01;
+    return vec4f(offsets[i % arrayLength(&offsets)].xy + corner, 0.0, 1.0);
+}
+
+@fragment
+fn fs_main() -> @location(0) vec4f {
+    return vec4f(1.0, 0.5, 0.0, 1.0);
+}
+)";
+
+struct Scene
+{
+    WGPURenderPipeline pipeline  = nullptr;
+    WGPUBindGroup      bindGroup = nullptr;
+    WGPUTextureView    target    = nullptr;
+};
+
+// Shared by the direct and bundle paths, which only differ by the encoder
+// type and its entry points
+template<
+    typename Encoder,
+    typename SetPipeline,
+    typename SetBindGroup,
+    typename Draw>
+void recordDraws(
+    Encoder      encoder,
+    const Scene& scene,
+    uint32_t     drawCount,
+    SetPipeline  setPipeline,
+    SetBindGroup setBindGroup,
+    Draw         draw)
+{
+    setPipeline(encoder, scene.pipeline);
+    setBindGroup(encoder, 0, scene.bindGroup, 0, nullptr);
+    for (uint32_t i = 0; i < drawCount; ++i) {
+        draw(encoder, 3, 1, 0, i);
+    }
+}
+
+// Encode and submit one frame, return the encoding time in ms
+double encodeFrame(
+    BenchContext&             ctx,
+    const Scene&              scene,
+    uint32_t                  drawCount,
+    RenderBundleCache*        bundles,
+    const RenderBundleTarget& target)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    WGPUCommandEncoderDescriptor encoderDesc =
+        WGPU_COMMAND_ENCODER_DESCRIPTOR_INIT;
+    WGPUCommandEncoder encoder =
+        wgpuDeviceCreateCommandEncoder(ctx.device, &encoderDesc);
+    WGPURenderPassColorAttachment colorAttachment =
+        WGPU_RENDER_PASS_COLOR_ATTACHMENT_INIT;
+    colorAttachment.view       = scene.target;
+    colorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
+    colorAttachment.loadOp     = WGPULoadOp_Clear;
+    colorAttachment.storeOp    = WGPUStoreOp_Store;
+    WGPURenderPassDescriptor passDesc = WGPU_RENDER_PASS_DESCRIPTOR_INIT;
+    passDesc.colorAttachmentCount     = 1;
+    passDesc.colorAttachments         = &colorAttachment;
+    WGPURenderPassEncoder pass =
+        wgpuCommandEncoderBeginRenderPass(encoder, &passDesc);
+
+    if (bundles) {
+        bundles->execute(pass, target);
+    }
+    else {
+        recordDraws(
+            pass,
+            scene,
+            drawCount,
+            wgpuRenderPassEncoderSetPipeline,
+            wgpuRenderPassEncoderSetBindGroup,
+            wgpuRenderPassEncoderDraw);
+    }
+
+    wgpuRenderPassEncoderEnd(pass);
+    wgpuRenderPassEncoderRelease(pass);
+    WGPUCommandBufferDescriptor commandDesc =
+        WGPU_COMMAND_BUFFER_DESCRIPTOR_INIT;
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &commandDesc);
+    wgpuCommandEncoderRelease(encoder);
+    double encodeMs = elapsedMs(start);
+
+    wgpuQueueSubmit(ctx.queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+    onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+    return encodeMs;
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "render-bundles",
+    "CPU encode time of 10k/50k static draws, direct vs render bundles")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+
+    PipelineRegistry   registry(ctx.device);
+    RenderPipelineSpec spec;
+    spec.label        = "Bundle benchmark";
+    spec.shaderSource = kShaderSource;
+    spec.colorFormats = {WGPUTextureFormat_RGBA8Unorm};
+    spec.topology     = WGPUPrimitiveTopology_TriangleStrip;
+
+    Scene scene;
+    scene.pipeline = registry.renderPipeline(spec);
+
+    std::vector<float> offsets(4 * 1024);
+    for (size_t i = 0; i < offsets.size(); i += 4) {
+        offsets[i]     = float(i % 256) / 128.0f - 1.0f;
+        offsets[i + 1] = float(i / 256) / 8.0f - 1.0f;
+    }
+    WGPUBufferDescriptor bufferDesc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    bufferDesc.usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst;
+    bufferDesc.size  = offsets.size() * sizeof(float);
+    WGPUBuffer offsetsBuffer = wgpuDeviceCreateBuffer(ctx.device, &bufferDesc);
+    wgpuQueueWriteBuffer(
+        ctx.queue, offsetsBuffer, 0, offsets.data(), bufferDesc.size);
+
+    WGPUBindGroupLayout layout =
+        wgpuRenderPipelineGetBindGroupLayout(scene.pipeline, 0);
+    WGPUBindGroupEntry entry = WGPU_BIND_GROUP_ENTRY_INIT;
+    entry.binding            = 0;
+    entry.buffer             = offsetsBuffer;
+    entry.size               = bufferDesc.size;
+    WGPUBindGroupDescriptor bindGroupDesc = WGPU_BIND_GROUP_DESCRIPTOR_INIT;
+    bindGroupDesc.layout                  = layout;
+    bindGroupDesc.entryCount              = 1;
+    bindGroupDesc.entries                 = &entry;
+    scene.bindGroup = wgpuDeviceCreateBindGroup(ctx.device, &bindGroupDesc);
+    wgpuBindGroupLayoutRelease(layout);
+
+    WGPUTextureDescriptor textureDesc = WGPU_TEXTURE_DESCRIPTOR_INIT;
+    textureDesc.usage         = WGPUTextureUsage_RenderAttachment;
+    textureDesc.dimension     = WGPUTextureDimension_2D;
+    textureDesc.size          = {kTargetSize, kTargetSize, 1};
+    textureDesc.format        = WGPUTextureFormat_RGBA8Unorm;
+    textureDesc.mipLevelCount = 1;
+    textureDesc.sampleCount   = 1;
+    WGPUTexture texture = wgpuDeviceCreateTexture(ctx.device, &textureDesc);
+    scene.target        = wgpuTextureCreateView(texture, nullptr);
+
+    RenderBundleTarget target;
+    target.colorFormats = {WGPUTextureFormat_RGBA8Unorm};
+
+    BenchReport report("render-bundles");
+    for (uint32_t drawCount : kDrawCounts) {
+        std::string suffix = "_" + std::to_string(drawCount);
+
+        std::vector<double> directMs;
+        for (unsigned int i = 0; i < opts.iterations; ++i) {
+            directMs.push_back(
+                encodeFrame(ctx, scene, drawCount, nullptr, target));
+        }
+
+        RenderBundleCache bundles(ctx.device);
+        bundles.add("Static draws", [&](WGPURenderBundleEncoder encoder) {
+            recordDraws(
+                encoder,
+                scene,
+                drawCount,
+                wgpuRenderBundleEncoderSetPipeline,
+                wgpuRenderBundleEncoderSetBindGroup,
+                wgpuRenderBundleEncoderDraw);
+        });
+        // The first frame records the bundle
+        double firstFrameMs =
+            encodeFrame(ctx, scene, drawCount, &bundles, target);
+        std::vector<double> bundleMs;
+        for (unsigned int i = 0; i < opts.iterations; ++i) {
+            bundleMs.push_back(
+                encodeFrame(ctx, scene, drawCount, &bundles, target));
+        }
+
+        report.addSeries("direct_encode_ms" + suffix, std::move(directMs));
+        report.addSeries("bundle_encode_ms" + suffix, std::move(bundleMs));
+        report.addValue("bundle_first_frame_ms" + suffix, firstFrameMs);
+        report.addValue("bundle_record_ms" + suffix, bundles.stats().recordMs);
+    }
+
+    wgpuTextureViewRelease(scene.target);
+    wgpuTextureDestroy(texture);
+    wgpuTextureRelease(texture);
+    wgpuBindGroupRelease(scene.bindGroup);
+    wgpuBufferDestroy(offsetsBuffer);
+    wgpuBufferRelease(offsetsBuffer);
+    return report.write(opts) ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#include "buffer-allocator.h"
+#include "microbench.h"
+#include "wgsl-layout.h"
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+// Per-draw uniforms kept in host-friendly structs and repacked field by
+// field into the WGSL layout every frame, versus kept in a struct declared
+// with WGSL_STRUCT and written to the ring with one memcpy.
+
+namespace {
+
+constexpr uint32_t kDrawsPerFrame = 10000;
+
+struct HostDraw
+{
+    std::array<float, 16> model  = {};
+    std::array<float, 9>  normal = {}; // 3x3, column-major
+    std::array<float, 3>  tint   = {};
+    float                 alpha  = 1;
+};
+
+struct DrawUniforms
+{
+    wgsl::mat4x4f           model;
+    wgsl::mat3x3f           normal;
+    alignas(16) wgsl::vec3f tint;
+    float                   alpha = 1;
+};
+
+} // namespace
+
+WGSL_STRUCT(DrawUniforms, model, normal, tint, alpha);
+static_assert(wgslLayoutMatches<DrawUniforms, WgslAddressSpace::Uniform>());
+
+namespace {
+
+// What the upload code does without a shared layout: offsets and padding
+// written out by hand, matching the shader's struct
+void repack(const HostDraw& draw, float* out)
+{
+    std::memcpy(out, draw.model.data(), sizeof(draw.model));
+    for (int column = 0; column < 3; ++column) {
+        std::memcpy(out + 16 + column * 4, &draw.normal[column * 3], 12);
+        out[16 + column * 4 + 3] = 0;
+    }
+    std::memcpy(out + 28, draw.tint.data(), sizeof(draw.tint));
+    out[31] = draw.alpha;
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "uniform-layout",
+    "10k per-draw uniforms per frame, repacked vs WGSL_STRUCT memcpy")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+
+    std::vector<HostDraw>     hostDraws(kDrawsPerFrame);
+    std::vector<DrawUniforms> draws(kDrawsPerFrame);
+    for (uint32_t i = 0; i < kDrawsPerFrame; ++i) {
+        hostDraws[i].model[0]  = hostDraws[i].model[5] = 1;
+        hostDraws[i].model[10] = hostDraws[i].model[15] = 1;
+        hostDraws[i].model[12] = float(i);
+        draws[i].model.columns[0][0] = draws[i].model.columns[1][1] = 1;
+        draws[i].model.columns[2][2] = draws[i].model.columns[3][3] = 1;
+        draws[i].model.columns[3][0] = float(i);
+    }
+
+    FrameRingAllocator ring(
+        ctx.device, kDrawsPerFrame * alignUp(sizeof(DrawUniforms), 256), 3);
+    std::vector<double> repackMs, repackFrameMs, layoutMs, layoutFrameMs;
+    uint64_t            frame = 0;
+    for (unsigned int i = 0; i < opts.iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        ring.beginFrame(frame++);
+        for (const HostDraw& draw : hostDraws) {
+            RingAllocation allocation = ring.allocate(sizeof(DrawUniforms));
+            repack(draw, static_cast<float*>(allocation.data));
+        }
+        repackMs.push_back(elapsedMs(start));
+        ring.flush(ctx.queue);
+        wgpuQueueSubmit(ctx.queue, 0, nullptr);
+        repackFrameMs.push_back(elapsedMs(start));
+    }
+    for (unsigned int i = 0; i < opts.iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        ring.beginFrame(frame++);
+        for (const DrawUniforms& draw : draws) {
+            ring.write(draw);
+        }
+        layoutMs.push_back(elapsedMs(start));
+        ring.flush(ctx.queue);
+        wgpuQueueSubmit(ctx.queue, 0, nullptr);
+        layoutFrameMs.push_back(elapsedMs(start));
+    }
+
+    BenchReport report("uniform-layout");
+    report.addValue("uniform_bytes", sizeof(DrawUniforms));
+    report.addSeries("repack_fill_ms", std::move(repackMs));
+    report.addSeries("repack_frame_ms", std::move(repackFrameMs));
+    report.addSeries("layout_fill_ms", std::move(layoutMs));
+    report.addSeries("layout_frame_ms", std::move(layoutFrameMs));
+    return report.write(opts) ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+#include "microbench.h"
+#include "staging-belt.h"
+
+#include <string>
+#include <vector>
+
+// Loading a scene worth of buffers and textures: one writeBuffer or
+// writeTexture per resource versus the StagingBelt, with and without a
+// per-frame byte budget. Each sample ends when the GPU has run the copies.
+
+namespace {
+
+constexpr uint32_t kBufferCount  = 128;
+constexpr uint64_t kBufferSize   = 256 << 10;
+constexpr uint32_t kTextureCount = 4;
+// Rows of 4000 bytes, which the belt repacks to 4096
+constexpr uint32_t kTextureSize = 1000;
+constexpr uint64_t kFrameBudget = 8 << 20;
+
+constexpr uint64_t kTextureBytes = uint64_t(kTextureSize) * kTextureSize * 4;
+
+struct Scene
+{
+    std::vector<WGPUBuffer>  buffers;
+    std::vector<WGPUTexture> textures;
+    std::vector<uint8_t>     bufferData;
+    std::vector<uint8_t>     textureData;
+};
+
+WGPUTexelCopyTextureInfo textureDestination(WGPUTexture texture)
+{
+    WGPUTexelCopyTextureInfo destination = WGPU_TEXEL_COPY_TEXTURE_INFO_INIT;
+    destination.texture                  = texture;
+    destination.aspect                   = WGPUTextureAspect_All;
+    return destination;
+}
+
+WGPUTexelCopyBufferLayout textureLayout()
+{
+    WGPUTexelCopyBufferLayout layout = {};
+    layout.bytesPerRow               = kTextureSize * 4;
+    layout.rowsPerImage              = kTextureSize;
+    return layout;
+}
+
+constexpr WGPUExtent3D kTextureExtent = {kTextureSize, kTextureSize, 1};
+
+void waitForGpu(const BenchContext& ctx)
+{
+    onSubmittedWorkDoneAsync(ctx.instance, ctx.queue).wait();
+}
+
+double uploadBuffersDirect(const BenchContext& ctx, const Scene& scene)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (WGPUBuffer buffer : scene.buffers) {
+        wgpuQueueWriteBuffer(
+            ctx.queue, buffer, 0, scene.bufferData.data(), kBufferSize);
+    }
+    waitForGpu(ctx);
+    return elapsedMs(start);
+}
+
+double uploadTexturesDirect(const BenchContext& ctx, const Scene& scene)
+{
+    auto                      start  = std::chrono::steady_clock::now();
+    WGPUTexelCopyBufferLayout layout = textureLayout();
+    for (WGPUTexture texture : scene.textures) {
+        WGPUTexelCopyTextureInfo destination = textureDestination(texture);
+        wgpuQueueWriteTexture(
+            ctx.queue,
+            &destination,
+            scene.textureData.data(),
+            kTextureBytes,
+            &layout,
+            &kTextureExtent);
+    }
+    waitForGpu(ctx);
+    return elapsedMs(start);
+}
+
+// Upload the buffers over as many frames as the budget of `belt` requires
+double uploadBuffersBelt(
+    const BenchContext& ctx,
+    const Scene&        scene,
+    StagingBelt&        belt,
+    uint32_t&           frames)
+{
+    auto   start = std::chrono::steady_clock::now();
+    size_t next  = 0;
+    frames       = 0;
+    while (next < scene.buffers.size()) {
+        belt.beginFrame();
+        while (next < scene.buffers.size() &&
+               belt.uploadBuffer(
+                   scene.buffers[next],
+                   0,
+                   scene.bufferData.data(),
+                   kBufferSize) == UploadResult::Recorded) {
+            ++next;
+        }
+        belt.submit(ctx.queue);
+        ++frames;
+    }
+    waitForGpu(ctx);
+    return elapsedMs(start);
+}
+
+double uploadTexturesBelt(
+    const BenchContext& ctx,
+    const Scene&        scene,
+    StagingBelt&        belt)
+{
+    auto start = std::chrono::steady_clock::now();
+    belt.beginFrame();
+    for (WGPUTexture texture : scene.textures) {
+        belt.uploadTexture(
+            textureDestination(texture),
+            scene.textureData.data(),
+            textureLayout(),
+            kTextureExtent);
+    }
+    belt.submit(ctx.queue);
+    waitForGpu(ctx);
+    return elapsedMs(start);
+}
+
+// GB/s of moving `bytes` in the mean time of `samples`
+double gigabytesPerSecond(uint64_t bytes, const std::vector<double>& samples)
+{
+    double meanMs = computeSampleStats(samples).mean;
+    return meanMs > 0 ? bytes / (meanMs * 1e6) : 0;
+}
+
+} // namespace
+
+MICROBENCHMARK(
+    "upload",
+    "32 MiB of buffers and 16 MB of textures, writeBuffer vs StagingBelt")
+{
+    BenchContext ctx;
+    if (!ctx.open(opts)) {
+        return 1;
+    }
+
+    Scene scene;
+    scene.bufferData.resize(kBufferSize, 0x5a);
+    scene.textureData.resize(kTextureBytes, 0xa5);
+    for (uint32_t i = 0; i < kBufferCount; ++i) {
+        WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+        desc.usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst;
+        desc.size  = kBufferSize;
+        scene.buffers.push_back(wgpuDeviceCreateBuffer(ctx.device, &desc));
+    }
+    for (uint32_t i = 0; i < kTextureCount; ++i) {
+        WGPUTextureDescriptor desc = WGPU_TEXTURE_DESCRIPTOR_INIT;
+        desc.usage =
+            WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
+        desc.dimension     = WGPUTextureDimension_2D;
+        desc.size          = kTextureExtent;
+        desc.format        = WGPUTextureFormat_RGBA8Unorm;
+        desc.mipLevelCount = 1;
+        desc.sampleCount   = 1;
+        scene.textures.push_back(wgpuDeviceCreateTexture(ctx.device, &desc));
+    }
+
+    StagingBelt belt(ctx.instance, ctx.device);
+    StagingBelt budgetBelt(ctx.instance, ctx.device, 8 << 20, kFrameBudget);
+
+    std::vector<double> writeBufferMs, beltBufferMs, budgetBufferMs;
+    std::vector<double> writeTextureMs, beltTextureMs;
+    uint32_t            frames       = 0;
+    uint32_t            budgetFrames = 0;
+    // The first round creates the staging chunks and is not recorded
+    for (unsigned int i = 0; i <= opts.iterations; ++i) {
+        double writeBuffer  = uploadBuffersDirect(ctx, scene);
+        double beltBuffer   = uploadBuffersBelt(ctx, scene, belt, frames);
+        double budgetBuffer =
+            uploadBuffersBelt(ctx, scene, budgetBelt, budgetFrames);
+        double writeTexture = uploadTexturesDirect(ctx, scene);
+        double beltTexture  = uploadTexturesBelt(ctx, scene, belt);
+        if (i == 0)
+            continue;
+        writeBufferMs.push_back(writeBuffer);
+        beltBufferMs.push_back(beltBuffer);
+        budgetBufferMs.push_back(budgetBuffer);
+        writeTextureMs.push_back(writeTexture);
+        beltTextureMs.push_back(beltTexture);
+    }
+
+    uint64_t bufferBytes  = kBufferCount * kBufferSize;
+    uint64_t textureBytes = kTextureCount * kTextureBytes;
+    BenchReport report("upload");
+    report.addValue("buffer_bytes", bufferBytes);
+    report.addValue("texture_bytes", textureBytes);
+    report.addValue(
+        "write_buffer_gb_per_s",
+        gigabytesPerSecond(bufferBytes, writeBufferMs));
+    report.addValue(
+        "belt_buffer_gb_per_s", gigabytesPerSecond(bufferBytes, beltBufferMs));
+    report.addValue(
+        "budget_buffer_gb_per_s",
+        gigabytesPerSecond(bufferBytes, budgetBufferMs));
+    report.addValue("belt_frames", frames);
+    report.addValue("budget_frames", budgetFrames);
+    report.addValue(
+        "write_texture_gb_per_s",
+        gigabytesPerSecond(textureBytes, writeTextureMs));
+    report.addValue(
+        "belt_texture_gb_per_s",
+        gigabytesPerSecond(textureBytes, beltTextureMs));
+    report.addSeries("write_buffer_ms", std::move(writeBufferMs));
+    report.addSeries("belt_buffer_ms", std::move(beltBufferMs));
+    report.addSeries("budget_buffer_ms", std::move(budgetBufferMs));
+    report.addSeries("write_texture_ms", std::move(writeTextureMs));
+    report.addSeries("belt_texture_ms", std::move(beltTextureMs));
+
+    UploadStats stats = belt.stats();
+    report.addValue("belt_chunks_created", (double) stats.chunksCreated);
+    report.addValue("belt_chunks_recycled", (double) stats.chunksRecycled);
+    report.addValue("belt_staging_bytes", (double) stats.stagingBytes);
+    report.addValue(
+        "budget_throttled", (double) budgetBelt.stats().throttled);
+
+    for (WGPUBuffer buffer : scene.buffers) {
+        wgpuBufferRelease(buffer);
+    }
+    for (WGPUTexture texture : scene.textures) {
+        wgpuTextureDestroy(texture);
+        wgpuTextureRelease(texture);
+    }
+    return report.write(opts) ? 0 : 1;
+}
@@ -0,0 +1,312 @@
+#include "binding-cache.h"
+
+#include "hashing.h"
+#include "metrics.h"
+
+#include <cstring>
+
+namespace {
+
+void releaseHandle(WGPUBindGroupLayout handle)
+{
+    wgpuBindGroupLayoutRelease(handle);
+}
+
+void releaseHandle(WGPUBindGroup handle)
+{
+    wgpuBindGroupRelease(handle);
+}
+
+void releaseHandle(WGPUPipelineLayout handle)
+{
+    wgpuPipelineLayoutRelease(handle);
+}
+
+void releaseHandle(WGPUSampler handle)
+{
+    wgpuSamplerRelease(handle);
+}
+
+uint64_t word(const void* handle)
+{
+    return uint64_t(uintptr_t(handle));
+}
+
+uint64_t word(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+uint64_t hashKey(const std::vector<uint64_t>& key)
+{
+    return hashBytes(key.data(), key.size() * sizeof(uint64_t));
+}
+
+// Descriptor serialization: one word per field, labels left out. Return
+// false if a chained struct is found, its content cannot be keyed.
+
+bool keyOf(
+    const WGPUBindGroupLayoutDescriptor& desc,
+    std::vector<uint64_t>&               key)
+{
+    if (desc.nextInChain)
+        return false;
+    key.push_back(desc.entryCount);
+    for (size_t i = 0; i < desc.entryCount; ++i) {
+        const WGPUBindGroupLayoutEntry& entry = desc.entries[i];
+        if (entry.nextInChain || entry.buffer.nextInChain ||
+            entry.sampler.nextInChain || entry.texture.nextInChain ||
+            entry.storageTexture.nextInChain) {
+            return false;
+        }
+        key.insert(
+            key.end(),
+            {entry.binding,
+             uint64_t(entry.visibility),
+             uint64_t(entry.buffer.type),
+             uint64_t(entry.buffer.hasDynamicOffset),
+             entry.buffer.minBindingSize,
+             uint64_t(entry.sampler.type),
+             uint64_t(entry.texture.sampleType),
+             uint64_t(entry.texture.viewDimension),
+             uint64_t(entry.texture.multisampled),
+             uint64_t(entry.storageTexture.access),
+             uint64_t(entry.storageTexture.format),
+             uint64_t(entry.storageTexture.viewDimension)});
+    }
+    return true;
+}
+
+bool keyOf(const WGPUBindGroupDescriptor& desc, std::vector<uint64_t>& key)
+{
+    if (desc.nextInChain)
+        return false;
+    key.push_back(word(desc.layout));
+    key.push_back(desc.entryCount);
+    for (size_t i = 0; i < desc.entryCount; ++i) {
+        const WGPUBindGroupEntry& entry = desc.entries[i];
+        if (entry.nextInChain)
+            return false;
+        key.insert(
+            key.end(),
+            {entry.binding,
+             word(entry.buffer),
+             entry.offset,
+             entry.size,
+             word(entry.sampler),
+             word(entry.textureView)});
+    }
+    return true;
+}
+
+// Immediate data size of a pipeline layout, whose field name varies
+// between header versions
+template<typename Descriptor>
+uint64_t immediateSize(const Descriptor& desc)
+{
+    if constexpr (requires { desc.immediateSize; }) {
+        return desc.immediateSize;
+    }
+    else if constexpr (requires { desc.immediateDataRangeByteSize; }) {
+        return desc.immediateDataRangeByteSize;
+    }
+    else {
+        return 0;
+    }
+}
+
+bool keyOf(
+    const WGPUPipelineLayoutDescriptor& desc,
+    std::vector<uint64_t>&              key)
+{
+    if (desc.nextInChain)
+        return false;
+    key.push_back(immediateSize(desc));
+    key.push_back(desc.bindGroupLayoutCount);
+    for (size_t i = 0; i < desc.bindGroupLayoutCount; ++i) {
+        key.push_back(word(desc.bindGroupLayouts[i]));
+    }
+    return true;
+}
+
+bool keyOf(const WGPUSamplerDescriptor& desc, std::vector<uint64_t>& key)
+{
+    if (desc.nextInChain)
+        return false;
+    key.insert(
+        key.end(),
+        {uint64_t(desc.addressModeU),
+         uint64_t(desc.addressModeV),
+         uint64_t(desc.addressModeW),
+         uint64_t(desc.magFilter),
+         uint64_t(desc.minFilter),
+         uint64_t(desc.mipmapFilter),
+         word(desc.lodMinClamp),
+         word(desc.lodMaxClamp),
+         uint64_t(desc.compare),
+         desc.maxAnisotropy});
+    return true;
+}
+
+} // namespace
+
+template<typename Handle>
+Handle BindingCache::Table<Handle>::find(
+    uint64_t                     hash,
+    const std::vector<uint64_t>& key)
+{
+    auto range = index.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        // Full comparison rules out hash collisions
+        if (it->second->key == key) {
+            lru.splice(lru.begin(), lru, it->second);
+            ++counters.hits;
+            countMetric(MetricCounter::BindingHits);
+            return it->second->handle;
+        }
+    }
+    return nullptr;
+}
+
+template<typename Handle>
+void BindingCache::Table<Handle>::insert(
+    uint64_t              hash,
+    std::vector<uint64_t> key,
+    Handle                handle,
+    size_t                capacity)
+{
+    while (!lru.empty() && lru.size() >= capacity) {
+        erase(std::prev(lru.end()));
+        ++counters.evictions;
+    }
+    lru.push_front({hash, std::move(key), handle});
+    index.emplace(hash, lru.begin());
+    counters.size = lru.size();
+}
+
+template<typename Handle>
+void BindingCache::Table<Handle>::erase(Iterator it)
+{
+    auto range = index.equal_range(it->hash);
+    for (auto i = range.first; i != range.second; ++i) {
+        if (i->second == it) {
+            index.erase(i);
+            break;
+        }
+    }
+    releaseHandle(it->handle);
+    lru.erase(it);
+    counters.size = lru.size();
+}
+
+template<typename Handle>
+void BindingCache::Table<Handle>::clear()
+{
+    for (Entry& entry : lru) {
+        releaseHandle(entry.handle);
+    }
+    lru.clear();
+    index.clear();
+    counters.size = 0;
+}
+
+BindingCache::BindingCache(WGPUDevice device, size_t capacity) :
+        m_device(device), m_capacity(capacity > 0 ? capacity : 1)
+{
+}
+
+BindingCache::~BindingCache()
+{
+    clear();
+}
+
+template<typename Handle, typename Descriptor, typename Create>
+Handle BindingCache::lookup(
+    Table<Handle>&    table,
+    const Descriptor& descriptor,
+    Create            create)
+{
+    m_key.clear();
+    bool keyed = keyOf(descriptor, m_key);
+    if (!keyed) {
+        // Unique key, so that the cache still owns the object
+        m_key.assign({~uint64_t(0), ++m_uniqueId});
+        ++table.counters.uncached;
+    }
+    uint64_t hash = hashKey(m_key);
+    if (keyed) {
+        if (Handle handle = table.find(hash, m_key))
+            return handle;
+    }
+    Handle handle = create(m_device, &descriptor);
+    ++table.counters.misses;
+    countMetric(MetricCounter::BindingMisses);
+    if (handle) {
+        table.insert(hash, m_key, handle, m_capacity);
+    }
+    return handle;
+}
+
+WGPUBindGroupLayout BindingCache::bindGroupLayout(
+    const WGPUBindGroupLayoutDescriptor& descriptor)
+{
+    return lookup(
+        m_bindGroupLayouts, descriptor, wgpuDeviceCreateBindGroupLayout);
+}
+
+WGPUBindGroup BindingCache::bindGroup(const WGPUBindGroupDescriptor& descriptor)
+{
+    return lookup(m_bindGroups, descriptor, wgpuDeviceCreateBindGroup);
+}
+
+WGPUPipelineLayout BindingCache::pipelineLayout(
+    const WGPUPipelineLayoutDescriptor& descriptor)
+{
+    return lookup(
+        m_pipelineLayouts, descriptor, wgpuDeviceCreatePipelineLayout);
+}
+
+WGPUSampler BindingCache::sampler(const WGPUSamplerDescriptor& descriptor)
+{
+    return lookup(m_samplers, descriptor, wgpuDeviceCreateSampler);
+}
+
+void BindingCache::evictResource(const void* resource)
+{
+    // Bind group keys are [layout, count, {binding, buffer, offset, size,
+    // sampler, view}...]
+    constexpr size_t kEntryWords = 6;
+    uint64_t         target      = word(resource);
+    for (auto it = m_bindGroups.lru.begin(); it != m_bindGroups.lru.end();) {
+        auto        next = std::next(it);
+        const auto& key  = it->key;
+        bool        uses = false;
+        for (size_t i = 2; i + kEntryWords <= key.size(); i += kEntryWords) {
+            uses = uses || key[i + 1] == target || key[i + 4] == target ||
+                   key[i + 5] == target;
+        }
+        if (uses)
+            m_bindGroups.erase(it);
+        it = next;
+    }
+}
+
+void BindingCache::clear()
+{
+    // Bind groups first, they reference the layouts
+    m_bindGroups.clear();
+    m_pipelineLayouts.clear();
+    m_bindGroupLayouts.clear();
+    m_samplers.clear();
+}
+
+BindingCache::Stats BindingCache::stats() const
+{
+    return {
+        m_bindGroupLayouts.counters,
+        m_bindGroups.counters,
+        m_pipelineLayouts.counters,
+        m_samplers.counters};
+}
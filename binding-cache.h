@@ -0,0 +1,116 @@
+#ifndef BINDING_CACHE_H
+#define BINDING_CACHE_H
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Cache of bind group layouts, bind groups, pipeline layouts and samplers,
+ * keyed by the content of their descriptor (labels excepted). Identical
+ * requests return the same handle, owned by the cache.
+ *
+ * Each kind keeps at most `capacity` objects and evicts the least recently
+ * requested one beyond that. A handle stays valid until it is evicted:
+ * recording it in an encoder is always safe, keeping it across frames
+ * needs an AddRef. Cached bind groups hold a reference to their resources;
+ * evictResource() drops them when a resource is retired.
+ *
+ * Descriptors with chained structs are not keyed: each request creates a
+ * new object (counted as uncached), still owned and evicted by the cache.
+ */
+class BindingCache
+{
+public:
+    struct Counters
+    {
+        uint64_t hits      = 0;
+        uint64_t misses    = 0; // objects created
+        uint64_t evictions = 0;
+        uint64_t uncached  = 0; // requests with chained structs
+        uint64_t size      = 0; // live objects
+    };
+
+    struct Stats
+    {
+        Counters bindGroupLayouts;
+        Counters bindGroups;
+        Counters pipelineLayouts;
+        Counters samplers;
+    };
+
+    explicit BindingCache(WGPUDevice device, size_t capacity = 4096);
+    ~BindingCache();
+
+    BindingCache(const BindingCache&)            = delete;
+    BindingCache& operator=(const BindingCache&) = delete;
+
+    WGPUBindGroupLayout bindGroupLayout(
+        const WGPUBindGroupLayoutDescriptor& descriptor);
+
+    WGPUBindGroup bindGroup(const WGPUBindGroupDescriptor& descriptor);
+
+    WGPUPipelineLayout pipelineLayout(
+        const WGPUPipelineLayoutDescriptor& descriptor);
+
+    WGPUSampler sampler(const WGPUSamplerDescriptor& descriptor);
+
+    // Release the bind groups that reference `resource` (a buffer, texture
+    // view or sampler), so that it can be freed
+    void evictResource(const void* resource);
+
+    // Release everything
+    void clear();
+
+    Stats stats() const;
+
+private:
+    // Objects of one kind in least recently used order
+    template<typename Handle>
+    struct Table
+    {
+        struct Entry
+        {
+            uint64_t              hash = 0;
+            std::vector<uint64_t> key;
+            Handle                handle = nullptr;
+        };
+        using Iterator = typename std::list<Entry>::iterator;
+
+        std::list<Entry>                            lru; // most recent first
+        std::unordered_multimap<uint64_t, Iterator> index;
+        Counters                                    counters;
+
+        // Return the cached handle and mark it as the most recent
+        Handle find(uint64_t hash, const std::vector<uint64_t>& key);
+        void   insert(
+              uint64_t              hash,
+              std::vector<uint64_t> key,
+              Handle                handle,
+              size_t                capacity);
+        void erase(Iterator it);
+        void clear();
+    };
+
+    template<typename Handle, typename Descriptor, typename Create>
+    Handle lookup(
+        Table<Handle>&    table,
+        const Descriptor& descriptor,
+        Create            create);
+
+    // Serialized descriptor, empty if it cannot be keyed
+    std::vector<uint64_t> m_key;
+
+    WGPUDevice                 m_device   = nullptr;
+    size_t                     m_capacity = 0;
+    uint64_t                   m_uniqueId = 0;
+    Table<WGPUBindGroupLayout> m_bindGroupLayouts;
+    Table<WGPUBindGroup>       m_bindGroups;
+    Table<WGPUPipelineLayout>  m_pipelineLayouts;
+    Table<WGPUSampler>         m_samplers;
+};
+
+#endif // BINDING_CACHE_H
@@ -0,0 +1,323 @@
+#include "buffer-allocator.h"
+
+#include "gpu-resources.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+FrameRingAllocator::FrameRingAllocator(
+    WGPUDevice device,
+    uint64_t   bytesPerFrame,
+    uint32_t   framesInFlight) :
+        m_device(device), m_framesInFlight(std::max(framesInFlight, 1u))
+{
+    WGPULimits limits = WGPU_LIMITS_INIT;
+    if (wgpuDeviceGetLimits(device, &limits) == WGPUStatus_Success) {
+        m_uniformAlignment = limits.minUniformBufferOffsetAlignment;
+        m_storageAlignment = limits.minStorageBufferOffsetAlignment;
+    }
+    m_bytesPerFrame = alignUp(
+        bytesPerFrame, std::max(m_uniformAlignment, m_storageAlignment));
+    createBuffer();
+}
+
+FrameRingAllocator::~FrameRingAllocator()
+{
+    setMemoryTracker(nullptr);
+    if (m_buffer) {
+        wgpuBufferRelease(m_buffer);
+    }
+}
+
+void FrameRingAllocator::setMemoryTracker(GpuMemoryTracker* memory)
+{
+    if (!m_buffer) {
+        m_memory = memory;
+        return;
+    }
+    uint64_t size = wgpuBufferGetSize(m_buffer);
+    if (m_memory) {
+        m_memory->onReleased(ResourceCategory::Uniform, size);
+    }
+    m_memory = memory;
+    if (m_memory) {
+        m_memory->onAllocated(ResourceCategory::Uniform, size);
+    }
+}
+
+void FrameRingAllocator::createBuffer()
+{
+    if (m_buffer) {
+        if (m_memory) {
+            m_memory->onReleased(
+                ResourceCategory::Uniform, wgpuBufferGetSize(m_buffer));
+        }
+        // Frames still in flight keep the previous buffer alive
+        wgpuBufferRelease(m_buffer);
+    }
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    desc.label                = {"Frame ring buffer", WGPU_STRLEN};
+    desc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_Storage |
+                 WGPUBufferUsage_CopyDst;
+    desc.size  = m_bytesPerFrame * m_framesInFlight;
+    m_buffer   = wgpuDeviceCreateBuffer(m_device, &desc);
+    if (m_memory) {
+        m_memory->onAllocated(ResourceCategory::Uniform, desc.size);
+    }
+    m_shadow.resize(m_bytesPerFrame);
+    ++m_generation;
+}
+
+void FrameRingAllocator::beginFrame(uint64_t frameIndex)
+{
+    if (m_frameOverflow > 0) {
+        m_bytesPerFrame = alignUp(
+            std::max(m_bytesPerFrame * 2, m_bytesPerFrame + m_frameOverflow),
+            std::max(m_uniformAlignment, m_storageAlignment));
+        m_frameOverflow = 0;
+        createBuffer();
+    }
+    m_segmentStart    = (frameIndex % m_framesInFlight) * m_bytesPerFrame;
+    m_cursor          = 0;
+    m_requested       = 0;
+    m_allocationCount = 0;
+}
+
+RingAllocation FrameRingAllocator::allocate(uint64_t size, Usage usage)
+{
+    uint32_t alignment =
+        usage == Usage::Uniform ? m_uniformAlignment : m_storageAlignment;
+    uint64_t offset = alignUp(m_cursor, alignment);
+    if (offset + size > m_bytesPerFrame) {
+        m_overflowBytes += size;
+        m_frameOverflow += alignUp(size, alignment);
+        return {};
+    }
+    m_cursor = offset + size;
+    m_requested += size;
+    ++m_allocationCount;
+
+    RingAllocation allocation;
+    allocation.buffer = m_buffer;
+    allocation.offset = (uint32_t) (m_segmentStart + offset);
+    allocation.size   = size;
+    allocation.data   = m_shadow.data() + offset;
+    return allocation;
+}
+
+void FrameRingAllocator::flush(WGPUQueue queue)
+{
+    if (m_cursor == 0)
+        return;
+    wgpuQueueWriteBuffer(
+        queue, m_buffer, m_segmentStart, m_shadow.data(), alignUp(m_cursor, 4));
+    countMetric(MetricCounter::UploadBytes, alignUp(m_cursor, 4));
+}
+
+AllocatorStats FrameRingAllocator::stats() const
+{
+    AllocatorStats stats;
+    stats.bytesUsed       = m_requested;
+    stats.bytesReserved   = m_bytesPerFrame * m_framesInFlight;
+    stats.bytesPadding    = m_cursor - m_requested;
+    stats.bufferCount     = m_buffer ? 1 : 0;
+    stats.allocationCount = (uint32_t) m_allocationCount;
+    return stats;
+}
+
+BlockAllocator::BlockAllocator(
+    WGPUDevice      device,
+    WGPUBufferUsage usage,
+    uint64_t        blockSize) :
+        m_device(device), m_usage(usage | WGPUBufferUsage_CopyDst),
+        m_blockSize(alignUp(blockSize, 4))
+{
+}
+
+BlockAllocator::~BlockAllocator()
+{
+    for (Block& block : m_blocks) {
+        if (block.buffer) {
+            releaseBlock(block);
+        }
+    }
+}
+
+void BlockAllocator::setMemoryTracker(GpuMemoryTracker* memory)
+{
+    ResourceCategory category = categorizeBuffer(m_usage);
+    for (const Block& block : m_blocks) {
+        if (block.buffer && m_memory) {
+            m_memory->onReleased(category, block.size);
+        }
+        if (block.buffer && memory) {
+            memory->onAllocated(category, block.size);
+        }
+    }
+    m_memory = memory;
+}
+
+void BlockAllocator::releaseBlock(Block& block)
+{
+    if (m_memory) {
+        m_memory->onReleased(categorizeBuffer(m_usage), block.size);
+    }
+    wgpuBufferRelease(block.buffer);
+    block = Block();
+}
+
+uint32_t BlockAllocator::addBlock(uint64_t size)
+{
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    desc.label                = {"Block allocator buffer", WGPU_STRLEN};
+    desc.usage                = m_usage;
+    desc.size                 = size;
+
+    Block block;
+    block.buffer        = wgpuDeviceCreateBuffer(m_device, &desc);
+    block.size          = size;
+    block.freeRanges[0] = size;
+    if (m_memory) {
+        m_memory->onAllocated(categorizeBuffer(m_usage), size);
+    }
+
+    // Reuse the slot of a released dedicated block if there is one
+    for (uint32_t i = 0; i < m_blocks.size(); ++i) {
+        if (!m_blocks[i].buffer) {
+            m_blocks[i] = std::move(block);
+            return i;
+        }
+    }
+    m_blocks.push_back(std::move(block));
+    return (uint32_t) m_blocks.size() - 1;
+}
+
+bool BlockAllocator::allocateFromBlock(
+    uint32_t         blockIndex,
+    uint64_t         size,
+    uint64_t         alignment,
+    BlockAllocation& allocation)
+{
+    Block& block = m_blocks[blockIndex];
+
+    // Best fit: the free range leaving the smallest remainder
+    auto     best         = block.freeRanges.end();
+    uint64_t bestLeftover = UINT64_MAX;
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end();
+         ++it) {
+        uint64_t padding = alignUp(it->first, alignment) - it->first;
+        if (padding + size > it->second)
+            continue;
+        uint64_t leftover = it->second - padding - size;
+        if (leftover < bestLeftover) {
+            best         = it;
+            bestLeftover = leftover;
+            if (leftover == 0)
+                break;
+        }
+    }
+    if (best == block.freeRanges.end())
+        return false;
+
+    uint64_t start   = best->first;
+    uint64_t padding = alignUp(start, alignment) - start;
+    block.freeRanges.erase(best);
+    if (bestLeftover > 0) {
+        block.freeRanges[start + padding + size] = bestLeftover;
+    }
+
+    block.used += size;
+    block.padding += padding;
+    ++block.liveCount;
+
+    allocation.buffer    = block.buffer;
+    allocation.offset    = start + padding;
+    allocation.size      = size;
+    allocation.m_block   = blockIndex;
+    allocation.m_start   = start;
+    allocation.m_reserve = padding + size;
+    return true;
+}
+
+BlockAllocation BlockAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+    BlockAllocation allocation;
+    if (size == 0)
+        return allocation;
+    size      = alignUp(size, 4);
+    alignment = std::max<uint64_t>(alignment, 4);
+
+    for (uint32_t i = 0; i < m_blocks.size(); ++i) {
+        if (m_blocks[i].buffer &&
+            allocateFromBlock(i, size, alignment, allocation)) {
+            return allocation;
+        }
+    }
+    uint32_t blockIndex = addBlock(std::max(m_blockSize, size));
+    allocateFromBlock(blockIndex, size, alignment, allocation);
+    return allocation;
+}
+
+void BlockAllocator::free(BlockAllocation& allocation)
+{
+    if (!allocation)
+        return;
+    Block& block = m_blocks[allocation.m_block];
+    assert(block.buffer == allocation.buffer);
+
+    block.used -= allocation.size;
+    block.padding -= allocation.m_reserve - allocation.size;
+    --block.liveCount;
+
+    if (block.liveCount == 0 && block.size > m_blockSize) {
+        // Dedicated buffers are not kept around once empty
+        releaseBlock(block);
+        allocation = BlockAllocation();
+        return;
+    }
+
+    uint64_t start = allocation.m_start;
+    uint64_t size  = allocation.m_reserve;
+
+    // Coalesce with the neighbouring free ranges
+    auto next = block.freeRanges.lower_bound(start);
+    if (next != block.freeRanges.end() && start + size == next->first) {
+        size += next->second;
+        next = block.freeRanges.erase(next);
+    }
+    if (next != block.freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == start) {
+            start = prev->first;
+            size += prev->second;
+            block.freeRanges.erase(prev);
+        }
+    }
+    block.freeRanges[start] = size;
+
+    allocation = BlockAllocation();
+}
+
+AllocatorStats BlockAllocator::stats() const
+{
+    AllocatorStats stats;
+    uint64_t       freeBytes    = 0;
+    uint64_t       largestRange = 0;
+    for (const Block& block : m_blocks) {
+        if (!block.buffer)
+            continue;
+        stats.bytesUsed += block.used;
+        stats.bytesReserved += block.size;
+        stats.bytesPadding += block.padding;
+        stats.allocationCount += block.liveCount;
+        ++stats.bufferCount;
+        for (const auto& [offset, size] : block.freeRanges) {
+            freeBytes += size;
+            largestRange = std::max(largestRange, size);
+        }
+    }
+    stats.bytesFragmented = freeBytes - largestRange;
+    return stats;
+}
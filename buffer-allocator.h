@@ -0,0 +1,201 @@
+#ifndef BUFFER_ALLOCATOR_H
+#define BUFFER_ALLOCATOR_H
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+class GpuMemoryTracker;
+
+/**
+ * Statistics shared by the buffer allocators.
+ */
+struct AllocatorStats
+{
+    uint64_t bytesUsed       = 0; // bytes requested by live allocations
+    uint64_t bytesReserved   = 0; // total size of the underlying buffers
+    uint64_t bytesPadding    = 0; // lost to alignment of live allocations
+    uint64_t bytesFragmented = 0; // free bytes outside the largest free range
+    uint32_t bufferCount     = 0;
+    uint32_t allocationCount = 0;
+};
+
+/**
+ * Round `value` up to the next multiple of `alignment` (a power of two).
+ */
+inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * A sub-allocation of the per-frame ring. `offset` is meant to be passed as
+ * a dynamic offset to setBindGroup, the bind group being created once over
+ * `buffer` with a layout entry that sets hasDynamicOffset.
+ */
+struct RingAllocation
+{
+    WGPUBuffer buffer = nullptr;
+    uint32_t   offset = 0;
+    uint64_t   size   = 0;
+    void*      data   = nullptr; // CPU memory uploaded by flush()
+
+    explicit operator bool() const { return buffer != nullptr; }
+};
+
+/**
+ * Linear allocator for data that lives for one frame (uniforms, per-draw
+ * storage). One Uniform | Storage buffer is split in one segment per frame in
+ * flight. Allocations are written to a CPU shadow and the used range of the
+ * frame is uploaded with a single writeBuffer in flush().
+ *
+ * Offsets respect minUniformBufferOffsetAlignment or
+ * minStorageBufferOffsetAlignment of the device.
+ */
+class FrameRingAllocator
+{
+public:
+    enum class Usage { Uniform, Storage };
+
+    FrameRingAllocator(
+        WGPUDevice device,
+        uint64_t   bytesPerFrame,
+        uint32_t   framesInFlight);
+    ~FrameRingAllocator();
+
+    FrameRingAllocator(const FrameRingAllocator&)            = delete;
+    FrameRingAllocator& operator=(const FrameRingAllocator&) = delete;
+
+    // Start allocating in the segment of `frameIndex`. If the previous
+    // frames overflowed, the buffer grows here and generation() changes.
+    void beginFrame(uint64_t frameIndex);
+
+    // Return an empty allocation if the frame segment is full
+    RingAllocation allocate(uint64_t size, Usage usage = Usage::Uniform);
+
+    // Allocate and copy `value`, already laid out as the shader reads it
+    // (see wgsl-layout.h)
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    RingAllocation write(const T& value, Usage usage = Usage::Uniform)
+    {
+        RingAllocation allocation = allocate(sizeof(T), usage);
+        if (allocation) {
+            std::memcpy(allocation.data, &value, sizeof(T));
+        }
+        return allocation;
+    }
+
+    // Upload what was allocated since beginFrame, before submitting
+    void flush(WGPUQueue queue);
+
+    WGPUBuffer buffer() const { return m_buffer; }
+
+    // Changes whenever buffer() is recreated; bind groups over the previous
+    // buffer must then be rebuilt
+    uint32_t generation() const { return m_generation; }
+
+    AllocatorStats stats() const;
+
+    uint64_t overflowBytes() const { return m_overflowBytes; }
+
+    // Account the ring buffer in `memory`, or stop with nullptr
+    void setMemoryTracker(GpuMemoryTracker* memory);
+
+private:
+    void createBuffer();
+
+    WGPUDevice           m_device           = nullptr;
+    GpuMemoryTracker*    m_memory           = nullptr;
+    WGPUBuffer           m_buffer           = nullptr;
+    uint32_t             m_uniformAlignment = 256;
+    uint32_t             m_storageAlignment = 256;
+    uint32_t             m_framesInFlight   = 1;
+    uint64_t             m_bytesPerFrame    = 0;
+    uint64_t             m_segmentStart     = 0;
+    uint64_t             m_cursor           = 0; // relative to segment
+    uint64_t             m_requested        = 0; // bytes asked this frame
+    uint64_t             m_allocationCount  = 0;
+    uint64_t             m_overflowBytes    = 0; // total since creation
+    uint64_t             m_frameOverflow    = 0; // pending growth
+    uint32_t             m_generation       = 0;
+    std::vector<uint8_t> m_shadow;
+};
+
+/**
+ * A sub-allocation of the block allocator.
+ */
+struct BlockAllocation
+{
+    WGPUBuffer buffer = nullptr;
+    uint64_t   offset = 0;
+    uint64_t   size   = 0;
+
+    explicit operator bool() const { return buffer != nullptr; }
+
+private:
+    friend class BlockAllocator;
+    uint32_t m_block   = 0;
+    uint64_t m_start   = 0; // start of the reserved range (before padding)
+    uint64_t m_reserve = 0; // reserved range size
+};
+
+/**
+ * Allocator for long-lived vertex and index data. Sub-allocates best-fit
+ * ranges from large buffers and coalesces ranges when they are freed.
+ * Requests larger than a block get a dedicated buffer.
+ */
+class BlockAllocator
+{
+public:
+    BlockAllocator(
+        WGPUDevice      device,
+        WGPUBufferUsage usage,
+        uint64_t        blockSize = 64 << 20);
+    ~BlockAllocator();
+
+    BlockAllocator(const BlockAllocator&)            = delete;
+    BlockAllocator& operator=(const BlockAllocator&) = delete;
+
+    // `alignment` must be a power of two; offsets and sizes are at least
+    // 4-byte aligned so that the range can be written with writeBuffer
+    BlockAllocation allocate(uint64_t size, uint64_t alignment = 4);
+
+    void free(BlockAllocation& allocation);
+
+    AllocatorStats stats() const;
+
+    // Account the blocks in `memory`, or stop with nullptr
+    void setMemoryTracker(GpuMemoryTracker* memory);
+
+private:
+    struct Block
+    {
+        WGPUBuffer                   buffer = nullptr;
+        uint64_t                     size   = 0;
+        std::map<uint64_t, uint64_t> freeRanges; // offset -> size
+        uint64_t                     used      = 0;
+        uint64_t                     padding   = 0;
+        uint32_t                     liveCount = 0;
+    };
+
+    bool allocateFromBlock(
+        uint32_t         blockIndex,
+        uint64_t         size,
+        uint64_t         alignment,
+        BlockAllocation& allocation);
+    uint32_t addBlock(uint64_t size);
+    void     releaseBlock(Block& block);
+
+    WGPUDevice         m_device    = nullptr;
+    GpuMemoryTracker*  m_memory    = nullptr;
+    WGPUBufferUsage    m_usage     = WGPUBufferUsage_None;
+    uint64_t           m_blockSize = 0;
+    std::vector<Block> m_blocks;
+};
+
+#endif // BUFFER_ALLOCATOR_H
@@ -0,0 +1,724 @@
+#include "compute-primitives.h"
+
+#include "webgpu-utils.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Values processed per invocation by the reduce and scan kernels
+constexpr uint32_t kItemsPerInvocation = 4;
+constexpr uint32_t kRadixBits          = 4;
+constexpr uint32_t kRadixBins          = 1 << kRadixBits;
+
+// Shared by all the kernels; binding 0 is always the Params uniform
+const char* kCommonSource = R"(
+const WG: u32 = {WG}u;
+const ITEMS: u32 = {ITEMS}u;
+
+struct Params {
+    count: u32,
+    groups: u32,
+    shift: u32,
+    pad: u32,
+}
+
+@group(0) @binding(0) var<uniform> params: Params;
+
+// Dispatches are folded in 2D when they exceed the per-dimension limit
+fn groupIndex(wid: vec3u, nwg: vec3u) -> u32 {
+    return wid.x + wid.y * nwg.x;
+}
+)";
+
+// Inclusive scan of sums[] over the workgroup (Hillis-Steele)
+const char* kWorkgroupScanSource = R"(
+var<workgroup> sums: array<u32, WG>;
+
+fn scanWorkgroup(lid: u32) {
+    for (var offset = 1u; offset < WG; offset *= 2u) {
+        var value = 0u;
+        if (lid >= offset) {
+            value = sums[lid - offset];
+        }
+        workgroupBarrier();
+        sums[lid] += value;
+        workgroupBarrier();
+    }
+}
+)";
+
+const char* kReduceSource = R"(
+@group(0) @binding(1) var<storage, read> input: array<u32>;
+@group(0) @binding(2) var<storage, read_write> output: array<u32>;
+
+var<workgroup> partial: array<u32, WG>;
+
+fn combine(a: u32, b: u32) -> u32 {
+    return {OP};
+}
+
+@compute @workgroup_size(WG)
+fn main(
+    @builtin(workgroup_id) wid: vec3u,
+    @builtin(num_workgroups) nwg: vec3u,
+    @builtin(local_invocation_index) lid: u32
+) {
+    let group = groupIndex(wid, nwg);
+    if (group >= params.groups) {
+        return;
+    }
+    // Strided so that neighbouring invocations load neighbouring values
+    let base = group * WG * ITEMS;
+    var acc = {IDENTITY};
+    for (var i = 0u; i < ITEMS; i++) {
+        let index = base + i * WG + lid;
+        if (index < params.count) {
+            acc = combine(acc, input[index]);
+        }
+    }
+    partial[lid] = acc;
+    workgroupBarrier();
+    for (var stride = WG / 2u; stride > 0u; stride /= 2u) {
+        if (lid < stride) {
+            partial[lid] = combine(partial[lid], partial[lid + stride]);
+        }
+        workgroupBarrier();
+    }
+    if (lid == 0u) {
+        output[group] = partial[0];
+    }
+}
+)";
+
+// Last pass of the reduce-then-scan: scan of a tile plus its offset
+const char* kScanTileSource = R"(
+@group(0) @binding(1) var<storage, read> input: array<u32>;
+@group(0) @binding(2) var<storage, read_write> output: array<u32>;
+@group(0) @binding(3) var<storage, read> tileOffsets: array<u32>;
+
+@compute @workgroup_size(WG)
+fn main(
+    @builtin(workgroup_id) wid: vec3u,
+    @builtin(num_workgroups) nwg: vec3u,
+    @builtin(local_invocation_index) lid: u32
+) {
+    let group = groupIndex(wid, nwg);
+    if (group >= params.groups) {
+        return;
+    }
+    let base = (group * WG + lid) * ITEMS;
+    var values: array<u32, ITEMS>;
+    var total = 0u;
+    for (var i = 0u; i < ITEMS; i++) {
+        if (base + i < params.count) {
+            values[i] = input[base + i];
+        }
+        total += values[i];
+    }
+    sums[lid] = total;
+    workgroupBarrier();
+    scanWorkgroup(lid);
+
+    var running = tileOffsets[group] + sums[lid] - total;
+    for (var i = 0u; i < ITEMS; i++) {
+        if (base + i < params.count) {
+            output[base + i] = running;
+        }
+        running += values[i];
+    }
+}
+)";
+
+// Single-pass scan (Merrill & Garland). state[0] hands out tile indices in
+// the order workgroups start, so a tile only waits for tiles that are
+// already running; state[t + 1] is the flag and value published by tile t.
+const char* kLookbackScanSource = R"(
+const FLAG_AGGREGATE: u32 = 1u << 30u;
+const FLAG_PREFIX: u32 = 2u << 30u;
+const FLAG_MASK: u32 = 3u << 30u;
+const VALUE_MASK: u32 = FLAG_AGGREGATE - 1u;
+
+@group(0) @binding(1) var<storage, read> input: array<u32>;
+@group(0) @binding(2) var<storage, read_write> output: array<u32>;
+@group(0) @binding(3) var<storage, read_write> state: array<atomic<u32>>;
+
+var<workgroup> tileId: u32;
+var<workgroup> tilePrefix: u32;
+
+@compute @workgroup_size(WG)
+fn main(@builtin(local_invocation_index) lid: u32) {
+    if (lid == 0u) {
+        tileId = atomicAdd(&state[0], 1u);
+    }
+    let tile = workgroupUniformLoad(&tileId);
+    if (tile >= params.groups) {
+        return;
+    }
+
+    let base = (tile * WG + lid) * ITEMS;
+    var values: array<u32, ITEMS>;
+    var total = 0u;
+    for (var i = 0u; i < ITEMS; i++) {
+        if (base + i < params.count) {
+            values[i] = input[base + i];
+        }
+        total += values[i];
+    }
+    sums[lid] = total;
+    workgroupBarrier();
+    scanWorkgroup(lid);
+
+    if (lid == 0u) {
+        let aggregate = sums[WG - 1u];
+        var exclusive = 0u;
+        if (tile == 0u) {
+            atomicStore(&state[1], FLAG_PREFIX | aggregate);
+        } else {
+            atomicStore(&state[tile + 1u], FLAG_AGGREGATE | aggregate);
+            // Walk back over the predecessors until one has its prefix
+            var look = tile;
+            loop {
+                let published = atomicLoad(&state[look]);
+                let flag = published & FLAG_MASK;
+                if (flag == 0u) {
+                    continue;
+                }
+                exclusive += published & VALUE_MASK;
+                if (flag == FLAG_PREFIX) {
+                    break;
+                }
+                look -= 1u;
+            }
+            atomicStore(
+                &state[tile + 1u],
+                FLAG_PREFIX | ((exclusive + aggregate) & VALUE_MASK));
+        }
+        tilePrefix = exclusive;
+    }
+    let prefix = workgroupUniformLoad(&tilePrefix);
+
+    var running = prefix + sums[lid] - total;
+    for (var i = 0u; i < ITEMS; i++) {
+        if (base + i < params.count) {
+            output[base + i] = running;
+        }
+        running += values[i];
+    }
+}
+)";
+
+const char* kCompactFlagsSource = R"(
+@group(0) @binding(1) var<storage, read> input: array<u32>;
+@group(0) @binding(2) var<storage, read_write> flags: array<u32>;
+
+@compute @workgroup_size(WG)
+fn main(
+    @builtin(workgroup_id) wid: vec3u,
+    @builtin(num_workgroups) nwg: vec3u,
+    @builtin(local_invocation_index) lid: u32
+) {
+    let index = groupIndex(wid, nwg) * WG + lid;
+    if (index < params.count) {
+        let x = input[index];
+        flags[index] = select(0u, 1u, {PREDICATE});
+    }
+}
+)";
+
+const char* kCompactScatterSource = R"(
+@group(0) @binding(1) var<storage, read> input: array<u32>;
+@group(0) @binding(2) var<storage, read> offsets: array<u32>;
+@group(0) @binding(3) var<storage, read_write> output: array<u32>;
+@group(0) @binding(4) var<storage, read_write> counter: array<u32>;
+
+@compute @workgroup_size(WG)
+fn main(
+    @builtin(workgroup_id) wid: vec3u,
+    @builtin(num_workgroups) nwg: vec3u,
+    @builtin(local_invocation_index) lid: u32
+) {
+    let index = groupIndex(wid, nwg) * WG + lid;
+    if (index < params.count) {
+        let x = input[index];
+        let keep = {PREDICATE};
+        if (keep) {
+            output[offsets[index]] = x;
+        }
+        if (index == params.count - 1u) {
+            counter[0] = offsets[index] + select(0u, 1u, keep);
+        }
+    }
+}
+)";
+
+// Digit counts per tile, stored digit-major so that their exclusive scan
+// gives the destination of each (digit, tile) pair
+const char* kRadixHistogramSource = R"(
+@group(0) @binding(1) var<storage, read> keys: array<u32>;
+@group(0) @binding(2) var<storage, read_write> histogram: array<u32>;
+
+var<workgroup> counts: array<atomic<u32>, 16>;
+
+@compute @workgroup_size(WG)
+fn main(
+    @builtin(workgroup_id) wid: vec3u,
+    @builtin(num_workgroups) nwg: vec3u,
+    @builtin(local_invocation_index) lid: u32
+) {
+    let group = groupIndex(wid, nwg);
+    if (group >= params.groups) {
+        return;
+    }
+    if (lid < 16u) {
+        atomicStore(&counts[lid], 0u);
+    }
+    workgroupBarrier();
+    let index = group * WG + lid;
+    if (index < params.count) {
+        atomicAdd(&counts[(keys[index] >> params.shift) & 15u], 1u);
+    }
+    workgroupBarrier();
+    if (lid < 16u) {
+        histogram[lid * params.groups + group] = atomicLoad(&counts[lid]);
+    }
+}
+)";
+
+// Sorts the tile on the digit with four stable 1-bit splits, then writes
+// each key after the keys of the same digit in the previous tiles.
+// Out-of-range slots hold 0xffffffff: stable splits keep them after the
+// valid keys of digit 15, i.e. at the end of the tile.
+const char* kRadixScatterSource = R"(
+@group(0) @binding(1) var<storage, read> keysIn: array<u32>;
+@group(0) @binding(2) var<storage, read> valuesIn: array<u32>;
+@group(0) @binding(3) var<storage, read> offsets: array<u32>;
+@group(0) @binding(4) var<storage, read_write> keysOut: array<u32>;
+@group(0) @binding(5) var<storage, read_write> valuesOut: array<u32>;
+
+var<workgroup> tileKeys: array<u32, WG>;
+var<workgroup> tileValues: array<u32, WG>;
+var<workgroup> digitStart: array<u32, 16>;
+
+@compute @workgroup_size(WG)
+fn main(
+    @builtin(workgroup_id) wid: vec3u,
+    @builtin(num_workgroups) nwg: vec3u,
+    @builtin(local_invocation_index) lid: u32
+) {
+    let group = groupIndex(wid, nwg);
+    if (group >= params.groups) {
+        return;
+    }
+    let first = group * WG;
+    let validCount = min(WG, params.count - first);
+    var key = 0xffffffffu;
+    var value = 0u;
+    if (lid < validCount) {
+        key = keysIn[first + lid];
+        value = valuesIn[first + lid];
+    }
+
+    for (var bit = 0u; bit < 4u; bit++) {
+        let one = (key >> (params.shift + bit)) & 1u;
+        sums[lid] = 1u - one;
+        workgroupBarrier();
+        scanWorkgroup(lid);
+        let zerosBefore = sums[lid] - (1u - one);
+        let zeros = sums[WG - 1u];
+        var destination = zerosBefore;
+        if (one == 1u) {
+            destination = zeros + lid - zerosBefore;
+        }
+        workgroupBarrier();
+        tileKeys[destination] = key;
+        tileValues[destination] = value;
+        workgroupBarrier();
+        key = tileKeys[lid];
+        value = tileValues[lid];
+        workgroupBarrier();
+    }
+
+    let digit = (key >> params.shift) & 15u;
+    if (lid == 0u || ((tileKeys[lid - 1u] >> params.shift) & 15u) != digit) {
+        digitStart[digit] = lid;
+    }
+    workgroupBarrier();
+    if (lid < validCount) {
+        let destination = offsets[digit * params.groups + group] + lid -
+            digitStart[digit];
+        keysOut[destination] = key;
+        valuesOut[destination] = value;
+    }
+}
+)";
+
+struct Params
+{
+    uint32_t count  = 0;
+    uint32_t groups = 0;
+    uint32_t shift  = 0;
+    uint32_t pad    = 0;
+};
+
+void replaceAll(std::string& text, std::string_view key, std::string_view value)
+{
+    for (size_t pos = text.find(key); pos != std::string::npos;
+         pos        = text.find(key, pos + value.size())) {
+        text.replace(pos, key.size(), value);
+    }
+}
+
+std::string reduceSource(ComputePrimitives::ReduceOp op)
+{
+    std::string source = kReduceSource;
+    switch (op) {
+    case ComputePrimitives::ReduceOp::Min:
+        replaceAll(source, "{OP}", "min(a, b)");
+        replaceAll(source, "{IDENTITY}", "0xffffffffu");
+        break;
+    case ComputePrimitives::ReduceOp::Max:
+        replaceAll(source, "{OP}", "max(a, b)");
+        replaceAll(source, "{IDENTITY}", "0u");
+        break;
+    default:
+        replaceAll(source, "{OP}", "a + b");
+        replaceAll(source, "{IDENTITY}", "0u");
+        break;
+    }
+    return source;
+}
+
+std::string withPredicate(const char* body, std::string_view predicate)
+{
+    std::string source = body;
+    replaceAll(source, "{PREDICATE}", predicate);
+    return source;
+}
+
+} // namespace
+
+ComputePrimitives::ComputePrimitives(
+    WGPUDevice        device,
+    PipelineRegistry& registry) :
+        m_device(device), m_registry(registry)
+{
+    WGPULimits limits = WGPU_LIMITS_INIT;
+    if (wgpuDeviceGetLimits(device, &limits) == WGPUStatus_Success) {
+        uint32_t maxSize = std::min(
+            {256u,
+             limits.maxComputeInvocationsPerWorkgroup,
+             limits.maxComputeWorkgroupSizeX});
+        // The radix scatter, the largest user of workgroup memory, needs
+        // three arrays of WG values plus the digit starts
+        auto fits = [&](uint32_t size) {
+            return (3 * size + kRadixBins) * sizeof(uint32_t) <=
+                   limits.maxComputeWorkgroupStorageSize;
+        };
+        m_workgroupSize = kRadixBins;
+        while (m_workgroupSize * 2 <= maxSize && fits(m_workgroupSize * 2)) {
+            m_workgroupSize *= 2;
+        }
+        m_maxGroupsPerDimension = limits.maxComputeWorkgroupsPerDimension;
+    }
+}
+
+ComputePrimitives::~ComputePrimitives()
+{
+    trim();
+}
+
+void ComputePrimitives::trim()
+{
+    for (auto& [name, scratch] : m_scratch) {
+        wgpuBufferRelease(scratch.buffer);
+    }
+    m_scratch.clear();
+}
+
+WGPUComputePipeline ComputePrimitives::pipeline(
+    std::string_view name,
+    std::string      body)
+{
+    ComputePipelineSpec spec;
+    spec.label        = name;
+    spec.shaderSource =
+        kCommonSource + std::string(kWorkgroupScanSource) + body;
+    replaceAll(spec.shaderSource, "{WG}", std::to_string(m_workgroupSize));
+    replaceAll(
+        spec.shaderSource, "{ITEMS}", std::to_string(kItemsPerInvocation));
+    return m_registry.computePipeline(spec);
+}
+
+WGPUBuffer ComputePrimitives::scratch(const std::string& name, uint64_t size)
+{
+    size             = std::max<uint64_t>((size + 3) & ~uint64_t(3), 4);
+    Scratch& scratch = m_scratch[name];
+    if (scratch.size >= size)
+        return scratch.buffer;
+    if (scratch.buffer) {
+        // Dispatches already encoded hold their own reference to it
+        wgpuBufferRelease(scratch.buffer);
+    }
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    desc.label                = {name.data(), name.size()};
+    desc.usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc |
+                 WGPUBufferUsage_CopyDst;
+    desc.size      = size;
+    scratch.buffer = wgpuDeviceCreateBuffer(m_device, &desc);
+    scratch.size   = size;
+    return scratch.buffer;
+}
+
+WGPUBuffer ComputePrimitives::uniforms(
+    uint32_t count,
+    uint32_t groups,
+    uint32_t shift)
+{
+    Params params{count, groups, shift, 0};
+    return createBufferWithData(
+        m_device,
+        "Compute primitive params",
+        WGPUBufferUsage_Uniform,
+        &params,
+        sizeof(Params));
+}
+
+void ComputePrimitives::dispatch(
+    WGPUCommandEncoder  encoder,
+    WGPUComputePipeline pipeline,
+    const WGPUBuffer*   buffers,
+    uint32_t            bufferCount,
+    uint32_t            groups)
+{
+    if (groups == 0)
+        return;
+
+    std::vector<WGPUBindGroupEntry> entries(bufferCount);
+    for (uint32_t i = 0; i < bufferCount; ++i) {
+        entries[i]         = WGPU_BIND_GROUP_ENTRY_INIT;
+        entries[i].binding = i;
+        entries[i].buffer  = buffers[i];
+        entries[i].size    = WGPU_WHOLE_SIZE;
+    }
+    WGPUBindGroupDescriptor bindGroupDesc = WGPU_BIND_GROUP_DESCRIPTOR_INIT;
+    bindGroupDesc.layout = wgpuComputePipelineGetBindGroupLayout(pipeline, 0);
+    bindGroupDesc.entryCount = entries.size();
+    bindGroupDesc.entries    = entries.data();
+    WGPUBindGroup bindGroup =
+        wgpuDeviceCreateBindGroup(m_device, &bindGroupDesc);
+    wgpuBindGroupLayoutRelease(bindGroupDesc.layout);
+
+    uint32_t x = std::min(groups, m_maxGroupsPerDimension);
+    uint32_t y = divideAndCeil(groups, x);
+
+    WGPUComputePassEncoder pass =
+        wgpuCommandEncoderBeginComputePass(encoder, nullptr);
+    wgpuComputePassEncoderSetPipeline(pass, pipeline);
+    wgpuComputePassEncoderSetBindGroup(pass, 0, bindGroup, 0, nullptr);
+    wgpuComputePassEncoderDispatchWorkgroups(pass, x, y, 1);
+    wgpuComputePassEncoderEnd(pass);
+    wgpuComputePassEncoderRelease(pass);
+    wgpuBindGroupRelease(bindGroup);
+}
+
+uint32_t ComputePrimitives::reducePass(
+    WGPUCommandEncoder encoder,
+    WGPUBuffer         input,
+    WGPUBuffer         output,
+    uint32_t           count,
+    ReduceOp           op)
+{
+    uint32_t groups =
+        divideAndCeil(count, m_workgroupSize * kItemsPerInvocation);
+    WGPUBuffer buffers[] = {uniforms(count, groups), input, output};
+    dispatch(encoder, pipeline("Reduce", reduceSource(op)), buffers, 3, groups);
+    wgpuBufferRelease(buffers[0]);
+    return groups;
+}
+
+void ComputePrimitives::reduce(
+    WGPUCommandEncoder encoder,
+    WGPUBuffer         input,
+    WGPUBuffer         output,
+    uint32_t           count,
+    ReduceOp           op)
+{
+    if (count == 0) {
+        wgpuCommandEncoderClearBuffer(encoder, output, 0, sizeof(uint32_t));
+        return;
+    }
+    // Ping-pong between two scratch buffers until one value is left
+    WGPUBuffer source = input;
+    for (uint32_t level = 0;; ++level) {
+        uint32_t groups =
+            divideAndCeil(count, m_workgroupSize * kItemsPerInvocation);
+        WGPUBuffer target =
+            groups == 1 ? output :
+                          scratch(
+                              "Reduce partials " + std::to_string(level % 2),
+                              groups * sizeof(uint32_t));
+        reducePass(encoder, source, target, count, op);
+        if (groups == 1)
+            return;
+        source = target;
+        count  = groups;
+    }
+}
+
+void ComputePrimitives::exclusiveScan(
+    WGPUCommandEncoder encoder,
+    WGPUBuffer         input,
+    WGPUBuffer         output,
+    uint32_t           count,
+    ScanAlgorithm      algorithm)
+{
+    if (count == 0)
+        return;
+    if (algorithm == ScanAlgorithm::DecoupledLookback) {
+        scanDecoupledLookback(encoder, input, output, count);
+    }
+    else {
+        scanReduceThenScan(encoder, input, output, count, 0);
+    }
+}
+
+void ComputePrimitives::scanReduceThenScan(
+    WGPUCommandEncoder encoder,
+    WGPUBuffer         input,
+    WGPUBuffer         output,
+    uint32_t           count,
+    uint32_t           level)
+{
+    uint32_t groups =
+        divideAndCeil(count, m_workgroupSize * kItemsPerInvocation);
+    std::string suffix      = " " + std::to_string(level);
+    WGPUBuffer  tileOffsets = scratch("Scan offsets" + suffix, groups * 4);
+    if (groups == 1) {
+        wgpuCommandEncoderClearBuffer(encoder, tileOffsets, 0, 4);
+    }
+    else {
+        WGPUBuffer tileSums = scratch("Scan sums" + suffix, groups * 4);
+        reducePass(encoder, input, tileSums, count, ReduceOp::Sum);
+        scanReduceThenScan(encoder, tileSums, tileOffsets, groups, level + 1);
+    }
+
+    WGPUBuffer buffers[] = {
+        uniforms(count, groups), input, output, tileOffsets};
+    dispatch(
+        encoder, pipeline("Scan tiles", kScanTileSource), buffers, 4, groups);
+    wgpuBufferRelease(buffers[0]);
+}
+
+void ComputePrimitives::scanDecoupledLookback(
+    WGPUCommandEncoder encoder,
+    WGPUBuffer         input,
+    WGPUBuffer         output,
+    uint32_t           count)
+{
+    uint32_t groups =
+        divideAndCeil(count, m_workgroupSize * kItemsPerInvocation);
+    uint64_t stateSize = (uint64_t(groups) + 1) * sizeof(uint32_t);
+    WGPUBuffer state   = scratch("Scan tile state", stateSize);
+    wgpuCommandEncoderClearBuffer(encoder, state, 0, stateSize);
+
+    WGPUBuffer buffers[] = {uniforms(count, groups), input, output, state};
+    dispatch(
+        encoder,
+        pipeline("Scan decoupled look-back", kLookbackScanSource),
+        buffers,
+        4,
+        groups);
+    wgpuBufferRelease(buffers[0]);
+}
+
+void ComputePrimitives::compact(
+    WGPUCommandEncoder encoder,
+    WGPUBuffer         input,
+    WGPUBuffer         output,
+    WGPUBuffer         counter,
+    uint32_t           count,
+    std::string_view   predicate)
+{
+    if (count == 0) {
+        wgpuCommandEncoderClearBuffer(encoder, counter, 0, sizeof(uint32_t));
+        return;
+    }
+    uint32_t   groups  = divideAndCeil(count, m_workgroupSize);
+    WGPUBuffer flags   = scratch("Compact flags", count * sizeof(uint32_t));
+    WGPUBuffer offsets = scratch("Compact offsets", count * sizeof(uint32_t));
+
+    WGPUBuffer flagBuffers[] = {uniforms(count, groups), input, flags};
+    dispatch(
+        encoder,
+        pipeline(
+            "Compact flags", withPredicate(kCompactFlagsSource, predicate)),
+        flagBuffers,
+        3,
+        groups);
+    wgpuBufferRelease(flagBuffers[0]);
+
+    exclusiveScan(encoder, flags, offsets, count);
+
+    WGPUBuffer scatterBuffers[] = {
+        uniforms(count, groups), input, offsets, output, counter};
+    dispatch(
+        encoder,
+        pipeline(
+            "Compact scatter",
+            withPredicate(kCompactScatterSource, predicate)),
+        scatterBuffers,
+        5,
+        groups);
+    wgpuBufferRelease(scatterBuffers[0]);
+}
+
+void ComputePrimitives::radixSort(
+    WGPUCommandEncoder encoder,
+    WGPUBuffer         keys,
+    WGPUBuffer         values,
+    uint32_t           count)
+{
+    if (count < 2)
+        return;
+    uint32_t   groups    = divideAndCeil(count, m_workgroupSize);
+    uint64_t   size      = uint64_t(count) * sizeof(uint32_t);
+    uint32_t   binCount  = kRadixBins * groups;
+    WGPUBuffer tmpKeys   = scratch("Sort keys", size);
+    WGPUBuffer tmpValues = scratch("Sort values", size);
+    WGPUBuffer histogram = scratch("Sort histogram", binCount * 4);
+    WGPUBuffer offsets   = scratch("Sort offsets", binCount * 4);
+
+    WGPUComputePipeline histogramPipeline =
+        pipeline("Radix histogram", kRadixHistogramSource);
+    WGPUComputePipeline scatterPipeline =
+        pipeline("Radix scatter", kRadixScatterSource);
+
+    // An even number of passes leaves the result in the caller's buffers
+    static_assert((32 / kRadixBits) % 2 == 0);
+    for (uint32_t shift = 0; shift < 32; shift += kRadixBits) {
+        bool       even      = (shift / kRadixBits) % 2 == 0;
+        WGPUBuffer srcKeys   = even ? keys : tmpKeys;
+        WGPUBuffer srcValues = even ? values : tmpValues;
+        WGPUBuffer dstKeys   = even ? tmpKeys : keys;
+        WGPUBuffer dstValues = even ? tmpValues : values;
+
+        WGPUBuffer histogramBuffers[] = {
+            uniforms(count, groups, shift), srcKeys, histogram};
+        dispatch(encoder, histogramPipeline, histogramBuffers, 3, groups);
+        wgpuBufferRelease(histogramBuffers[0]);
+
+        exclusiveScan(encoder, histogram, offsets, binCount);
+
+        WGPUBuffer scatterBuffers[] = {
+            uniforms(count, groups, shift),
+            srcKeys,
+            srcValues,
+            offsets,
+            dstKeys,
+            dstValues};
+        dispatch(encoder, scatterPipeline, scatterBuffers, 6, groups);
+        wgpuBufferRelease(scatterBuffers[0]);
+    }
+}
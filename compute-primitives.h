@@ -0,0 +1,137 @@
+#ifndef COMPUTE_PRIMITIVES_H
+#define COMPUTE_PRIMITIVES_H
+
+#include "pipeline-cache.h"
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+/**
+ * Data-parallel building blocks on arrays of u32, as WGSL compute kernels.
+ *
+ * Every primitive records its passes into the given command encoder and
+ * returns without submitting, so several primitives can be chained in one
+ * submission. Buffers must have the Storage usage; temporary buffers are
+ * owned by this object and reused between calls.
+ *
+ * The workgroup size is the largest power of two up to 256 allowed by
+ * maxComputeInvocationsPerWorkgroup, maxComputeWorkgroupSizeX and
+ * maxComputeWorkgroupStorageSize. Dispatches larger than
+ * maxComputeWorkgroupsPerDimension are folded into two dimensions.
+ */
+class ComputePrimitives
+{
+public:
+    enum class ReduceOp { Sum, Min, Max };
+
+    enum class ScanAlgorithm {
+        // Tile sums, scan of the sums, then scan of the tiles: 3 passes per
+        // level, no restriction on the values
+        ReduceThenScan,
+        // Single pass, tiles publish their prefix for the next ones. Opt-in,
+        // only for values whose total < 2^30: the tile state packs a 2-bit
+        // flag with the value in one 32-bit atomic, larger prefixes are
+        // silently wrong. Each tile spins until its predecessors publish,
+        // and WebGPU gives no forward-progress guarantee between
+        // workgroups: it may hang on some implementations (SwiftShader,
+        // Apple GPUs).
+        DecoupledLookback,
+    };
+
+    ComputePrimitives(WGPUDevice device, PipelineRegistry& registry);
+    ~ComputePrimitives();
+
+    ComputePrimitives(const ComputePrimitives&)            = delete;
+    ComputePrimitives& operator=(const ComputePrimitives&) = delete;
+
+    uint32_t workgroupSize() const { return m_workgroupSize; }
+
+    // Reduce `count` values of `input` into output[0]
+    void reduce(
+        WGPUCommandEncoder encoder,
+        WGPUBuffer         input,
+        WGPUBuffer         output,
+        uint32_t           count,
+        ReduceOp           op = ReduceOp::Sum);
+
+    // output[i] = input[0] + ... + input[i - 1]; output must not be input
+    void exclusiveScan(
+        WGPUCommandEncoder encoder,
+        WGPUBuffer         input,
+        WGPUBuffer         output,
+        uint32_t           count,
+        ScanAlgorithm      algorithm = ScanAlgorithm::ReduceThenScan);
+
+    // Copy, in order, the values `x` of `input` for which the WGSL boolean
+    // expression `predicate` holds, and write their number to counter[0]
+    void compact(
+        WGPUCommandEncoder encoder,
+        WGPUBuffer         input,
+        WGPUBuffer         output,
+        WGPUBuffer         counter,
+        uint32_t           count,
+        std::string_view   predicate = "x != 0u");
+
+    // Stable ascending sort of `keys`, moving `values` along, in place.
+    // LSD radix sort, 4 bits per pass.
+    void radixSort(
+        WGPUCommandEncoder encoder,
+        WGPUBuffer         keys,
+        WGPUBuffer         values,
+        uint32_t           count);
+
+    // Release the temporary buffers
+    void trim();
+
+private:
+    struct Scratch
+    {
+        WGPUBuffer buffer = nullptr;
+        uint64_t   size   = 0;
+    };
+
+    // Kernel `body` specialized for the workgroup size
+    WGPUComputePipeline pipeline(std::string_view name, std::string body);
+    // Storage buffer of at least `size` bytes, kept between calls
+    WGPUBuffer scratch(const std::string& name, uint64_t size);
+    // A new uniform buffer per dispatch, see createBufferWithData()
+    WGPUBuffer uniforms(uint32_t count, uint32_t groups, uint32_t shift = 0);
+    // One compute pass; buffers[i] is bound at binding i of group 0
+    void dispatch(
+        WGPUCommandEncoder  encoder,
+        WGPUComputePipeline pipeline,
+        const WGPUBuffer*   buffers,
+        uint32_t            bufferCount,
+        uint32_t            groups);
+
+    // One reduction pass, return the number of partial results
+    uint32_t reducePass(
+        WGPUCommandEncoder encoder,
+        WGPUBuffer         input,
+        WGPUBuffer         output,
+        uint32_t           count,
+        ReduceOp           op);
+    void scanReduceThenScan(
+        WGPUCommandEncoder encoder,
+        WGPUBuffer         input,
+        WGPUBuffer         output,
+        uint32_t           count,
+        uint32_t           level);
+    void scanDecoupledLookback(
+        WGPUCommandEncoder encoder,
+        WGPUBuffer         input,
+        WGPUBuffer         output,
+        uint32_t           count);
+
+    WGPUDevice                     m_device = nullptr;
+    PipelineRegistry&              m_registry;
+    uint32_t                       m_workgroupSize         = 64;
+    uint32_t                       m_maxGroupsPerDimension = 65535;
+    std::map<std::string, Scratch> m_scratch;
+};
+
+#endif // COMPUTE_PRIMITIVES_H
@@ -0,0 +1,115 @@
+#include "event-thread.h"
+
+#include <optional>
+
+namespace {
+
+// Longest wait on a future before the thread services processEvents and
+// new watches again
+constexpr uint64_t kWaitSliceNs = 500'000;
+// Period of processEvents when there is no future to wait for
+constexpr auto kIdlePeriod = std::chrono::milliseconds(2);
+
+} // namespace
+
+EventThread::EventThread(WGPUInstance instance) :
+        m_instance(instance), m_thread([this] { run(); })
+{
+}
+
+EventThread::~EventThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void EventThread::watch(WGPUFuture future, Callback callback)
+{
+    m_watches.push({future, std::move(callback)});
+    ++m_watched;
+    // Taking the lock orders the push before the thread's check of the
+    // queue, so the notification cannot be missed
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+    }
+    m_wake.notify_one();
+}
+
+size_t EventThread::dispatch()
+{
+    size_t count = 0;
+    while (std::optional<Completion> completion = m_completions.pop()) {
+        if (completion->callback) {
+            completion->callback(completion->time);
+        }
+        ++count;
+    }
+    m_dispatched += count;
+    return count;
+}
+
+EventThread::Stats EventThread::stats() const
+{
+    Stats stats;
+    stats.watched      = m_watched;
+    stats.completed    = m_completed;
+    stats.dispatched   = m_dispatched;
+    stats.processCalls = m_processCalls;
+    return stats;
+}
+
+void EventThread::run()
+{
+    std::vector<Watch>              pending;
+    std::vector<WGPUFutureWaitInfo> waitInfos;
+    while (!m_stop) {
+        while (std::optional<Watch> watch = m_watches.pop()) {
+            pending.push_back(std::move(*watch));
+        }
+        wgpuInstanceProcessEvents(m_instance);
+        ++m_processCalls;
+
+        if (pending.empty()) {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, kIdlePeriod, [this] {
+                return m_stop || !m_watches.empty();
+            });
+            continue;
+        }
+
+        // Block on the oldest future, usually the next one to complete,
+        // then collect all those completed meanwhile
+        waitForFuture(m_instance, pending.front().future, kWaitSliceNs);
+        waitInfos.clear();
+        for (const Watch& watch : pending) {
+            waitInfos.push_back({watch.future, false});
+        }
+        waitForFutures(m_instance, waitInfos.data(), waitInfos.size(), 0);
+
+        Clock::time_point now  = Clock::now();
+        size_t            kept = 0;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (waitInfos[i].completed) {
+                m_completions.push({std::move(pending[i].callback), now});
+                ++m_completed;
+            }
+            else if (kept++ != i) {
+                pending[kept - 1] = std::move(pending[i]);
+            }
+        }
+        pending.resize(kept);
+    }
+}
+
+std::vector<InputEvent> InputQueue::take()
+{
+    std::vector<InputEvent> events;
+    while (std::optional<InputEvent> event = m_events.pop()) {
+        events.push_back(*event);
+    }
+    return events;
+}
@@ -0,0 +1,164 @@
+#ifndef EVENT_THREAD_H
+#define EVENT_THREAD_H
+
+#include "mpsc-queue.h"
+#include "webgpu-async.h"
+
+#include <webgpu/webgpu.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Thread servicing the WebGPU instance away from the render loop. It calls
+ * wgpuInstanceProcessEvents continuously, so that device-lost, error and
+ * other AllowProcessEvents callbacks fire right away, and waits for the
+ * futures given to watch(): a watched Future is ready as soon as the GPU is
+ * done, whatever the frame rate.
+ *
+ * Completions are sent back through a lock-free queue; their callbacks run
+ * on the render thread, in dispatch():
+ *     events.watch(future.handle(), [](auto completedAt) { ... });
+ *     ...
+ *     events.dispatch(); // once per frame
+ *
+ * The device must have been created with ImplicitDeviceSynchronization (see
+ * adapter-selection.h) when other threads use it meanwhile.
+ */
+class EventThread
+{
+public:
+    using Clock    = std::chrono::steady_clock;
+    using Callback = std::function<void(Clock::time_point completedAt)>;
+
+    struct Stats
+    {
+        uint64_t watched      = 0;
+        uint64_t completed    = 0;
+        uint64_t dispatched   = 0;
+        uint64_t processCalls = 0; // wgpuInstanceProcessEvents
+    };
+
+    explicit EventThread(WGPUInstance instance);
+    // Stops the thread; callbacks not dispatched yet are dropped
+    ~EventThread();
+
+    EventThread(const EventThread&)            = delete;
+    EventThread& operator=(const EventThread&) = delete;
+
+    // Any thread. The future must come from a WaitAnyOnly callback, as
+    // those of webgpu-async.h do.
+    void watch(WGPUFuture future, Callback callback = {});
+
+    template<typename T>
+    void watch(const Future<T>& future, Callback callback = {})
+    {
+        watch(future.handle(), std::move(callback));
+    }
+
+    // Render thread: run the callbacks of the futures completed since the
+    // previous call and return how many ran
+    size_t dispatch();
+
+    Stats stats() const;
+
+private:
+    struct Watch
+    {
+        WGPUFuture future;
+        Callback   callback;
+    };
+
+    struct Completion
+    {
+        Callback          callback;
+        Clock::time_point time;
+    };
+
+    void run();
+
+    WGPUInstance m_instance = nullptr;
+
+    MpscQueue<Watch>      m_watches;     // to the event thread
+    MpscQueue<Completion> m_completions; // to the render thread
+
+    std::mutex              m_wakeMutex;
+    std::condition_variable m_wake;
+    std::atomic<bool>       m_stop = false;
+
+    std::atomic<uint64_t> m_watched      = 0;
+    std::atomic<uint64_t> m_completed    = 0;
+    std::atomic<uint64_t> m_dispatched   = 0;
+    std::atomic<uint64_t> m_processCalls = 0;
+
+    std::thread m_thread; // last, started once the rest is initialized
+};
+
+/**
+ * For objects whose EventThread callbacks use `this`: the callbacks made by
+ * bind() do nothing once the guard, a member of the object, is destroyed.
+ * Both happen on the render thread, so they cannot race.
+ *     events->watch(future, m_guard.bind([this] { poll(); }));
+ */
+class WatchGuard
+{
+public:
+    WatchGuard() = default;
+    WatchGuard(const WatchGuard&)            = delete;
+    WatchGuard& operator=(const WatchGuard&) = delete;
+
+    EventThread::Callback bind(std::function<void()> callback) const
+    {
+        std::weak_ptr<const bool> alive = m_alive;
+        return [alive, callback = std::move(callback)](auto) {
+            if (!alive.expired()) {
+                callback();
+            }
+        };
+    }
+
+private:
+    std::shared_ptr<const bool> m_alive = std::make_shared<const bool>(true);
+};
+
+/**
+ * An input event, stamped when the window system reported it.
+ */
+struct InputEvent
+{
+    enum class Type { Key, MouseButton, CursorMove, Scroll };
+
+    Type                                  type = Type::Key;
+    std::chrono::steady_clock::time_point time;
+    int                                   code   = 0; // key or button
+    int                                   action = 0; // GLFW_PRESS...
+    int                                   mods   = 0;
+    double                                x      = 0; // cursor or offset
+    double                                y      = 0;
+};
+
+/**
+ * Input events on their way to the render thread, through the same kind of
+ * queue as the completions of EventThread. push() may be called from any
+ * thread, take() from the render thread only.
+ */
+class InputQueue
+{
+public:
+    void push(const InputEvent& event) { m_events.push(event); }
+
+    // Events pushed since the previous call, oldest first
+    std::vector<InputEvent> take();
+
+private:
+    MpscQueue<InputEvent> m_events;
+};
+
+#endif // EVENT_THREAD_H
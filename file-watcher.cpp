@@ -0,0 +1,206 @@
+#include "file-watcher.h"
+
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Longest wait before the thread checks whether it must stop, and the
+// period of the modification time polling
+constexpr int kPollPeriodMs = 100;
+// Events following the first one (several writes, a rename) are gathered
+// before the files are read
+constexpr auto kSettleTime = std::chrono::milliseconds(10);
+
+std::filesystem::file_time_type writeTime(const std::filesystem::path& path)
+{
+    std::error_code error;
+    auto            time = std::filesystem::last_write_time(path, error);
+    return error ? std::filesystem::file_time_type::min() : time;
+}
+
+bool readFile(const std::filesystem::path& path, std::string& contents)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+} // namespace
+
+std::filesystem::path normalizedPath(const std::filesystem::path& path)
+{
+    if (path.empty()) {
+        return path;
+    }
+    std::error_code       error;
+    std::filesystem::path absolute = std::filesystem::absolute(path, error);
+    return (error ? path : absolute).lexically_normal();
+}
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    m_thread = std::thread([this] { run(); });
+}
+
+FileWatcher::~FileWatcher()
+{
+    m_stop = true;
+    m_thread.join();
+#ifdef __linux__
+    if (m_inotify >= 0) {
+        close(m_inotify);
+    }
+#endif
+}
+
+bool FileWatcher::watch(const std::filesystem::path& path)
+{
+    std::filesystem::path key = normalizedPath(path);
+    if (!std::filesystem::is_regular_file(key)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+#ifdef __linux__
+    if (m_inotify >= 0) {
+        // Watching the directory catches the file being replaced by a
+        // rename; a directory watched already gets its descriptor back
+        int directory = inotify_add_watch(
+            m_inotify,
+            key.parent_path().c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (directory < 0) {
+            return false;
+        }
+        m_directories[directory] = key.parent_path();
+    }
+#endif
+    m_files[key] = {path, writeTime(key)};
+    return true;
+}
+
+std::vector<FileWatcher::Change> FileWatcher::take()
+{
+    std::vector<Change> changes;
+    while (std::optional<Change> change = m_changes.pop()) {
+        // A later change of the same file supersedes the earlier ones
+        auto same = std::find_if(
+            changes.begin(), changes.end(), [&](const Change& other) {
+                return other.path == change->path;
+            });
+        if (same != changes.end()) {
+            *same = std::move(*change);
+        }
+        else {
+            changes.push_back(std::move(*change));
+        }
+    }
+    return changes;
+}
+
+void FileWatcher::run()
+{
+    std::vector<std::filesystem::path> changed;
+    while (!m_stop) {
+#ifdef __linux__
+        if (m_inotify >= 0) {
+            pollfd descriptor = {m_inotify, POLLIN, 0};
+            if (poll(&descriptor, 1, kPollPeriodMs) <= 0) {
+                continue;
+            }
+            std::this_thread::sleep_for(kSettleTime);
+            changed.clear();
+            readInotifyEvents(changed);
+            publish(changed);
+            continue;
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::milliseconds(kPollPeriodMs));
+        pollWriteTimes();
+    }
+}
+
+void FileWatcher::publish(const std::vector<std::filesystem::path>& keys)
+{
+    for (const std::filesystem::path& key : keys) {
+        Change change;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto                        file = m_files.find(key);
+            if (file == m_files.end()) {
+                continue;
+            }
+            change.path            = file->second.path;
+            file->second.writeTime = writeTime(key);
+        }
+        // Read outside of the lock: watch() is not held up by the IO
+        if (!readFile(key, change.contents)) {
+            continue;
+        }
+        change.time = Clock::now();
+        m_changes.push(std::move(change));
+    }
+}
+
+void FileWatcher::pollWriteTimes()
+{
+    std::vector<std::filesystem::path> changed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& [key, file] : m_files) {
+            if (writeTime(key) != file.writeTime) {
+                changed.push_back(key);
+            }
+        }
+    }
+    publish(changed);
+}
+
+void FileWatcher::readInotifyEvents(std::vector<std::filesystem::path>& changed)
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (;;) {
+        ssize_t size = read(m_inotify, buffer, sizeof(buffer));
+        if (size <= 0) {
+            break; // EAGAIN, nothing left
+        }
+        for (char* next = buffer; next < buffer + size;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(next);
+            next += sizeof(inotify_event) + event->len;
+
+            auto directory = m_directories.find(event->wd);
+            if (event->len == 0 || directory == m_directories.end()) {
+                continue;
+            }
+            std::filesystem::path key = directory->second / event->name;
+            if (m_files.count(key) &&
+                std::find(changed.begin(), changed.end(), key) ==
+                    changed.end()) {
+                changed.push_back(key);
+            }
+        }
+    }
+#else
+    (void) changed;
+#endif
+}
@@ -0,0 +1,84 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include "mpsc-queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * `path` made absolute and lexically normal, so that two spellings of the
+ * same file compare equal. An empty path stays empty.
+ */
+std::filesystem::path normalizedPath(const std::filesystem::path& path);
+
+/**
+ * Watches files from a background thread and reads them there when they
+ * change, so that the render thread only picks up their new contents.
+ *
+ * On Linux the directories of the files are watched with inotify: a change
+ * is seen once the writer closes the file or renames it into place, as
+ * editors saving atomically do. Elsewhere the modification times are
+ * polled.
+ *     watcher.watch("shaders/sky.wgsl");
+ *     ...
+ *     for (FileWatcher::Change& change : watcher.take()) { ... } // per frame
+ */
+class FileWatcher
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Change
+    {
+        std::filesystem::path path; // as given to watch()
+        std::string           contents;
+        Clock::time_point     time; // when the change was seen
+    };
+
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&)            = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Any thread. Return false if the file cannot be watched.
+    bool watch(const std::filesystem::path& path);
+
+    // Consumer thread: the changes seen since the previous call, at most one
+    // per file
+    std::vector<Change> take();
+
+    // False if the modification times are polled
+    bool usesInotify() const { return m_inotify >= 0; }
+
+private:
+    struct File
+    {
+        std::filesystem::path           path; // as given to watch()
+        std::filesystem::file_time_type writeTime;
+    };
+
+    void run();
+    // Read the files of `keys` whose contents may have changed
+    void publish(const std::vector<std::filesystem::path>& keys);
+    void pollWriteTimes();
+    void readInotifyEvents(std::vector<std::filesystem::path>& changed);
+
+    std::mutex                            m_mutex;       // guards the maps
+    std::map<std::filesystem::path, File> m_files;       // by normalized path
+    std::map<int, std::filesystem::path>  m_directories; // inotify watches
+    MpscQueue<Change>                     m_changes;
+    int                                   m_inotify = -1;
+    std::atomic<bool>                     m_stop    = false;
+
+    std::thread m_thread; // last, started once the rest is initialized
+};
+
+#endif // FILE_WATCHER_H
@@ -0,0 +1,68 @@
+#include "frame-arena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cstring>
+
+FrameArena::FrameArena(size_t blockSize) : m_blockSize(blockSize)
+{
+    addBlock(m_blockSize);
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+    assert(alignment <= alignof(std::max_align_t));
+    size_t start = (m_cursor + alignment - 1) & ~(alignment - 1);
+    if (start + size > m_blocks.back().size) {
+        addBlock(size);
+        start = 0;
+    }
+    m_cursor = start + size;
+    m_stats.bytes += size;
+    m_stats.peakBytes = std::max(m_stats.peakBytes, m_stats.bytes);
+    return m_blocks.back().data.get() + start;
+}
+
+WGPUStringView FrameArena::label(std::string_view text)
+{
+    char* data = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(data, text.data(), text.size());
+    return {data, text.size()};
+}
+
+WGPUStringView FrameArena::label(std::string_view prefix, uint64_t number)
+{
+    // The longest uint64_t has 20 digits
+    char* data = static_cast<char*>(allocate(prefix.size() + 20, 1));
+    std::memcpy(data, prefix.data(), prefix.size());
+    char* digits = data + prefix.size();
+    char* end    = std::to_chars(digits, digits + 20, number).ptr;
+    return {data, size_t(end - data)};
+}
+
+void FrameArena::reset()
+{
+    if (m_blocks.size() > 1) {
+        size_t total = 0;
+        for (const Block& block : m_blocks) {
+            total += block.size;
+        }
+        m_blocks.clear();
+        addBlock(total);
+    }
+    m_cursor      = 0;
+    m_stats.bytes = 0;
+}
+
+void FrameArena::addBlock(size_t minSize)
+{
+    Block block;
+    block.size = std::max(minSize, m_blockSize);
+    // new[] aligns to alignof(max_align_t)
+    block.data = std::make_unique_for_overwrite<std::byte[]>(block.size);
+    m_blocks.push_back(std::move(block));
+    m_cursor = 0;
+    ++m_stats.heapAllocations;
+    m_stats.blocks = uint32_t(m_blocks.size());
+}
@@ -0,0 +1,95 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <webgpu/webgpu.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Bump allocator for the transient CPU data of a frame: descriptor structs,
+ * attachment arrays, labels. Nothing is freed one by one; reset() drops
+ * everything at once and keeps the memory, so that after the first frames
+ * a frame makes no heap allocation:
+ *     auto* attachments = arena.make<WGPURenderPassColorAttachment>(2);
+ *     ...
+ *     arena.reset(); // once the frame is submitted
+ *
+ * Only for trivially destructible types, which WebGPU descriptors are. Not
+ * thread-safe: fill it from one thread, before handing the data to others.
+ */
+class FrameArena
+{
+public:
+    struct Stats
+    {
+        uint64_t bytes           = 0; // allocated since the last reset()
+        uint64_t peakBytes       = 0; // over all the frames
+        uint64_t heapAllocations = 0; // blocks allocated, in total
+        uint32_t blocks          = 0; // live
+    };
+
+    explicit FrameArena(size_t blockSize = 64 << 10);
+
+    FrameArena(const FrameArena&)            = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // `size` bytes aligned to `alignment`, at most alignof(max_align_t)
+    void* allocate(size_t size, size_t alignment);
+
+    // `count` value-initialized T, e.g. descriptors with their defaults
+    template<typename T>
+        requires std::is_trivially_destructible_v<T>
+    T* make(size_t count = 1)
+    {
+        T* objects = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; ++i) {
+            new (objects + i) T{};
+        }
+        return objects;
+    }
+
+    // `count` copies of `value`, e.g. wgpu::Default
+    template<typename T>
+        requires std::is_trivially_destructible_v<T>
+    T* make(size_t count, const T& value)
+    {
+        T* objects = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; ++i) {
+            new (objects + i) T(value);
+        }
+        return objects;
+    }
+
+    // A copy of `text`, as a label
+    WGPUStringView label(std::string_view text);
+    // `prefix` followed by `number`, e.g. "Parallel commands 3"
+    WGPUStringView label(std::string_view prefix, uint64_t number);
+
+    // Drop everything allocated. If the frame needed several blocks, they
+    // are merged into one large enough for the next frame.
+    void reset();
+
+    Stats stats() const { return m_stats; }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t                       size = 0;
+    };
+
+    void addBlock(size_t minSize);
+
+    size_t             m_blockSize = 0;
+    size_t             m_cursor    = 0; // in the last block
+    std::vector<Block> m_blocks;
+    Stats              m_stats;
+};
+
+#endif // FRAME_ARENA_H
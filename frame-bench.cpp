@@ -0,0 +1,273 @@
+#include "frame-bench.h"
+
+#include "application.h"
+#include "image-writer.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+constexpr unsigned int kWarmupFrames = 10;
+// How long the device-lost callback may take to be reported
+constexpr std::chrono::seconds kLossTimeout(5);
+
+} // namespace
+
+int runFrameBenchmark(unsigned int frames, const BenchOptions& opts)
+{
+    ApplicationOptions appOptions;
+    appOptions.headless             = true;
+    appOptions.backend              = opts.backend;
+    appOptions.forceFallbackAdapter = opts.forceFallback;
+    appOptions.tracePath            = opts.tracePath;
+    appOptions.framesInFlight       = opts.framesInFlight;
+    appOptions.maxFps               = opts.maxFps;
+
+    Application app;
+    if (!app.initialize(appOptions)) {
+        std::cerr << "Could not initialize the headless application!"
+                  << std::endl;
+        return 1;
+    }
+
+    for (unsigned int i = 0; i < kWarmupFrames; ++i) {
+        app.mainLoop();
+    }
+    double timeToFirstFrameMs = app.timeToFirstFrameMs();
+    // Every measured frame draws the same passes
+    app.pipelineLoader().waitAll();
+    app.waitForIdle();
+    FrameScheduler& scheduler = app.scheduler();
+    scheduler.takeSubmitLatencies();
+    scheduler.takeInputLatencies();
+    scheduler.takeFrameIntervals();
+    scheduler.takeThrottleWaits();
+    scheduler.takeGpuIdleMs();
+    ParallelRecorder::Stats submitsBefore = app.recorder().stats();
+    FrameArena::Stats       arenaBefore   = app.recorder().arena().stats();
+
+    std::vector<double> cpuFrameMs;
+    cpuFrameMs.reserve(frames);
+    auto runStart = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < frames; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        app.mainLoop();
+        cpuFrameMs.push_back(elapsedMs(start));
+    }
+    double totalMs   = elapsedMs(runStart);
+    double gpuIdleMs = scheduler.takeGpuIdleMs();
+    ParallelRecorder::Stats submits = app.recorder().stats();
+    FrameArena::Stats       arena   = app.recorder().arena().stats();
+    app.waitForIdle();
+    std::vector<double>      submitToDoneMs = scheduler.takeSubmitLatencies();
+    std::vector<double>      inputToPresent = scheduler.takeInputLatencies();
+    std::vector<double>      frameInterval  = scheduler.takeFrameIntervals();
+    std::vector<double>      throttleWait   = scheduler.takeThrottleWaits();
+    std::vector<ScopeTiming> scopes         = app.profiler().averages();
+    bool                     gpuTimed       = app.profiler().hasGpuTimings();
+    uint32_t                 framesInFlight = scheduler.framesInFlight();
+
+    // GPU memory, read before terminate() releases everything
+    const GpuMemoryTracker& memory          = app.resources().memory();
+    uint64_t                peakMemoryBytes = memory.peakTotalBytes();
+    std::vector<GpuMemoryTracker::CategoryStats> memoryStats;
+    for (size_t i = 0; i < kResourceCategoryCount; ++i) {
+        memoryStats.push_back(memory.stats(ResourceCategory(i)));
+    }
+
+    app.terminate();
+
+    BenchReport report("frames");
+    report.addValue("frames", frames);
+    report.addValue("width", appOptions.width);
+    report.addValue("height", appOptions.height);
+    report.addValue("total_ms", totalMs);
+    report.addValue("time_to_first_frame_ms", timeToFirstFrameMs);
+    report.addValue("fps", totalMs > 0 ? frames * 1000.0 / totalMs : 0);
+    report.addValue(
+        "gpu_idle_percent", totalMs > 0 ? 100 * gpuIdleMs / totalMs : 0);
+    report.addValue("frames_in_flight", framesInFlight);
+    report.addValue("max_fps", opts.maxFps);
+    report.addSeries("cpu_frame_ms", std::move(cpuFrameMs));
+    report.addSeries("submit_to_done_ms", std::move(submitToDoneMs));
+    // The stddev of the frame interval is the frame-time jitter
+    report.addSeries("frame_interval_ms", std::move(frameInterval));
+    report.addSeries("input_to_present_ms", std::move(inputToPresent));
+    report.addSeries("throttle_wait_ms", std::move(throttleWait));
+    // Queue submits of the frames, all their command buffers at once
+    report.addValue(
+        "submits_per_frame",
+        double(submits.submits - submitsBefore.submits) / frames);
+    report.addValue(
+        "command_buffers_per_frame",
+        double(submits.commandBuffers - submitsBefore.commandBuffers) /
+            frames);
+    report.addValue(
+        "submit_cpu_ms_per_frame",
+        (submits.submitMs - submitsBefore.submitMs) / frames);
+    report.addValue("arena_peak_bytes", arena.peakBytes);
+    report.addValue(
+        "arena_heap_allocations",
+        arena.heapAllocations - arenaBefore.heapAllocations);
+    report.addValue("gpu_timestamps", gpuTimed);
+    for (const ScopeTiming& scope : scopes) {
+        report.addValue("scope_" + scope.name + "_cpu_ms", scope.cpuMs);
+        if (gpuTimed) {
+            report.addValue("scope_" + scope.name + "_gpu_ms", scope.gpuMs);
+        }
+    }
+    // GPU memory per resource category at the end of the run, and peaks
+    report.addValue("memory_peak_bytes", peakMemoryBytes);
+    for (size_t i = 0; i < kResourceCategoryCount; ++i) {
+        std::string prefix =
+            std::string("memory_") + resourceCategoryName(ResourceCategory(i));
+        report.addValue(prefix + "_bytes", memoryStats[i].bytes);
+        report.addValue(prefix + "_peak_bytes", memoryStats[i].peakBytes);
+        report.addValue(prefix + "_live", memoryStats[i].live);
+    }
+    return report.write(opts) ? 0 : 1;
+}
+
+int runBatchRender(
+    unsigned int        frames,
+    const std::string&  pathPattern,
+    const BenchOptions& opts)
+{
+    ApplicationOptions appOptions;
+    appOptions.headless             = true;
+    appOptions.backend              = opts.backend;
+    appOptions.forceFallbackAdapter = opts.forceFallback;
+    appOptions.tracePath            = opts.tracePath;
+    appOptions.framesInFlight       = opts.framesInFlight;
+    appOptions.maxFps               = opts.maxFps;
+    appOptions.capturePattern       = pathPattern;
+
+    std::filesystem::path directory =
+        std::filesystem::path(framePath(pathPattern, 0)).parent_path();
+    std::error_code error;
+    if (!directory.empty()) {
+        std::filesystem::create_directories(directory, error);
+    }
+
+    Application app;
+    if (!app.initialize(appOptions) || !app.frameCapture()) {
+        std::cerr << "Could not initialize the headless application!"
+                  << std::endl;
+        return 1;
+    }
+    // Frames rendered with the final pipelines only
+    app.pipelineLoader().waitAll();
+
+    FrameScheduler& scheduler = app.scheduler();
+    scheduler.takeGpuIdleMs();
+    std::vector<double> cpuFrameMs;
+    cpuFrameMs.reserve(frames);
+    auto runStart = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < frames; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        app.mainLoop();
+        cpuFrameMs.push_back(elapsedMs(start));
+    }
+    double renderMs  = elapsedMs(runStart);
+    double gpuIdleMs = scheduler.takeGpuIdleMs();
+    // The last frames are still being read back and encoded
+    app.waitForIdle();
+    app.frameCapture()->flush();
+    double totalMs = elapsedMs(runStart);
+
+    FrameCapture::Stats stats = app.frameCapture()->stats();
+    app.terminate();
+
+    BenchReport report("batch-render");
+    report.addValue("frames", frames);
+    report.addValue("width", appOptions.width);
+    report.addValue("height", appOptions.height);
+    report.addValue("total_ms", totalMs);
+    report.addValue("fps", totalMs > 0 ? stats.written * 1000.0 / totalMs : 0);
+    report.addValue(
+        "gpu_idle_percent", renderMs > 0 ? 100 * gpuIdleMs / renderMs : 0);
+    report.addValue("written", stats.written);
+    report.addValue("failed", stats.failed);
+    report.addValue("readback_stalls", stats.readbackStalls);
+    report.addValue("encode_stalls", stats.encodeStalls);
+    report.addValue(
+        "encode_ms_per_frame",
+        stats.written > 0 ? stats.encodeMs / stats.written : 0);
+    report.addSeries("cpu_frame_ms", std::move(cpuFrameMs));
+    if (!report.write(opts)) {
+        return 1;
+    }
+    return stats.written == frames ? 0 : 1;
+}
+
+int runDeviceRecovery(unsigned int losses, const BenchOptions& opts)
+{
+    ApplicationOptions appOptions;
+    appOptions.headless             = true;
+    appOptions.backend              = opts.backend;
+    appOptions.forceFallbackAdapter = opts.forceFallback;
+    appOptions.framesInFlight       = opts.framesInFlight;
+
+    Application app;
+    if (!app.initialize(appOptions)) {
+        std::cerr << "Could not initialize the headless application!"
+                  << std::endl;
+        return 1;
+    }
+    app.mainLoop();
+    double timeToFirstFrameMs = app.timeToFirstFrameMs();
+
+    std::vector<double> reportedMs, timeToFrameMs, deviceMs, rebuildMs;
+    std::vector<double> pipelinesReadyMs;
+    for (unsigned int i = 0; i < losses; ++i) {
+        // In the middle of a run, with the pipelines in use
+        app.pipelineLoader().waitAll();
+        for (unsigned int j = 0; j < kWarmupFrames; ++j) {
+            app.mainLoop();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        app.loseDevice();
+        while (!app.deviceLost()) {
+            if (std::chrono::steady_clock::now() - start > kLossTimeout) {
+                std::cerr << "The device loss was not reported" << std::endl;
+                app.terminate();
+                return 1;
+            }
+            // Without the event thread, the callback only fires from here
+            app.processEvents();
+            std::this_thread::yield();
+        }
+        reportedMs.push_back(elapsedMs(start));
+        // Recovers, then draws a frame with what is ready
+        app.mainLoop();
+        if (!app.isRunning()) {
+            std::cerr << "Could not recover from the device loss" << std::endl;
+            app.terminate();
+            return 1;
+        }
+        timeToFrameMs.push_back(elapsedMs(start));
+        app.pipelineLoader().waitAll();
+        pipelinesReadyMs.push_back(elapsedMs(start));
+
+        DeviceRecoveryStats stats = app.recoveryStats();
+        deviceMs.push_back(stats.deviceMs);
+        rebuildMs.push_back(stats.rebuildMs);
+    }
+    DeviceRecoveryStats stats = app.recoveryStats();
+    app.terminate();
+
+    BenchReport report("device-recovery");
+    report.addValue("losses", stats.losses);
+    report.addValue("recoveries", stats.recoveries);
+    report.addValue("time_to_first_frame_ms", timeToFirstFrameMs);
+    report.addSeries("loss_reported_ms", std::move(reportedMs));
+    report.addSeries("time_to_frame_ms", std::move(timeToFrameMs));
+    report.addSeries("device_ms", std::move(deviceMs));
+    report.addSeries("rebuild_ms", std::move(rebuildMs));
+    report.addSeries("pipelines_ready_ms", std::move(pipelinesReadyMs));
+    return report.write(opts) ? 0 : 1;
+}
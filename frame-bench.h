@@ -0,0 +1,38 @@
+#ifndef FRAME_BENCH_H
+#define FRAME_BENCH_H
+
+#include "microbench.h"
+
+#include <string>
+
+/**
+ * Run `frames` frames of Application::mainLoop() headless on the backend of
+ * `opts`, after a short warm-up, and write a JSON report with the CPU time
+ * per frame and the submit-to-done latency (p50/p95/p99).
+ * Return the process exit code.
+ */
+int runFrameBenchmark(unsigned int frames, const BenchOptions& opts);
+
+/**
+ * Render `frames` frames headless and write each of them as a PNG to
+ * framePath(pathPattern, i), see FrameCapture. The JSON report holds the
+ * throughput in frames per second, counting until the last file is
+ * written, and the share of the time the GPU had no frame to work on.
+ * Return the process exit code.
+ */
+int runBatchRender(
+    unsigned int        frames,
+    const std::string&  pathPattern,
+    const BenchOptions& opts);
+
+/**
+ * Destroy the device of a headless Application `losses` times, as a driver
+ * reset would, and write a JSON report with the time from each loss to the
+ * next frame presented on the new device, split into the device request
+ * and the rebuild, and to its pipelines being compiled again, next to the
+ * cold time to first frame.
+ * Return the process exit code.
+ */
+int runDeviceRecovery(unsigned int losses, const BenchOptions& opts);
+
+#endif // FRAME_BENCH_H
@@ -0,0 +1,118 @@
+#include "frame-capture.h"
+
+#include "image-writer.h"
+
+#include <chrono>
+#include <iostream>
+
+FrameCapture::FrameCapture(
+    WGPUInstance instance,
+    WGPUDevice   device,
+    JobSystem&   jobs,
+    std::string  pathPattern,
+    uint32_t     depth) :
+        m_ring(instance, device, depth), m_jobs(jobs),
+        m_pattern(std::move(pathPattern)), m_maxEncoding(jobs.threadCount())
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+    flush();
+}
+
+bool FrameCapture::capture(
+    WGPUCommandEncoder encoder,
+    WGPUTexture        texture,
+    uint64_t           frameIndex)
+{
+    WGPUTextureFormat format = wgpuTextureGetFormat(texture);
+    if (format != WGPUTextureFormat_RGBA8Unorm &&
+        format != WGPUTextureFormat_BGRA8Unorm) {
+        std::cerr << "Cannot capture frames of format " << format << '\n';
+        return false;
+    }
+    uint32_t width  = wgpuTextureGetWidth(texture);
+    uint32_t height = wgpuTextureGetHeight(texture);
+    bool     bgra   = format == WGPUTextureFormat_BGRA8Unorm;
+
+    bool recorded = m_ring.enqueueTextureCopy(
+        encoder,
+        texture,
+        4,
+        [this, width, height, bgra, frameIndex](
+            const void* data, uint64_t size) {
+            encode(data, size, width, height, bgra, frameIndex);
+        });
+    m_captured += recorded;
+    return recorded;
+}
+
+void FrameCapture::onSubmitted()
+{
+    m_ring.onSubmitted();
+}
+
+void FrameCapture::poll()
+{
+    m_ring.poll();
+}
+
+void FrameCapture::flush()
+{
+    m_ring.flush();
+    m_jobs.wait(m_encoders);
+}
+
+FrameCapture::Stats FrameCapture::stats() const
+{
+    ReadbackStats readback = m_ring.stats();
+
+    Stats stats;
+    stats.captured       = m_captured;
+    stats.written        = m_written;
+    stats.failed         = m_failed + readback.failed;
+    stats.readbackStalls = readback.stalls;
+    stats.encodeStalls   = m_encodeStalls;
+    stats.encodeMs       = m_encodeNs * 1e-6;
+    return stats;
+}
+
+void FrameCapture::encode(
+    const void* data,
+    uint64_t    size,
+    uint32_t    width,
+    uint32_t    height,
+    bool        bgra,
+    uint64_t    frameIndex)
+{
+    // More frames waiting for an encoder than there are threads: disk or
+    // encoding is the bottleneck, help until the backlog is cleared
+    if (m_encoding >= m_maxEncoding) {
+        ++m_encodeStalls;
+        m_jobs.wait(m_encoders);
+    }
+
+    // The staging buffer is unmapped after this call
+    const uint8_t*       bytes = static_cast<const uint8_t*>(data);
+    std::vector<uint8_t> pixels(bytes, bytes + size);
+    ++m_encoding;
+    m_jobs.run(
+        m_encoders,
+        [this, pixels = std::move(pixels), width, height, bgra, frameIndex] {
+            auto start   = std::chrono::steady_clock::now();
+            bool written = writePng(
+                framePath(m_pattern, frameIndex),
+                pixels.data(),
+                width,
+                height,
+                textureRowPitch(width, 4),
+                bgra);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            m_encodeNs +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count();
+            ++(written ? m_written : m_failed);
+            --m_encoding;
+        });
+}
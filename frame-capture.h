@@ -0,0 +1,102 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "job-system.h"
+#include "readback-ring.h"
+
+#include <webgpu/webgpu.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Writes rendered frames to disk without stalling the GPU or the render
+ * loop. Each frame is copied into a staging buffer of a ReadbackRing,
+ * mapped a few frames later, and encoded to PNG by JobSystem jobs:
+ *     capture.capture(encoder, texture, frameIndex); // after the passes
+ *     queue.submit(...);
+ *     capture.onSubmitted();
+ *     ...
+ *     capture.poll(); // once per frame: hands mapped frames to the jobs
+ *     ...
+ *     capture.flush(); // before exiting
+ *
+ * The render loop only waits when all `depth` staging buffers are still in
+ * flight, or when more frames are being encoded than there are threads.
+ */
+class FrameCapture
+{
+public:
+    struct Stats
+    {
+        uint64_t captured = 0; // copies recorded
+        uint64_t written  = 0; // files written
+        uint64_t failed   = 0; // failed readbacks or writes
+        // Captures that waited for a staging buffer, and polls that waited
+        // for the encoders
+        uint64_t readbackStalls = 0;
+        uint64_t encodeStalls   = 0;
+        double   encodeMs       = 0; // summed over the threads
+    };
+
+    // Frame i is written to framePath(pathPattern, i), see image-writer.h
+    FrameCapture(
+        WGPUInstance instance,
+        WGPUDevice   device,
+        JobSystem&   jobs,
+        std::string  pathPattern,
+        uint32_t     depth = 3);
+    // Flushes
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&)            = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Record the copy of `texture`: 2D, RGBA8Unorm or BGRA8Unorm, with the
+    // CopySrc usage. Return false if the frame cannot be captured.
+    bool capture(
+        WGPUCommandEncoder encoder,
+        WGPUTexture        texture,
+        uint64_t           frameIndex);
+
+    // After the submission of the copies recorded by capture()
+    void onSubmitted();
+
+    // Hand the frames mapped since the previous call to the encoders
+    void poll();
+
+    // Wait until every captured frame is written
+    void flush();
+
+    Stats stats() const;
+
+    // See ReadbackRing::setEventThread()
+    void setEventThread(EventThread* events) { m_ring.setEventThread(events); }
+
+private:
+    // Start encoding a mapped frame; `data` is only valid during the call
+    void encode(
+        const void* data,
+        uint64_t    size,
+        uint32_t    width,
+        uint32_t    height,
+        bool        bgra,
+        uint64_t    frameIndex);
+
+    ReadbackRing     m_ring;
+    JobSystem&       m_jobs;
+    JobSystem::Group m_encoders;
+    std::string      m_pattern;
+    uint32_t         m_maxEncoding = 1;
+
+    uint64_t              m_captured     = 0;
+    uint64_t              m_encodeStalls = 0;
+    std::atomic<uint32_t> m_encoding     = 0;
+    std::atomic<uint64_t> m_written      = 0;
+    std::atomic<uint64_t> m_failed       = 0;
+    std::atomic<uint64_t> m_encodeNs     = 0;
+};
+
+#endif // FRAME_CAPTURE_H
@@ -0,0 +1,202 @@
+#include "frame-scheduler.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+namespace {
+
+double msBetween(
+    FrameScheduler::Clock::time_point from,
+    FrameScheduler::Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+bool supports(const WGPUPresentMode* modes, size_t count, WGPUPresentMode mode)
+{
+    return std::find(modes, modes + count, mode) != modes + count;
+}
+
+// OS sleeps overshoot by up to a scheduler tick; the end of the wait spins
+constexpr auto kSpinMargin = std::chrono::microseconds(1500);
+
+} // namespace
+
+WGPUPresentMode selectPresentMode(
+    const WGPUPresentMode* supportedModes,
+    size_t                 supportedCount,
+    WGPUPresentMode        preferred)
+{
+    WGPUPresentMode candidates[] = {preferred, WGPUPresentMode_Fifo};
+    if (preferred == WGPUPresentMode_Mailbox) {
+        candidates[1] = WGPUPresentMode_Immediate;
+    }
+    else if (preferred == WGPUPresentMode_Immediate) {
+        candidates[1] = WGPUPresentMode_Mailbox;
+    }
+    for (WGPUPresentMode mode : candidates) {
+        if (supports(supportedModes, supportedCount, mode)) {
+            return mode;
+        }
+    }
+    return WGPUPresentMode_Fifo;
+}
+
+const char* presentModeName(WGPUPresentMode mode)
+{
+    switch (mode) {
+    case WGPUPresentMode_Fifo: return "fifo";
+    case WGPUPresentMode_FifoRelaxed: return "fifo-relaxed";
+    case WGPUPresentMode_Immediate: return "immediate";
+    case WGPUPresentMode_Mailbox: return "mailbox";
+    default: return "undefined";
+    }
+}
+
+FrameScheduler::FrameScheduler(
+    WGPUInstance instance,
+    WGPUQueue    queue,
+    uint32_t     framesInFlight,
+    double       maxFps) :
+        m_instance(instance), m_queue(queue),
+        m_framesInFlight(std::max(framesInFlight, 1u)), m_maxFps(maxFps)
+{
+}
+
+FrameScheduler::~FrameScheduler()
+{
+    waitForIdle();
+}
+
+void FrameScheduler::setMaxFps(double maxFps)
+{
+    m_maxFps = maxFps;
+    // Restart the pacing from the next frame
+    m_nextDeadline = Clock::now();
+}
+
+void FrameScheduler::beginFrame()
+{
+    collectCompleted();
+
+    // Block on the oldest frame until a slot is free
+    if (m_inFlight.size() >= m_framesInFlight) {
+        Clock::time_point waitStart = Clock::now();
+        while (m_inFlight.size() >= m_framesInFlight) {
+            if (!m_inFlight.front().done.wait()) {
+                // The wait failed, e.g. the device is lost: the frame will
+                // not complete, count its slot as free
+                m_inFlight.pop_front();
+                break;
+            }
+            collectCompleted();
+        }
+        m_throttleWaitsMs.push_back(msBetween(waitStart, Clock::now()));
+    }
+
+    if (m_maxFps > 0) {
+        auto period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / m_maxFps));
+        if (m_started) {
+            sleepUntil(m_nextDeadline);
+        }
+        Clock::time_point now = Clock::now();
+        // Keep the cadence when slightly late, but don't try to catch up
+        // with frames missed by more than one period
+        m_nextDeadline = m_started && now < m_nextDeadline + period ?
+                             m_nextDeadline + period :
+                             now + period;
+    }
+
+    Clock::time_point start = Clock::now();
+    if (m_started) {
+        m_frameIntervalsMs.push_back(msBetween(m_lastFrameStart, start));
+    }
+    m_lastFrameStart = start;
+    m_inputTime      = start;
+    m_started        = true;
+}
+
+void FrameScheduler::setInputTime(Clock::time_point time)
+{
+    m_inputTime = std::min(m_inputTime, time);
+}
+
+void FrameScheduler::onSubmitted()
+{
+    if (m_idleSince != Clock::time_point()) {
+        m_gpuIdleMs += msBetween(m_idleSince, Clock::now());
+        m_idleSince = {};
+    }
+    m_inFlight.push_back(
+        {onSubmittedWorkDoneAsync(m_instance, m_queue), Clock::now()});
+}
+
+void FrameScheduler::onPresented()
+{
+    m_inputLatenciesMs.push_back(msBetween(m_inputTime, Clock::now()));
+}
+
+void FrameScheduler::collectCompleted()
+{
+    while (!m_inFlight.empty() && m_inFlight.front().done.wait(0)) {
+        m_submitLatenciesMs.push_back(
+            msBetween(m_inFlight.front().submitTime, Clock::now()));
+        m_inFlight.pop_front();
+        if (m_inFlight.empty()) {
+            m_idleSince = Clock::now();
+        }
+    }
+}
+
+void FrameScheduler::waitForIdle()
+{
+    if (m_queue) {
+        onSubmittedWorkDoneAsync(m_instance, m_queue).wait();
+    }
+    collectCompleted();
+    // The wait breaks the cadence: the next frame starts a new interval
+    m_started = false;
+}
+
+std::vector<double> FrameScheduler::takeSubmitLatencies()
+{
+    return std::exchange(m_submitLatenciesMs, {});
+}
+
+std::vector<double> FrameScheduler::takeInputLatencies()
+{
+    return std::exchange(m_inputLatenciesMs, {});
+}
+
+std::vector<double> FrameScheduler::takeFrameIntervals()
+{
+    return std::exchange(m_frameIntervalsMs, {});
+}
+
+std::vector<double> FrameScheduler::takeThrottleWaits()
+{
+    return std::exchange(m_throttleWaitsMs, {});
+}
+
+double FrameScheduler::takeGpuIdleMs()
+{
+    // An ongoing idle period is split at this call
+    if (m_idleSince != Clock::time_point()) {
+        Clock::time_point now = Clock::now();
+        m_gpuIdleMs += msBetween(m_idleSince, now);
+        m_idleSince = now;
+    }
+    return std::exchange(m_gpuIdleMs, 0);
+}
+
+void FrameScheduler::sleepUntil(Clock::time_point deadline) const
+{
+    if (Clock::now() + kSpinMargin < deadline) {
+        std::this_thread::sleep_until(deadline - kSpinMargin);
+    }
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include "webgpu-async.h"
+
+#include <webgpu/webgpu.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/**
+ * Pick the present mode to configure a surface with. `preferred` is used if
+ * the surface supports it; otherwise Mailbox and Immediate fall back to each
+ * other, then to Fifo, which every surface supports.
+ */
+WGPUPresentMode selectPresentMode(
+    const WGPUPresentMode* supportedModes,
+    size_t                 supportedCount,
+    WGPUPresentMode        preferred);
+
+const char* presentModeName(WGPUPresentMode mode);
+
+/**
+ * Bounds the number of frames queued on the GPU and paces the frame rate.
+ *
+ * Per frame:
+ *     scheduler.beginFrame();          // waits for a free frame slot
+ *     ... poll input, encode ...
+ *     queue.submit(...);
+ *     scheduler.onSubmitted();
+ *     surface.present();
+ *     scheduler.onPresented();
+ *
+ * With N frames in flight, beginFrame() of frame k returns once frame
+ * k - N is done on the GPU, so per-frame resources indexed by k % N can be
+ * reused. Fewer frames in flight lower the latency, more of them keep the
+ * GPU busy when the CPU time varies.
+ */
+class FrameScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // `maxFps` of 0 disables frame-rate capping
+    FrameScheduler(
+        WGPUInstance instance,
+        WGPUQueue    queue,
+        uint32_t     framesInFlight,
+        double       maxFps = 0);
+    ~FrameScheduler();
+
+    FrameScheduler(const FrameScheduler&)            = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    // Wait until a frame slot is free and, if capped, until the frame is
+    // due. Input should be sampled right after: the input-to-present latency
+    // is measured from the return of this call.
+    void beginFrame();
+
+    // Measure the input-to-present latency of this frame from `time`, when
+    // the oldest input event it handles was reported, if that is earlier
+    // than beginFrame()
+    void setInputTime(Clock::time_point time);
+
+    void onSubmitted();
+
+    // Call right after presenting (or after submitting, without a surface)
+    void onPresented();
+
+    // Record the submissions that are done on the GPU, without waiting
+    void collectCompleted();
+
+    // Wait for all the submitted frames. The next frame interval and pacing
+    // deadline restart from the following beginFrame().
+    void waitForIdle();
+
+    uint32_t framesInFlight() const { return m_framesInFlight; }
+    uint32_t pendingFrames() const { return uint32_t(m_inFlight.size()); }
+    double   maxFps() const { return m_maxFps; }
+    void     setMaxFps(double maxFps);
+
+    // Samples recorded since the previous call, in ms:
+    // submit to GPU done, as observed by collectCompleted()
+    std::vector<double> takeSubmitLatencies();
+    // input sampled to present, per frame
+    std::vector<double> takeInputLatencies();
+    // interval between consecutive beginFrame() returns
+    std::vector<double> takeFrameIntervals();
+    // time beginFrame() blocked on the GPU (excluding pacing)
+    std::vector<double> takeThrottleWaits();
+    // Time with no frame in flight since the previous call, in ms. Counted
+    // from when collectCompleted() saw the last frame done to the next
+    // submission, so idle periods shorter than the polling are missed.
+    double takeGpuIdleMs();
+
+private:
+    struct InFlightFrame
+    {
+        Future<AsyncStatus> done;
+        Clock::time_point   submitTime;
+    };
+
+    void sleepUntil(Clock::time_point deadline) const;
+
+    WGPUInstance m_instance       = nullptr;
+    WGPUQueue    m_queue          = nullptr;
+    uint32_t     m_framesInFlight = 1;
+    double       m_maxFps         = 0;
+
+    std::deque<InFlightFrame> m_inFlight;
+    Clock::time_point         m_nextDeadline;
+    Clock::time_point         m_lastFrameStart;
+    Clock::time_point         m_inputTime;
+    bool                      m_started = false;
+    // Set while no frame is in flight, after the first submission
+    Clock::time_point m_idleSince;
+    double            m_gpuIdleMs = 0;
+
+    std::vector<double> m_submitLatenciesMs;
+    std::vector<double> m_inputLatenciesMs;
+    std::vector<double> m_frameIntervalsMs;
+    std::vector<double> m_throttleWaitsMs;
+};
+
+#endif // FRAME_SCHEDULER_H
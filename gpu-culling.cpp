@@ -0,0 +1,596 @@
+#include "gpu-culling.h"
+
+#include "buffer-allocator.h"
+#include "webgpu-utils.h"
+#include "wgsl-layout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+static_assert(sizeof(InstanceBounds) == 16, "matches the WGSL Bounds");
+static_assert(sizeof(DrawIndexedIndirectArgs) == 20, "matches WGSL Args");
+
+namespace {
+
+constexpr uint32_t kCullWorkgroupSize = 64;
+constexpr uint32_t kHiZWorkgroupSize  = 8;
+
+// One invocation per instance; visible instances are appended to the list
+// of their mesh, whose instance count they increment. CullParams is declared
+// from its C++ definition.
+const char* kCullSource = R"(
+const WG: u32 = 64u;
+
+struct Bounds {
+    center: vec3f,
+    radius: f32,
+}
+
+struct Args {
+    indexCount: u32,
+    instanceCount: atomic<u32>,
+    firstIndex: u32,
+    baseVertex: i32,
+    firstInstance: u32,
+}
+
+@group(0) @binding(0) var<uniform> params: CullParams;
+@group(0) @binding(1) var<storage, read> bounds: array<Bounds>;
+@group(0) @binding(2) var<storage, read> meshOf: array<u32>;
+@group(0) @binding(3) var<storage, read> visibleOffsets: array<u32>;
+@group(0) @binding(4) var<storage, read_write> args: array<Args>;
+@group(0) @binding(5) var<storage, read_write> visible: array<u32>;
+@group(0) @binding(6) var hiZ: texture_2d<f32>;
+
+fn inFrustum(b: Bounds) -> bool {
+    for (var i = 0u; i < 6u; i++) {
+        let plane = params.planes[i];
+        if (dot(plane.xyz, b.center) + plane.w < -b.radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compare the nearest depth of the box around the sphere with the farthest
+// depth of the 2x2 Hi-Z texels covering its screen rectangle, at the level
+// where the rectangle spans at most one texel
+fn occluded(b: Bounds) -> bool {
+    var uvMin = vec2f(1.0);
+    var uvMax = vec2f(0.0);
+    var nearest = 1.0;
+    for (var i = 0u; i < 8u; i++) {
+        let corner = b.center + b.radius * vec3f(
+            select(-1.0, 1.0, (i & 1u) != 0u),
+            select(-1.0, 1.0, (i & 2u) != 0u),
+            select(-1.0, 1.0, (i & 4u) != 0u));
+        let clip = params.viewProj * vec4f(corner, 1.0);
+        if (clip.w <= 0.0) {
+            return false; // crosses the near plane
+        }
+        let ndc = clip.xyz / clip.w;
+        let uv = saturate(ndc.xy * vec2f(0.5, -0.5) + 0.5);
+        uvMin = min(uvMin, uv);
+        uvMax = max(uvMax, uv);
+        nearest = min(nearest, ndc.z);
+    }
+
+    let extent = (uvMax - uvMin) * vec2f(textureDimensions(hiZ, 0));
+    let level = min(
+        u32(ceil(log2(max(max(extent.x, extent.y), 1.0)))),
+        textureNumLevels(hiZ) - 1u);
+    let size = textureDimensions(hiZ, level);
+    let last = vec2i(size) - 1;
+    let a = min(vec2i(uvMin * vec2f(size)), last);
+    let c = min(vec2i(uvMax * vec2f(size)), last);
+    let farthest = max(
+        max(textureLoad(hiZ, a, level).r,
+            textureLoad(hiZ, vec2i(c.x, a.y), level).r),
+        max(textureLoad(hiZ, vec2i(a.x, c.y), level).r,
+            textureLoad(hiZ, c, level).r));
+    return nearest > farthest;
+}
+
+@compute @workgroup_size(WG)
+fn main(
+    @builtin(workgroup_id) wid: vec3u,
+    @builtin(num_workgroups) nwg: vec3u,
+    @builtin(local_invocation_index) lid: u32
+) {
+    let index = (wid.x + wid.y * nwg.x) * WG + lid;
+    if (index >= params.instanceCount) {
+        return;
+    }
+    let b = bounds[index];
+    if (!inFrustum(b) || (params.occlusion != 0u && occluded(b))) {
+        return;
+    }
+    let mesh = meshOf[index];
+    let slot = atomicAdd(&args[mesh].instanceCount, 1u);
+    visible[visibleOffsets[mesh] + slot] = index;
+}
+)";
+
+// Hi-Z reduction: each texel takes the farthest depth of the texels of the
+// level below that it overlaps, so that odd sizes stay conservative
+const char* kHiZFromDepthSource = R"(
+@group(0) @binding(0) var inputDepth: texture_depth_2d;
+
+fn loadDepth(x: u32, y: u32) -> f32 {
+    return textureLoad(inputDepth, vec2u(x, y), 0);
+}
+)";
+
+const char* kHiZFromLevelSource = R"(
+@group(0) @binding(0) var inputDepth: texture_2d<f32>;
+
+fn loadDepth(x: u32, y: u32) -> f32 {
+    return textureLoad(inputDepth, vec2u(x, y), 0).r;
+}
+)";
+
+const char* kHiZReduceSource = R"(
+@group(0) @binding(1) var outputDepth: texture_storage_2d<r32float, write>;
+
+@compute @workgroup_size(8, 8)
+fn main(@builtin(global_invocation_id) id: vec3u) {
+    let outputSize = textureDimensions(outputDepth);
+    if (any(id.xy >= outputSize)) {
+        return;
+    }
+    let inputSize = textureDimensions(inputDepth);
+    let begin = id.xy * inputSize / outputSize;
+    let end = min(
+        ((id.xy + 1u) * inputSize + outputSize - 1u) / outputSize,
+        inputSize);
+    var depth = 0.0;
+    for (var y = begin.y; y < end.y; y++) {
+        for (var x = begin.x; x < end.x; x++) {
+            depth = max(depth, loadDepth(x, y));
+        }
+    }
+    textureStore(outputDepth, id.xy, vec4f(depth));
+}
+)";
+
+struct CullParams
+{
+    wgsl::mat4x4f              viewProj;
+    std::array<wgsl::vec4f, 6> planes;
+    uint32_t                   instanceCount = 0;
+    uint32_t                   occlusion     = 0;
+};
+
+} // namespace
+
+WGSL_STRUCT(CullParams, viewProj, planes, instanceCount, occlusion);
+static_assert(wgslLayoutMatches<CullParams, WgslAddressSpace::Uniform>());
+
+namespace {
+
+const std::string& cullSource()
+{
+    static const std::string source =
+        wgslStructSource<CullParams>() + kCullSource;
+    return source;
+}
+
+WGPUBindGroupEntry bufferEntry(uint32_t binding, WGPUBuffer buffer)
+{
+    WGPUBindGroupEntry entry = WGPU_BIND_GROUP_ENTRY_INIT;
+    entry.binding            = binding;
+    entry.buffer             = buffer;
+    entry.size               = WGPU_WHOLE_SIZE;
+    return entry;
+}
+
+WGPUBindGroupEntry textureEntry(uint32_t binding, WGPUTextureView view)
+{
+    WGPUBindGroupEntry entry = WGPU_BIND_GROUP_ENTRY_INIT;
+    entry.binding            = binding;
+    entry.textureView        = view;
+    return entry;
+}
+
+} // namespace
+
+FrustumPlanes extractFrustumPlanes(const std::array<float, 16>& viewProj)
+{
+    auto row = [&](int r, int c) { return viewProj[c * 4 + r]; };
+    FrustumPlanes planes;
+    for (int c = 0; c < 4; ++c) {
+        planes[0][c] = row(3, c) + row(0, c); // left
+        planes[1][c] = row(3, c) - row(0, c); // right
+        planes[2][c] = row(3, c) + row(1, c); // bottom
+        planes[3][c] = row(3, c) - row(1, c); // top
+        planes[4][c] = row(2, c);             // near, z >= 0
+        planes[5][c] = row(3, c) - row(2, c); // far
+    }
+    for (auto& plane : planes) {
+        float length = std::sqrt(
+            plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0) {
+            for (float& value : plane) {
+                value /= length;
+            }
+        }
+    }
+    return planes;
+}
+
+bool sphereInFrustum(const FrustumPlanes& planes, const InstanceBounds& bounds)
+{
+    for (const auto& plane : planes) {
+        float distance = plane[0] * bounds.center[0] +
+                         plane[1] * bounds.center[1] +
+                         plane[2] * bounds.center[2] + plane[3];
+        if (distance < -bounds.radius)
+            return false;
+    }
+    return true;
+}
+
+GpuCuller::GpuCuller(WGPUDevice device, PipelineRegistry& registry) :
+        m_device(device), m_registry(registry)
+{
+    WGPULimits limits = WGPU_LIMITS_INIT;
+    if (wgpuDeviceGetLimits(device, &limits) == WGPUStatus_Success) {
+        m_offsetAlignment       = limits.minStorageBufferOffsetAlignment;
+        m_maxGroupsPerDimension = limits.maxComputeWorkgroupsPerDimension;
+    }
+
+    WGPUBindGroupLayoutEntry entry = WGPU_BIND_GROUP_LAYOUT_ENTRY_INIT;
+    entry.binding                  = 0;
+    entry.visibility               = WGPUShaderStage_Vertex;
+    entry.buffer.type              = WGPUBufferBindingType_ReadOnlyStorage;
+    entry.buffer.hasDynamicOffset  = true;
+    WGPUBindGroupLayoutDescriptor layoutDesc =
+        WGPU_BIND_GROUP_LAYOUT_DESCRIPTOR_INIT;
+    layoutDesc.label      = {"Visible instances", WGPU_STRLEN};
+    layoutDesc.entryCount = 1;
+    layoutDesc.entries    = &entry;
+    m_visibleLayout = wgpuDeviceCreateBindGroupLayout(device, &layoutDesc);
+}
+
+GpuCuller::~GpuCuller()
+{
+    releaseScene();
+    releaseHiZ();
+    wgpuBindGroupLayoutRelease(m_visibleLayout);
+}
+
+WGPUBuffer GpuCuller::createBuffer(
+    const char*     label,
+    WGPUBufferUsage usage,
+    uint64_t        size)
+{
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    desc.label                = {label, WGPU_STRLEN};
+    desc.usage                = usage;
+    desc.size = std::max<uint64_t>(alignUp(size, 4), m_offsetAlignment);
+    return wgpuDeviceCreateBuffer(m_device, &desc);
+}
+
+void GpuCuller::releaseScene()
+{
+    // Culls encoded for the previous scene, not submitted yet, still use
+    // these: the command buffers hold references of their own
+    for (WGPUBuffer* buffer :
+         {&m_bounds,
+          &m_meshOf,
+          &m_visibleOffsets,
+          &m_initialArgs,
+          &m_indirect,
+          &m_visible}) {
+        if (*buffer) {
+            wgpuBufferRelease(*buffer);
+            *buffer = nullptr;
+        }
+    }
+    if (m_visibleGroup) {
+        wgpuBindGroupRelease(m_visibleGroup);
+        m_visibleGroup = nullptr;
+    }
+    m_meshes.clear();
+    m_instanceCount = 0;
+}
+
+void GpuCuller::setScene(
+    WGPUQueue                          queue,
+    const std::vector<CullMesh>&       meshes,
+    const std::vector<InstanceBounds>& bounds,
+    const std::vector<uint32_t>&       meshOf)
+{
+    releaseScene();
+    m_instanceCount = uint32_t(std::min(bounds.size(), meshOf.size()));
+    m_meshes.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        m_meshes[i].mesh = meshes[i];
+    }
+    for (uint32_t i = 0; i < m_instanceCount; ++i) {
+        ++m_meshes[meshOf[i]].capacity;
+    }
+
+    // Each visible list starts at an offset usable as a dynamic offset,
+    // and is bound with the size of the largest one
+    const uint32_t alignment = m_offsetAlignment / sizeof(uint32_t);
+    uint32_t       offset    = 0;
+    uint32_t       largest   = 1;
+    std::vector<uint32_t>                visibleOffsets;
+    std::vector<DrawIndexedIndirectArgs> args;
+    for (Mesh& mesh : m_meshes) {
+        mesh.visibleOffset = offset;
+        offset += uint32_t(alignUp(mesh.capacity, alignment));
+        largest = std::max(largest, mesh.capacity);
+        visibleOffsets.push_back(mesh.visibleOffset);
+
+        DrawIndexedIndirectArgs draw;
+        draw.indexCount = mesh.mesh.indexCount;
+        draw.firstIndex = mesh.mesh.firstIndex;
+        draw.baseVertex = mesh.mesh.baseVertex;
+        args.push_back(draw);
+    }
+    m_regionSize = uint64_t(largest) * sizeof(uint32_t);
+
+    uint64_t boundsSize = uint64_t(m_instanceCount) * sizeof(InstanceBounds);
+    uint64_t argsSize   = args.size() * sizeof(DrawIndexedIndirectArgs);
+
+    m_bounds = createBuffer(
+        "Cull bounds",
+        WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst,
+        boundsSize);
+    m_meshOf = createBuffer(
+        "Cull mesh indices",
+        WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst,
+        m_instanceCount * sizeof(uint32_t));
+    m_visibleOffsets = createBuffer(
+        "Cull visible offsets",
+        WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst,
+        visibleOffsets.size() * sizeof(uint32_t));
+    m_initialArgs = createBuffer(
+        "Cull initial arguments",
+        WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst,
+        argsSize);
+    m_indirect = createBuffer(
+        "Cull indirect arguments",
+        WGPUBufferUsage_Indirect | WGPUBufferUsage_Storage |
+            WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst,
+        argsSize);
+    m_visible = createBuffer(
+        "Visible instances",
+        WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc,
+        uint64_t(offset) * sizeof(uint32_t) + m_regionSize);
+
+    if (m_instanceCount > 0) {
+        wgpuQueueWriteBuffer(queue, m_bounds, 0, bounds.data(), boundsSize);
+        wgpuQueueWriteBuffer(
+            queue,
+            m_meshOf,
+            0,
+            meshOf.data(),
+            m_instanceCount * sizeof(uint32_t));
+    }
+    if (!args.empty()) {
+        wgpuQueueWriteBuffer(
+            queue,
+            m_visibleOffsets,
+            0,
+            visibleOffsets.data(),
+            visibleOffsets.size() * sizeof(uint32_t));
+        wgpuQueueWriteBuffer(queue, m_initialArgs, 0, args.data(), argsSize);
+    }
+
+    WGPUBindGroupEntry entry = bufferEntry(0, m_visible);
+    entry.size               = m_regionSize;
+    WGPUBindGroupDescriptor bindGroupDesc = WGPU_BIND_GROUP_DESCRIPTOR_INIT;
+    bindGroupDesc.layout                  = m_visibleLayout;
+    bindGroupDesc.entryCount              = 1;
+    bindGroupDesc.entries                 = &entry;
+    m_visibleGroup = wgpuDeviceCreateBindGroup(m_device, &bindGroupDesc);
+}
+
+void GpuCuller::updateBounds(
+    WGPUQueue             queue,
+    uint32_t              first,
+    const InstanceBounds* bounds,
+    uint32_t              count)
+{
+    count = std::min(count, m_instanceCount - std::min(first, m_instanceCount));
+    if (count == 0)
+        return;
+    wgpuQueueWriteBuffer(
+        queue,
+        m_bounds,
+        uint64_t(first) * sizeof(InstanceBounds),
+        bounds,
+        uint64_t(count) * sizeof(InstanceBounds));
+}
+
+void GpuCuller::cull(
+    WGPUCommandEncoder             encoder,
+    const View&                    view,
+    const WGPUPassTimestampWrites* timestamps)
+{
+    if (m_meshes.empty())
+        return;
+    if (!m_hiZ) {
+        // Bound even when occlusion is off, as the kernel declares it
+        createHiZ(1, 1);
+    }
+
+    // Reset the instance counts
+    wgpuCommandEncoderCopyBufferToBuffer(
+        encoder,
+        m_initialArgs,
+        0,
+        m_indirect,
+        0,
+        m_meshes.size() * sizeof(DrawIndexedIndirectArgs));
+    if (m_instanceCount == 0)
+        return;
+
+    CullParams    params;
+    FrustumPlanes planes = extractFrustumPlanes(view.viewProj);
+    std::copy(
+        view.viewProj.begin(),
+        view.viewProj.end(),
+        &params.viewProj.columns[0][0]);
+    for (size_t i = 0; i < planes.size(); ++i) {
+        std::copy(planes[i].begin(), planes[i].end(), params.planes[i].data);
+    }
+    params.instanceCount = m_instanceCount;
+    params.occlusion     = view.occlusion && m_hiZValid ? 1 : 0;
+
+    // Several culls may be recorded in one encoder, see createBufferWithData
+    WGPUBuffer uniforms = createBufferWithData(
+        m_device,
+        "Cull params",
+        WGPUBufferUsage_Uniform,
+        &params,
+        sizeof(CullParams));
+
+    ComputePipelineSpec spec;
+    spec.label        = "Instance culling";
+    spec.shaderSource = cullSource();
+
+    uint32_t groups = divideAndCeil(m_instanceCount, kCullWorkgroupSize);
+    uint32_t x      = std::min(groups, m_maxGroupsPerDimension);
+    dispatch(
+        encoder,
+        m_registry.computePipeline(spec),
+        {bufferEntry(0, uniforms),
+         bufferEntry(1, m_bounds),
+         bufferEntry(2, m_meshOf),
+         bufferEntry(3, m_visibleOffsets),
+         bufferEntry(4, m_indirect),
+         bufferEntry(5, m_visible),
+         textureEntry(6, m_hiZAll)},
+        x,
+        divideAndCeil(groups, x),
+        timestamps);
+    wgpuBufferRelease(uniforms);
+}
+
+void GpuCuller::draw(WGPURenderPassEncoder pass, uint32_t group) const
+{
+    for (size_t i = 0; i < m_meshes.size(); ++i) {
+        uint32_t offset =
+            m_meshes[i].visibleOffset * uint32_t(sizeof(uint32_t));
+        wgpuRenderPassEncoderSetBindGroup(
+            pass, group, m_visibleGroup, 1, &offset);
+        wgpuRenderPassEncoderDrawIndexedIndirect(
+            pass, m_indirect, i * sizeof(DrawIndexedIndirectArgs));
+    }
+}
+
+void GpuCuller::releaseHiZ()
+{
+    for (WGPUTextureView view : m_hiZViews) {
+        wgpuTextureViewRelease(view);
+    }
+    m_hiZViews.clear();
+    if (m_hiZAll) {
+        wgpuTextureViewRelease(m_hiZAll);
+        m_hiZAll = nullptr;
+    }
+    if (m_hiZ) {
+        wgpuTextureRelease(m_hiZ);
+        m_hiZ = nullptr;
+    }
+    m_hiZWidth  = 0;
+    m_hiZHeight = 0;
+    m_hiZValid  = false;
+}
+
+void GpuCuller::createHiZ(uint32_t width, uint32_t height)
+{
+    releaseHiZ();
+    uint32_t levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+        ++levels;
+    }
+
+    WGPUTextureDescriptor desc = WGPU_TEXTURE_DESCRIPTOR_INIT;
+    desc.label                 = {"Hi-Z pyramid", WGPU_STRLEN};
+    desc.usage =
+        WGPUTextureUsage_TextureBinding | WGPUTextureUsage_StorageBinding;
+    desc.dimension     = WGPUTextureDimension_2D;
+    desc.size          = {width, height, 1};
+    desc.format        = WGPUTextureFormat_R32Float;
+    desc.mipLevelCount = levels;
+    m_hiZ              = wgpuDeviceCreateTexture(m_device, &desc);
+    m_hiZAll           = wgpuTextureCreateView(m_hiZ, nullptr);
+    for (uint32_t level = 0; level < levels; ++level) {
+        WGPUTextureViewDescriptor viewDesc = WGPU_TEXTURE_VIEW_DESCRIPTOR_INIT;
+        viewDesc.baseMipLevel              = level;
+        viewDesc.mipLevelCount             = 1;
+        m_hiZViews.push_back(wgpuTextureCreateView(m_hiZ, &viewDesc));
+    }
+    m_hiZWidth  = width;
+    m_hiZHeight = height;
+}
+
+void GpuCuller::buildHiZ(WGPUCommandEncoder encoder, WGPUTexture depth)
+{
+    uint32_t width  = std::max(wgpuTextureGetWidth(depth) / 2, 1u);
+    uint32_t height = std::max(wgpuTextureGetHeight(depth) / 2, 1u);
+    if (width != m_hiZWidth || height != m_hiZHeight) {
+        createHiZ(width, height);
+    }
+
+    ComputePipelineSpec fromDepth;
+    fromDepth.label        = "Hi-Z from depth";
+    fromDepth.shaderSource =
+        std::string(kHiZFromDepthSource) + kHiZReduceSource;
+    ComputePipelineSpec fromLevel;
+    fromLevel.label        = "Hi-Z from level";
+    fromLevel.shaderSource =
+        std::string(kHiZFromLevelSource) + kHiZReduceSource;
+
+    WGPUTextureViewDescriptor depthViewDesc = WGPU_TEXTURE_VIEW_DESCRIPTOR_INIT;
+    depthViewDesc.aspect                    = WGPUTextureAspect_DepthOnly;
+    WGPUTextureView depthView = wgpuTextureCreateView(depth, &depthViewDesc);
+
+    for (uint32_t level = 0; level < m_hiZViews.size(); ++level) {
+        uint32_t levelWidth  = std::max(width >> level, 1u);
+        uint32_t levelHeight = std::max(height >> level, 1u);
+        dispatch(
+            encoder,
+            m_registry.computePipeline(level == 0 ? fromDepth : fromLevel),
+            {textureEntry(0, level == 0 ? depthView : m_hiZViews[level - 1]),
+             textureEntry(1, m_hiZViews[level])},
+            divideAndCeil(levelWidth, kHiZWorkgroupSize),
+            divideAndCeil(levelHeight, kHiZWorkgroupSize));
+    }
+    wgpuTextureViewRelease(depthView);
+    m_hiZValid = true;
+}
+
+void GpuCuller::dispatch(
+    WGPUCommandEncoder                     encoder,
+    WGPUComputePipeline                    pipeline,
+    const std::vector<WGPUBindGroupEntry>& entries,
+    uint32_t                               groupsX,
+    uint32_t                               groupsY,
+    const WGPUPassTimestampWrites*         timestamps)
+{
+    WGPUBindGroupDescriptor bindGroupDesc = WGPU_BIND_GROUP_DESCRIPTOR_INIT;
+    bindGroupDesc.layout = wgpuComputePipelineGetBindGroupLayout(pipeline, 0);
+    bindGroupDesc.entryCount = entries.size();
+    bindGroupDesc.entries    = entries.data();
+    WGPUBindGroup bindGroup =
+        wgpuDeviceCreateBindGroup(m_device, &bindGroupDesc);
+    wgpuBindGroupLayoutRelease(bindGroupDesc.layout);
+
+    WGPUComputePassDescriptor passDesc = WGPU_COMPUTE_PASS_DESCRIPTOR_INIT;
+    passDesc.timestampWrites           = timestamps;
+    WGPUComputePassEncoder pass =
+        wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+    wgpuComputePassEncoderSetPipeline(pass, pipeline);
+    wgpuComputePassEncoderSetBindGroup(pass, 0, bindGroup, 0, nullptr);
+    wgpuComputePassEncoderDispatchWorkgroups(pass, groupsX, groupsY, 1);
+    wgpuComputePassEncoderEnd(pass);
+    wgpuComputePassEncoderRelease(pass);
+    wgpuBindGroupRelease(bindGroup);
+}
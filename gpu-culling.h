@@ -0,0 +1,182 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include "pipeline-cache.h"
+
+#include <webgpu/webgpu.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * World-space bounding sphere of an instance, as laid out on the GPU.
+ */
+struct InstanceBounds
+{
+    float center[3] = {0, 0, 0};
+    float radius    = 0;
+};
+
+/**
+ * Arguments of drawIndexedIndirect, as laid out on the GPU.
+ */
+struct DrawIndexedIndirectArgs
+{
+    uint32_t indexCount    = 0;
+    uint32_t instanceCount = 0;
+    uint32_t firstIndex    = 0;
+    int32_t  baseVertex    = 0;
+    uint32_t firstInstance = 0;
+};
+
+/**
+ * Planes of a view frustum, normalized, pointing inwards: left, right,
+ * bottom, top, near, far. Each is (nx, ny, nz, d) with n.p + d >= 0 inside.
+ */
+using FrustumPlanes = std::array<std::array<float, 4>, 6>;
+
+// `viewProj` is column-major, clip z in [0, 1] as in WebGPU
+FrustumPlanes extractFrustumPlanes(const std::array<float, 16>& viewProj);
+
+// The test done by the culling kernel, for CPU culling
+bool sphereInFrustum(const FrustumPlanes& planes, const InstanceBounds& bounds);
+
+/**
+ * A mesh drawn by GpuCuller::draw(), in the bound index and vertex buffers.
+ */
+struct CullMesh
+{
+    uint32_t indexCount = 0;
+    uint32_t firstIndex = 0;
+    int32_t  baseVertex = 0;
+};
+
+/**
+ * GPU-driven culling: a compute pass tests the bounds of every instance
+ * against the frustum and, optionally, a Hi-Z pyramid of the previous
+ * frame's depth, then writes one drawIndexedIndirect per mesh with the
+ * compacted list of its visible instances. The CPU issues one draw per mesh
+ * whatever the number of instances.
+ *
+ * Per frame:
+ *     culler.cull(encoder, view);            // before the render pass
+ *     ... begin the pass, set the pipeline and buffers ...
+ *     culler.draw(pass, 1);                  // visible lists at group 1
+ *     ... end the pass ...
+ *     culler.buildHiZ(encoder, depthTexture); // for the next frame
+ *
+ * The render pipeline layout must use visibleLayout() at the group given to
+ * draw(): a read-only storage array<u32> at binding 0, whose element
+ * instance_index is the index of the instance to draw. Each mesh has its
+ * own region of the list, selected with a dynamic offset, so draws do not
+ * depend on the IndirectFirstInstance feature.
+ *
+ * The occlusion test assumes a depth buffer cleared to 1 with the Less
+ * comparison; instances crossing the near plane are always kept.
+ */
+class GpuCuller
+{
+public:
+    struct View
+    {
+        std::array<float, 16> viewProj  = {};    // column-major
+        bool                  occlusion = false; // once buildHiZ() ran
+    };
+
+    GpuCuller(WGPUDevice device, PipelineRegistry& registry);
+    ~GpuCuller();
+
+    GpuCuller(const GpuCuller&)            = delete;
+    GpuCuller& operator=(const GpuCuller&) = delete;
+
+    // Replace the scene: instance i uses meshes[meshOf[i]], which must be
+    // in range. Buffers are reallocated: commands recorded before keep the
+    // previous ones.
+    void setScene(
+        WGPUQueue                          queue,
+        const std::vector<CullMesh>&       meshes,
+        const std::vector<InstanceBounds>& bounds,
+        const std::vector<uint32_t>&       meshOf);
+
+    // Update the bounds of instances [first, first + count)
+    void updateBounds(
+        WGPUQueue             queue,
+        uint32_t              first,
+        const InstanceBounds* bounds,
+        uint32_t              count);
+
+    // Record the culling passes; `timestamps` may time the cull pass
+    void cull(
+        WGPUCommandEncoder             encoder,
+        const View&                    view,
+        const WGPUPassTimestampWrites* timestamps = nullptr);
+
+    // Record one drawIndexedIndirect per mesh, with the visible list bound
+    // at `group`; the pipeline and the index buffer must be set
+    void draw(WGPURenderPassEncoder pass, uint32_t group) const;
+
+    // Reduce `depth` (a Depth32Float or Depth24Plus texture with the
+    // TextureBinding usage) into the pyramid used by occlusion culling
+    void buildHiZ(WGPUCommandEncoder encoder, WGPUTexture depth);
+
+    WGPUBindGroupLayout visibleLayout() const { return m_visibleLayout; }
+    // drawIndexedIndirect arguments, one per mesh, and the visible lists
+    WGPUBuffer indirectBuffer() const { return m_indirect; }
+    WGPUBuffer visibleBuffer() const { return m_visible; }
+
+    uint32_t instanceCount() const { return m_instanceCount; }
+    uint32_t meshCount() const { return uint32_t(m_meshes.size()); }
+    uint32_t hiZLevels() const { return uint32_t(m_hiZViews.size()); }
+
+private:
+    struct Mesh
+    {
+        CullMesh mesh;
+        uint32_t visibleOffset = 0; // first entry of its visible list
+        uint32_t capacity      = 0; // instances using it
+    };
+
+    WGPUBuffer createBuffer(
+        const char*     label,
+        WGPUBufferUsage usage,
+        uint64_t        size);
+    void releaseScene();
+    void releaseHiZ();
+    void createHiZ(uint32_t width, uint32_t height);
+    // One compute pass with a bind group made of `entries` at group 0
+    void dispatch(
+        WGPUCommandEncoder                     encoder,
+        WGPUComputePipeline                    pipeline,
+        const std::vector<WGPUBindGroupEntry>& entries,
+        uint32_t                               groupsX,
+        uint32_t                               groupsY,
+        const WGPUPassTimestampWrites*         timestamps = nullptr);
+
+    WGPUDevice        m_device = nullptr;
+    PipelineRegistry& m_registry;
+    uint32_t          m_offsetAlignment       = 256;
+    uint32_t          m_maxGroupsPerDimension = 65535;
+
+    std::vector<Mesh>   m_meshes;
+    uint32_t            m_instanceCount  = 0;
+    uint64_t            m_regionSize     = 0; // bytes bound per draw
+    WGPUBuffer          m_bounds         = nullptr;
+    WGPUBuffer          m_meshOf         = nullptr;
+    WGPUBuffer          m_visibleOffsets = nullptr; // per mesh
+    WGPUBuffer          m_initialArgs    = nullptr; // zero instance counts
+    WGPUBuffer          m_indirect       = nullptr;
+    WGPUBuffer          m_visible        = nullptr;
+    WGPUBindGroupLayout m_visibleLayout  = nullptr;
+    WGPUBindGroup       m_visibleGroup   = nullptr;
+
+    // Hi-Z pyramid, level 0 is half the depth resolution
+    WGPUTexture                  m_hiZ    = nullptr;
+    WGPUTextureView              m_hiZAll = nullptr;
+    std::vector<WGPUTextureView> m_hiZViews;
+    uint32_t                     m_hiZWidth  = 0;
+    uint32_t                     m_hiZHeight = 0;
+    bool                         m_hiZValid  = false;
+};
+
+#endif // GPU_CULLING_H
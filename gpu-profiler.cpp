@@ -0,0 +1,274 @@
+#include "gpu-profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace {
+
+// `text` as the contents of a JSON string
+std::string escapeJson(const std::string& text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            static const char kHex[] = "0123456789abcdef";
+            escaped += "\\u00";
+            escaped += kHex[c >> 4];
+            escaped += kHex[c & 0xf];
+        }
+        else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+GpuProfiler::CpuScope::CpuScope(GpuProfiler* profiler, std::string name) :
+        m_profiler(profiler), m_name(std::move(name)),
+        m_start(std::chrono::steady_clock::now())
+{
+}
+
+GpuProfiler::CpuScope::~CpuScope()
+{
+    auto toUs = [this](std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration<double, std::micro>(
+                   t - m_profiler->m_origin)
+            .count();
+    };
+    m_profiler->recordCpu(
+        std::move(m_name),
+        toUs(m_start),
+        toUs(std::chrono::steady_clock::now()));
+}
+
+GpuProfiler::GpuProfiler(
+    WGPUInstance instance,
+    WGPUDevice   device,
+    uint32_t     maxPassesPerFrame,
+    uint32_t     framesInFlight) :
+        m_maxPasses(maxPassesPerFrame),
+        // One more slot than frames in flight, so that resolve() finds a
+        // free one whenever the GPU keeps up
+        m_readbacks(instance, device, framesInFlight + 1),
+        m_origin(std::chrono::steady_clock::now())
+{
+    if (!wgpuDeviceHasFeature(device, WGPUFeatureName_TimestampQuery)) {
+        std::cout << "Timestamp queries are not supported, the profiler only "
+                     "records CPU scopes"
+                  << std::endl;
+        return;
+    }
+
+    WGPUQuerySetDescriptor querySetDesc = WGPU_QUERY_SET_DESCRIPTOR_INIT;
+    querySetDesc.label = {"Profiler timestamps", WGPU_STRLEN};
+    querySetDesc.type  = WGPUQueryType_Timestamp;
+    querySetDesc.count = 2 * m_maxPasses;
+    m_querySet         = wgpuDeviceCreateQuerySet(device, &querySetDesc);
+
+    // Queries are resolved into this buffer then copied into the readback
+    // ring within the same submission, so one buffer is enough
+    WGPUBufferDescriptor bufferDesc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    bufferDesc.label = {"Profiler resolve buffer", WGPU_STRLEN};
+    bufferDesc.usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc;
+    bufferDesc.size  = 2 * m_maxPasses * sizeof(uint64_t);
+    m_resolveBuffer  = wgpuDeviceCreateBuffer(device, &bufferDesc);
+
+    m_passWrites.reserve(m_maxPasses);
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    if (m_resolveBuffer) {
+        wgpuBufferRelease(m_resolveBuffer);
+    }
+    if (m_querySet) {
+        wgpuQuerySetRelease(m_querySet);
+    }
+}
+
+double GpuProfiler::nowUs() const
+{
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - m_origin)
+        .count();
+}
+
+void GpuProfiler::beginFrame()
+{
+    m_readbacks.poll();
+    ++m_frame;
+    m_passNames.clear();
+    m_passWrites.clear();
+    m_resolved = false;
+}
+
+const WGPUPassTimestampWrites* GpuProfiler::passTimestampWrites(
+    std::string name)
+{
+    if (!m_querySet || m_resolved || m_passWrites.size() >= m_maxPasses)
+        return nullptr;
+
+    uint32_t                index  = (uint32_t) m_passWrites.size();
+    WGPUPassTimestampWrites writes = {};
+    writes.querySet                = m_querySet;
+    writes.beginningOfPassWriteIndex = 2 * index;
+    writes.endOfPassWriteIndex       = 2 * index + 1;
+    m_passNames.push_back(std::move(name));
+    // Reserved in the constructor: pointers stay valid during the frame
+    m_passWrites.push_back(writes);
+    return &m_passWrites.back();
+}
+
+void GpuProfiler::resolve(WGPUCommandEncoder encoder)
+{
+    m_resolved = true;
+    if (m_passWrites.empty())
+        return;
+    if (!m_readbacks.hasFreeSlot()) {
+        // Rather than stalling on the oldest readback, skip this frame
+        ++m_droppedFrames;
+        return;
+    }
+
+    uint32_t queryCount = 2 * (uint32_t) m_passWrites.size();
+    wgpuCommandEncoderResolveQuerySet(
+        encoder, m_querySet, 0, queryCount, m_resolveBuffer, 0);
+
+    // The ring skips the callback of a failed mapping: the frames it left
+    // behind are older than those still in flight
+    while (m_pending.size() > m_readbacks.inFlight()) {
+        m_pending.pop_front();
+    }
+    m_pending.push_back({m_frame, m_passNames, 0});
+    m_readbacks.enqueueCopy(
+        encoder,
+        m_resolveBuffer,
+        0,
+        queryCount * sizeof(uint64_t),
+        [this, frame = m_frame](const void* data, uint64_t) {
+            // Callbacks come in submission order, minus the failed ones
+            while (m_pending.front().frame != frame) {
+                m_pending.pop_front();
+            }
+            recordGpu(
+                m_pending.front(), static_cast<const uint64_t*>(data));
+            m_pending.pop_front();
+        });
+}
+
+void GpuProfiler::onSubmitted()
+{
+    double submitUs = nowUs();
+    for (PendingFrame& frame : m_pending) {
+        if (frame.frame == m_frame) {
+            frame.submitUs = submitUs;
+        }
+    }
+    m_readbacks.onSubmitted();
+}
+
+void GpuProfiler::push(std::deque<double>& window, double value)
+{
+    window.push_back(value);
+    if (window.size() > windowFrames) {
+        window.pop_front();
+    }
+}
+
+void GpuProfiler::addEvent(TraceEvent event)
+{
+    if (m_events.size() < kMaxEvents) {
+        m_events.push_back(std::move(event));
+    }
+}
+
+void GpuProfiler::recordCpu(std::string name, double startUs, double endUs)
+{
+    push(m_rolling[name].cpuMs, (endUs - startUs) / 1000.0);
+    addEvent({std::move(name), false, startUs, endUs - startUs, m_frame});
+}
+
+void GpuProfiler::recordGpu(
+    const PendingFrame& frame,
+    const uint64_t*     timestamps)
+{
+    // GPU timestamps have their own origin. The GPU cannot start a frame
+    // before it is submitted, so the offset is the largest one that keeps
+    // every frame's first pass after its submission.
+    double firstBeginUs = timestamps[0] / 1000.0;
+    double offsetUs     = frame.submitUs - firstBeginUs;
+    if (!m_gpuCalibrated || offsetUs > m_gpuOffsetUs) {
+        m_gpuOffsetUs   = offsetUs;
+        m_gpuCalibrated = true;
+    }
+
+    for (size_t i = 0; i < frame.names.size(); ++i) {
+        uint64_t begin = timestamps[2 * i];
+        uint64_t end   = timestamps[2 * i + 1];
+        // Some implementations return 0 or out of order values when a pass
+        // is empty or the counter wraps
+        if (end < begin)
+            continue;
+        double durUs = (end - begin) / 1000.0;
+        push(m_rolling[frame.names[i]].gpuMs, durUs / 1000.0);
+        addEvent(
+            {frame.names[i],
+             true,
+             begin / 1000.0 + m_gpuOffsetUs,
+             durUs,
+             frame.frame});
+    }
+}
+
+std::vector<ScopeTiming> GpuProfiler::averages() const
+{
+    auto mean = [](const std::deque<double>& window) {
+        return window.empty() ?
+                   0.0 :
+                   std::accumulate(window.begin(), window.end(), 0.0) /
+                       window.size();
+    };
+    std::vector<ScopeTiming> timings;
+    for (const auto& [name, rolling] : m_rolling) {
+        timings.push_back(
+            {name,
+             mean(rolling.gpuMs),
+             mean(rolling.cpuMs),
+             std::max(rolling.gpuMs.size(), rolling.cpuMs.size())});
+    }
+    return timings;
+}
+
+bool GpuProfiler::writeChromeTrace(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+    file << "{\"traceEvents\": [\n"
+         << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1,"
+            " \"args\": {\"name\": \"CPU\"}},\n"
+         << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2,"
+            " \"args\": {\"name\": \"GPU\"}}";
+    for (const TraceEvent& event : m_events) {
+        file << ",\n{\"name\": \"" << escapeJson(event.name)
+             << "\", \"cat\": \"" << (event.gpu ? "gpu" : "cpu")
+             << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+             << (event.gpu ? 2 : 1) << ", \"ts\": " << event.startUs
+             << ", \"dur\": " << event.durUs
+             << ", \"args\": {\"frame\": " << event.frame << "}}";
+    }
+    file << "\n]}\n";
+    return true;
+}
@@ -0,0 +1,159 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "readback-ring.h"
+
+#include <webgpu/webgpu.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Rolling averages of one named scope over the last frames.
+ */
+struct ScopeTiming
+{
+    std::string name;
+    double      gpuMs   = 0; // 0 if the scope has no GPU interval
+    double      cpuMs   = 0; // 0 if the scope has no CPU interval
+    uint64_t    samples = 0;
+};
+
+/**
+ * Frame profiler pairing GPU pass intervals, measured with timestamp queries,
+ * with CPU scopes measured with steady_clock.
+ *
+ * Per frame:
+ *     profiler.beginFrame();
+ *     passDesc.timestampWrites = profiler.passTimestampWrites("Main pass");
+ *     { auto scope = profiler.cpuScope("Encode"); ... }
+ *     profiler.resolve(encoder);              // before finishing the encoder
+ *     queue.submit(...);
+ *     profiler.onSubmitted();
+ *
+ * Timestamps are read back through a ReadbackRing, a few frames late, and
+ * never block. Without the TimestampQuery feature only CPU scopes are
+ * recorded and passTimestampWrites() returns nullptr.
+ */
+class GpuProfiler
+{
+public:
+    class CpuScope
+    {
+        GpuProfiler*                          m_profiler = nullptr;
+        std::string                           m_name;
+        std::chrono::steady_clock::time_point m_start;
+
+    public:
+        CpuScope(GpuProfiler* profiler, std::string name);
+        ~CpuScope();
+
+        CpuScope(const CpuScope&)            = delete;
+        CpuScope& operator=(const CpuScope&) = delete;
+    };
+
+    GpuProfiler(
+        WGPUInstance instance,
+        WGPUDevice   device,
+        uint32_t     maxPassesPerFrame = 32,
+        uint32_t     framesInFlight    = 3);
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&)            = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // True if the device supports timestamp queries
+    bool hasGpuTimings() const { return m_querySet != nullptr; }
+
+    // Collect the timestamps that arrived since the previous frame
+    void beginFrame();
+
+    // Timestamp writes for a render or compute pass descriptor, or nullptr if
+    // GPU timings are unavailable or the frame has no query left. The
+    // pointer stays valid until the next beginFrame().
+    const WGPUPassTimestampWrites* passTimestampWrites(std::string name);
+
+    CpuScope cpuScope(std::string name)
+    {
+        return CpuScope(this, std::move(name));
+    }
+
+    // Resolve this frame's queries and queue their readback
+    void resolve(WGPUCommandEncoder encoder);
+
+    void onSubmitted();
+
+    // Rolling average per scope over the last `windowFrames` frames
+    std::vector<ScopeTiming> averages() const;
+
+    // Write all recorded intervals in the Chrome trace event format
+    // (chrome://tracing, Perfetto). Return false if the file can't be written.
+    bool writeChromeTrace(const std::string& path) const;
+
+    // Frames whose GPU timings were skipped because the ring was full
+    uint64_t droppedFrames() const { return m_droppedFrames; }
+
+    // See ReadbackRing::setEventThread()
+    void setEventThread(EventThread* events)
+    {
+        m_readbacks.setEventThread(events);
+    }
+
+    static constexpr uint32_t windowFrames = 60;
+
+private:
+    struct TraceEvent
+    {
+        std::string name;
+        bool        gpu     = false;
+        double      startUs = 0;
+        double      durUs   = 0;
+        uint64_t    frame   = 0;
+    };
+
+    struct PendingFrame
+    {
+        uint64_t                 frame = 0;
+        std::vector<std::string> names;
+        double                   submitUs = 0;
+    };
+
+    struct Rolling
+    {
+        std::deque<double> gpuMs;
+        std::deque<double> cpuMs;
+    };
+
+    double nowUs() const;
+    void   recordCpu(std::string name, double startUs, double endUs);
+    void   recordGpu(const PendingFrame& frame, const uint64_t* timestamps);
+    void   addEvent(TraceEvent event);
+    static void push(std::deque<double>& window, double value);
+
+    WGPUQuerySet m_querySet      = nullptr;
+    WGPUBuffer   m_resolveBuffer = nullptr;
+    uint32_t     m_maxPasses     = 0;
+    ReadbackRing m_readbacks;
+
+    uint64_t                             m_frame = 0;
+    std::vector<std::string>             m_passNames;
+    std::vector<WGPUPassTimestampWrites> m_passWrites;
+    std::deque<PendingFrame>             m_pending;
+    bool                                 m_resolved = false;
+
+    std::chrono::steady_clock::time_point m_origin;
+    // Added to GPU timestamps (ns) to place them on the CPU timeline (us)
+    double   m_gpuOffsetUs   = 0;
+    bool     m_gpuCalibrated = false;
+    uint64_t m_droppedFrames = 0;
+
+    std::map<std::string, Rolling> m_rolling;
+    std::vector<TraceEvent>        m_events;
+    static constexpr size_t        kMaxEvents = 1 << 20;
+};
+
+#endif // GPU_PROFILER_H
@@ -0,0 +1,241 @@
+#include "gpu-resources.h"
+
+#include <algorithm>
+
+namespace {
+
+void raiseTo(std::atomic<uint64_t>& peak, uint64_t value)
+{
+    uint64_t current = peak.load(std::memory_order_relaxed);
+    while (current < value &&
+           !peak.compare_exchange_weak(
+               current, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t bytesPerTexel(WGPUTextureFormat format)
+{
+    switch (format) {
+    case WGPUTextureFormat_R8Unorm:
+    case WGPUTextureFormat_Stencil8: return 1;
+    case WGPUTextureFormat_RG8Unorm:
+    case WGPUTextureFormat_R16Float:
+    case WGPUTextureFormat_Depth16Unorm: return 2;
+    case WGPUTextureFormat_RG16Float:
+    case WGPUTextureFormat_R32Float:
+    case WGPUTextureFormat_RGBA8Unorm:
+    case WGPUTextureFormat_RGBA8UnormSrgb:
+    case WGPUTextureFormat_BGRA8Unorm:
+    case WGPUTextureFormat_BGRA8UnormSrgb:
+    case WGPUTextureFormat_RGB10A2Unorm:
+    case WGPUTextureFormat_Depth24Plus:
+    case WGPUTextureFormat_Depth32Float: return 4;
+    case WGPUTextureFormat_Depth24PlusStencil8: return 5;
+    case WGPUTextureFormat_RG32Float:
+    case WGPUTextureFormat_RGBA16Float: return 8;
+    case WGPUTextureFormat_RGBA32Float: return 16;
+    default: return 4;
+    }
+}
+
+} // namespace
+
+const char* resourceCategoryName(ResourceCategory category)
+{
+    switch (category) {
+    case ResourceCategory::Geometry: return "geometry";
+    case ResourceCategory::Uniform: return "uniform";
+    case ResourceCategory::Storage: return "storage";
+    case ResourceCategory::Staging: return "staging";
+    case ResourceCategory::Texture: return "texture";
+    case ResourceCategory::RenderTarget: return "render_target";
+    default: return "other";
+    }
+}
+
+ResourceCategory categorizeBuffer(WGPUBufferUsage usage)
+{
+    if (usage & (WGPUBufferUsage_MapRead | WGPUBufferUsage_MapWrite))
+        return ResourceCategory::Staging;
+    if (usage & (WGPUBufferUsage_Vertex | WGPUBufferUsage_Index |
+                 WGPUBufferUsage_Indirect))
+        return ResourceCategory::Geometry;
+    if (usage & WGPUBufferUsage_Storage)
+        return ResourceCategory::Storage;
+    if (usage & WGPUBufferUsage_Uniform)
+        return ResourceCategory::Uniform;
+    return ResourceCategory::Other;
+}
+
+ResourceCategory categorizeTexture(WGPUTextureUsage usage)
+{
+    if (usage & WGPUTextureUsage_RenderAttachment)
+        return ResourceCategory::RenderTarget;
+    return ResourceCategory::Texture;
+}
+
+uint64_t estimateTextureBytes(const WGPUTextureDescriptor& desc)
+{
+    uint64_t width  = desc.size.width;
+    uint64_t height = desc.size.height;
+    uint64_t depth  = desc.size.depthOrArrayLayers;
+    bool     is3D   = desc.dimension == WGPUTextureDimension_3D;
+    uint64_t texels = 0;
+    for (uint32_t level = 0; level < std::max(desc.mipLevelCount, 1u);
+         ++level) {
+        texels += std::max<uint64_t>(width >> level, 1) *
+                  std::max<uint64_t>(height >> level, 1) *
+                  (is3D ? std::max<uint64_t>(depth >> level, 1) : depth);
+    }
+    return texels * bytesPerTexel(desc.format) *
+           std::max(desc.sampleCount, 1u);
+}
+
+void GpuMemoryTracker::onAllocated(ResourceCategory category, uint64_t bytes)
+{
+    Counters& counters = m_categories[size_t(category)];
+    raiseTo(counters.peakBytes, counters.bytes += bytes);
+    raiseTo(counters.peakLive, ++counters.live);
+    ++counters.allocations;
+    raiseTo(m_peakTotalBytes, m_totalBytes += bytes);
+}
+
+void GpuMemoryTracker::onReleased(ResourceCategory category, uint64_t bytes)
+{
+    Counters& counters = m_categories[size_t(category)];
+    counters.bytes -= bytes;
+    --counters.live;
+    m_totalBytes -= bytes;
+}
+
+GpuMemoryTracker::CategoryStats GpuMemoryTracker::stats(
+    ResourceCategory category) const
+{
+    const Counters& counters = m_categories[size_t(category)];
+    CategoryStats   stats;
+    stats.bytes       = counters.bytes;
+    stats.peakBytes   = counters.peakBytes;
+    stats.live        = counters.live;
+    stats.peakLive    = counters.peakLive;
+    stats.allocations = counters.allocations;
+    return stats;
+}
+
+void destroyGpuHandle(WGPUBuffer buffer)
+{
+    wgpuBufferDestroy(buffer);
+    wgpuBufferRelease(buffer);
+}
+
+void destroyGpuHandle(WGPUTexture texture)
+{
+    wgpuTextureDestroy(texture);
+    wgpuTextureRelease(texture);
+}
+
+void destroyGpuHandle(WGPUTextureView view)
+{
+    wgpuTextureViewRelease(view);
+}
+
+void destroyGpuHandle(WGPUBindGroup bindGroup)
+{
+    wgpuBindGroupRelease(bindGroup);
+}
+
+void destroyGpuHandle(WGPUSampler sampler)
+{
+    wgpuSamplerRelease(sampler);
+}
+
+DeferredReleaseQueue::DeferredReleaseQueue(WGPUInstance instance) :
+        m_instance(instance)
+{
+}
+
+DeferredReleaseQueue::~DeferredReleaseQueue()
+{
+    for (Batch& batch : m_batches) {
+        destroy(batch.resources);
+    }
+    destroy(m_current);
+}
+
+GpuBuffer DeferredReleaseQueue::createBuffer(
+    WGPUDevice                  device,
+    const WGPUBufferDescriptor& desc)
+{
+    return adopt(
+        wgpuDeviceCreateBuffer(device, &desc),
+        categorizeBuffer(desc.usage),
+        desc.size);
+}
+
+GpuTexture DeferredReleaseQueue::createTexture(
+    WGPUDevice                   device,
+    const WGPUTextureDescriptor& desc)
+{
+    return adopt(
+        wgpuDeviceCreateTexture(device, &desc),
+        categorizeTexture(desc.usage),
+        estimateTextureBytes(desc));
+}
+
+void DeferredReleaseQueue::retire(const Retired& retired)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_current.push_back(retired);
+    ++m_stats.retired;
+}
+
+void DeferredReleaseQueue::onSubmitted(WGPUQueue queue)
+{
+    Batch batch;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_current.empty())
+            return;
+        batch.resources.swap(m_current);
+        ++m_stats.batches;
+    }
+    batch.done = onSubmittedWorkDoneAsync(m_instance, queue);
+    m_batches.push_back(std::move(batch));
+}
+
+void DeferredReleaseQueue::collect()
+{
+    // Submissions complete in order
+    while (!m_batches.empty() && m_batches.front().done.wait(0)) {
+        destroy(m_batches.front().resources);
+        m_batches.pop_front();
+    }
+}
+
+void DeferredReleaseQueue::flush(WGPUQueue queue)
+{
+    onSubmitted(queue);
+    for (Batch& batch : m_batches) {
+        batch.done.wait();
+        destroy(batch.resources);
+    }
+    m_batches.clear();
+}
+
+void DeferredReleaseQueue::destroy(std::vector<Retired>& resources)
+{
+    for (const Retired& retired : resources) {
+        retired.destroy(retired.handle);
+        m_memory.onReleased(retired.category, retired.bytes);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.destroyed += resources.size();
+    resources.clear();
+}
+
+DeferredReleaseQueue::Stats DeferredReleaseQueue::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats   = m_stats;
+    stats.pending = stats.retired - stats.destroyed;
+    return stats;
+}
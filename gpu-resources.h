@@ -0,0 +1,275 @@
+#ifndef GPU_RESOURCES_H
+#define GPU_RESOURCES_H
+
+#include "webgpu-async.h"
+
+#include <webgpu/webgpu.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * What GPU memory is used for, as accounted by GpuMemoryTracker.
+ */
+enum class ResourceCategory : uint32_t {
+    Geometry,     // vertex, index and indirect buffers
+    Uniform,      // uniform buffers, including the frame ring
+    Storage,      // storage buffers
+    Staging,      // mappable upload and readback buffers
+    Texture,      // sampled and storage textures
+    RenderTarget, // render attachments
+    Other,
+    Count
+};
+
+constexpr size_t kResourceCategoryCount = size_t(ResourceCategory::Count);
+
+const char* resourceCategoryName(ResourceCategory category);
+
+ResourceCategory categorizeBuffer(WGPUBufferUsage usage);
+ResourceCategory categorizeTexture(WGPUTextureUsage usage);
+
+/**
+ * Approximate size of a texture, mip chain and samples included. Formats
+ * without a known texel size count as 4 bytes per texel.
+ */
+uint64_t estimateTextureBytes(const WGPUTextureDescriptor& desc);
+
+/**
+ * Bytes and objects alive per resource category, with their peaks. Safe to
+ * update from any thread.
+ */
+class GpuMemoryTracker
+{
+public:
+    struct CategoryStats
+    {
+        uint64_t bytes       = 0;
+        uint64_t peakBytes   = 0;
+        uint64_t live        = 0;
+        uint64_t peakLive    = 0;
+        uint64_t allocations = 0; // since creation
+    };
+
+    void onAllocated(ResourceCategory category, uint64_t bytes);
+    void onReleased(ResourceCategory category, uint64_t bytes);
+
+    CategoryStats stats(ResourceCategory category) const;
+    uint64_t      totalBytes() const { return m_totalBytes; }
+    uint64_t      peakTotalBytes() const { return m_peakTotalBytes; }
+
+private:
+    struct Counters
+    {
+        std::atomic<uint64_t> bytes       = 0;
+        std::atomic<uint64_t> peakBytes   = 0;
+        std::atomic<uint64_t> live        = 0;
+        std::atomic<uint64_t> peakLive    = 0;
+        std::atomic<uint64_t> allocations = 0;
+    };
+
+    std::array<Counters, kResourceCategoryCount> m_categories;
+    std::atomic<uint64_t>                        m_totalBytes     = 0;
+    std::atomic<uint64_t>                        m_peakTotalBytes = 0;
+};
+
+// What the deferred release does to each kind of handle: buffers and
+// textures are destroyed, which frees their memory right away, then
+// released
+void destroyGpuHandle(WGPUBuffer buffer);
+void destroyGpuHandle(WGPUTexture texture);
+void destroyGpuHandle(WGPUTextureView view);
+void destroyGpuHandle(WGPUBindGroup bindGroup);
+void destroyGpuHandle(WGPUSampler sampler);
+
+class DeferredReleaseQueue;
+
+/**
+ * Owning handle whose destruction is deferred by a DeferredReleaseQueue
+ * until the GPU can no longer use it. Move-only.
+ */
+template<typename Handle>
+class GpuResource
+{
+public:
+    GpuResource() = default;
+    ~GpuResource() { reset(); }
+
+    GpuResource(GpuResource&& other) noexcept { *this = std::move(other); }
+    GpuResource& operator=(GpuResource&& other) noexcept;
+
+    GpuResource(const GpuResource&)            = delete;
+    GpuResource& operator=(const GpuResource&) = delete;
+
+    Handle           get() const { return m_handle; }
+    explicit         operator bool() const { return m_handle != nullptr; }
+    ResourceCategory category() const { return m_category; }
+    uint64_t         bytes() const { return m_bytes; }
+
+    // Hand the handle to the release queue
+    void reset();
+
+private:
+    friend class DeferredReleaseQueue;
+
+    Handle                m_handle   = nullptr;
+    DeferredReleaseQueue* m_owner    = nullptr;
+    ResourceCategory      m_category = ResourceCategory::Other;
+    uint64_t              m_bytes    = 0;
+};
+
+using GpuBuffer      = GpuResource<WGPUBuffer>;
+using GpuTexture     = GpuResource<WGPUTexture>;
+using GpuTextureView = GpuResource<WGPUTextureView>;
+using GpuBindGroup   = GpuResource<WGPUBindGroup>;
+using GpuSampler     = GpuResource<WGPUSampler>;
+
+/**
+ * Destroys resources once the submissions that may use them are done.
+ *
+ * A GpuResource dropped during frame k joins the batch closed by the next
+ * onSubmitted(), and is destroyed when that submission completes, hence
+ * after every earlier submission too. Commands recorded but not submitted
+ * yet can thus still reference it, which destroying right away would make
+ * invalid. Per frame:
+ *     resources.collect();         // destroys what the GPU is done with
+ *     ... record, drop GpuResources ...
+ *     queue.submit(...);
+ *     resources.onSubmitted(queue);
+ *
+ * Resources may be dropped from any thread; the other calls belong to the
+ * thread that submits.
+ */
+class DeferredReleaseQueue
+{
+public:
+    struct Stats
+    {
+        uint64_t retired   = 0; // handed over by GpuResource
+        uint64_t destroyed = 0;
+        uint64_t pending   = 0; // waiting for a submission
+        uint64_t batches   = 0; // waited for with onSubmittedWorkDone
+    };
+
+    explicit DeferredReleaseQueue(WGPUInstance instance);
+    // Destroys everything pending: flush() first if the GPU may still use
+    // the resources
+    ~DeferredReleaseQueue();
+
+    DeferredReleaseQueue(const DeferredReleaseQueue&)            = delete;
+    DeferredReleaseQueue& operator=(const DeferredReleaseQueue&) = delete;
+
+    // Create a tracked buffer or texture; null if creation failed
+    GpuBuffer createBuffer(
+        WGPUDevice                  device,
+        const WGPUBufferDescriptor& desc);
+    GpuTexture createTexture(
+        WGPUDevice                   device,
+        const WGPUTextureDescriptor& desc);
+
+    // Take ownership of an existing handle
+    template<typename Handle>
+    GpuResource<Handle> adopt(
+        Handle           handle,
+        ResourceCategory category = ResourceCategory::Other,
+        uint64_t         bytes    = 0);
+
+    void onSubmitted(WGPUQueue queue);
+
+    // Destroy the batches whose submission is done, without waiting
+    void collect();
+
+    // Wait for the GPU and destroy everything retired so far
+    void flush(WGPUQueue queue);
+
+    GpuMemoryTracker&       memory() { return m_memory; }
+    const GpuMemoryTracker& memory() const { return m_memory; }
+
+    Stats stats() const;
+
+private:
+    template<typename Handle>
+    friend class GpuResource;
+
+    using DestroyFunction = void (*)(void*);
+
+    struct Retired
+    {
+        void*            handle   = nullptr;
+        DestroyFunction  destroy  = nullptr;
+        ResourceCategory category = ResourceCategory::Other;
+        uint64_t         bytes    = 0;
+    };
+
+    struct Batch
+    {
+        Future<AsyncStatus>  done;
+        std::vector<Retired> resources;
+    };
+
+    void retire(const Retired& retired);
+    void destroy(std::vector<Retired>& resources);
+
+    WGPUInstance      m_instance = nullptr;
+    GpuMemoryTracker  m_memory;
+    std::deque<Batch> m_batches;
+
+    mutable std::mutex   m_mutex; // guards m_current and m_stats
+    std::vector<Retired> m_current;
+    Stats                m_stats;
+};
+
+template<typename Handle>
+GpuResource<Handle>& GpuResource<Handle>::operator=(
+    GpuResource&& other) noexcept
+{
+    if (this != &other) {
+        reset();
+        m_handle   = std::exchange(other.m_handle, nullptr);
+        m_owner    = std::exchange(other.m_owner, nullptr);
+        m_category = other.m_category;
+        m_bytes    = other.m_bytes;
+    }
+    return *this;
+}
+
+template<typename Handle>
+void GpuResource<Handle>::reset()
+{
+    if (!m_handle)
+        return;
+    DeferredReleaseQueue::Retired retired;
+    retired.handle  = m_handle;
+    retired.destroy = [](void* handle) {
+        destroyGpuHandle(static_cast<Handle>(handle));
+    };
+    retired.category = m_category;
+    retired.bytes    = m_bytes;
+    m_owner->retire(retired);
+    m_handle = nullptr;
+    m_owner  = nullptr;
+}
+
+template<typename Handle>
+GpuResource<Handle> DeferredReleaseQueue::adopt(
+    Handle           handle,
+    ResourceCategory category,
+    uint64_t         bytes)
+{
+    GpuResource<Handle> resource;
+    if (handle) {
+        resource.m_handle   = handle;
+        resource.m_owner    = this;
+        resource.m_category = category;
+        resource.m_bytes    = bytes;
+        m_memory.onAllocated(category, bytes);
+    }
+    return resource;
+}
+
+#endif // GPU_RESOURCES_H
@@ -0,0 +1,54 @@
+#ifndef HASHING_H
+#define HASHING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * Incremental 64-bit FNV-1a hasher, used to key caches by the content of
+ * descriptors and sources.
+ */
+class Hasher
+{
+    uint64_t m_state = 14695981039346656037ull;
+
+public:
+    Hasher& addBytes(const void* data, size_t size)
+    {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            m_state ^= bytes[i];
+            m_state *= 1099511628211ull;
+        }
+        return *this;
+    }
+
+    // Scalars and enums only: structs may contain uninitialized padding
+    template<typename T>
+        requires std::is_arithmetic_v<T> || std::is_enum_v<T> ||
+                 std::is_pointer_v<T>
+    Hasher& add(T value)
+    {
+        return addBytes(&value, sizeof(value));
+    }
+
+    Hasher& add(std::string_view text)
+    {
+        add(text.size());
+        return addBytes(text.data(), text.size());
+    }
+
+    uint64_t value() const { return m_state; }
+};
+
+/**
+ * Hash a block of bytes in one call.
+ */
+inline uint64_t hashBytes(const void* data, size_t size)
+{
+    return Hasher().addBytes(data, size).value();
+}
+
+#endif // HASHING_H
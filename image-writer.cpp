@@ -0,0 +1,174 @@
+#include "image-writer.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+// Largest payload of a stored deflate block
+constexpr size_t kStoredBlockSize = 65535;
+
+const std::array<uint32_t, 256>& crcTable()
+{
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> result;
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            result[n] = c;
+        }
+        return result;
+    }();
+    return table;
+}
+
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    const std::array<uint32_t, 256>& table = crcTable();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t adler32(const uint8_t* data, size_t size)
+{
+    // 5552 bytes is the most that can be summed before the modulo without
+    // overflowing 32 bits
+    uint32_t a = 1;
+    uint32_t b = 0;
+    while (size > 0) {
+        size_t block = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < block; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back(uint8_t(value >> 24));
+    out.push_back(uint8_t(value >> 16));
+    out.push_back(uint8_t(value >> 8));
+    out.push_back(uint8_t(value));
+}
+
+void writeChunk(
+    std::ofstream&              file,
+    const char*                 type,
+    const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> header;
+    putBigEndian(header, uint32_t(data.size()));
+    header.insert(header.end(), type, type + 4);
+
+    uint32_t crc = crc32(0, header.data() + 4, 4);
+    crc          = crc32(crc, data.data(), data.size());
+    std::vector<uint8_t> footer;
+    putBigEndian(footer, crc);
+
+    file.write((const char*) header.data(), header.size());
+    file.write((const char*) data.data(), data.size());
+    file.write((const char*) footer.data(), footer.size());
+}
+
+} // namespace
+
+bool writePng(
+    const std::filesystem::path& path,
+    const uint8_t*               pixels,
+    uint32_t                     width,
+    uint32_t                     height,
+    uint32_t                     rowPitch,
+    bool                         bgra)
+{
+    // Scanlines, each preceded by its filter type (0, none)
+    size_t               rowSize = size_t(width) * 4;
+    std::vector<uint8_t> scanlines(height * (rowSize + 1));
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t*       out = &scanlines[y * (rowSize + 1)];
+        const uint8_t* in  = pixels + size_t(y) * rowPitch;
+        *out++             = 0;
+        if (!bgra) {
+            std::copy(in, in + rowSize, out);
+            continue;
+        }
+        for (uint32_t x = 0; x < width; ++x, in += 4, out += 4) {
+            out[0] = in[2];
+            out[1] = in[1];
+            out[2] = in[0];
+            out[3] = in[3];
+        }
+    }
+
+    // zlib stream of stored deflate blocks
+    std::vector<uint8_t> idat = {0x78, 0x01};
+    idat.reserve(
+        scanlines.size() + scanlines.size() / kStoredBlockSize * 5 + 16);
+    size_t offset = 0;
+    do {
+        size_t  size = std::min(kStoredBlockSize, scanlines.size() - offset);
+        bool    last = offset + size == scanlines.size();
+        uint8_t length[4] = {
+            uint8_t(size), uint8_t(size >> 8),
+            uint8_t(~size), uint8_t(~size >> 8)};
+        idat.push_back(last ? 1 : 0);
+        idat.insert(idat.end(), length, length + 4);
+        idat.insert(
+            idat.end(),
+            scanlines.begin() + offset,
+            scanlines.begin() + offset + size);
+        offset += size;
+    } while (offset < scanlines.size());
+    putBigEndian(idat, adler32(scanlines.data(), scanlines.size()));
+
+    std::vector<uint8_t> ihdr;
+    putBigEndian(ihdr, width);
+    putBigEndian(ihdr, height);
+    ihdr.insert(ihdr.end(), {8, 6, 0, 0, 0}); // 8-bit RGBA, no interlace
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write((const char*) signature, sizeof(signature));
+    writeChunk(file, "IHDR", ihdr);
+    writeChunk(file, "IDAT", idat);
+    writeChunk(file, "IEND", {});
+    return bool(file);
+}
+
+std::string framePath(const std::string& pattern, uint64_t index)
+{
+    std::string number = std::to_string(index);
+    size_t      end    = pattern.find_last_of('#');
+    if (end == std::string::npos) {
+        size_t dot   = pattern.find_last_of('.');
+        size_t slash = pattern.find_last_of('/');
+        if (dot == std::string::npos ||
+            (slash != std::string::npos && slash > dot)) {
+            dot = pattern.size();
+        }
+        return pattern.substr(0, dot) + number + pattern.substr(dot);
+    }
+    size_t begin = pattern.find_last_not_of('#', end);
+    begin        = begin == std::string::npos ? 0 : begin + 1;
+    size_t width = end + 1 - begin;
+    if (number.size() < width) {
+        number.insert(0, width - number.size(), '0');
+    }
+    return pattern.substr(0, begin) + number + pattern.substr(end + 1);
+}
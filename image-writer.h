@@ -0,0 +1,29 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/**
+ * Write 8-bit RGBA (or BGRA, with `bgra`) pixels as a PNG. Rows start
+ * `rowPitch` bytes apart, so the padded rows of a texture readback are
+ * written as they are. The image data is stored without compression: the
+ * encoding costs a copy and two checksums, no more.
+ */
+bool writePng(
+    const std::filesystem::path& path,
+    const uint8_t*               pixels,
+    uint32_t                     width,
+    uint32_t                     height,
+    uint32_t                     rowPitch,
+    bool                         bgra = false);
+
+/**
+ * `pattern` with its last run of '#' replaced by `index`, zero-padded to
+ * the length of the run: "out/frame-####.png" gives "out/frame-0042.png".
+ * Without '#', the index is inserted before the extension.
+ */
+std::string framePath(const std::string& pattern, uint64_t index);
+
+#endif // IMAGE_WRITER_H
@@ -0,0 +1,498 @@
+#include "instance-store.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define INSTANCE_STORE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Functions using AVX2 intrinsics in a translation unit compiled for the
+// baseline instruction set; they only run when the CPU supports them
+#if defined(INSTANCE_STORE_X86) && defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace {
+
+// The component arrays, read by the kernels
+struct Columns
+{
+    const float* px;
+    const float* py;
+    const float* pz;
+    const float* qx;
+    const float* qy;
+    const float* qz;
+    const float* qw;
+    const float* sx;
+    const float* sy;
+    const float* sz;
+    const float* radius;
+};
+
+// Compose instances [begin, end): the rotation matrix of the quaternion,
+// its columns scaled, translation in w; the sphere is centered on the
+// position and its radius scaled by the largest scale
+void composeScalar(
+    const Columns&     c,
+    uint32_t           begin,
+    uint32_t           end,
+    InstanceTransform* transforms,
+    InstanceBounds*    bounds)
+{
+    for (uint32_t i = begin; i < end; ++i) {
+        float x  = c.qx[i], y = c.qy[i], z = c.qz[i], w = c.qw[i];
+        float sx = c.sx[i], sy = c.sy[i], sz = c.sz[i];
+
+        std::array<wgsl::vec4f, 3>& rows = transforms[i].rows;
+        rows[0] = {{(1 - 2 * (y * y + z * z)) * sx,
+                    2 * (x * y - w * z) * sy,
+                    2 * (x * z + w * y) * sz,
+                    c.px[i]}};
+        rows[1] = {{2 * (x * y + w * z) * sx,
+                    (1 - 2 * (x * x + z * z)) * sy,
+                    2 * (y * z - w * x) * sz,
+                    c.py[i]}};
+        rows[2] = {{2 * (x * z - w * y) * sx,
+                    2 * (y * z + w * x) * sy,
+                    (1 - 2 * (x * x + y * y)) * sz,
+                    c.pz[i]}};
+
+        float scale = std::max({std::abs(sx), std::abs(sy), std::abs(sz)});
+        bounds[i]   = {{c.px[i], c.py[i], c.pz[i]}, c.radius[i] * scale};
+    }
+}
+
+#ifdef INSTANCE_STORE_X86
+
+void composeSse(
+    const Columns&     c,
+    uint32_t           begin,
+    uint32_t           end,
+    InstanceTransform* transforms,
+    InstanceBounds*    bounds)
+{
+    const __m128 one     = _mm_set1_ps(1);
+    const __m128 two     = _mm_set1_ps(2);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x  = _mm_loadu_ps(c.qx + i);
+        __m128 y  = _mm_loadu_ps(c.qy + i);
+        __m128 z  = _mm_loadu_ps(c.qz + i);
+        __m128 w  = _mm_loadu_ps(c.qw + i);
+        __m128 sx = _mm_loadu_ps(c.sx + i);
+        __m128 sy = _mm_loadu_ps(c.sy + i);
+        __m128 sz = _mm_loadu_ps(c.sz + i);
+        __m128 px = _mm_loadu_ps(c.px + i);
+        __m128 py = _mm_loadu_ps(c.py + i);
+        __m128 pz = _mm_loadu_ps(c.pz + i);
+
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y);
+        __m128 zz = _mm_mul_ps(z, z), xy = _mm_mul_ps(x, y);
+        __m128 xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y);
+        __m128 wz = _mm_mul_ps(w, z);
+
+        // One register per matrix element, lane k for instance i + k
+        __m128 m00 = _mm_mul_ps(
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+        __m128 m01 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+        __m128 m02 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+        __m128 m10 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+        __m128 m11 = _mm_mul_ps(
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+        __m128 m12 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+        __m128 m20 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+        __m128 m21 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+        __m128 m22 = _mm_mul_ps(
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+
+        __m128 scale  = _mm_max_ps(
+            _mm_and_ps(sx, absMask),
+            _mm_max_ps(_mm_and_ps(sy, absMask), _mm_and_ps(sz, absMask)));
+        __m128 radius = _mm_mul_ps(_mm_loadu_ps(c.radius + i), scale);
+
+        // Transposed, each register holds a row of one instance
+        _MM_TRANSPOSE4_PS(m00, m01, m02, px);
+        _MM_TRANSPOSE4_PS(m10, m11, m12, py);
+        _MM_TRANSPOSE4_PS(m20, m21, m22, pz);
+        __m128 cx = _mm_loadu_ps(c.px + i);
+        __m128 cy = _mm_loadu_ps(c.py + i);
+        __m128 cz = _mm_loadu_ps(c.pz + i);
+        _MM_TRANSPOSE4_PS(cx, cy, cz, radius);
+
+        // Four transforms, then four spheres, are contiguous
+        float* out = reinterpret_cast<float*>(transforms + i);
+        _mm_store_ps(out + 0, m00);
+        _mm_store_ps(out + 4, m10);
+        _mm_store_ps(out + 8, m20);
+        _mm_store_ps(out + 12, m01);
+        _mm_store_ps(out + 16, m11);
+        _mm_store_ps(out + 20, m21);
+        _mm_store_ps(out + 24, m02);
+        _mm_store_ps(out + 28, m12);
+        _mm_store_ps(out + 32, m22);
+        _mm_store_ps(out + 36, px);
+        _mm_store_ps(out + 40, py);
+        _mm_store_ps(out + 44, pz);
+
+        float* sphere = reinterpret_cast<float*>(bounds + i);
+        _mm_storeu_ps(sphere + 0, cx);
+        _mm_storeu_ps(sphere + 4, cy);
+        _mm_storeu_ps(sphere + 8, cz);
+        _mm_storeu_ps(sphere + 12, radius);
+    }
+    composeScalar(c, i, end, transforms, bounds);
+}
+
+// _MM_TRANSPOSE4_PS within each 128-bit half: afterwards the low halves
+// hold instances 0-3 and the high halves instances 4-7
+TARGET_AVX2 inline void transpose4x2(__m256& a, __m256& b, __m256& c, __m256& d)
+{
+    __m256 t0 = _mm256_unpacklo_ps(a, b);
+    __m256 t1 = _mm256_unpackhi_ps(a, b);
+    __m256 t2 = _mm256_unpacklo_ps(c, d);
+    __m256 t3 = _mm256_unpackhi_ps(c, d);
+    a         = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    b         = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    c         = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    d         = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+// Store the low half of a transposed register to `low`, the high half to
+// `high`
+TARGET_AVX2 inline void storeRow(float* low, float* high, __m256 row)
+{
+    _mm_store_ps(low, _mm256_castps256_ps128(row));
+    _mm_store_ps(high, _mm256_extractf128_ps(row, 1));
+}
+
+TARGET_AVX2 void composeAvx2(
+    const Columns&     c,
+    uint32_t           begin,
+    uint32_t           end,
+    InstanceTransform* transforms,
+    InstanceBounds*    bounds)
+{
+    const __m256 one     = _mm256_set1_ps(1);
+    const __m256 two     = _mm256_set1_ps(2);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x  = _mm256_loadu_ps(c.qx + i);
+        __m256 y  = _mm256_loadu_ps(c.qy + i);
+        __m256 z  = _mm256_loadu_ps(c.qz + i);
+        __m256 w  = _mm256_loadu_ps(c.qw + i);
+        __m256 sx = _mm256_loadu_ps(c.sx + i);
+        __m256 sy = _mm256_loadu_ps(c.sy + i);
+        __m256 sz = _mm256_loadu_ps(c.sz + i);
+        __m256 px = _mm256_loadu_ps(c.px + i);
+        __m256 py = _mm256_loadu_ps(c.py + i);
+        __m256 pz = _mm256_loadu_ps(c.pz + i);
+
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y);
+        __m256 zz = _mm256_mul_ps(z, z), xy = _mm256_mul_ps(x, y);
+        __m256 xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y);
+        __m256 wz = _mm256_mul_ps(w, z);
+
+        __m256 m00 = _mm256_mul_ps(
+            _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx);
+        __m256 m01 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+        __m256 m02 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+        __m256 m10 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+        __m256 m11 = _mm256_mul_ps(
+            _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy);
+        __m256 m12 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+        __m256 m20 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+        __m256 m21 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+        __m256 m22 = _mm256_mul_ps(
+            _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz);
+
+        __m256 scale  = _mm256_max_ps(
+            _mm256_and_ps(sx, absMask),
+            _mm256_max_ps(
+                _mm256_and_ps(sy, absMask), _mm256_and_ps(sz, absMask)));
+        __m256 radius = _mm256_mul_ps(_mm256_loadu_ps(c.radius + i), scale);
+        __m256 cx     = px;
+        __m256 cy     = py;
+        __m256 cz     = pz;
+
+        transpose4x2(m00, m01, m02, px);
+        transpose4x2(m10, m11, m12, py);
+        transpose4x2(m20, m21, m22, pz);
+        transpose4x2(cx, cy, cz, radius);
+
+        const __m256 rows[4][3] = {
+            {m00, m10, m20}, {m01, m11, m21}, {m02, m12, m22}, {px, py, pz}};
+        const __m256 spheres[4] = {cx, cy, cz, radius};
+        for (uint32_t k = 0; k < 4; ++k) {
+            InstanceTransform& low  = transforms[i + k];
+            InstanceTransform& high = transforms[i + k + 4];
+            for (uint32_t r = 0; r < 3; ++r) {
+                storeRow(low.rows[r].data, high.rows[r].data, rows[k][r]);
+            }
+            _mm_storeu_ps(
+                reinterpret_cast<float*>(bounds + i + k),
+                _mm256_castps256_ps128(spheres[k]));
+            _mm_storeu_ps(
+                reinterpret_cast<float*>(bounds + i + k + 4),
+                _mm256_extractf128_ps(spheres[k], 1));
+        }
+    }
+    composeScalar(c, i, end, transforms, bounds);
+}
+
+bool cpuSupportsAvx2()
+{
+#ifdef _MSC_VER
+    // AVX2 flag, and the OS saving the AVX registers
+    int info[4] = {};
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    __cpuidex(info, 7, 0);
+    return osxsave && (info[1] & (1 << 5)) != 0 &&
+           (_xgetbv(0) & 0x6) == 0x6;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // INSTANCE_STORE_X86
+
+} // namespace
+
+const char* simdLevelName(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::Scalar: return "scalar";
+    case SimdLevel::Sse: return "sse";
+    case SimdLevel::Avx2: return "avx2";
+    }
+    return "unknown";
+}
+
+SimdLevel bestSimdLevel()
+{
+#ifdef INSTANCE_STORE_X86
+    // SSE2 is part of x86-64
+    static const SimdLevel level =
+        cpuSupportsAvx2() ? SimdLevel::Avx2 : SimdLevel::Sse;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+InstanceStore::InstanceStore(WGPUDevice device, uint32_t capacity) :
+        m_device(device), m_simd(bestSimdLevel())
+{
+    for (Column& column : m_columns) {
+        column.reserve(capacity);
+    }
+    createBuffers(std::max(capacity, kDirtyBlock));
+}
+
+InstanceStore::~InstanceStore()
+{
+    wgpuBufferRelease(m_transformBuffer);
+    wgpuBufferRelease(m_boundsBuffer);
+}
+
+void InstanceStore::createBuffers(uint32_t capacity)
+{
+    if (m_transformBuffer) {
+        // Growing: draws recorded with the smaller buffers still own them
+        wgpuBufferRelease(m_transformBuffer);
+        wgpuBufferRelease(m_boundsBuffer);
+    }
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    desc.usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst;
+    desc.label = {"Instance transforms", WGPU_STRLEN};
+    desc.size  = uint64_t(capacity) * sizeof(InstanceTransform);
+    m_transformBuffer = wgpuDeviceCreateBuffer(m_device, &desc);
+    desc.label        = {"Instance bounds", WGPU_STRLEN};
+    desc.size         = uint64_t(capacity) * sizeof(InstanceBounds);
+    m_boundsBuffer    = wgpuDeviceCreateBuffer(m_device, &desc);
+    m_bufferCapacity  = capacity;
+    ++m_generation;
+}
+
+uint32_t InstanceStore::add(const InstanceState& state)
+{
+    const float values[] = {
+        state.position[0],
+        state.position[1],
+        state.position[2],
+        state.rotation[0],
+        state.rotation[1],
+        state.rotation[2],
+        state.rotation[3],
+        state.scale[0],
+        state.scale[1],
+        state.scale[2],
+        state.radius};
+    static_assert(std::size(values) == size_t(InstanceColumn::Count));
+    for (size_t i = 0; i < m_columns.size(); ++i) {
+        m_columns[i].push_back(values[i]);
+    }
+    m_transforms.emplace_back();
+    m_bounds.emplace_back();
+    markDirty(m_size, 1);
+    return m_size++;
+}
+
+void InstanceStore::setPosition(
+    uint32_t                    index,
+    const std::array<float, 3>& position)
+{
+    for (uint32_t i = 0; i < 3; ++i) {
+        m_columns[size_t(InstanceColumn::PositionX) + i][index] = position[i];
+    }
+    markDirty(index, 1);
+}
+
+void InstanceStore::setRotation(
+    uint32_t                    index,
+    const std::array<float, 4>& rotation)
+{
+    for (uint32_t i = 0; i < 4; ++i) {
+        m_columns[size_t(InstanceColumn::RotationX) + i][index] = rotation[i];
+    }
+    markDirty(index, 1);
+}
+
+void InstanceStore::setScale(
+    uint32_t                    index,
+    const std::array<float, 3>& scale)
+{
+    for (uint32_t i = 0; i < 3; ++i) {
+        m_columns[size_t(InstanceColumn::ScaleX) + i][index] = scale[i];
+    }
+    markDirty(index, 1);
+}
+
+float* InstanceStore::column(InstanceColumn column)
+{
+    return m_columns[size_t(column)].data();
+}
+
+const float* InstanceStore::column(InstanceColumn column) const
+{
+    return m_columns[size_t(column)].data();
+}
+
+void InstanceStore::markDirty(uint32_t first, uint32_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    uint32_t last = (first + count - 1) / kDirtyBlock;
+    if (m_dirtyBlocks.size() * 64 <= last) {
+        m_dirtyBlocks.resize(last / 64 + 1, 0);
+    }
+    for (uint32_t block = first / kDirtyBlock; block <= last; ++block) {
+        m_dirtyBlocks[block / 64] |= uint64_t(1) << (block % 64);
+    }
+}
+
+void InstanceStore::update(WGPUQueue queue)
+{
+    m_updatedRanges.clear();
+    if (m_size > m_bufferCapacity) {
+        createBuffers(std::max(m_size, m_bufferCapacity * 2));
+        markDirty(0, m_size);
+    }
+
+    // Runs of dirty blocks, clamped to the instances
+    uint32_t blockCount = (m_size + kDirtyBlock - 1) / kDirtyBlock;
+    for (uint32_t block = 0; block < blockCount;) {
+        if (!(m_dirtyBlocks[block / 64] >> (block % 64) & 1)) {
+            ++block;
+            continue;
+        }
+        uint32_t first = block;
+        while (block < blockCount &&
+               (m_dirtyBlocks[block / 64] >> (block % 64) & 1)) {
+            ++block;
+        }
+        uint32_t begin = first * kDirtyBlock;
+        uint32_t end   = std::min(block * kDirtyBlock, m_size);
+        m_updatedRanges.push_back({begin, end - begin});
+    }
+    std::fill(m_dirtyBlocks.begin(), m_dirtyBlocks.end(), 0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (const InstanceRange& range : m_updatedRanges) {
+        compose(range.first, range.count);
+    }
+    m_stats.composeMs += std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+    for (const InstanceRange& range : m_updatedRanges) {
+        uint64_t transformSize = range.count * sizeof(InstanceTransform);
+        uint64_t boundsSize    = range.count * sizeof(InstanceBounds);
+        wgpuQueueWriteBuffer(
+            queue,
+            m_transformBuffer,
+            range.first * sizeof(InstanceTransform),
+            &m_transforms[range.first],
+            transformSize);
+        wgpuQueueWriteBuffer(
+            queue,
+            m_boundsBuffer,
+            range.first * sizeof(InstanceBounds),
+            &m_bounds[range.first],
+            boundsSize);
+        m_stats.updated += range.count;
+        m_stats.bytes += transformSize + boundsSize;
+        ++m_stats.ranges;
+    }
+}
+
+void InstanceStore::compose(uint32_t first, uint32_t count)
+{
+    Columns columns = {
+        column(InstanceColumn::PositionX),
+        column(InstanceColumn::PositionY),
+        column(InstanceColumn::PositionZ),
+        column(InstanceColumn::RotationX),
+        column(InstanceColumn::RotationY),
+        column(InstanceColumn::RotationZ),
+        column(InstanceColumn::RotationW),
+        column(InstanceColumn::ScaleX),
+        column(InstanceColumn::ScaleY),
+        column(InstanceColumn::ScaleZ),
+        column(InstanceColumn::Radius)};
+
+    auto kernel = composeScalar;
+#ifdef INSTANCE_STORE_X86
+    if (m_simd == SimdLevel::Avx2 && bestSimdLevel() == SimdLevel::Avx2) {
+        kernel = composeAvx2;
+    }
+    else if (m_simd != SimdLevel::Scalar) {
+        kernel = composeSse;
+    }
+#endif
+    kernel(
+        columns, first, first + count, m_transforms.data(), m_bounds.data());
+}
@@ -0,0 +1,207 @@
+#ifndef INSTANCE_STORE_H
+#define INSTANCE_STORE_H
+
+#include "gpu-culling.h"
+#include "wgsl-layout.h"
+
+#include <webgpu/webgpu.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/**
+ * Allocator of storage aligned to `Alignment` bytes, for SIMD loads.
+ */
+template<typename T, size_t Alignment>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(
+            ::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* pointer, size_t)
+    {
+        ::operator delete(pointer, std::align_val_t(Alignment));
+    }
+
+    bool operator==(const AlignedAllocator&) const = default;
+};
+
+/**
+ * Object-to-world transform of an instance, as laid out on the GPU: the
+ * first three rows of the matrix, translation in w.
+ *     let world = vec3f(dot(t.rows[0], p), dot(t.rows[1], p),
+ *                       dot(t.rows[2], p)); // p = vec4f(position, 1.0)
+ */
+struct InstanceTransform
+{
+    std::array<wgsl::vec4f, 3> rows;
+};
+
+WGSL_STRUCT(InstanceTransform, rows);
+static_assert(
+    wgslLayoutMatches<InstanceTransform, WgslAddressSpace::Storage>());
+
+/**
+ * The SIMD kernels of an InstanceStore: the best one the CPU supports is
+ * used unless another is forced.
+ */
+enum class SimdLevel { Scalar, Sse, Avx2 };
+
+const char* simdLevelName(SimdLevel level);
+SimdLevel   bestSimdLevel();
+
+/**
+ * Initial state of an instance added to an InstanceStore.
+ */
+struct InstanceState
+{
+    std::array<float, 3> position = {0, 0, 0};
+    std::array<float, 4> rotation = {0, 0, 0, 1}; // unit quaternion xyzw
+    std::array<float, 3> scale    = {1, 1, 1};
+    float                radius   = 1; // of the bounding sphere, unscaled
+};
+
+/**
+ * Instances [first, first + count).
+ */
+struct InstanceRange
+{
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+/**
+ * The components of an instance, see InstanceStore::column().
+ */
+enum class InstanceColumn : uint32_t {
+    PositionX,
+    PositionY,
+    PositionZ,
+    RotationX,
+    RotationY,
+    RotationZ,
+    RotationW,
+    ScaleX,
+    ScaleY,
+    ScaleZ,
+    Radius,
+    Count
+};
+
+/**
+ * Dynamic instances stored as a structure of arrays, one aligned array per
+ * component, so that transforms are composed several instances at a time
+ * with SSE or AVX2. Per frame:
+ *     store.column(InstanceColumn::PositionX)[i] = ...; // any number
+ *     store.markDirty(first, count);
+ *     store.update(queue); // before the submit of the draws
+ *
+ * update() composes the transforms and bounding spheres of the dirty
+ * instances and uploads only their ranges to two storage buffers:
+ * array<InstanceTransform> and array<Bounds> (see gpu-culling.h), indexed
+ * by instance. Dirtiness is tracked per block of kDirtyBlock instances.
+ */
+class InstanceStore
+{
+public:
+    static constexpr uint32_t kDirtyBlock = 256;
+
+    struct Stats
+    {
+        uint64_t updated   = 0; // instances composed
+        uint64_t ranges    = 0; // ranges uploaded, per buffer
+        uint64_t bytes     = 0; // bytes uploaded
+        double   composeMs = 0;
+    };
+
+    explicit InstanceStore(WGPUDevice device, uint32_t capacity = 1024);
+    ~InstanceStore();
+
+    InstanceStore(const InstanceStore&)            = delete;
+    InstanceStore& operator=(const InstanceStore&) = delete;
+
+    // Append an instance, dirty, and return its index
+    uint32_t add(const InstanceState& state);
+
+    void setPosition(uint32_t index, const std::array<float, 3>& position);
+    void setRotation(uint32_t index, const std::array<float, 4>& rotation);
+    void setScale(uint32_t index, const std::array<float, 3>& scale);
+
+    // The array of a component, size() elements, for bulk updates followed
+    // by markDirty()
+    float*       column(InstanceColumn column);
+    const float* column(InstanceColumn column) const;
+
+    void markDirty(uint32_t first, uint32_t count);
+
+    // Compose the dirty instances and upload them. If the instances
+    // outgrew the buffers, they are recreated here, generation() changes
+    // and every instance is uploaded.
+    void update(WGPUQueue queue);
+
+    // The ranges composed and uploaded by the last update(), e.g. for
+    // GpuCuller::updateBounds()
+    const std::vector<InstanceRange>& updatedRanges() const
+    {
+        return m_updatedRanges;
+    }
+
+    // CPU copies of what update() uploaded
+    const InstanceTransform* transforms() const { return m_transforms.data(); }
+    const InstanceBounds*    bounds() const { return m_bounds.data(); }
+
+    WGPUBuffer transformBuffer() const { return m_transformBuffer; }
+    WGPUBuffer boundsBuffer() const { return m_boundsBuffer; }
+    // Changes whenever the buffers are recreated
+    uint32_t generation() const { return m_generation; }
+
+    uint32_t size() const { return m_size; }
+
+    void      setSimdLevel(SimdLevel level) { m_simd = level; }
+    SimdLevel simdLevel() const { return m_simd; }
+
+    Stats stats() const { return m_stats; }
+
+private:
+    using Column = std::vector<float, AlignedAllocator<float, 32>>;
+
+    void createBuffers(uint32_t capacity);
+    void compose(uint32_t first, uint32_t count);
+
+    WGPUDevice m_device          = nullptr;
+    WGPUBuffer m_transformBuffer = nullptr;
+    WGPUBuffer m_boundsBuffer    = nullptr;
+    uint32_t   m_bufferCapacity  = 0; // instances
+    uint32_t   m_generation      = 0;
+    uint32_t   m_size            = 0;
+    SimdLevel  m_simd            = SimdLevel::Scalar;
+
+    std::array<Column, size_t(InstanceColumn::Count)> m_columns;
+    std::vector<InstanceTransform>                    m_transforms;
+    std::vector<InstanceBounds>                       m_bounds;
+    std::vector<uint64_t>                             m_dirtyBlocks; // bits
+    std::vector<InstanceRange>                        m_updatedRanges;
+    Stats                                             m_stats;
+};
+
+#endif // INSTANCE_STORE_H
@@ -0,0 +1,134 @@
+#include "job-system.h"
+
+#include <algorithm>
+
+namespace {
+
+// Which pool the current thread belongs to, and its queue index there
+thread_local const JobSystem* t_system      = nullptr;
+thread_local uint32_t         t_threadIndex = 0;
+
+} // namespace
+
+JobSystem::JobSystem(uint32_t threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (uint32_t i = 1; i < threadCount; ++i) {
+        m_workers.emplace_back([this, i] { workerMain(i); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+uint32_t JobSystem::currentThreadIndex() const
+{
+    return t_system == this ? t_threadIndex : 0;
+}
+
+void JobSystem::run(Group& group, Job job)
+{
+    group.m_pending.fetch_add(1, std::memory_order_relaxed);
+    // Counted before the push so that m_queued never goes below zero
+    m_queued.fetch_add(1, std::memory_order_release);
+    WorkQueue& queue = *m_queues[currentThreadIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back({std::move(job), &group});
+    }
+    // Taking the lock orders this notification after any sleeping worker's
+    // check of m_queued, so the wakeup cannot be lost
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_one();
+}
+
+void JobSystem::wait(Group& group)
+{
+    uint32_t home = currentThreadIndex();
+    while (group.m_pending.load(std::memory_order_acquire) > 0) {
+        if (!tryRunOne(home)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::parallelFor(
+    uint32_t                                       count,
+    uint32_t                                       grain,
+    const std::function<void(uint32_t, uint32_t)>& function)
+{
+    grain = std::max(grain, 1u);
+    Group group;
+    for (uint32_t begin = 0; begin < count; begin += grain) {
+        uint32_t end = std::min(begin + grain, count);
+        run(group, [&function, begin, end] { function(begin, end); });
+    }
+    wait(group);
+}
+
+bool JobSystem::tryRunOne(uint32_t home)
+{
+    Task task;
+    bool found  = false;
+    bool stolen = false;
+    for (uint32_t i = 0; i < m_queues.size() && !found; ++i) {
+        uint32_t   index = (home + i) % m_queues.size();
+        WorkQueue& queue = *m_queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+        // Own jobs are taken LIFO (cache-warm), stolen ones FIFO (larger)
+        if (i == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            stolen = true;
+        }
+        found = true;
+    }
+    if (!found)
+        return false;
+
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    if (stolen) {
+        m_stolen.fetch_add(1, std::memory_order_relaxed);
+    }
+    task.job();
+    task.group->m_pending.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::workerMain(uint32_t index)
+{
+    t_system      = this;
+    t_threadIndex = index;
+    while (true) {
+        if (tryRunOne(index))
+            continue;
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this] {
+            return m_stop || m_queued.load(std::memory_order_acquire) > 0;
+        });
+        if (m_stop)
+            return;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed pool of worker threads with one job deque per thread. A thread
+ * pushes and pops jobs at the back of its own deque and, when it runs out,
+ * steals from the front of the others, so that nested jobs stay on the
+ * thread that spawned them while idle threads balance the load.
+ *
+ * Threads that wait for a group execute pending jobs meanwhile, so the
+ * calling thread counts as one of the `threadCount` threads.
+ */
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    /**
+     * Jobs that can be waited for together. Must outlive its jobs.
+     */
+    class Group
+    {
+        friend class JobSystem;
+        std::atomic<uint32_t> m_pending = 0;
+    };
+
+    // `threadCount` includes the calling thread; 0 uses all the cores
+    explicit JobSystem(uint32_t threadCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&)            = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    uint32_t threadCount() const { return uint32_t(m_workers.size()) + 1; }
+
+    void run(Group& group, Job job);
+
+    // Execute jobs until all the jobs of `group` are done
+    void wait(Group& group);
+
+    // Call `function(begin, end)` over [0, count) in ranges of at most
+    // `grain` items, on all the threads, and wait for them
+    void parallelFor(
+        uint32_t                                       count,
+        uint32_t                                       grain,
+        const std::function<void(uint32_t, uint32_t)>& function);
+
+    // Index of the calling thread in this system: 0 for threads outside the
+    // pool, 1..threadCount()-1 for the workers
+    uint32_t currentThreadIndex() const;
+
+    // Jobs run by a thread other than the one that queued them
+    uint64_t stolenJobs() const { return m_stolen.load(); }
+
+private:
+    struct Task
+    {
+        Job    job;
+        Group* group = nullptr;
+    };
+
+    struct WorkQueue
+    {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool tryRunOne(uint32_t home);
+    void workerMain(uint32_t index);
+
+    // Queue 0 is shared by the threads outside the pool
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread>                m_workers;
+
+    std::mutex              m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<uint32_t>   m_queued = 0;
+    std::atomic<bool>       m_stop   = false;
+    std::atomic<uint64_t>   m_stolen = 0;
+};
+
+#endif // JOB_SYSTEM_H
@@ -1,10 +1,170 @@
 
 #include "application.h"
+#include "frame-bench.h"
+#include "mesh-asset.h"
+#include "microbench.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <string_view>
+
+namespace {
+
+// wgputest [--present-mode fifo|mailbox|immediate] [--frames-in-flight N]
+//          [--max-fps F] [--adapter INDEX|NAME] [--background-shader FILE]
+//          [--hot-reload] [--metrics FILE] [--metrics-format json|prometheus]
+//          [--metrics-interval SECONDS]
+bool parseWindowOptions(int argc, char* argv[], ApplicationOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg  = argv[i];
+        bool             last = i + 1 >= argc;
+        if (arg == "--present-mode" && !last) {
+            std::string_view mode = argv[++i];
+            if (mode == "fifo") {
+                options.presentMode = WGPUPresentMode_Fifo;
+            }
+            else if (mode == "mailbox") {
+                options.presentMode = WGPUPresentMode_Mailbox;
+            }
+            else if (mode == "immediate") {
+                options.presentMode = WGPUPresentMode_Immediate;
+            }
+            else {
+                std::cerr << "Unknown present mode: " << mode << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--frames-in-flight" && !last) {
+            options.framesInFlight = std::clamp(std::atoi(argv[++i]), 1, 3);
+        }
+        else if (arg == "--max-fps" && !last) {
+            options.maxFps = std::max(0.0, std::atof(argv[++i]));
+        }
+        else if (arg == "--adapter" && !last) {
+            options.adapter = argv[++i];
+        }
+        else if (arg == "--background-shader" && !last) {
+            options.backgroundShader = argv[++i];
+        }
+        else if (arg == "--hot-reload") {
+            options.hotReload = true;
+        }
+        else if (arg == "--metrics" && !last) {
+            options.metricsPath = argv[++i];
+        }
+        else if (arg == "--metrics-format" && !last) {
+            std::string_view format = argv[++i];
+            if (format == "json") {
+                options.metricsFormat = MetricsFormat::JsonLines;
+            }
+            else if (format == "prometheus") {
+                options.metricsFormat = MetricsFormat::Prometheus;
+            }
+            else {
+                std::cerr << "Unknown metrics format: " << format << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--metrics-interval" && !last) {
+            options.metricsInterval = std::max(0.0, std::atof(argv[++i]));
+        }
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
 
 int main(int argc, char *argv[])
 {
+    // wgputest --microbench <name> [--backend null|swiftshader|default]
+    //          [--iterations N] [--out FILE]
+    if (argc >= 3 && std::string_view(argv[1]) == "--microbench") {
+        BenchOptions opts;
+        if (!parseBenchOptions(argc, argv, 3, opts)) {
+            return 1;
+        }
+        return runMicrobenchmark(argv[2], opts);
+    }
+
+    // wgputest --convert-mesh <input.obj|input.ply> <output.wgm>
+    // Offline conversion to the binary mesh asset format, see mesh-asset.h
+    if (argc == 4 && std::string_view(argv[1]) == "--convert-mesh") {
+        return convertMeshFile(argv[2], argv[3]) ? 0 : 1;
+    }
+
+    // wgputest --list-adapters
+    // Prints the adapters in ranking order, with the index --adapter takes
+    if (argc == 2 && std::string_view(argv[1]) == "--list-adapters") {
+        WGPUInstance              instance = createInstanceWithTimedWait();
+        WGPURequestAdapterOptions options  = WGPU_REQUEST_ADAPTER_OPTIONS_INIT;
+        {
+            AdapterList adapters;
+            adapters.enumerate(instance, options);
+            adapters.print(std::cout);
+        }
+        wgpuInstanceRelease(instance);
+        return 0;
+    }
+
+    // wgputest --bench N [--backend null|swiftshader|default] [--out FILE]
+    //                    [--trace FILE] [--frames-in-flight N] [--max-fps F]
+    // Runs N headless frames, no display needed
+    if (argc >= 3 && std::string_view(argv[1]) == "--bench") {
+        BenchOptions opts;
+        if (!parseBenchOptions(argc, argv, 3, opts)) {
+            return 1;
+        }
+        int frames = std::atoi(argv[2]);
+        if (frames <= 0) {
+            std::cerr << "--bench expects a positive frame count" << std::endl;
+            return 1;
+        }
+        return runFrameBenchmark(frames, opts);
+    }
+
+    // wgputest --render N PATTERN [--backend null|swiftshader|default]
+    //                             [--out FILE] [--frames-in-flight N]
+    // Renders N headless frames to PATTERN ("out/frame-####.png")
+    if (argc >= 4 && std::string_view(argv[1]) == "--render") {
+        BenchOptions opts;
+        if (!parseBenchOptions(argc, argv, 4, opts)) {
+            return 1;
+        }
+        int frames = std::atoi(argv[2]);
+        if (frames <= 0) {
+            std::cerr << "--render expects a positive frame count" << std::endl;
+            return 1;
+        }
+        return runBatchRender(frames, argv[3], opts);
+    }
+
+    // wgputest --device-loss N [--backend null|swiftshader|default]
+    //                          [--out FILE]
+    // Destroys the device of a headless run N times and times the recovery
+    if (argc >= 3 && std::string_view(argv[1]) == "--device-loss") {
+        BenchOptions opts;
+        if (!parseBenchOptions(argc, argv, 3, opts)) {
+            return 1;
+        }
+        int losses = std::atoi(argv[2]);
+        if (losses <= 0) {
+            std::cerr << "--device-loss expects a positive count" << std::endl;
+            return 1;
+        }
+        return runDeviceRecovery(losses, opts);
+    }
+
+    ApplicationOptions options;
+    if (!parseWindowOptions(argc, argv, options)) {
+        return 1;
+    }
+
     if (!glfwInit()) {
         std::cerr << "Could not initialize GLFW!" << std::endl;
         return 1;
@@ -12,7 +172,7 @@ int main(int argc, char *argv[])
 
     Application app;
 
-    if (!app.initialize()) {
+    if (!app.initialize(options)) {
         std::cerr << "Could not open window!" << std::endl;
         glfwTerminate();
         return 1;
@@ -0,0 +1,792 @@
+#include "mesh-asset.h"
+
+#include "buffer-allocator.h"
+#include "hashing.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Vertices and indices are counted in uint32_t by GpuMesh and index buffers
+constexpr uint64_t kMaxMeshElements = std::numeric_limits<uint32_t>::max();
+
+} // namespace
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::filesystem::path& path)
+{
+    close();
+    HANDLE file = CreateFileW(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    HANDLE        mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        mapping =
+            CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file    = file;
+    m_mapping = mapping;
+    m_size    = size.QuadPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+    }
+    m_data    = nullptr;
+    m_size    = 0;
+    m_file    = nullptr;
+    m_mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::filesystem::path& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    void*       data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping stays valid once the descriptor is closed
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    // Sections are read front to back, once
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = info.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif // _WIN32
+
+bool MeshAsset::open(const std::filesystem::path& path)
+{
+    m_header   = nullptr;
+    m_sections = nullptr;
+    if (!m_file.open(path)) {
+        std::cerr << "Could not map mesh asset " << path << '\n';
+        return false;
+    }
+
+    auto fail = [&](const char* reason) {
+        std::cerr << "Invalid mesh asset " << path << ": " << reason << '\n';
+        m_file.close();
+        return false;
+    };
+    if (m_file.size() < sizeof(MeshAssetHeader))
+        return fail("truncated header");
+    const auto* header =
+        reinterpret_cast<const MeshAssetHeader*>(m_file.data());
+    if (header->magic != kMeshAssetMagic)
+        return fail("bad magic");
+    if (header->version != kMeshAssetVersion)
+        return fail("unsupported version");
+    if (header->fileSize != m_file.size())
+        return fail("size mismatch");
+    uint64_t tableEnd = sizeof(MeshAssetHeader) +
+                        uint64_t(header->sectionCount) * sizeof(MeshSection);
+    if (tableEnd > m_file.size())
+        return fail("truncated section table");
+
+    const auto* sections = reinterpret_cast<const MeshSection*>(
+        m_file.data() + sizeof(MeshAssetHeader));
+    for (uint32_t i = 0; i < header->sectionCount; ++i) {
+        const MeshSection& section = sections[i];
+        uint32_t           stride  = section.kind == MeshSectionKind::Vertices ?
+                                         sizeof(MeshVertex) :
+                                         sizeof(uint32_t);
+        if (section.stride != stride || section.size % stride != 0 ||
+            section.size / stride != section.count)
+            return fail("bad section layout");
+        if (section.count > kMaxMeshElements)
+            return fail("too many elements");
+        if (section.offset % kMeshAssetAlignment != 0 ||
+            section.offset < tableEnd || section.offset > m_file.size() ||
+            section.size > m_file.size() - section.offset)
+            return fail("section out of bounds");
+    }
+    m_header   = header;
+    m_sections = sections;
+    return true;
+}
+
+const MeshSection* MeshAsset::section(MeshSectionKind kind) const
+{
+    for (uint32_t i = 0; m_header && i < m_header->sectionCount; ++i) {
+        if (m_sections[i].kind == kind)
+            return &m_sections[i];
+    }
+    return nullptr;
+}
+
+void GpuMesh::release()
+{
+    if (vertexBuffer) {
+        wgpuBufferRelease(vertexBuffer);
+    }
+    if (indexBuffer) {
+        wgpuBufferRelease(indexBuffer);
+    }
+    *this = {};
+}
+
+namespace {
+
+// Buffer holding a copy of `size` bytes of `data`, written while mapped at
+// creation so that no staging copy is made
+WGPUBuffer createBufferFrom(
+    WGPUDevice      device,
+    const char*     label,
+    WGPUBufferUsage usage,
+    const void*     data,
+    uint64_t        size)
+{
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    desc.label                = {label, WGPU_STRLEN};
+    desc.usage                = usage | WGPUBufferUsage_CopyDst;
+    desc.size                 = alignUp(std::max<uint64_t>(size, 4), 4);
+    desc.mappedAtCreation     = true;
+    WGPUBuffer buffer         = wgpuDeviceCreateBuffer(device, &desc);
+    void*      target = wgpuBufferGetMappedRange(buffer, 0, desc.size);
+    if (target) {
+        std::memcpy(target, data, size);
+    }
+    wgpuBufferUnmap(buffer);
+    return buffer;
+}
+
+} // namespace
+
+GpuMesh uploadMeshAsset(WGPUDevice device, const MeshAsset& asset)
+{
+    GpuMesh            mesh;
+    const MeshSection* vertices = asset.section(MeshSectionKind::Vertices);
+    const MeshSection* indices  = asset.section(MeshSectionKind::Indices);
+    if (!vertices)
+        return mesh;
+
+    mesh.vertexCount  = uint32_t(vertices->count);
+    mesh.vertexBuffer = createBufferFrom(
+        device,
+        "Mesh vertices",
+        WGPUBufferUsage_Vertex,
+        asset.sectionData(*vertices),
+        vertices->size);
+    if (indices) {
+        mesh.indexCount  = uint32_t(indices->count);
+        mesh.indexBuffer = createBufferFrom(
+            device,
+            "Mesh indices",
+            WGPUBufferUsage_Index,
+            asset.sectionData(*indices),
+            indices->size);
+    }
+    return mesh;
+}
+
+namespace {
+
+// Area-weighted vertex normals, for files that have none
+void computeNormals(MeshData& mesh)
+{
+    for (MeshVertex& vertex : mesh.vertices) {
+        std::fill(std::begin(vertex.normal), std::end(vertex.normal), 0.f);
+    }
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        MeshVertex* v[3];
+        for (int k = 0; k < 3; ++k) {
+            v[k] = &mesh.vertices[mesh.indices[i + k]];
+        }
+        float e1[3], e2[3];
+        for (int c = 0; c < 3; ++c) {
+            e1[c] = v[1]->position[c] - v[0]->position[c];
+            e2[c] = v[2]->position[c] - v[0]->position[c];
+        }
+        float n[3] = {
+            e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0]};
+        for (int k = 0; k < 3; ++k) {
+            for (int c = 0; c < 3; ++c) {
+                v[k]->normal[c] += n[c];
+            }
+        }
+    }
+    for (MeshVertex& vertex : mesh.vertices) {
+        float* n      = vertex.normal;
+        float  length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0) {
+            for (int c = 0; c < 3; ++c) {
+                n[c] /= length;
+            }
+        }
+    }
+}
+
+// Reject meshes whose faces reference missing vertices
+bool checkIndices(const std::filesystem::path& path, const MeshData& mesh)
+{
+    for (uint32_t index : mesh.indices) {
+        if (index >= mesh.vertices.size()) {
+            std::cerr << "Vertex index out of range in " << path << '\n';
+            return false;
+        }
+    }
+    return true;
+}
+
+struct ObjCorner
+{
+    int position = 0;
+    int uv       = 0;
+    int normal   = 0;
+
+    bool operator==(const ObjCorner&) const = default;
+};
+
+struct ObjCornerHash
+{
+    size_t operator()(const ObjCorner& corner) const
+    {
+        return Hasher()
+            .add(corner.position)
+            .add(corner.uv)
+            .add(corner.normal)
+            .value();
+    }
+};
+
+// OBJ indices are 1-based, negative ones count from the end; 0 is "none"
+// and -1 a negative index before the first element
+int resolveObjIndex(int index, size_t count)
+{
+    if (index >= 0)
+        return index;
+    int64_t resolved = int64_t(count) + index + 1;
+    return resolved > 0 ? int(resolved) : -1;
+}
+
+} // namespace
+
+bool loadObj(const std::filesystem::path& path, MeshData& mesh)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open " << path << '\n';
+        return false;
+    }
+
+    std::vector<std::array<float, 3>>                  positions, normals;
+    std::vector<std::array<float, 2>>                  uvs;
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> corners;
+    std::vector<uint32_t>                              polygon;
+    mesh = {};
+
+    std::string line;
+    size_t      lineNumber = 0;
+
+    auto fail = [&](const char* reason) {
+        std::cerr << reason << " in " << path << " at line " << lineNumber
+                  << '\n';
+        return false;
+    };
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        std::istringstream in(line);
+        std::string        tag;
+        in >> tag;
+        if (tag == "v") {
+            auto& p = positions.emplace_back();
+            in >> p[0] >> p[1] >> p[2];
+        }
+        else if (tag == "vn") {
+            auto& n = normals.emplace_back();
+            in >> n[0] >> n[1] >> n[2];
+        }
+        else if (tag == "vt") {
+            auto& t = uvs.emplace_back();
+            in >> t[0] >> t[1];
+        }
+        else if (tag == "f") {
+            polygon.clear();
+            std::string token;
+            while (in >> token) {
+                // v, v/vt, v//vn or v/vt/vn
+                ObjCorner corner;
+                int*      fields[] = {
+                    &corner.position, &corner.uv, &corner.normal};
+                size_t start = 0;
+                for (int field = 0; field < 3 && start <= token.size();
+                     ++field) {
+                    size_t end = token.find('/', start);
+                    if (end == std::string::npos) {
+                        end = token.size();
+                    }
+                    const char* first = token.data() + start;
+                    const char* last  = token.data() + end;
+                    if (end > start &&
+                        std::from_chars(first, last, *fields[field]).ptr !=
+                            last) {
+                        return fail("Bad face index");
+                    }
+                    start = end + 1;
+                }
+                corner.position =
+                    resolveObjIndex(corner.position, positions.size());
+                corner.uv     = resolveObjIndex(corner.uv, uvs.size());
+                corner.normal = resolveObjIndex(corner.normal, normals.size());
+                if (corner.position <= 0 ||
+                    corner.position > int(positions.size()) ||
+                    corner.uv < 0 || corner.uv > int(uvs.size()) ||
+                    corner.normal < 0 || corner.normal > int(normals.size())) {
+                    return fail("Bad face index");
+                }
+                if (mesh.vertices.size() >= kMaxMeshElements) {
+                    return fail("Too many vertices");
+                }
+
+                auto [it, inserted] =
+                    corners.try_emplace(corner, uint32_t(mesh.vertices.size()));
+                if (inserted) {
+                    MeshVertex& vertex = mesh.vertices.emplace_back();
+                    std::memcpy(
+                        vertex.position,
+                        positions[corner.position - 1].data(),
+                        sizeof(vertex.position));
+                    if (corner.normal > 0) {
+                        std::memcpy(
+                            vertex.normal,
+                            normals[corner.normal - 1].data(),
+                            sizeof(vertex.normal));
+                    }
+                    if (corner.uv > 0) {
+                        std::memcpy(
+                            vertex.uv,
+                            uvs[corner.uv - 1].data(),
+                            sizeof(vertex.uv));
+                    }
+                }
+                polygon.push_back(it->second);
+            }
+            for (size_t i = 2; i < polygon.size(); ++i) {
+                mesh.indices.insert(
+                    mesh.indices.end(),
+                    {polygon[0], polygon[i - 1], polygon[i]});
+            }
+            if (mesh.indices.size() > kMaxMeshElements) {
+                return fail("Too many indices");
+            }
+        }
+    }
+    if (normals.empty()) {
+        computeNormals(mesh);
+    }
+    return true;
+}
+
+namespace {
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float, Double };
+
+bool parsePlyType(const std::string& name, PlyType& type)
+{
+    static const std::pair<const char*, PlyType> kTypes[] = {
+        {"char", PlyType::Int8},     {"int8", PlyType::Int8},
+        {"uchar", PlyType::UInt8},   {"uint8", PlyType::UInt8},
+        {"short", PlyType::Int16},   {"int16", PlyType::Int16},
+        {"ushort", PlyType::UInt16}, {"uint16", PlyType::UInt16},
+        {"int", PlyType::Int32},     {"int32", PlyType::Int32},
+        {"uint", PlyType::UInt32},   {"uint32", PlyType::UInt32},
+        {"float", PlyType::Float},   {"float32", PlyType::Float},
+        {"double", PlyType::Double}, {"float64", PlyType::Double},
+    };
+    for (const auto& [typeName, value] : kTypes) {
+        if (name == typeName) {
+            type = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t plyTypeSize(PlyType type)
+{
+    switch (type) {
+    case PlyType::Int8:
+    case PlyType::UInt8: return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16: return 2;
+    case PlyType::Double: return 8;
+    default: return 4;
+    }
+}
+
+struct PlyProperty
+{
+    std::string name;
+    PlyType     type      = PlyType::Float;
+    bool        isList    = false;
+    PlyType     countType = PlyType::UInt8;
+};
+
+struct PlyElement
+{
+    std::string              name;
+    uint64_t                 count = 0;
+    std::vector<PlyProperty> properties;
+};
+
+// Read one value as a double, in ASCII or binary little endian
+bool readPlyValue(std::istream& in, bool binary, PlyType type, double& value)
+{
+    if (!binary) {
+        return bool(in >> value);
+    }
+    unsigned char bytes[8];
+    if (!in.read(reinterpret_cast<char*>(bytes), plyTypeSize(type)))
+        return false;
+    switch (type) {
+    case PlyType::Int8: value = int8_t(bytes[0]); break;
+    case PlyType::UInt8: value = bytes[0]; break;
+    case PlyType::Int16: {
+        int16_t v;
+        std::memcpy(&v, bytes, 2);
+        value = v;
+        break;
+    }
+    case PlyType::UInt16: {
+        uint16_t v;
+        std::memcpy(&v, bytes, 2);
+        value = v;
+        break;
+    }
+    case PlyType::Int32: {
+        int32_t v;
+        std::memcpy(&v, bytes, 4);
+        value = v;
+        break;
+    }
+    case PlyType::UInt32: {
+        uint32_t v;
+        std::memcpy(&v, bytes, 4);
+        value = v;
+        break;
+    }
+    case PlyType::Float: {
+        float v;
+        std::memcpy(&v, bytes, 4);
+        value = v;
+        break;
+    }
+    case PlyType::Double: std::memcpy(&value, bytes, 8); break;
+    }
+    return true;
+}
+
+} // namespace
+
+bool loadPly(const std::filesystem::path& path, MeshData& mesh)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Could not open " << path << '\n';
+        return false;
+    }
+    auto fail = [&](const char* reason) {
+        std::cerr << "Could not parse " << path << ": " << reason << '\n';
+        return false;
+    };
+
+    std::vector<PlyElement> elements;
+    bool                    binary = false;
+    std::string             line;
+    if (!std::getline(file, line) || line.rfind("ply", 0) != 0)
+        return fail("not a PLY file");
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        std::istringstream in(line);
+        std::string        keyword;
+        in >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            in >> format;
+            if (format == "binary_little_endian") {
+                binary = true;
+            }
+            else if (format != "ascii") {
+                return fail("unsupported format");
+            }
+        }
+        else if (keyword == "element") {
+            PlyElement& element = elements.emplace_back();
+            in >> element.name >> element.count;
+        }
+        else if (keyword == "property") {
+            if (elements.empty())
+                return fail("property outside of an element");
+            PlyProperty property;
+            std::string type;
+            in >> type;
+            if (type == "list") {
+                std::string countType;
+                in >> countType >> type;
+                property.isList = true;
+                if (!parsePlyType(countType, property.countType))
+                    return fail("unknown property type");
+            }
+            if (!parsePlyType(type, property.type))
+                return fail("unknown property type");
+            in >> property.name;
+            elements.back().properties.push_back(property);
+        }
+        else if (keyword == "end_header") {
+            break;
+        }
+    }
+
+    // Every value takes a byte at least, so the counts of the header are
+    // checked against the rest of the file before anything is reserved
+    std::error_code ec;
+    uint64_t        fileSize  = std::filesystem::file_size(path, ec);
+    std::streamoff  dataStart = file.tellg();
+    if (ec || dataStart < 0 || uint64_t(dataStart) > fileSize)
+        return fail("truncated header");
+    uint64_t remaining = fileSize - uint64_t(dataStart);
+
+    mesh = {};
+    bool hasNormals = false;
+    for (const PlyElement& element : elements) {
+        uint64_t valueCount = std::max<uint64_t>(element.properties.size(), 1);
+        if (element.count > remaining / valueCount)
+            return fail("element count larger than the file");
+        remaining -= element.count * valueCount;
+
+        bool isVertex = element.name == "vertex";
+        bool isFace   = element.name == "face";
+        // Where each vertex property goes, null when it is ignored
+        std::vector<float*> targets(element.properties.size(), nullptr);
+        MeshVertex          vertex = {};
+        if (isVertex) {
+            const std::pair<const char*, float*> kNames[] = {
+                {"x", &vertex.position[0]},
+                {"y", &vertex.position[1]},
+                {"z", &vertex.position[2]},
+                {"nx", &vertex.normal[0]},
+                {"ny", &vertex.normal[1]},
+                {"nz", &vertex.normal[2]},
+                {"u", &vertex.uv[0]},
+                {"v", &vertex.uv[1]},
+                {"s", &vertex.uv[0]},
+                {"t", &vertex.uv[1]},
+                {"texture_u", &vertex.uv[0]},
+                {"texture_v", &vertex.uv[1]},
+            };
+            for (size_t p = 0; p < element.properties.size(); ++p) {
+                for (const auto& [name, target] : kNames) {
+                    if (element.properties[p].name == name) {
+                        targets[p] = target;
+                    }
+                }
+                hasNormals = hasNormals || element.properties[p].name == "nx";
+            }
+            if (element.count > kMaxMeshElements)
+                return fail("too many vertices");
+            mesh.vertices.reserve(element.count);
+        }
+
+        std::vector<uint32_t> polygon;
+        for (uint64_t i = 0; i < element.count; ++i) {
+            vertex = {};
+            for (size_t p = 0; p < element.properties.size(); ++p) {
+                const PlyProperty& property = element.properties[p];
+                double             value    = 0;
+                if (!property.isList) {
+                    if (!readPlyValue(file, binary, property.type, value))
+                        return fail("truncated data");
+                    if (targets[p]) {
+                        *targets[p] = float(value);
+                    }
+                    continue;
+                }
+                double count = 0;
+                if (!readPlyValue(file, binary, property.countType, count))
+                    return fail("truncated data");
+                // Converting a negative or too large double is undefined
+                if (!(count >= 0 && count < double(kMaxMeshElements)) ||
+                    count != std::floor(count))
+                    return fail("bad list size");
+                polygon.clear();
+                for (uint64_t k = 0; k < uint64_t(count); ++k) {
+                    if (!readPlyValue(file, binary, property.type, value))
+                        return fail("truncated data");
+                    if (!(value >= 0 && value < double(kMaxMeshElements)))
+                        return fail("bad vertex index");
+                    polygon.push_back(uint32_t(value));
+                }
+                if (isFace && (property.name == "vertex_indices" ||
+                               property.name == "vertex_index")) {
+                    for (size_t k = 2; k < polygon.size(); ++k) {
+                        mesh.indices.insert(
+                            mesh.indices.end(),
+                            {polygon[0], polygon[k - 1], polygon[k]});
+                    }
+                }
+            }
+            if (isVertex) {
+                mesh.vertices.push_back(vertex);
+            }
+        }
+    }
+
+    if (mesh.indices.size() > kMaxMeshElements)
+        return fail("too many indices");
+    if (!checkIndices(path, mesh))
+        return false;
+    if (!hasNormals) {
+        computeNormals(mesh);
+    }
+    return true;
+}
+
+bool writeMeshAsset(const std::filesystem::path& path, const MeshData& mesh)
+{
+    MeshAssetHeader header;
+    header.sectionCount = 2;
+    if (!mesh.vertices.empty()) {
+        std::copy_n(mesh.vertices[0].position, 3, header.boundsMin);
+        std::copy_n(mesh.vertices[0].position, 3, header.boundsMax);
+    }
+    for (const MeshVertex& vertex : mesh.vertices) {
+        for (int c = 0; c < 3; ++c) {
+            float value         = vertex.position[c];
+            header.boundsMin[c] = std::min(header.boundsMin[c], value);
+            header.boundsMax[c] = std::max(header.boundsMax[c], value);
+        }
+    }
+
+    MeshSection sections[2];
+    sections[0].kind   = MeshSectionKind::Vertices;
+    sections[0].stride = sizeof(MeshVertex);
+    sections[0].count  = mesh.vertices.size();
+    sections[0].size   = mesh.vertices.size() * sizeof(MeshVertex);
+    sections[1].kind   = MeshSectionKind::Indices;
+    sections[1].stride = sizeof(uint32_t);
+    sections[1].count  = mesh.indices.size();
+    sections[1].size   = mesh.indices.size() * sizeof(uint32_t);
+    uint64_t offset    = sizeof(header) + sizeof(sections);
+    for (MeshSection& section : sections) {
+        section.offset = alignUp(offset, kMeshAssetAlignment);
+        offset         = section.offset + section.size;
+    }
+    header.fileSize = offset;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Could not create " << path << '\n';
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+    const void* data[] = {mesh.vertices.data(), mesh.indices.data()};
+    for (int i = 0; i < 2; ++i) {
+        static const char kPadding[kMeshAssetAlignment] = {};
+        file.write(kPadding, sections[i].offset - uint64_t(file.tellp()));
+        file.write(static_cast<const char*>(data[i]), sections[i].size);
+    }
+    if (!file) {
+        std::cerr << "Could not write " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool convertMeshFile(
+    const std::filesystem::path& input,
+    const std::filesystem::path& output)
+{
+    std::string extension = input.extension().string();
+    std::transform(
+        extension.begin(), extension.end(), extension.begin(), [](char c) {
+            return char(std::tolower((unsigned char) c));
+        });
+
+    MeshData mesh;
+    bool     loaded = false;
+    if (extension == ".obj") {
+        loaded = loadObj(input, mesh);
+    }
+    else if (extension == ".ply") {
+        loaded = loadPly(input, mesh);
+    }
+    else {
+        std::cerr << "Unsupported mesh format: " << input << '\n';
+    }
+    return loaded && writeMeshAsset(output, mesh);
+}
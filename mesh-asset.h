@@ -0,0 +1,167 @@
+#ifndef MESH_ASSET_H
+#define MESH_ASSET_H
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/**
+ * Binary mesh asset (.wgm), laid out so that its sections can be copied to
+ * GPU buffers as they are:
+ *
+ *     MeshAssetHeader
+ *     MeshSection[sectionCount]
+ *     section data, each at a multiple of kMeshAssetAlignment
+ *
+ * All values are little endian. Vertices are interleaved MeshVertex,
+ * indices are u32.
+ */
+constexpr uint32_t kMeshAssetMagic     = 0x4d475057; // "WPGM"
+constexpr uint32_t kMeshAssetVersion   = 1;
+constexpr uint64_t kMeshAssetAlignment = 256;
+
+enum class MeshSectionKind : uint32_t {
+    Vertices = 1,
+    Indices  = 2,
+};
+
+struct MeshVertex
+{
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+static_assert(sizeof(MeshVertex) == 32);
+
+struct MeshAssetHeader
+{
+    uint32_t magic        = kMeshAssetMagic;
+    uint32_t version      = kMeshAssetVersion;
+    uint32_t sectionCount = 0;
+    uint32_t reserved     = 0;
+    float    boundsMin[3] = {};
+    float    boundsMax[3] = {};
+    uint64_t fileSize     = 0;
+};
+static_assert(sizeof(MeshAssetHeader) == 48);
+
+struct MeshSection
+{
+    MeshSectionKind kind   = MeshSectionKind::Vertices;
+    uint32_t        stride = 0; // bytes per element
+    uint64_t        count  = 0; // elements
+    uint64_t        offset = 0; // from the start of the file
+    uint64_t        size   = 0; // bytes
+};
+static_assert(sizeof(MeshSection) == 32);
+
+/**
+ * Read-only memory mapping of a whole file.
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::filesystem::path& path);
+    void close();
+
+    const uint8_t* data() const { return m_data; }
+    uint64_t       size() const { return m_size; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    uint64_t       m_size = 0;
+#ifdef _WIN32
+    void* m_file    = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+/**
+ * A mesh asset file mapped in memory. The header and the section table are
+ * validated by open(); the section data is read straight from the mapping,
+ * nothing is copied to the heap.
+ */
+class MeshAsset
+{
+public:
+    // Print the reason and return false if the file is not a valid asset
+    bool open(const std::filesystem::path& path);
+
+    const MeshAssetHeader& header() const { return *m_header; }
+
+    // Null if the asset has no section of this kind
+    const MeshSection* section(MeshSectionKind kind) const;
+
+    const void* sectionData(const MeshSection& section) const
+    {
+        return m_file.data() + section.offset;
+    }
+
+    uint64_t fileSize() const { return m_file.size(); }
+
+private:
+    MappedFile             m_file;
+    const MeshAssetHeader* m_header   = nullptr;
+    const MeshSection*     m_sections = nullptr;
+};
+
+/**
+ * Vertex and index buffers of a mesh.
+ */
+struct GpuMesh
+{
+    WGPUBuffer vertexBuffer = nullptr;
+    WGPUBuffer indexBuffer  = nullptr;
+    uint32_t   vertexCount  = 0;
+    uint32_t   indexCount   = 0;
+
+    explicit operator bool() const { return vertexBuffer != nullptr; }
+
+    void release();
+};
+
+/**
+ * Create the buffers of `asset`, each section being copied from the file
+ * mapping into the mappedAtCreation range of its buffer.
+ */
+GpuMesh uploadMeshAsset(WGPUDevice device, const MeshAsset& asset);
+
+/**
+ * A mesh in memory, as produced by the text parsers.
+ */
+struct MeshData
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t>   indices;
+};
+
+/**
+ * Parse a Wavefront OBJ file. Polygons are triangulated as fans and
+ * identical position/uv/normal triplets are merged.
+ */
+bool loadObj(const std::filesystem::path& path, MeshData& mesh);
+
+/**
+ * Parse a PLY file, ASCII or binary little endian, with x/y/z and optional
+ * nx/ny/nz and u/v (or s/t) vertex properties.
+ */
+bool loadPly(const std::filesystem::path& path, MeshData& mesh);
+
+bool writeMeshAsset(const std::filesystem::path& path, const MeshData& mesh);
+
+/**
+ * Convert an .obj or .ply file, chosen by extension, to a mesh asset.
+ */
+bool convertMeshFile(
+    const std::filesystem::path& input,
+    const std::filesystem::path& output);
+
+#endif // MESH_ASSET_H
@@ -0,0 +1,321 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Upper bound of histogram bucket i, in milliseconds
+double bucketBoundMs(size_t bucket)
+{
+    return double(kHistogramBaseUs << bucket) * 1e-3;
+}
+
+} // namespace
+
+const char* metricCounterName(MetricCounter counter)
+{
+    switch (counter) {
+    case MetricCounter::Frames:
+        return "frames";
+    case MetricCounter::Submits:
+        return "submits";
+    case MetricCounter::CommandBuffers:
+        return "command_buffers";
+    case MetricCounter::UploadBytes:
+        return "upload_bytes";
+    case MetricCounter::ReadbackBytes:
+        return "readback_bytes";
+    case MetricCounter::PipelineHits:
+        return "pipeline_hits";
+    case MetricCounter::PipelineMisses:
+        return "pipeline_misses";
+    case MetricCounter::BindingHits:
+        return "binding_hits";
+    case MetricCounter::BindingMisses:
+        return "binding_misses";
+    case MetricCounter::BlobHits:
+        return "blob_hits";
+    case MetricCounter::BlobMisses:
+        return "blob_misses";
+    case MetricCounter::Count:
+        break;
+    }
+    return "unknown";
+}
+
+const char* metricHistogramName(MetricHistogram histogram)
+{
+    switch (histogram) {
+    case MetricHistogram::FrameMs:
+        return "frame_ms";
+    case MetricHistogram::EncodeMs:
+        return "encode_ms";
+    case MetricHistogram::SubmitMs:
+        return "submit_ms";
+    case MetricHistogram::SurfaceWaitMs:
+        return "surface_wait_ms";
+    case MetricHistogram::Count:
+        break;
+    }
+    return "unknown";
+}
+
+double HistogramStats::quantileMs(double q) const
+{
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank       = std::max<uint64_t>(1, uint64_t(q * count + 0.5));
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < kHistogramBuckets; ++i) {
+        cumulative += buckets[i];
+        if (cumulative >= rank) {
+            // The last bucket is open: its lower bound
+            return bucketBoundMs(std::min(i, kHistogramBuckets - 2));
+        }
+    }
+    return bucketBoundMs(kHistogramBuckets - 2);
+}
+
+MetricsSnapshot operator-(const MetricsSnapshot& a, const MetricsSnapshot& b)
+{
+    MetricsSnapshot difference;
+    for (size_t i = 0; i < kCounterCount; ++i) {
+        difference.counters[i] = a.counters[i] - b.counters[i];
+    }
+    for (size_t h = 0; h < kHistogramCount; ++h) {
+        HistogramStats&       out = difference.histograms[h];
+        const HistogramStats& x   = a.histograms[h];
+        const HistogramStats& y   = b.histograms[h];
+        for (size_t i = 0; i < kHistogramBuckets; ++i) {
+            out.buckets[i] = x.buckets[i] - y.buckets[i];
+        }
+        out.count = x.count - y.count;
+        out.sumUs = x.sumUs - y.sumUs;
+    }
+    return difference;
+}
+
+#ifdef WGPUTEST_METRICS
+
+namespace {
+
+struct ThreadRegistry
+{
+    std::mutex                                                mutex;
+    std::vector<std::unique_ptr<metrics_detail::ThreadSlots>> threads;
+    // Totals of the threads that exited
+    MetricsSnapshot retired;
+};
+
+// Add the slots of one thread to `snapshot`
+void addSlots(
+    const metrics_detail::ThreadSlots& slots,
+    MetricsSnapshot&                   snapshot)
+{
+    for (size_t i = 0; i < kCounterCount; ++i) {
+        snapshot.counters[i] +=
+            slots.counters[i].load(std::memory_order_relaxed);
+    }
+    for (size_t h = 0; h < kHistogramCount; ++h) {
+        HistogramStats& histogram = snapshot.histograms[h];
+        for (size_t i = 0; i < kHistogramBuckets; ++i) {
+            uint64_t count =
+                slots.buckets[h][i].load(std::memory_order_relaxed);
+            histogram.buckets[i] += count;
+            histogram.count += count;
+        }
+        histogram.sumUs += slots.sumsUs[h].load(std::memory_order_relaxed);
+    }
+}
+
+ThreadRegistry& threadRegistry()
+{
+    static ThreadRegistry registry;
+    return registry;
+}
+
+} // namespace
+
+metrics_detail::ThreadSlots* metrics_detail::registerThread()
+{
+    ThreadRegistry&             registry = threadRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(std::make_unique<ThreadSlots>());
+    return registry.threads.back().get();
+}
+
+void metrics_detail::retireThread(ThreadSlots* slots)
+{
+    ThreadRegistry&             registry = threadRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    addSlots(*slots, registry.retired);
+    std::erase_if(registry.threads, [slots](const auto& thread) {
+        return thread.get() == slots;
+    });
+}
+
+MetricsSnapshot collectMetrics()
+{
+    ThreadRegistry&             registry = threadRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    MetricsSnapshot             snapshot = registry.retired;
+    for (const auto& slots : registry.threads) {
+        addSlots(*slots, snapshot);
+    }
+    return snapshot;
+}
+
+#else
+
+MetricsSnapshot collectMetrics()
+{
+    return {};
+}
+
+#endif // WGPUTEST_METRICS
+
+MetricsExporter::MetricsExporter(
+    std::string   path,
+    MetricsFormat format,
+    double        intervalSeconds) :
+        m_path(std::move(path)), m_format(format),
+        m_period(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(intervalSeconds))),
+        m_start(Clock::now()), m_exportedAt(m_start), m_total(collectMetrics()),
+        m_exported(m_total)
+{
+    if (m_format == MetricsFormat::JsonLines) {
+        m_jsonLines.open(m_path);
+        if (!m_jsonLines) {
+            std::cerr << "Could not open " << m_path << '\n';
+        }
+    }
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    m_total = collectMetrics();
+    flush();
+}
+
+bool MetricsExporter::onFrame()
+{
+    m_total = collectMetrics();
+    if (Clock::now() - m_exportedAt < m_period) {
+        return false;
+    }
+    flush();
+    return true;
+}
+
+void MetricsExporter::flush()
+{
+    using Seconds = std::chrono::duration<double>;
+
+    Clock::time_point now = Clock::now();
+    m_interval            = m_total - m_exported;
+    m_intervalSeconds     = Seconds(now - m_exportedAt).count();
+    if (m_format == MetricsFormat::JsonLines) {
+        writeJsonLine(Seconds(now - m_start).count());
+    }
+    else {
+        writePrometheus();
+    }
+    m_exported   = m_total;
+    m_exportedAt = now;
+}
+
+std::string MetricsExporter::summary() const
+{
+    uint64_t frames = m_interval.counter(MetricCounter::Frames);
+    const HistogramStats& frameMs =
+        m_interval.histogram(MetricHistogram::FrameMs);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << (m_intervalSeconds > 0 ? frames / m_intervalSeconds : 0) << " fps";
+    if (frames > 0) {
+        double submits = m_interval.counter(MetricCounter::Submits);
+        double bytes   = m_interval.counter(MetricCounter::UploadBytes);
+        out << std::setprecision(2) << ", " << frameMs.meanMs()
+            << " ms/frame (p95 < " << frameMs.quantileMs(0.95) << "), "
+            << std::setprecision(1) << submits / frames << " submits/frame, "
+            << bytes / 1024 / frames << " KiB uploaded/frame";
+    }
+    return out.str();
+}
+
+void MetricsExporter::writeJsonLine(double seconds)
+{
+    if (!m_jsonLines) {
+        return;
+    }
+    std::ostream& out = m_jsonLines;
+    out << "{\"time_s\":" << seconds
+        << ",\"interval_s\":" << m_intervalSeconds << ",\"counters\":{";
+    for (size_t i = 0; i < kCounterCount; ++i) {
+        out << (i > 0 ? "," : "") << '"' << metricCounterName(MetricCounter(i))
+            << "\":" << m_interval.counters[i];
+    }
+    out << "},\"histograms\":{";
+    for (size_t h = 0; h < kHistogramCount; ++h) {
+        const HistogramStats& histogram = m_interval.histograms[h];
+        out << (h > 0 ? "," : "") << '"'
+            << metricHistogramName(MetricHistogram(h))
+            << "\":{\"count\":" << histogram.count
+            << ",\"mean\":" << histogram.meanMs()
+            << ",\"p50\":" << histogram.quantileMs(0.5)
+            << ",\"p95\":" << histogram.quantileMs(0.95)
+            << ",\"p99\":" << histogram.quantileMs(0.99) << "}";
+    }
+    // One line per interval: flushed, so that it can be tailed
+    out << "}}\n" << std::flush;
+}
+
+void MetricsExporter::writePrometheus()
+{
+    // Written aside, then renamed over the previous dump, so that a reader
+    // never sees half of it
+    std::string   temporary = m_path + ".tmp";
+    std::ofstream out(temporary);
+    if (!out) {
+        std::cerr << "Could not write " << temporary << '\n';
+        return;
+    }
+    for (size_t i = 0; i < kCounterCount; ++i) {
+        std::string name =
+            std::string("wgputest_") + metricCounterName(MetricCounter(i)) +
+            "_total";
+        out << "# TYPE " << name << " counter\n"
+            << name << " " << m_total.counters[i] << "\n";
+    }
+    for (size_t h = 0; h < kHistogramCount; ++h) {
+        std::string name = std::string("wgputest_") +
+                           metricHistogramName(MetricHistogram(h));
+        const HistogramStats& histogram  = m_total.histograms[h];
+        uint64_t              cumulative = 0;
+        out << "# TYPE " << name << " histogram\n";
+        for (size_t i = 0; i + 1 < kHistogramBuckets; ++i) {
+            cumulative += histogram.buckets[i];
+            out << name << "_bucket{le=\"" << bucketBoundMs(i) << "\"} "
+                << cumulative << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << histogram.count << "\n"
+            << name << "_sum " << histogram.sumUs * 1e-3 << "\n"
+            << name << "_count " << histogram.count << "\n";
+    }
+    out.close();
+    std::error_code error;
+    std::filesystem::rename(temporary, m_path, error);
+    if (error) {
+        std::cerr << "Could not write " << m_path << ": " << error.message()
+                  << '\n';
+    }
+}
@@ -0,0 +1,262 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/**
+ * Events counted on the hot paths, see countMetric().
+ */
+enum class MetricCounter : uint32_t {
+    Frames,
+    Submits,
+    CommandBuffers,
+    UploadBytes,    // staging belt copies and frame ring writes
+    ReadbackBytes,  // handed to ReadbackRing callbacks
+    PipelineHits,   // PipelineRegistry lookups
+    PipelineMisses, // PipelineRegistry creations
+    BindingHits,    // BindingCache lookups
+    BindingMisses,  // BindingCache creations
+    BlobHits,       // on-disk BlobCache loads
+    BlobMisses,
+    Count
+};
+
+/**
+ * Durations sampled on the hot paths, see recordMetric().
+ */
+enum class MetricHistogram : uint32_t {
+    FrameMs,       // CPU time of Application::mainLoop(), waits included
+    EncodeMs,      // recording the commands of a frame
+    SubmitMs,      // ParallelRecorder::submit()
+    SurfaceWaitMs, // getCurrentTexture() of the window surface
+    Count
+};
+
+constexpr size_t kCounterCount   = size_t(MetricCounter::Count);
+constexpr size_t kHistogramCount = size_t(MetricHistogram::Count);
+// Bucket i holds the samples under kHistogramBaseUs << i microseconds, the
+// last one everything above
+constexpr size_t   kHistogramBuckets = 16;
+constexpr uint64_t kHistogramBaseUs  = 16;
+
+const char* metricCounterName(MetricCounter counter);
+const char* metricHistogramName(MetricHistogram histogram);
+
+/**
+ * Sum of the samples of a histogram over all the threads.
+ */
+struct HistogramStats
+{
+    std::array<uint64_t, kHistogramBuckets> buckets = {};
+    uint64_t                                count   = 0;
+    uint64_t                                sumUs   = 0;
+
+    double meanMs() const { return count > 0 ? sumUs * 1e-3 / count : 0; }
+    // Upper bound of the bucket holding the quantile `q` (0 to 1)
+    double quantileMs(double q) const;
+};
+
+/**
+ * Totals of every counter and histogram, over all the threads.
+ */
+struct MetricsSnapshot
+{
+    std::array<uint64_t, kCounterCount>         counters   = {};
+    std::array<HistogramStats, kHistogramCount> histograms = {};
+
+    uint64_t counter(MetricCounter c) const { return counters[size_t(c)]; }
+    const HistogramStats& histogram(MetricHistogram h) const
+    {
+        return histograms[size_t(h)];
+    }
+};
+
+// What happened between two snapshots
+MetricsSnapshot operator-(const MetricsSnapshot& a, const MetricsSnapshot& b);
+
+// Sum the slots of all the threads, those exited included, empty when
+// compiled out. Takes a lock that only the first countMetric() or
+// recordMetric() of a thread and thread exits contend for.
+MetricsSnapshot collectMetrics();
+
+#ifdef WGPUTEST_METRICS
+
+constexpr bool kMetricsEnabled = true;
+
+namespace metrics_detail {
+
+// The metrics of one thread. Only that thread writes them, with relaxed
+// loads and stores instead of read-modify-writes; collectMetrics() reads
+// them from another thread at any time.
+struct ThreadSlots
+{
+    using Buckets = std::array<std::atomic<uint64_t>, kHistogramBuckets>;
+
+    std::array<std::atomic<uint64_t>, kCounterCount>   counters = {};
+    std::array<Buckets, kHistogramCount>               buckets  = {};
+    std::array<std::atomic<uint64_t>, kHistogramCount> sumsUs   = {};
+};
+
+// Registered on first use. When the thread exits, its totals are added to
+// those of the exited threads and its slots are freed.
+ThreadSlots* registerThread();
+void         retireThread(ThreadSlots* slots);
+
+struct ThreadRegistration
+{
+    ThreadSlots* slots = registerThread();
+
+    ~ThreadRegistration() { retireThread(slots); }
+};
+
+inline ThreadSlots& threadSlots()
+{
+    thread_local ThreadRegistration registration;
+    return *registration.slots;
+}
+
+inline void add(std::atomic<uint64_t>& slot, uint64_t value)
+{
+    slot.store(
+        slot.load(std::memory_order_relaxed) + value,
+        std::memory_order_relaxed);
+}
+
+} // namespace metrics_detail
+
+inline void countMetric(MetricCounter counter, uint64_t value = 1)
+{
+    metrics_detail::add(
+        metrics_detail::threadSlots().counters[size_t(counter)], value);
+}
+
+inline void recordMetric(MetricHistogram histogram, double ms)
+{
+    uint64_t us     = ms > 0 ? uint64_t(ms * 1000) : 0;
+    size_t   bucket = std::bit_width(us / kHistogramBaseUs);
+    bucket          = bucket < kHistogramBuckets ? bucket :
+                                                   kHistogramBuckets - 1;
+    metrics_detail::ThreadSlots& slots = metrics_detail::threadSlots();
+    metrics_detail::add(slots.buckets[size_t(histogram)][bucket], 1);
+    metrics_detail::add(slots.sumsUs[size_t(histogram)], us);
+}
+
+#else
+
+constexpr bool kMetricsEnabled = false;
+
+inline void countMetric(MetricCounter, uint64_t = 1) {}
+inline void recordMetric(MetricHistogram, double) {}
+
+#endif // WGPUTEST_METRICS
+
+/**
+ * Records the lifetime of the scope into a histogram; reads no clock when
+ * the metrics are compiled out.
+ */
+class MetricTimer
+{
+public:
+    explicit MetricTimer(MetricHistogram histogram) : m_histogram(histogram)
+    {
+        if constexpr (kMetricsEnabled) {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~MetricTimer() { stop(); }
+
+    MetricTimer(const MetricTimer&)            = delete;
+    MetricTimer& operator=(const MetricTimer&) = delete;
+
+    // Record now rather than at the end of the scope
+    void stop()
+    {
+        if constexpr (kMetricsEnabled) {
+            if (m_stopped) {
+                return;
+            }
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - m_start;
+            recordMetric(m_histogram, elapsed.count());
+            m_stopped = true;
+        }
+    }
+
+private:
+    MetricHistogram                       m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+    bool                                  m_stopped = false;
+};
+
+/**
+ * How a MetricsExporter writes the metrics: JSON lines are appended, one
+ * per interval with what it did; the Prometheus text dump is rewritten with
+ * the totals, e.g. for the textfile collector of node_exporter.
+ */
+enum class MetricsFormat { JsonLines, Prometheus };
+
+/**
+ * Aggregates the metrics of all the threads once per frame and exports them
+ * to a file every interval:
+ *     MetricsExporter exporter("metrics.jsonl", MetricsFormat::JsonLines);
+ *     ...
+ *     exporter.onFrame(); // once per frame
+ *
+ * Compiled out (WGPUTEST_METRICS off), the metrics are all zero.
+ */
+class MetricsExporter
+{
+public:
+    MetricsExporter(
+        std::string   path,
+        MetricsFormat format,
+        double        intervalSeconds = 1);
+    // Exports what the last interval did not
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&)            = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    // Aggregate the threads; export if the interval has elapsed. Returns
+    // true if it exported.
+    bool onFrame();
+
+    // Export now
+    void flush();
+
+    // Totals as of the last onFrame(), and what the last exported interval
+    // did
+    const MetricsSnapshot& total() const { return m_total; }
+    const MetricsSnapshot& lastInterval() const { return m_interval; }
+
+    // One line on the last interval: frame rate, frame time, submits...
+    // e.g. for a window title
+    std::string summary() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void writeJsonLine(double seconds);
+    void writePrometheus();
+
+    std::string       m_path;
+    MetricsFormat     m_format;
+    Clock::duration   m_period;
+    Clock::time_point m_start;
+    Clock::time_point m_exportedAt;
+    MetricsSnapshot   m_total;
+    MetricsSnapshot   m_exported; // total at the last export
+    MetricsSnapshot   m_interval;
+    double            m_intervalSeconds = 0;
+    std::ofstream     m_jsonLines;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,236 @@
+#include "microbench.h"
+
+#include "webgpu-async.h"
+#include "webgpu-utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+
+namespace {
+
+struct MicrobenchEntry
+{
+    std::string        description;
+    MicrobenchFunction function;
+};
+
+std::map<std::string, MicrobenchEntry, std::less<>>& microbenchRegistry()
+{
+    static std::map<std::string, MicrobenchEntry, std::less<>> registry;
+    return registry;
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    // Nearest-rank percentile
+    size_t rank = (size_t) std::ceil(p / 100.0 * sorted.size());
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+} // namespace
+
+bool parseBenchOptions(int argc, char* argv[], int first, BenchOptions& opts)
+{
+    for (int i = first; i < argc; ++i) {
+        std::string_view arg  = argv[i];
+        bool             last = i + 1 >= argc;
+        if (arg == "--backend" && !last) {
+            std::string_view backend = argv[++i];
+            if (backend == "null") {
+                opts.backend       = WGPUBackendType_Null;
+                opts.forceFallback = false;
+            }
+            else if (backend == "swiftshader") {
+                opts.backend       = WGPUBackendType_Vulkan;
+                opts.forceFallback = true;
+            }
+            else if (backend == "default") {
+                opts.backend       = WGPUBackendType_Undefined;
+                opts.forceFallback = false;
+            }
+            else {
+                std::cerr << "Unknown backend: " << backend << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--iterations" && !last) {
+            opts.iterations = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--out" && !last) {
+            opts.outputPath = argv[++i];
+        }
+        else if (arg == "--trace" && !last) {
+            opts.tracePath = argv[++i];
+        }
+        else if (arg == "--frames-in-flight" && !last) {
+            opts.framesInFlight = std::clamp(std::atoi(argv[++i]), 1, 3);
+        }
+        else if (arg == "--max-fps" && !last) {
+            opts.maxFps = std::max(0.0, std::atof(argv[++i]));
+        }
+        else {
+            std::cerr << "Unknown benchmark option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+SampleStats computeSampleStats(std::vector<double> samples)
+{
+    SampleStats stats;
+    if (samples.empty())
+        return stats;
+    std::sort(samples.begin(), samples.end());
+    stats.count = samples.size();
+    stats.min   = samples.front();
+    stats.max   = samples.back();
+    stats.mean =
+        std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    stats.p50 = percentile(samples, 50);
+    stats.p95 = percentile(samples, 95);
+    stats.p99 = percentile(samples, 99);
+    double sumSquares = 0;
+    for (double sample : samples) {
+        sumSquares += (sample - stats.mean) * (sample - stats.mean);
+    }
+    stats.stddev = std::sqrt(sumSquares / samples.size());
+    return stats;
+}
+
+void writeSampleStatsJson(std::ostream& out, const SampleStats& stats)
+{
+    out << "{\"count\": " << stats.count << ", \"min\": " << stats.min
+        << ", \"max\": " << stats.max << ", \"mean\": " << stats.mean
+        << ", \"p50\": " << stats.p50 << ", \"p95\": " << stats.p95
+        << ", \"p99\": " << stats.p99 << ", \"stddev\": " << stats.stddev
+        << "}";
+}
+
+void BenchReport::writeJson(std::ostream& out) const
+{
+    out << "{\n  \"benchmark\": \"" << m_name << "\"";
+    for (const auto& [name, stats] : m_series) {
+        out << ",\n  \"" << name << "\": ";
+        writeSampleStatsJson(out, stats);
+    }
+    for (const auto& [name, value] : m_values) {
+        out << ",\n  \"" << name << "\": " << value;
+    }
+    out << "\n}\n";
+}
+
+bool BenchReport::write(const BenchOptions& opts) const
+{
+    if (opts.outputPath.empty()) {
+        writeJson(std::cout);
+        return true;
+    }
+    std::ofstream file(opts.outputPath);
+    if (!file) {
+        std::cerr << "Could not open " << opts.outputPath << std::endl;
+        return false;
+    }
+    writeJson(file);
+    return true;
+}
+
+BenchContext::~BenchContext()
+{
+    if (queue)
+        wgpuQueueRelease(queue);
+    if (device)
+        wgpuDeviceRelease(device);
+    if (adapter)
+        wgpuAdapterRelease(adapter);
+    if (instance)
+        wgpuInstanceRelease(instance);
+}
+
+void fillAdapterOptions(
+    const BenchOptions&        opts,
+    WGPURequestAdapterOptions& adapterOpts)
+{
+    adapterOpts.backendType          = opts.backend;
+    adapterOpts.forceFallbackAdapter = opts.forceFallback;
+}
+
+bool BenchContext::open(
+    const BenchOptions&         opts,
+    const WGPUDeviceDescriptor* deviceDesc)
+{
+    auto fail = [](const char* object) {
+        std::cerr << "Could not create " << object << " for the benchmark\n";
+        return false;
+    };
+
+    instance = createInstanceWithTimedWait();
+    if (!instance)
+        return fail("an instance");
+
+    WGPURequestAdapterOptions adapterOpts = WGPU_REQUEST_ADAPTER_OPTIONS_INIT;
+    fillAdapterOptions(opts, adapterOpts);
+    adapter = requestAdapterSync(instance, &adapterOpts);
+    if (!adapter)
+        return fail("an adapter");
+
+    WGPUDeviceDescriptor defaultDesc = WGPU_DEVICE_DESCRIPTOR_INIT;
+    device = requestDeviceSync(
+        instance, adapter, deviceDesc ? deviceDesc : &defaultDesc);
+    if (!device)
+        return fail("a device");
+
+    queue = wgpuDeviceGetQueue(device);
+    return true;
+}
+
+WGPUBuffer BenchContext::createBuffer(
+    WGPUBufferUsage usage,
+    uint64_t        size,
+    const void*     data,
+    const char*     label) const
+{
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    if (label) {
+        desc.label = {label, WGPU_STRLEN};
+    }
+    desc.usage        = data ? usage | WGPUBufferUsage_CopyDst : usage;
+    desc.size         = size;
+    WGPUBuffer buffer = wgpuDeviceCreateBuffer(device, &desc);
+    if (data) {
+        wgpuQueueWriteBuffer(queue, buffer, 0, data, size);
+    }
+    return buffer;
+}
+
+bool registerMicrobenchmark(
+    const char*        name,
+    const char*        description,
+    MicrobenchFunction function)
+{
+    microbenchRegistry()[name] = {description, std::move(function)};
+    return true;
+}
+
+int runMicrobenchmark(std::string_view name, const BenchOptions& opts)
+{
+    auto& registry = microbenchRegistry();
+    auto  it       = registry.find(name);
+    if (it == registry.end()) {
+        std::cerr << "Unknown microbenchmark '" << name
+                  << "'. Available:" << std::endl;
+        for (const auto& [benchName, entry] : registry) {
+            std::cerr << " - " << benchName << ": " << entry.description
+                      << std::endl;
+        }
+        return 1;
+    }
+    return it->second.function(opts);
+}
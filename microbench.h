@@ -0,0 +1,168 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <webgpu/webgpu.h>
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Command line options shared by all the microbenchmarks.
+ */
+struct BenchOptions
+{
+    // Null is Dawn's no-op backend; SwiftShader is Vulkan with
+    // forceFallbackAdapter set
+    WGPUBackendType backend       = WGPUBackendType_Null;
+    bool            forceFallback = false;
+    unsigned int    iterations    = 20;
+    std::string     outputPath; // empty means stdout
+    std::string     tracePath;  // Chrome trace output, where supported
+    // Frame scheduling of the benchmarks that run the Application
+    unsigned int framesInFlight = 2;
+    double       maxFps         = 0;
+};
+
+/**
+ * Parse "--backend null|swiftshader|default", "--iterations N",
+ * "--out FILE", "--trace FILE", "--frames-in-flight N" and "--max-fps F"
+ * from argv, starting at `first`. Return false on error.
+ */
+bool parseBenchOptions(int argc, char* argv[], int first, BenchOptions& opts);
+
+/**
+ * Summary of a set of samples, in the unit the samples were recorded in.
+ */
+struct SampleStats
+{
+    size_t count  = 0;
+    double min    = 0;
+    double max    = 0;
+    double mean   = 0;
+    double p50    = 0;
+    double p95    = 0;
+    double p99    = 0;
+    double stddev = 0; // population standard deviation, i.e. the jitter
+};
+
+SampleStats computeSampleStats(std::vector<double> samples);
+
+/**
+ * Write `stats` as a JSON object (no trailing newline).
+ */
+void writeSampleStatsJson(std::ostream& out, const SampleStats& stats);
+
+/**
+ * Milliseconds elapsed since `start`.
+ */
+inline double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+/**
+ * Collects named results of a benchmark run and writes them as one JSON
+ * object.
+ */
+class BenchReport
+{
+    std::string                                      m_name;
+    std::vector<std::pair<std::string, SampleStats>> m_series;
+    std::vector<std::pair<std::string, double>>      m_values;
+
+public:
+    explicit BenchReport(std::string name) : m_name(std::move(name)) {}
+
+    void addSeries(std::string name, std::vector<double> samples)
+    {
+        m_series.emplace_back(
+            std::move(name), computeSampleStats(std::move(samples)));
+    }
+
+    void addValue(std::string name, double value)
+    {
+        m_values.emplace_back(std::move(name), value);
+    }
+
+    void writeJson(std::ostream& out) const;
+
+    // Write to opts.outputPath, or stdout if it is empty
+    bool write(const BenchOptions& opts) const;
+};
+
+/**
+ * A headless WebGPU instance/adapter/device triple for benchmarks.
+ */
+struct BenchContext
+{
+    WGPUInstance instance = nullptr;
+    WGPUAdapter  adapter  = nullptr;
+    WGPUDevice   device   = nullptr;
+    WGPUQueue    queue    = nullptr;
+
+    BenchContext() = default;
+    BenchContext(const BenchContext&)            = delete;
+    BenchContext& operator=(const BenchContext&) = delete;
+    ~BenchContext();
+
+    // `deviceDesc` may chain extra structs into the device request. Logs
+    // what could not be created on failure.
+    bool open(
+        const BenchOptions&         opts,
+        const WGPUDeviceDescriptor* deviceDesc = nullptr);
+
+    // A buffer of `size` bytes. If `data` is given, CopyDst is added to
+    // `usage` and the data is written through the queue.
+    WGPUBuffer createBuffer(
+        WGPUBufferUsage usage,
+        uint64_t        size,
+        const void*     data  = nullptr,
+        const char*     label = nullptr) const;
+};
+
+/**
+ * Fill adapter options so that they select the backend of `opts`.
+ */
+void fillAdapterOptions(
+    const BenchOptions&        opts,
+    WGPURequestAdapterOptions& adapterOpts);
+
+using MicrobenchFunction = std::function<int(const BenchOptions&)>;
+
+/**
+ * Register a microbenchmark under `name`; used by MICROBENCHMARK.
+ */
+bool registerMicrobenchmark(
+    const char*        name,
+    const char*        description,
+    MicrobenchFunction function);
+
+/**
+ * Run the microbenchmark `name` and return its exit code, or list all
+ * registered benchmarks if it does not exist.
+ */
+int runMicrobenchmark(std::string_view name, const BenchOptions& opts);
+
+#define MICROBENCH_CONCAT_IMPL(a, b) a##b
+#define MICROBENCH_CONCAT(a, b)      MICROBENCH_CONCAT_IMPL(a, b)
+
+/**
+ * Define and register a microbenchmark:
+ *     MICROBENCHMARK("name", "what it measures") { ...; return 0; }
+ */
+#define MICROBENCHMARK(name, description)                                      \
+    static int MICROBENCH_CONCAT(microbench_, __LINE__)(const BenchOptions&); \
+    static const bool MICROBENCH_CONCAT(microbenchRegistered_, __LINE__) =     \
+        registerMicrobenchmark(                                                \
+            name, description, MICROBENCH_CONCAT(microbench_, __LINE__));      \
+    static int MICROBENCH_CONCAT(microbench_, __LINE__)(                       \
+        [[maybe_unused]] const BenchOptions& opts)
+
+#endif // MICROBENCH_H
@@ -0,0 +1,74 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+/**
+ * Unbounded multiple-producer single-consumer queue (Vyukov's linked
+ * list). push() never blocks: one node allocation and one atomic exchange.
+ * pop() belongs to a single consumer thread.
+ *
+ * An element being pushed becomes visible once its producer links it, so
+ * pop() may briefly miss an element that another thread already started
+ * pushing; it shows up on the next call.
+ */
+template<typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : m_head(new Node), m_tail(m_head.load()) {}
+
+    ~MpscQueue()
+    {
+        while (pop()) {
+        }
+        delete m_tail;
+    }
+
+    MpscQueue(const MpscQueue&)            = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Any thread
+    void push(T value)
+    {
+        Node* node = new Node;
+        node->value.emplace(std::move(value));
+        Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Consumer thread only
+    std::optional<T> pop()
+    {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+            return std::nullopt;
+        // `next` becomes the empty sentinel
+        std::optional<T> value = std::move(next->value);
+        next->value.reset();
+        m_tail = next;
+        delete tail;
+        return value;
+    }
+
+    // Consumer thread only
+    bool empty() const
+    {
+        return m_tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next = nullptr;
+        std::optional<T>   value;
+    };
+
+    alignas(64) std::atomic<Node*> m_head; // last pushed
+    alignas(64) Node* m_tail;              // sentinel before the next pop
+};
+
+#endif // MPSC_QUEUE_H
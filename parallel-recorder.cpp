@@ -0,0 +1,225 @@
+#include "parallel-recorder.h"
+
+#include "metrics.h"
+
+#include <cassert>
+#include <chrono>
+
+const char* submitStageName(SubmitStage stage)
+{
+    switch (stage) {
+    case SubmitStage::Upload:
+        return "Upload";
+    case SubmitStage::Compute:
+        return "Compute";
+    case SubmitStage::Render:
+        return "Render";
+    case SubmitStage::Readback:
+        return "Readback";
+    case SubmitStage::Count:
+        break;
+    }
+    return "Unknown";
+}
+
+bool supportsParallelRecording(WGPUDevice device)
+{
+#ifdef WEBGPU_BACKEND_DAWN
+    // Dawn objects are not internally synchronized unless this is enabled
+    return wgpuDeviceHasFeature(
+        device, WGPUFeatureName_ImplicitDeviceSynchronization);
+#else
+    // wgpu-native objects are thread-safe
+    (void) device;
+    return true;
+#endif
+}
+
+ParallelRecorder::ParallelRecorder(JobSystem& jobs, WGPUDevice device) :
+        m_jobs(jobs), m_device(device),
+        m_parallel(jobs.threadCount() > 1 && supportsParallelRecording(device)),
+        m_owner(std::this_thread::get_id())
+{
+}
+
+ParallelRecorder::~ParallelRecorder()
+{
+    releaseBundles();
+    for (size_t stage = 0; stage < kStageCount; ++stage) {
+        if (m_encoders[stage]) {
+            wgpuCommandEncoderRelease(m_encoders[stage]);
+        }
+        for (WGPUCommandBuffer commandBuffer : m_stages[stage]) {
+            wgpuCommandBufferRelease(commandBuffer);
+        }
+    }
+}
+
+const std::vector<WGPURenderBundle>& ParallelRecorder::recordBundles(
+    const RenderBundleTarget& target,
+    uint32_t                  chunkCount,
+    const BundleFunction&     record)
+{
+    assert(std::this_thread::get_id() == m_owner);
+    releaseBundles();
+    m_bundles.resize(chunkCount, nullptr);
+    // Made on this thread: the arena is not thread-safe
+    WGPUStringView* labels = m_arena.make<WGPUStringView>(chunkCount);
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+        labels[chunk] = m_arena.label("Parallel bundle ", chunk);
+    }
+
+    forEachChunk(chunkCount, [&](uint32_t chunk) {
+        WGPURenderBundleEncoderDescriptor encoderDesc =
+            WGPU_RENDER_BUNDLE_ENCODER_DESCRIPTOR_INIT;
+        encoderDesc.label              = labels[chunk];
+        encoderDesc.colorFormatCount   = target.colorFormats.size();
+        encoderDesc.colorFormats       = target.colorFormats.data();
+        encoderDesc.depthStencilFormat = target.depthStencilFormat;
+        encoderDesc.sampleCount        = target.sampleCount;
+        WGPURenderBundleEncoder encoder =
+            wgpuDeviceCreateRenderBundleEncoder(m_device, &encoderDesc);
+        record(chunk, encoder);
+        WGPURenderBundleDescriptor bundleDesc =
+            WGPU_RENDER_BUNDLE_DESCRIPTOR_INIT;
+        bundleDesc.label = encoderDesc.label;
+        // Each job writes its own slot, no lock needed
+        m_bundles[chunk] = wgpuRenderBundleEncoderFinish(encoder, &bundleDesc);
+        wgpuRenderBundleEncoderRelease(encoder);
+    });
+    return m_bundles;
+}
+
+void ParallelRecorder::recordCommandBuffers(
+    uint32_t               chunkCount,
+    const CommandFunction& record,
+    SubmitStage            stage)
+{
+    assert(std::this_thread::get_id() == m_owner);
+    closeEncoder(stage);
+    std::vector<WGPUCommandBuffer>& batch = m_stages[size_t(stage)];
+    size_t                          first = batch.size();
+    batch.resize(first + chunkCount, nullptr);
+    WGPUStringView* labels = m_arena.make<WGPUStringView>(chunkCount);
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+        labels[chunk] = m_arena.label("Parallel commands ", chunk);
+    }
+
+    forEachChunk(chunkCount, [&](uint32_t chunk) {
+        WGPUCommandEncoderDescriptor encoderDesc =
+            WGPU_COMMAND_ENCODER_DESCRIPTOR_INIT;
+        encoderDesc.label = labels[chunk];
+        WGPUCommandEncoder encoder =
+            wgpuDeviceCreateCommandEncoder(m_device, &encoderDesc);
+        record(chunk, encoder);
+        WGPUCommandBufferDescriptor commandDesc =
+            WGPU_COMMAND_BUFFER_DESCRIPTOR_INIT;
+        commandDesc.label = encoderDesc.label;
+        batch[first + chunk] = wgpuCommandEncoderFinish(encoder, &commandDesc);
+        wgpuCommandEncoderRelease(encoder);
+    });
+}
+
+void ParallelRecorder::append(
+    WGPUCommandBuffer commandBuffer,
+    SubmitStage       stage)
+{
+    assert(std::this_thread::get_id() == m_owner);
+    if (!commandBuffer)
+        return;
+    closeEncoder(stage);
+    m_stages[size_t(stage)].push_back(commandBuffer);
+}
+
+WGPUCommandEncoder ParallelRecorder::encoder(SubmitStage stage)
+{
+    assert(std::this_thread::get_id() == m_owner);
+    WGPUCommandEncoder& encoder = m_encoders[size_t(stage)];
+    if (!encoder) {
+        WGPUCommandEncoderDescriptor encoderDesc =
+            WGPU_COMMAND_ENCODER_DESCRIPTOR_INIT;
+        encoderDesc.label = {submitStageName(stage), WGPU_STRLEN};
+        encoder = wgpuDeviceCreateCommandEncoder(m_device, &encoderDesc);
+        ++m_stats.encoders;
+    }
+    return encoder;
+}
+
+void ParallelRecorder::submit(WGPUQueue queue)
+{
+    assert(std::this_thread::get_id() == m_owner);
+    auto start = std::chrono::steady_clock::now();
+    m_batch.clear();
+    for (size_t stage = 0; stage < kStageCount; ++stage) {
+        closeEncoder(SubmitStage(stage));
+        m_batch.insert(
+            m_batch.end(), m_stages[stage].begin(), m_stages[stage].end());
+        m_stages[stage].clear();
+    }
+    m_arena.reset();
+    if (m_batch.empty())
+        return;
+    wgpuQueueSubmit(queue, m_batch.size(), m_batch.data());
+    for (WGPUCommandBuffer commandBuffer : m_batch) {
+        wgpuCommandBufferRelease(commandBuffer);
+    }
+    ++m_stats.submits;
+    m_stats.commandBuffers += m_batch.size();
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    m_stats.submitMs += elapsed.count();
+    countMetric(MetricCounter::Submits);
+    countMetric(MetricCounter::CommandBuffers, m_batch.size());
+    recordMetric(MetricHistogram::SubmitMs, elapsed.count());
+    m_batch.clear();
+}
+
+size_t ParallelRecorder::pendingCount() const
+{
+    size_t count = 0;
+    for (size_t stage = 0; stage < kStageCount; ++stage) {
+        count += m_stages[stage].size() + (m_encoders[stage] ? 1 : 0);
+    }
+    return count;
+}
+
+void ParallelRecorder::forEachChunk(
+    uint32_t                             chunkCount,
+    const std::function<void(uint32_t)>& function)
+{
+    if (!m_parallel) {
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+            function(chunk);
+        }
+        return;
+    }
+    m_jobs.parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk = begin; chunk < end; ++chunk) {
+            function(chunk);
+        }
+    });
+}
+
+void ParallelRecorder::releaseBundles()
+{
+    for (WGPURenderBundle bundle : m_bundles) {
+        if (bundle) {
+            wgpuRenderBundleRelease(bundle);
+        }
+    }
+    m_bundles.clear();
+}
+
+void ParallelRecorder::closeEncoder(SubmitStage stage)
+{
+    WGPUCommandEncoder& encoder = m_encoders[size_t(stage)];
+    if (!encoder)
+        return;
+    WGPUCommandBufferDescriptor commandDesc =
+        WGPU_COMMAND_BUFFER_DESCRIPTOR_INIT;
+    commandDesc.label = {submitStageName(stage), WGPU_STRLEN};
+    m_stages[size_t(stage)].push_back(
+        wgpuCommandEncoderFinish(encoder, &commandDesc));
+    wgpuCommandEncoderRelease(encoder);
+    encoder = nullptr;
+}
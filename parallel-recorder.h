@@ -0,0 +1,141 @@
+#ifndef PARALLEL_RECORDER_H
+#define PARALLEL_RECORDER_H
+
+#include "frame-arena.h"
+#include "job-system.h"
+#include "render-bundle-cache.h"
+
+#include <webgpu/webgpu.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+ * Where the command buffers of a frame go in its single submit: each stage
+ * may depend on the ones before it.
+ */
+enum class SubmitStage : uint32_t {
+    Upload,   // staging copies, read by everything after
+    Compute,  // e.g. culling, which writes the indirect draws
+    Render,
+    Readback, // copies out of the frame, e.g. captures
+    Count
+};
+
+const char* submitStageName(SubmitStage stage);
+
+/**
+ * Records GPU commands on the threads of a JobSystem and submits all the
+ * command buffers of a frame in a single ordered batch: by stage, then in
+ * the order they were recorded within a stage. Subsystems recording on the
+ * owner thread share one encoder per stage:
+ *     recorder.append(belt.finish(), SubmitStage::Upload);
+ *     culler.cull(recorder.encoder(SubmitStage::Compute), view);
+ *     ... recorder.encoder(SubmitStage::Render) ...
+ *     recorder.submit(queue); // one queue submit
+ *
+ * Transient descriptors and labels of the frame come from arena(), reset
+ * by submit().
+ *
+ * Threading rules, checked with assertions:
+ *  - the recorder is used from the thread that created it (the owner);
+ *  - each chunk gets its own encoder, used by one worker only;
+ *  - only the owner submits, so the queue is never used concurrently.
+ * With Dawn, concurrent use of the device (creating encoders on workers)
+ * needs the ImplicitDeviceSynchronization feature; without it the chunks
+ * are recorded one after the other on the owner thread.
+ */
+class ParallelRecorder
+{
+public:
+    using BundleFunction =
+        std::function<void(uint32_t chunk, WGPURenderBundleEncoder encoder)>;
+    using CommandFunction =
+        std::function<void(uint32_t chunk, WGPUCommandEncoder encoder)>;
+
+    struct Stats
+    {
+        uint64_t submits        = 0;
+        uint64_t commandBuffers = 0; // submitted
+        uint64_t encoders       = 0; // stage encoders created
+        double   submitMs       = 0; // CPU time of submit()
+    };
+
+    ParallelRecorder(JobSystem& jobs, WGPUDevice device);
+    ~ParallelRecorder();
+
+    ParallelRecorder(const ParallelRecorder&)            = delete;
+    ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+
+    // True if chunks are recorded on several threads
+    bool parallel() const { return m_parallel; }
+
+    // Record `chunkCount` render bundles concurrently. They are returned in
+    // chunk order, to be executed in one pass, and stay valid until the next
+    // call.
+    const std::vector<WGPURenderBundle>& recordBundles(
+        const RenderBundleTarget& target,
+        uint32_t                  chunkCount,
+        const BundleFunction&     record);
+
+    // Record `chunkCount` command buffers concurrently and append them to
+    // `stage`, in chunk order
+    void recordCommandBuffers(
+        uint32_t               chunkCount,
+        const CommandFunction& record,
+        SubmitStage            stage = SubmitStage::Render);
+
+    // Append a command buffer recorded by the owner to `stage`; the batch
+    // takes it over. Null ones are ignored.
+    void append(
+        WGPUCommandBuffer commandBuffer,
+        SubmitStage       stage = SubmitStage::Render);
+
+    // The encoder of `stage` for this frame, created on first use and
+    // finished by submit(). Command buffers appended to the stage later go
+    // after its commands, and the next call starts another encoder.
+    WGPUCommandEncoder encoder(SubmitStage stage = SubmitStage::Render);
+
+    // Submit the pending command buffers with one queue submit, stage by
+    // stage, then reset the arena
+    void submit(WGPUQueue queue);
+
+    size_t pendingCount() const;
+
+    // Transient CPU data of the frame being recorded, see FrameArena
+    FrameArena& arena() { return m_arena; }
+
+    Stats stats() const { return m_stats; }
+
+private:
+    void forEachChunk(
+        uint32_t                             chunkCount,
+        const std::function<void(uint32_t)>& function);
+    void releaseBundles();
+    // Finish the encoder of `stage`, if any, into its command buffers
+    void closeEncoder(SubmitStage stage);
+
+    static constexpr size_t kStageCount = size_t(SubmitStage::Count);
+
+    JobSystem&                     m_jobs;
+    WGPUDevice                     m_device   = nullptr;
+    bool                           m_parallel = false;
+    std::thread::id                m_owner;
+    std::vector<WGPURenderBundle>  m_bundles;
+    std::vector<WGPUCommandBuffer> m_batch; // kept for its capacity
+    FrameArena                     m_arena;
+    Stats                          m_stats;
+
+    std::array<std::vector<WGPUCommandBuffer>, kStageCount> m_stages;
+    std::array<WGPUCommandEncoder, kStageCount>             m_encoders = {};
+};
+
+/**
+ * True if `device` may be used from several threads at once.
+ */
+bool supportsParallelRecording(WGPUDevice device);
+
+#endif // PARALLEL_RECORDER_H
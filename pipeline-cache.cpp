@@ -0,0 +1,457 @@
+#include "pipeline-cache.h"
+
+#include "hashing.h"
+#include "metrics.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t kBlobMagic = 0x42504757; // "WGPB"
+
+WGPUStringView toStringView(const std::string& text)
+{
+    return {text.data(), text.size()};
+}
+
+double msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+} // namespace
+
+uint64_t hashPipelineSpec(const RenderPipelineSpec& spec)
+{
+    Hasher hasher;
+    hasher.add(std::string_view(spec.shaderSource))
+        .add(std::string_view(spec.vertexEntry))
+        .add(std::string_view(spec.fragmentEntry))
+        .add(spec.vertexBuffers.size());
+    for (const VertexBufferSpec& buffer : spec.vertexBuffers) {
+        hasher.add(buffer.arrayStride)
+            .add(buffer.stepMode)
+            .add(buffer.attributes.size());
+        for (const VertexAttributeSpec& attribute : buffer.attributes) {
+            hasher.add(attribute.format)
+                .add(attribute.offset)
+                .add(attribute.shaderLocation);
+        }
+    }
+    hasher.add(spec.colorFormats.size());
+    for (WGPUTextureFormat format : spec.colorFormats) {
+        hasher.add(format);
+    }
+    hasher.add(spec.alphaBlending)
+        .add(spec.topology)
+        .add(spec.cullMode)
+        .add(spec.depthFormat)
+        .add(spec.depthCompare)
+        .add(spec.depthWrite)
+        .add(spec.sampleCount)
+        .add(spec.layout);
+    return hasher.value();
+}
+
+uint64_t hashPipelineSpec(const ComputePipelineSpec& spec)
+{
+    return Hasher()
+        .add(std::string_view(spec.shaderSource))
+        .add(std::string_view(spec.entryPoint))
+        .add(spec.layout)
+        .value();
+}
+
+RenderPipelineDescriptor::RenderPipelineDescriptor(
+    const RenderPipelineSpec& spec,
+    WGPUShaderModule          module)
+{
+    // Translate the owned spec into the C descriptor chain
+    for (const VertexBufferSpec& bufferSpec : spec.vertexBuffers) {
+        auto& bufferAttributes = m_attributes.emplace_back();
+        for (const VertexAttributeSpec& attributeSpec : bufferSpec.attributes) {
+            WGPUVertexAttribute attribute = {};
+            attribute.format              = attributeSpec.format;
+            attribute.offset              = attributeSpec.offset;
+            attribute.shaderLocation      = attributeSpec.shaderLocation;
+            bufferAttributes.push_back(attribute);
+        }
+        WGPUVertexBufferLayout layout = WGPU_VERTEX_BUFFER_LAYOUT_INIT;
+        layout.arrayStride            = bufferSpec.arrayStride;
+        layout.stepMode               = bufferSpec.stepMode;
+        layout.attributeCount         = bufferAttributes.size();
+        layout.attributes             = bufferAttributes.data();
+        m_buffers.push_back(layout);
+    }
+
+    m_blend                 = {};
+    m_blend.color.operation = WGPUBlendOperation_Add;
+    m_blend.color.srcFactor = WGPUBlendFactor_SrcAlpha;
+    m_blend.color.dstFactor = WGPUBlendFactor_OneMinusSrcAlpha;
+    m_blend.alpha.operation = WGPUBlendOperation_Add;
+    m_blend.alpha.srcFactor = WGPUBlendFactor_Zero;
+    m_blend.alpha.dstFactor = WGPUBlendFactor_One;
+
+    for (WGPUTextureFormat format : spec.colorFormats) {
+        WGPUColorTargetState target = WGPU_COLOR_TARGET_STATE_INIT;
+        target.format               = format;
+        target.blend                = spec.alphaBlending ? &m_blend : nullptr;
+        target.writeMask            = WGPUColorWriteMask_All;
+        m_targets.push_back(target);
+    }
+
+    m_fragment             = WGPU_FRAGMENT_STATE_INIT;
+    m_fragment.module      = module;
+    m_fragment.entryPoint  = toStringView(spec.fragmentEntry);
+    m_fragment.targetCount = m_targets.size();
+    m_fragment.targets     = m_targets.data();
+
+    m_depthStencil        = WGPU_DEPTH_STENCIL_STATE_INIT;
+    m_depthStencil.format = spec.depthFormat;
+    m_depthStencil.depthWriteEnabled =
+        spec.depthWrite ? WGPUOptionalBool_True : WGPUOptionalBool_False;
+    m_depthStencil.depthCompare = spec.depthCompare;
+
+    m_desc                    = WGPU_RENDER_PIPELINE_DESCRIPTOR_INIT;
+    m_desc.label              = toStringView(spec.label);
+    m_desc.layout             = spec.layout;
+    m_desc.vertex.module      = module;
+    m_desc.vertex.entryPoint  = toStringView(spec.vertexEntry);
+    m_desc.vertex.bufferCount = m_buffers.size();
+    m_desc.vertex.buffers     = m_buffers.data();
+    m_desc.primitive.topology = spec.topology;
+    m_desc.primitive.cullMode = spec.cullMode;
+    m_desc.multisample.count  = spec.sampleCount;
+    m_desc.multisample.mask   = ~0u;
+    m_desc.depthStencil = spec.depthFormat != WGPUTextureFormat_Undefined ?
+                              &m_depthStencil :
+                              nullptr;
+    m_desc.fragment     = m_targets.empty() ? nullptr : &m_fragment;
+}
+
+WGPUComputePipelineDescriptor computePipelineDescriptor(
+    const ComputePipelineSpec& spec,
+    WGPUShaderModule           module)
+{
+    WGPUComputePipelineDescriptor desc = WGPU_COMPUTE_PIPELINE_DESCRIPTOR_INIT;
+    desc.label                         = toStringView(spec.label);
+    desc.layout                        = spec.layout;
+    desc.compute.module                = module;
+    desc.compute.entryPoint            = toStringView(spec.entryPoint);
+    return desc;
+}
+
+BlobCache::BlobCache(std::filesystem::path directory) :
+        m_directory(std::move(directory))
+{
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error) {
+        std::cerr << "Could not create cache directory " << m_directory
+                  << ": " << error.message() << std::endl;
+    }
+}
+
+std::filesystem::path BlobCache::entryPath(std::string_view key) const
+{
+    char name[17];
+    std::snprintf(
+        name,
+        sizeof(name),
+        "%016llx",
+        (unsigned long long) hashBytes(key.data(), key.size()));
+    return m_directory / name;
+}
+
+size_t BlobCache::load(
+    const void* key,
+    size_t      keySize,
+    void*       value,
+    size_t      valueSize)
+{
+    std::string                 keyString((const char*) key, keySize);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(keyString);
+    if (it == m_entries.end()) {
+        // Not in memory yet: look for it on disk
+        std::ifstream file(entryPath(keyString), std::ios::binary);
+        uint32_t      magic         = 0;
+        uint64_t      storedKeySize = 0;
+        file.read((char*) &magic, sizeof(magic));
+        file.read((char*) &storedKeySize, sizeof(storedKeySize));
+        // Checked before allocating: a corrupt file may hold any size
+        bool        valid = file && magic == kBlobMagic &&
+                            storedKeySize == keyString.size();
+        std::string storedKey(valid ? storedKeySize : 0, '\0');
+        file.read(storedKey.data(), storedKey.size());
+        if (!valid || !file || storedKey != keyString) {
+            ++m_stats.misses;
+            countMetric(MetricCounter::BlobMisses);
+            return 0;
+        }
+        std::vector<uint8_t> data(
+            (std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>());
+        it = m_entries.emplace(std::move(keyString), std::move(data)).first;
+    }
+
+    const std::vector<uint8_t>& data = it->second;
+    if (value != nullptr && valueSize >= data.size()) {
+        std::memcpy(value, data.data(), data.size());
+        ++m_stats.hits;
+        m_stats.bytesLoaded += data.size();
+        countMetric(MetricCounter::BlobHits);
+    }
+    return data.size();
+}
+
+void BlobCache::store(
+    const void* key,
+    size_t      keySize,
+    const void* value,
+    size_t      valueSize)
+{
+    std::string                 keyString((const char*) key, keySize);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::filesystem::path path = entryPath(keyString);
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        uint64_t      storedKeySize = keySize;
+        file.write((const char*) &kBlobMagic, sizeof(kBlobMagic));
+        file.write((const char*) &storedKeySize, sizeof(storedKeySize));
+        file.write((const char*) key, keySize);
+        file.write((const char*) value, valueSize);
+        if (!file) {
+            std::cerr << "Could not write cache entry " << temp << std::endl;
+            return;
+        }
+    }
+    // Rename so that a concurrent reader never sees a partial entry
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+
+    const auto* bytes = static_cast<const uint8_t*>(value);
+    m_entries[std::move(keyString)].assign(bytes, bytes + valueSize);
+    ++m_stats.stores;
+    m_stats.bytesStored += valueSize;
+}
+
+void BlobCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    std::error_code error;
+    std::filesystem::remove_all(m_directory, error);
+    std::filesystem::create_directories(m_directory, error);
+}
+
+BlobCache::Stats BlobCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void chainBlobCache(
+    WGPUDeviceDescriptor& deviceDesc,
+    BlobCache&            cache,
+    BlobCacheChain&       chain)
+{
+#ifdef WEBGPU_BACKEND_DAWN
+    chain.descriptor              = WGPU_DAWN_CACHE_DEVICE_DESCRIPTOR_INIT;
+    chain.descriptor.chain.next   = deviceDesc.nextInChain;
+    chain.descriptor.chain.sType  = WGPUSType_DawnCacheDeviceDescriptor;
+    chain.descriptor.isolationKey = {"wgputest", WGPU_STRLEN};
+    chain.descriptor.loadDataFunction = [](const void* key,
+                                           size_t      keySize,
+                                           void*       value,
+                                           size_t      valueSize,
+                                           void*       userdata) {
+        return static_cast<BlobCache*>(userdata)->load(
+            key, keySize, value, valueSize);
+    };
+    chain.descriptor.storeDataFunction = [](const void* key,
+                                            size_t      keySize,
+                                            const void* value,
+                                            size_t      valueSize,
+                                            void*       userdata) {
+        static_cast<BlobCache*>(userdata)->store(
+            key, keySize, value, valueSize);
+    };
+    chain.descriptor.functionUserdata = &cache;
+    deviceDesc.nextInChain            = &chain.descriptor.chain;
+#else
+    (void) deviceDesc;
+    (void) cache;
+    (void) chain;
+#endif
+}
+
+PipelineRegistry::PipelineRegistry(WGPUDevice device) : m_device(device) {}
+
+PipelineRegistry::~PipelineRegistry()
+{
+    clear();
+}
+
+void PipelineRegistry::clear()
+{
+    for (auto& [hash, entry] : m_renderPipelines) {
+        wgpuRenderPipelineRelease(entry.handle);
+    }
+    for (auto& [hash, entry] : m_computePipelines) {
+        wgpuComputePipelineRelease(entry.handle);
+    }
+    for (auto& [hash, entry] : m_modules) {
+        wgpuShaderModuleRelease(entry.handle);
+    }
+    m_renderPipelines.clear();
+    m_computePipelines.clear();
+    m_modules.clear();
+}
+
+void PipelineRegistry::setDevice(WGPUDevice device)
+{
+    std::vector<std::string>         sources;
+    std::vector<RenderPipelineSpec>  renderSpecs;
+    std::vector<ComputePipelineSpec> computeSpecs;
+    for (const auto& [hash, entry] : m_modules) {
+        sources.push_back(entry.spec);
+    }
+    uint64_t dropped = 0;
+    for (const auto& [hash, entry] : m_renderPipelines) {
+        if (entry.spec.layout) {
+            ++dropped;
+        }
+        else {
+            renderSpecs.push_back(entry.spec);
+        }
+    }
+    for (const auto& [hash, entry] : m_computePipelines) {
+        if (entry.spec.layout) {
+            ++dropped;
+        }
+        else {
+            computeSpecs.push_back(entry.spec);
+        }
+    }
+    clear();
+    if (dropped > 0) {
+        m_stats.droppedSpecs += dropped;
+        std::cerr << "Pipeline registry: " << dropped
+                  << " pipelines with an explicit layout not recreated\n";
+    }
+
+    // Served by the blob cache of the device, when it has one
+    m_device = device;
+    for (const std::string& source : sources) {
+        shaderModule(source);
+    }
+    for (const RenderPipelineSpec& spec : renderSpecs) {
+        renderPipeline(spec);
+    }
+    for (const ComputePipelineSpec& spec : computeSpecs) {
+        computePipeline(spec);
+    }
+}
+
+WGPUShaderModule PipelineRegistry::shaderModule(
+    std::string_view wgslSource,
+    std::string_view label)
+{
+    uint64_t hash  = Hasher().add(wgslSource).value();
+    auto     range = m_modules.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.spec == wgslSource) {
+            ++m_stats.hits;
+            countMetric(MetricCounter::PipelineHits);
+            return it->second.handle;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    WGPUShaderSourceWGSL wgslDesc = WGPU_SHADER_SOURCE_WGSL_INIT;
+    wgslDesc.chain.sType          = WGPUSType_ShaderSourceWGSL;
+    wgslDesc.code = {wgslSource.data(), wgslSource.size()};
+
+    WGPUShaderModuleDescriptor moduleDesc = WGPU_SHADER_MODULE_DESCRIPTOR_INIT;
+    moduleDesc.nextInChain                = &wgslDesc.chain;
+    moduleDesc.label = {label.data(), label.size()};
+
+    WGPUShaderModule module =
+        wgpuDeviceCreateShaderModule(m_device, &moduleDesc);
+
+    m_stats.createMs += msSince(start);
+    ++m_stats.shaderModules;
+    countMetric(MetricCounter::PipelineMisses);
+    m_modules.emplace(hash, Entry<std::string, WGPUShaderModule> {
+        std::string(wgslSource), module});
+    return module;
+}
+
+WGPURenderPipeline PipelineRegistry::renderPipeline(
+    const RenderPipelineSpec& spec)
+{
+    uint64_t hash  = hashPipelineSpec(spec);
+    auto     range = m_renderPipelines.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.spec == spec) {
+            ++m_stats.hits;
+            countMetric(MetricCounter::PipelineHits);
+            return it->second.handle;
+        }
+    }
+
+    WGPUShaderModule module = shaderModule(spec.shaderSource, spec.label);
+    auto             start  = std::chrono::steady_clock::now();
+
+    RenderPipelineDescriptor desc(spec, module);
+    WGPURenderPipeline       pipeline =
+        wgpuDeviceCreateRenderPipeline(m_device, desc.get());
+
+    m_stats.createMs += msSince(start);
+    ++m_stats.pipelines;
+    countMetric(MetricCounter::PipelineMisses);
+    m_renderPipelines.emplace(
+        hash, Entry<RenderPipelineSpec, WGPURenderPipeline> {spec, pipeline});
+    return pipeline;
+}
+
+WGPUComputePipeline PipelineRegistry::computePipeline(
+    const ComputePipelineSpec& spec)
+{
+    uint64_t hash  = hashPipelineSpec(spec);
+    auto     range = m_computePipelines.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.spec == spec) {
+            ++m_stats.hits;
+            countMetric(MetricCounter::PipelineHits);
+            return it->second.handle;
+        }
+    }
+
+    WGPUShaderModule module = shaderModule(spec.shaderSource, spec.label);
+    auto             start  = std::chrono::steady_clock::now();
+
+    WGPUComputePipelineDescriptor desc =
+        computePipelineDescriptor(spec, module);
+    WGPUComputePipeline pipeline =
+        wgpuDeviceCreateComputePipeline(m_device, &desc);
+
+    m_stats.createMs += msSince(start);
+    ++m_stats.pipelines;
+    countMetric(MetricCounter::PipelineMisses);
+    m_computePipelines.emplace(
+        hash, Entry<ComputePipelineSpec, WGPUComputePipeline> {spec, pipeline});
+    return pipeline;
+}
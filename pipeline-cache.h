@@ -0,0 +1,239 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * CPU-side description of a vertex attribute, see VertexBufferSpec.
+ */
+struct VertexAttributeSpec
+{
+    WGPUVertexFormat format         = WGPUVertexFormat_Float32x3;
+    uint64_t         offset         = 0;
+    uint32_t         shaderLocation = 0;
+
+    bool operator==(const VertexAttributeSpec&) const = default;
+};
+
+struct VertexBufferSpec
+{
+    uint64_t                         arrayStride = 0;
+    WGPUVertexStepMode               stepMode    = WGPUVertexStepMode_Vertex;
+    std::vector<VertexAttributeSpec> attributes;
+
+    bool operator==(const VertexBufferSpec&) const = default;
+};
+
+/**
+ * Self-contained description of a render pipeline: unlike
+ * WGPURenderPipelineDescriptor it owns all its data, so it can be hashed,
+ * compared and kept around to create the pipeline again.
+ */
+struct RenderPipelineSpec
+{
+    std::string                    label;
+    std::string                    shaderSource; // WGSL
+    std::string                    vertexEntry   = "vs_main";
+    std::string                    fragmentEntry = "fs_main";
+    std::vector<VertexBufferSpec>  vertexBuffers;
+    std::vector<WGPUTextureFormat> colorFormats;
+    bool                           alphaBlending = false;
+    WGPUPrimitiveTopology topology     = WGPUPrimitiveTopology_TriangleList;
+    WGPUCullMode          cullMode     = WGPUCullMode_None;
+    WGPUTextureFormat     depthFormat  = WGPUTextureFormat_Undefined;
+    WGPUCompareFunction   depthCompare = WGPUCompareFunction_Less;
+    bool                  depthWrite   = true;
+    uint32_t              sampleCount  = 1;
+    // nullptr selects the automatic layout
+    WGPUPipelineLayout layout = nullptr;
+
+    bool operator==(const RenderPipelineSpec&) const = default;
+};
+
+struct ComputePipelineSpec
+{
+    std::string        label;
+    std::string        shaderSource; // WGSL
+    std::string        entryPoint = "main";
+    WGPUPipelineLayout layout     = nullptr;
+
+    bool operator==(const ComputePipelineSpec&) const = default;
+};
+
+uint64_t hashPipelineSpec(const RenderPipelineSpec& spec);
+uint64_t hashPipelineSpec(const ComputePipelineSpec& spec);
+
+/**
+ * The C descriptor of a RenderPipelineSpec using `module`. It points into
+ * this object and into `spec`, which must outlive it.
+ */
+class RenderPipelineDescriptor
+{
+public:
+    RenderPipelineDescriptor(
+        const RenderPipelineSpec& spec,
+        WGPUShaderModule          module);
+
+    RenderPipelineDescriptor(const RenderPipelineDescriptor&) = delete;
+    RenderPipelineDescriptor& operator=(const RenderPipelineDescriptor&) =
+        delete;
+
+    const WGPURenderPipelineDescriptor* get() const { return &m_desc; }
+
+private:
+    std::vector<std::vector<WGPUVertexAttribute>> m_attributes;
+    std::vector<WGPUVertexBufferLayout>           m_buffers;
+    std::vector<WGPUColorTargetState>             m_targets;
+    WGPUBlendState                                m_blend;
+    WGPUFragmentState                             m_fragment;
+    WGPUDepthStencilState                         m_depthStencil;
+    WGPURenderPipelineDescriptor                  m_desc;
+};
+
+// Points into `spec`
+WGPUComputePipelineDescriptor computePipelineDescriptor(
+    const ComputePipelineSpec& spec,
+    WGPUShaderModule           module);
+
+/**
+ * Persistent key/value store for the compiled blobs of Dawn (shaders and
+ * pipelines translated for the backend). One file per entry in `directory`,
+ * named after the hash of its key. Entries are also kept in memory.
+ * Dawn may call load/store from several threads, so access is locked.
+ */
+class BlobCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits        = 0;
+        uint64_t misses      = 0;
+        uint64_t stores      = 0;
+        uint64_t bytesLoaded = 0;
+        uint64_t bytesStored = 0;
+    };
+
+    explicit BlobCache(std::filesystem::path directory);
+
+    // Return the size of the value stored for `key`, or 0 if there is none.
+    // The value is copied only if `valueSize` is large enough.
+    size_t load(const void* key, size_t keySize, void* value, size_t valueSize);
+
+    void store(
+        const void* key,
+        size_t      keySize,
+        const void* value,
+        size_t      valueSize);
+
+    // Remove all the entries, in memory and on disk
+    void clear();
+
+    Stats stats() const;
+
+    const std::filesystem::path& directory() const { return m_directory; }
+
+private:
+    std::filesystem::path entryPath(std::string_view key) const;
+
+    std::filesystem::path                                  m_directory;
+    mutable std::mutex                                     m_mutex;
+    std::unordered_map<std::string, std::vector<uint8_t>> m_entries;
+    Stats                                                  m_stats;
+};
+
+/**
+ * Storage for the Dawn-specific chained struct that plugs a BlobCache into
+ * device creation. Must outlive the wgpuAdapterRequestDevice call.
+ */
+struct BlobCacheChain
+{
+#ifdef WEBGPU_BACKEND_DAWN
+    WGPUDawnCacheDeviceDescriptor descriptor;
+#endif
+};
+
+/**
+ * Chain `cache` into `deviceDesc` so that the device loads and stores its
+ * compiled blobs through it. Does nothing on backends other than Dawn.
+ */
+void chainBlobCache(
+    WGPUDeviceDescriptor& deviceDesc,
+    BlobCache&            cache,
+    BlobCacheChain&       chain);
+
+/**
+ * Creates shader modules and pipelines once per distinct WGSL source and
+ * spec. Identical requests return the same handle, owned by the registry.
+ */
+class PipelineRegistry
+{
+public:
+    struct Stats
+    {
+        uint64_t shaderModules = 0; // modules compiled
+        uint64_t pipelines     = 0; // pipelines created
+        uint64_t hits          = 0; // requests served from memory
+        uint64_t droppedSpecs  = 0; // explicit layouts, see setDevice()
+        double   createMs      = 0; // time spent creating modules/pipelines
+    };
+
+    explicit PipelineRegistry(WGPUDevice device);
+    ~PipelineRegistry();
+
+    PipelineRegistry(const PipelineRegistry&)            = delete;
+    PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+    WGPUShaderModule shaderModule(
+        std::string_view wgslSource,
+        std::string_view label = {});
+
+    WGPURenderPipeline renderPipeline(const RenderPipelineSpec& spec);
+
+    WGPUComputePipeline computePipeline(const ComputePipelineSpec& spec);
+
+    // Release all the modules and pipelines
+    void clear();
+
+    // After a device loss: release everything created on the previous
+    // device, then create the modules and pipelines again on `device` from
+    // the retained sources and specs, so that the next requests are hits.
+    // Specs with an explicit layout are dropped, their layout being one of
+    // the previous device: they are counted and logged, and their owners
+    // must request them again with a new layout. Handles returned before
+    // are invalid.
+    void setDevice(WGPUDevice device);
+
+    Stats stats() const { return m_stats; }
+
+private:
+    template<typename Spec, typename Handle>
+    struct Entry
+    {
+        Spec   spec;
+        Handle handle = nullptr;
+    };
+
+    WGPUDevice m_device = nullptr;
+    // Keyed by source hash; the source is kept to rule out collisions
+    std::unordered_multimap<uint64_t, Entry<std::string, WGPUShaderModule>>
+        m_modules;
+    std::unordered_multimap<
+        uint64_t,
+        Entry<RenderPipelineSpec, WGPURenderPipeline>>
+        m_renderPipelines;
+    std::unordered_multimap<
+        uint64_t,
+        Entry<ComputePipelineSpec, WGPUComputePipeline>>
+          m_computePipelines;
+    Stats m_stats;
+};
+
+#endif // PIPELINE_CACHE_H
@@ -0,0 +1,340 @@
+#include "pipeline-loader.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+void releasePipeline(WGPURenderPipeline pipeline)
+{
+    wgpuRenderPipelineRelease(pipeline);
+}
+
+void releasePipeline(WGPUComputePipeline pipeline)
+{
+    wgpuComputePipelineRelease(pipeline);
+}
+
+// Read `path` into `source`, unless one of them is empty
+bool loadSource(const std::filesystem::path& path, std::string& source)
+{
+    if (path.empty() || !source.empty()) {
+        return true;
+    }
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Could not read shader " << path << '\n';
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    source = stream.str();
+    return true;
+}
+
+double msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+} // namespace
+
+PipelineLoader::PipelineLoader(WGPUInstance instance, WGPUDevice device) :
+        m_instance(instance), m_device(device)
+{
+}
+
+PipelineLoader::~PipelineLoader()
+{
+    // The pipelines of pending creations are only ours once they complete
+    waitAll();
+    m_watcher.reset();
+    for (RenderSlot& slot : m_render) {
+        if (slot.current) {
+            releasePipeline(slot.current);
+        }
+    }
+    for (ComputeSlot& slot : m_compute) {
+        if (slot.current) {
+            releasePipeline(slot.current);
+        }
+    }
+}
+
+PipelineLoader::Id PipelineLoader::addRenderPipeline(
+    RenderPipelineSpec    spec,
+    std::filesystem::path shaderPath,
+    Id                    fallback)
+{
+    Id id = Id(m_render.size());
+    m_render.emplace_back();
+    RenderSlot& slot = m_render.back();
+    slot.spec        = std::move(spec);
+    slot.shaderPath  = normalizedPath(shaderPath);
+    // Only earlier pipelines, which rules out cycles
+    slot.fallback = fallback < id ? fallback : kNone;
+
+    if (loadSource(slot.shaderPath, slot.spec.shaderSource)) {
+        start(slot);
+    }
+    else {
+        ++m_stats.failed;
+    }
+    watch(slot);
+    return id;
+}
+
+PipelineLoader::Id PipelineLoader::addComputePipeline(
+    ComputePipelineSpec   spec,
+    std::filesystem::path shaderPath)
+{
+    Id id = Id(m_compute.size());
+    m_compute.emplace_back();
+    ComputeSlot& slot = m_compute.back();
+    slot.spec         = std::move(spec);
+    slot.shaderPath   = normalizedPath(shaderPath);
+
+    if (loadSource(slot.shaderPath, slot.spec.shaderSource)) {
+        start(slot);
+    }
+    else {
+        ++m_stats.failed;
+    }
+    watch(slot);
+    return id;
+}
+
+WGPURenderPipeline PipelineLoader::renderPipeline(Id id) const
+{
+    if (id >= m_render.size()) {
+        return nullptr;
+    }
+    const RenderSlot& slot = m_render[id];
+    if (slot.current) {
+        return slot.current;
+    }
+    return renderPipeline(slot.fallback);
+}
+
+WGPUComputePipeline PipelineLoader::computePipeline(Id id) const
+{
+    return id < m_compute.size() ? m_compute[id].current : nullptr;
+}
+
+bool PipelineLoader::renderReady(Id id) const
+{
+    return id < m_render.size() && m_render[id].current;
+}
+
+bool PipelineLoader::computeReady(Id id) const
+{
+    return id < m_compute.size() && m_compute[id].current;
+}
+
+size_t PipelineLoader::pendingCount() const
+{
+    size_t count = 0;
+    for (const RenderSlot& slot : m_render) {
+        count += slot.pending.valid();
+    }
+    for (const ComputeSlot& slot : m_compute) {
+        count += slot.pending.valid();
+    }
+    return count;
+}
+
+void PipelineLoader::enableHotReload()
+{
+    if (m_watcher) {
+        return;
+    }
+    m_watcher = std::make_unique<FileWatcher>();
+    for (const RenderSlot& slot : m_render) {
+        watch(slot);
+    }
+    for (const ComputeSlot& slot : m_compute) {
+        watch(slot);
+    }
+}
+
+void PipelineLoader::update()
+{
+    for (RenderSlot& slot : m_render) {
+        poll(slot, false);
+    }
+    for (ComputeSlot& slot : m_compute) {
+        poll(slot, false);
+    }
+    if (!m_watcher) {
+        return;
+    }
+
+    for (const FileWatcher::Change& change : m_watcher->take()) {
+        for (RenderSlot& slot : m_render) {
+            if (slot.shaderPath == change.path) {
+                reload(slot, change);
+            }
+        }
+        for (ComputeSlot& slot : m_compute) {
+            if (slot.shaderPath == change.path) {
+                reload(slot, change);
+            }
+        }
+    }
+}
+
+void PipelineLoader::waitAll()
+{
+    // A completed creation may start the reload queued behind it
+    while (pendingCount() > 0) {
+        for (RenderSlot& slot : m_render) {
+            poll(slot, true);
+        }
+        for (ComputeSlot& slot : m_compute) {
+            poll(slot, true);
+        }
+    }
+}
+
+void PipelineLoader::setDevice(WGPUDevice device)
+{
+    // Creations on the lost device complete too, most likely failing
+    waitAll();
+    m_device = device;
+    restart(m_render);
+    restart(m_compute);
+}
+
+void PipelineLoader::setColorFormats(
+    Id                             id,
+    std::vector<WGPUTextureFormat> formats)
+{
+    if (id < m_render.size()) {
+        m_render[id].spec.colorFormats = std::move(formats);
+    }
+}
+
+WGPUShaderModule PipelineLoader::createShaderModule(
+    const std::string& source,
+    const std::string& label)
+{
+    WGPUShaderSourceWGSL wgslDesc = WGPU_SHADER_SOURCE_WGSL_INIT;
+    wgslDesc.chain.sType          = WGPUSType_ShaderSourceWGSL;
+    wgslDesc.code                 = {source.data(), source.size()};
+
+    WGPUShaderModuleDescriptor moduleDesc = WGPU_SHADER_MODULE_DESCRIPTOR_INIT;
+    moduleDesc.nextInChain                = &wgslDesc.chain;
+    moduleDesc.label                      = {label.data(), label.size()};
+    return wgpuDeviceCreateShaderModule(m_device, &moduleDesc);
+}
+
+Future<WGPURenderPipeline> PipelineLoader::createAsync(
+    const RenderPipelineSpec& spec)
+{
+    WGPUShaderModule module = createShaderModule(spec.shaderSource, spec.label);
+    RenderPipelineDescriptor   desc(spec, module);
+    Future<WGPURenderPipeline> pipeline =
+        createRenderPipelineAsync(m_instance, m_device, desc.get());
+    // The creation holds its own reference
+    wgpuShaderModuleRelease(module);
+    return pipeline;
+}
+
+Future<WGPUComputePipeline> PipelineLoader::createAsync(
+    const ComputePipelineSpec& spec)
+{
+    WGPUShaderModule module = createShaderModule(spec.shaderSource, spec.label);
+    WGPUComputePipelineDescriptor desc =
+        computePipelineDescriptor(spec, module);
+    Future<WGPUComputePipeline> pipeline =
+        createComputePipelineAsync(m_instance, m_device, &desc);
+    wgpuShaderModuleRelease(module);
+    return pipeline;
+}
+
+template<typename SlotType>
+void PipelineLoader::start(SlotType& slot)
+{
+    slot.pending = createAsync(slot.spec);
+    ++m_stats.requested;
+}
+
+template<typename SlotType>
+void PipelineLoader::poll(SlotType& slot, bool wait)
+{
+    if (!slot.pending.valid() ||
+        !slot.pending.wait(wait ? kInfiniteTimeout : 0)) {
+        return;
+    }
+    auto pipeline = slot.pending.get();
+    slot.pending  = {};
+
+    if (pipeline) {
+        if (slot.current) {
+            releasePipeline(slot.current);
+            ++m_stats.swaps;
+        }
+        slot.current = pipeline;
+        ++m_stats.created;
+    }
+    else {
+        ++m_stats.failed;
+    }
+
+    if (slot.reloadQueued) {
+        slot.reloadQueued = false;
+        start(slot);
+        return;
+    }
+    if (pipeline && slot.changedAt != Clock::time_point()) {
+        m_stats.lastReloadMs = msSince(slot.changedAt);
+    }
+    slot.changedAt = {};
+}
+
+template<typename SlotType>
+void PipelineLoader::reload(SlotType& slot, const FileWatcher::Change& change)
+{
+    slot.spec.shaderSource = change.contents;
+    ++m_stats.reloads;
+    if (slot.pending.valid()) {
+        // Started once the current creation completes, with the latest
+        // source; the changedAt of the earlier change is kept
+        slot.reloadQueued = true;
+        return;
+    }
+    slot.changedAt = change.time;
+    start(slot);
+}
+
+template<typename SlotType>
+void PipelineLoader::watch(const SlotType& slot)
+{
+    if (!m_watcher || slot.shaderPath.empty()) {
+        return;
+    }
+    if (!m_watcher->watch(slot.shaderPath)) {
+        std::cerr << "Could not watch shader " << slot.shaderPath << '\n';
+    }
+}
+
+template<typename SlotType>
+void PipelineLoader::restart(std::vector<SlotType>& slots)
+{
+    for (SlotType& slot : slots) {
+        if (slot.current) {
+            releasePipeline(slot.current);
+            slot.current = nullptr;
+        }
+        slot.changedAt = {};
+        if (slot.spec.layout) {
+            ++m_stats.failed;
+        }
+        else if (!slot.spec.shaderSource.empty()) {
+            start(slot);
+        }
+    }
+}
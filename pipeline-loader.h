@@ -0,0 +1,149 @@
+#ifndef PIPELINE_LOADER_H
+#define PIPELINE_LOADER_H
+
+#include "file-watcher.h"
+#include "pipeline-cache.h"
+#include "webgpu-async.h"
+
+#include <webgpu/webgpu.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+/**
+ * Pipelines compiled in the background. add*() start the creation and
+ * return at once; until a pipeline is ready, renderPipeline() returns its
+ * fallback or null, and the draws using it are skipped:
+ *     PipelineLoader::Id sky = loader.addRenderPipeline(spec, "sky.wgsl");
+ *     ...
+ *     loader.update(); // between frames
+ *     if (WGPURenderPipeline pipeline = loader.renderPipeline(sky)) { ... }
+ *
+ * With hot reload enabled, the shader files are watched: a changed file is
+ * read by the FileWatcher thread, compiled asynchronously, and the new
+ * pipeline replaces the old one in update(), so a frame never sees a half
+ * updated set. If the new source does not compile, the old pipeline stays.
+ *
+ * Shader modules are still parsed on the thread calling add*() or update();
+ * the backend compilation, which dominates, is not.
+ */
+class PipelineLoader
+{
+public:
+    using Id    = uint32_t;
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr Id kNone = UINT32_MAX;
+
+    struct Stats
+    {
+        uint64_t requested = 0; // creations started, reloads included
+        uint64_t created   = 0;
+        uint64_t failed    = 0; // the previous pipeline, if any, was kept
+        uint64_t reloads   = 0; // file changes picked up
+        uint64_t swaps     = 0; // pipelines replaced by a reloaded one
+        // From the file change being seen to the new pipeline in use
+        double lastReloadMs = 0;
+    };
+
+    PipelineLoader(WGPUInstance instance, WGPUDevice device);
+    // Waits for the pending creations, then releases the pipelines
+    ~PipelineLoader();
+
+    PipelineLoader(const PipelineLoader&)            = delete;
+    PipelineLoader& operator=(const PipelineLoader&) = delete;
+
+    // If `shaderPath` is given and `spec.shaderSource` is empty, the source
+    // is read from that file. `fallback` is used until the pipeline is ready.
+    Id addRenderPipeline(
+        RenderPipelineSpec    spec,
+        std::filesystem::path shaderPath = {},
+        Id                    fallback   = kNone);
+
+    Id addComputePipeline(
+        ComputePipelineSpec   spec,
+        std::filesystem::path shaderPath = {});
+
+    // The pipeline, its fallback if it is not ready, or null
+    WGPURenderPipeline renderPipeline(Id id) const;
+    // The pipeline, or null if it is not ready
+    WGPUComputePipeline computePipeline(Id id) const;
+
+    bool renderReady(Id id) const;
+    bool computeReady(Id id) const;
+    // Creations not completed yet
+    size_t pendingCount() const;
+
+    // Watch the shader files, those added before and after this call
+    void enableHotReload();
+    bool hotReloadEnabled() const { return m_watcher != nullptr; }
+
+    // Between frames: swap in the pipelines created since the previous call
+    // and recompile those whose shader file changed. Does not block.
+    void update();
+
+    // Block until no creation is pending
+    void waitAll();
+
+    // After a device loss: drop the pipelines of the previous device and
+    // create them again on `device` from the retained specs and sources.
+    // Ids stay valid; draws are skipped until the pipelines are ready.
+    // Specs with an explicit layout, one of the previous device, are not
+    // recreated.
+    void setDevice(WGPUDevice device);
+
+    // The targets of render pipeline `id` changed, e.g. the surface format
+    // of a new device: used by its next creation, such as setDevice()'s
+    void setColorFormats(Id id, std::vector<WGPUTextureFormat> formats);
+
+    Stats stats() const { return m_stats; }
+
+private:
+    template<typename Spec, typename Handle>
+    struct Slot
+    {
+        Spec                  spec;
+        std::filesystem::path shaderPath;
+        Id                    fallback = kNone;
+        Handle                current  = nullptr;
+        Future<Handle>        pending;
+        // The file changed again while `pending` was compiling
+        bool reloadQueued = false;
+        // Set for creations started by a file change
+        Clock::time_point changedAt;
+    };
+
+    using RenderSlot  = Slot<RenderPipelineSpec, WGPURenderPipeline>;
+    using ComputeSlot = Slot<ComputePipelineSpec, WGPUComputePipeline>;
+
+    WGPUShaderModule createShaderModule(
+        const std::string& source,
+        const std::string& label);
+    Future<WGPURenderPipeline>  createAsync(const RenderPipelineSpec& spec);
+    Future<WGPUComputePipeline> createAsync(const ComputePipelineSpec& spec);
+
+    template<typename SlotType>
+    void start(SlotType& slot);
+    // Take the result of the pending creation, if it completed
+    template<typename SlotType>
+    void poll(SlotType& slot, bool wait);
+    template<typename SlotType>
+    void reload(SlotType& slot, const FileWatcher::Change& change);
+    template<typename SlotType>
+    void watch(const SlotType& slot);
+    template<typename SlotType>
+    void restart(std::vector<SlotType>& slots);
+
+    WGPUInstance m_instance = nullptr;
+    WGPUDevice   m_device   = nullptr;
+
+    std::vector<RenderSlot>      m_render;
+    std::vector<ComputeSlot>     m_compute;
+    std::unique_ptr<FileWatcher> m_watcher;
+    Stats                        m_stats;
+};
+
+#endif // PIPELINE_LOADER_H
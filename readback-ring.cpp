@@ -0,0 +1,197 @@
+#include "readback-ring.h"
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cassert>
+
+ReadbackRing::ReadbackRing(
+    WGPUInstance instance,
+    WGPUDevice   device,
+    uint32_t     depth) :
+        m_instance(instance), m_device(device), m_slots(std::max(depth, 1u))
+{
+}
+
+ReadbackRing::~ReadbackRing()
+{
+    // Pending callbacks may reference objects that are being destroyed, so
+    // they are dropped rather than invoked.
+    for (Slot& slot : m_slots) {
+        if (slot.state == SlotState::Mapping) {
+            slot.mapped.wait();
+        }
+        if (slot.buffer) {
+            wgpuBufferRelease(slot.buffer);
+        }
+    }
+}
+
+bool ReadbackRing::hasFreeSlot() const
+{
+    return m_count < m_slots.size();
+}
+
+bool ReadbackRing::enqueueCopy(
+    WGPUCommandEncoder encoder,
+    WGPUBuffer         source,
+    uint64_t           offset,
+    uint64_t           size,
+    Callback           callback)
+{
+    assert(offset % 4 == 0 && size % 4 == 0);
+
+    Slot* slot = reserveSlot(size, std::move(callback));
+    if (!slot)
+        return false;
+    wgpuCommandEncoderCopyBufferToBuffer(
+        encoder, source, offset, slot->buffer, 0, size);
+    return true;
+}
+
+bool ReadbackRing::enqueueTextureCopy(
+    WGPUCommandEncoder encoder,
+    WGPUTexture        texture,
+    uint32_t           bytesPerTexel,
+    Callback           callback)
+{
+    uint32_t width    = wgpuTextureGetWidth(texture);
+    uint32_t height   = wgpuTextureGetHeight(texture);
+    uint32_t rowPitch = textureRowPitch(width, bytesPerTexel);
+
+    Slot* slot = reserveSlot(uint64_t(rowPitch) * height, std::move(callback));
+    if (!slot)
+        return false;
+
+    WGPUTexelCopyTextureInfo source = WGPU_TEXEL_COPY_TEXTURE_INFO_INIT;
+    source.texture                  = texture;
+    WGPUTexelCopyBufferInfo destination = WGPU_TEXEL_COPY_BUFFER_INFO_INIT;
+    destination.buffer                  = slot->buffer;
+    destination.layout.bytesPerRow      = rowPitch;
+    destination.layout.rowsPerImage     = height;
+    WGPUExtent3D size                   = {width, height, 1};
+    wgpuCommandEncoderCopyTextureToBuffer(
+        encoder, &source, &destination, &size);
+    return true;
+}
+
+ReadbackRing::Slot* ReadbackRing::reserveSlot(uint64_t size, Callback callback)
+{
+    if (!hasFreeSlot()) {
+        // Copies that were recorded but not submitted yet cannot complete
+        if (m_slots[m_head].state != SlotState::Mapping)
+            return nullptr;
+        ++m_stats.stalls;
+        // A failed wait leaves the oldest slot in flight: it must not be
+        // overwritten
+        if (!consumeOldest(kInfiniteTimeout))
+            return nullptr;
+    }
+    if (!m_started) {
+        m_started   = true;
+        m_startTime = std::chrono::steady_clock::now();
+    }
+
+    Slot& slot = m_slots[(m_head + m_count) % m_slots.size()];
+    ++m_count;
+
+    if (slot.capacity < size) {
+        if (slot.buffer) {
+            wgpuBufferRelease(slot.buffer);
+        }
+        WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+        desc.label = {"Readback staging buffer", WGPU_STRLEN};
+        desc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+        desc.size  = size;
+        slot.buffer   = wgpuDeviceCreateBuffer(m_device, &desc);
+        slot.capacity = size;
+    }
+
+    slot.size     = size;
+    slot.callback = std::move(callback);
+    slot.state    = SlotState::Recorded;
+    return &slot;
+}
+
+void ReadbackRing::onSubmitted()
+{
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < m_count; ++i) {
+        Slot& slot = m_slots[(m_head + i) % m_slots.size()];
+        if (slot.state != SlotState::Recorded)
+            continue;
+        slot.mapped     = mapBufferAsync(
+            m_instance, slot.buffer, WGPUMapMode_Read, 0, slot.size);
+        slot.submitTime = now;
+        slot.state      = SlotState::Mapping;
+        if (m_events) {
+            m_events->watch(slot.mapped, m_guard.bind([this] { poll(); }));
+        }
+    }
+}
+
+size_t ReadbackRing::poll()
+{
+    size_t invoked = 0;
+    while (m_count > 0 && consumeOldest(0)) {
+        ++invoked;
+    }
+    return invoked;
+}
+
+void ReadbackRing::flush()
+{
+    while (m_count > 0 && m_slots[m_head].state == SlotState::Mapping) {
+        consumeOldest(kInfiniteTimeout);
+    }
+}
+
+bool ReadbackRing::consumeOldest(uint64_t timeoutNs)
+{
+    Slot& slot = m_slots[m_head];
+    if (slot.state != SlotState::Mapping || !slot.mapped.wait(timeoutNs))
+        return false;
+
+    if (slot.mapped.get().success) {
+        const void* data =
+            wgpuBufferGetConstMappedRange(slot.buffer, 0, slot.size);
+        slot.callback(data, slot.size);
+        wgpuBufferUnmap(slot.buffer);
+
+        double latencyMs = std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() -
+                               slot.submitTime)
+                               .count();
+        ++m_stats.completed;
+        m_stats.bytes += slot.size;
+        countMetric(MetricCounter::ReadbackBytes, slot.size);
+        m_stats.lastLatencyMs = latencyMs;
+        m_stats.maxLatencyMs  = std::max(m_stats.maxLatencyMs, latencyMs);
+        m_totalLatencyMs += latencyMs;
+    }
+    else {
+        ++m_stats.failed;
+    }
+
+    slot.callback = nullptr;
+    slot.mapped   = {};
+    slot.state    = SlotState::Free;
+    m_head        = (m_head + 1) % m_slots.size();
+    --m_count;
+    return true;
+}
+
+ReadbackStats ReadbackRing::stats() const
+{
+    ReadbackStats stats = m_stats;
+    if (stats.completed > 0) {
+        stats.meanLatencyMs = m_totalLatencyMs / stats.completed;
+    }
+    if (m_started) {
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - m_startTime)
+                             .count();
+        stats.bytesPerSecond = seconds > 0 ? stats.bytes / seconds : 0;
+    }
+    return stats;
+}
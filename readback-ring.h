@@ -0,0 +1,146 @@
+#ifndef READBACK_RING_H
+#define READBACK_RING_H
+
+#include "event-thread.h"
+#include "webgpu-async.h"
+
+#include <webgpu/webgpu.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * Counters of a ReadbackRing since its creation.
+ */
+struct ReadbackStats
+{
+    uint64_t completed      = 0; // readbacks whose callback was invoked
+    uint64_t failed         = 0; // readbacks whose mapping failed
+    uint64_t bytes          = 0; // bytes handed to callbacks
+    uint64_t stalls         = 0; // enqueues that waited for a free slot
+    double   bytesPerSecond = 0; // since the first enqueued copy
+    double   lastLatencyMs  = 0; // submit to callback, last readback
+    double   meanLatencyMs  = 0;
+    double   maxLatencyMs   = 0;
+};
+
+/**
+ * Rows of a texture copied into a buffer must start at multiples of 256
+ * bytes: the row pitch of a `width` texels wide copy.
+ */
+constexpr uint32_t kCopyRowAlignment = 256;
+
+inline uint32_t textureRowPitch(uint32_t width, uint32_t bytesPerTexel)
+{
+    return (width * bytesPerTexel + kCopyRowAlignment - 1) /
+           kCopyRowAlignment * kCopyRowAlignment;
+}
+
+/**
+ * A ring of N MapRead staging buffers for pipelined GPU -> CPU readback.
+ *
+ * Usage, once per frame:
+ *     ring.poll();                               // callbacks of frame k - N
+ *     ring.enqueueCopy(encoder, buffer, 0, size, callback);
+ *     queue.submit(...);
+ *     ring.onSubmitted();                        // start mapping frame k
+ *
+ * Callbacks are invoked in enqueue order from poll() or flush(), with the
+ * staging buffer mapped; the data pointer is only valid during the call.
+ * Nothing blocks as long as at most N copies are in flight.
+ */
+class ReadbackRing
+{
+public:
+    using Callback = std::function<void(const void* data, uint64_t size)>;
+
+    ReadbackRing(WGPUInstance instance, WGPUDevice device, uint32_t depth);
+    ~ReadbackRing();
+
+    ReadbackRing(const ReadbackRing&)            = delete;
+    ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+    // Return true if enqueueCopy can proceed without waiting
+    bool hasFreeSlot() const;
+
+    // Record a copy of `size` bytes of `source` at `offset` into the next
+    // staging buffer. Offset and size must be multiples of 4. If all the
+    // slots are in flight, wait for the oldest one first (counted as a stall).
+    // Return false if no slot can be freed, because none of them has been
+    // submitted yet or the wait for the oldest one failed.
+    bool enqueueCopy(
+        WGPUCommandEncoder encoder,
+        WGPUBuffer         source,
+        uint64_t           offset,
+        uint64_t           size,
+        Callback           callback);
+
+    // Record a copy of mip level 0 of the 2D `texture`, whose texels are
+    // `bytesPerTexel` bytes. The callback gets rows of
+    // textureRowPitch(width, bytesPerTexel) bytes. Same waits as
+    // enqueueCopy().
+    bool enqueueTextureCopy(
+        WGPUCommandEncoder encoder,
+        WGPUTexture        texture,
+        uint32_t           bytesPerTexel,
+        Callback           callback);
+
+    // Start mapping the copies recorded since the previous call. Must be
+    // called after the command buffer holding them has been submitted.
+    void onSubmitted();
+
+    // Invoke the callbacks of the completed readbacks, without blocking.
+    // Return the number of callbacks invoked.
+    size_t poll();
+
+    // Wait for all the submitted readbacks and invoke their callbacks
+    void flush();
+
+    uint32_t depth() const { return (uint32_t) m_slots.size(); }
+
+    size_t inFlight() const { return m_count; }
+
+    ReadbackStats stats() const;
+
+    // Have `events` watch the mappings, so that the callbacks of completed
+    // readbacks run from its dispatch(), as soon as the frame after their
+    // completion starts, instead of waiting for poll(). Null stops.
+    void setEventThread(EventThread* events) { m_events = events; }
+
+private:
+    enum class SlotState { Free, Recorded, Mapping };
+
+    struct Slot
+    {
+        WGPUBuffer                            buffer   = nullptr;
+        uint64_t                              capacity = 0;
+        uint64_t                              size     = 0;
+        SlotState                             state    = SlotState::Free;
+        Callback                              callback;
+        Future<AsyncStatus>                   mapped;
+        std::chrono::steady_clock::time_point submitTime;
+    };
+
+    // The next slot, with room for `size` bytes, or null if all of them
+    // are in flight and the oldest cannot be consumed
+    Slot* reserveSlot(uint64_t size, Callback callback);
+    // Wait up to `timeoutNs` for the oldest slot and consume it if done
+    bool consumeOldest(uint64_t timeoutNs);
+
+    WGPUInstance      m_instance = nullptr;
+    WGPUDevice        m_device   = nullptr;
+    EventThread*      m_events   = nullptr;
+    std::vector<Slot> m_slots;
+    size_t            m_head  = 0; // oldest in-flight slot
+    size_t            m_count = 0; // slots not Free
+
+    ReadbackStats                         m_stats;
+    double                                m_totalLatencyMs = 0;
+    bool                                  m_started        = false;
+    std::chrono::steady_clock::time_point m_startTime;
+    WatchGuard                            m_guard; // of the m_events callbacks
+};
+
+#endif // READBACK_RING_H
@@ -0,0 +1,147 @@
+#include "render-bundle-cache.h"
+
+#include <cassert>
+#include <chrono>
+#include <utility>
+
+RenderBundleCache::RenderBundleCache(WGPUDevice device) : m_device(device) {}
+
+RenderBundleCache::~RenderBundleCache()
+{
+    for (Entry& entry : m_entries) {
+        if (entry.bundle) {
+            wgpuRenderBundleRelease(entry.bundle);
+        }
+    }
+}
+
+RenderBundleCache::Id RenderBundleCache::add(
+    std::string     label,
+    RecordFunction  record,
+    VersionFunction version)
+{
+    Id id;
+    if (!m_freeIds.empty()) {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    }
+    else {
+        id = Id(m_entries.size());
+        m_entries.emplace_back();
+    }
+    Entry& entry  = m_entries[id];
+    entry.label   = std::move(label);
+    entry.record  = std::move(record);
+    entry.version = std::move(version);
+    entry.dirty   = true;
+    entry.live    = true;
+    ++m_stats.liveCount;
+    return id;
+}
+
+void RenderBundleCache::remove(Id id)
+{
+    assert(id < m_entries.size() && m_entries[id].live);
+    Entry& entry = m_entries[id];
+    if (entry.bundle) {
+        wgpuRenderBundleRelease(entry.bundle);
+    }
+    entry = Entry();
+    m_freeIds.push_back(id);
+    --m_stats.liveCount;
+}
+
+void RenderBundleCache::markDirty(Id id)
+{
+    assert(id < m_entries.size() && m_entries[id].live);
+    m_entries[id].dirty = true;
+}
+
+void RenderBundleCache::markAllDirty()
+{
+    for (Entry& entry : m_entries) {
+        entry.dirty = true;
+    }
+}
+
+void RenderBundleCache::setDevice(WGPUDevice device)
+{
+    for (Entry& entry : m_entries) {
+        if (entry.bundle) {
+            wgpuRenderBundleRelease(entry.bundle);
+            entry.bundle = nullptr;
+        }
+    }
+    m_prepared.clear();
+    m_device = device;
+    markAllDirty();
+}
+
+void RenderBundleCache::execute(
+    WGPURenderPassEncoder     pass,
+    const RenderBundleTarget& target)
+{
+    const std::vector<WGPURenderBundle>& bundles = prepare(target);
+    if (!bundles.empty()) {
+        wgpuRenderPassEncoderExecuteBundles(
+            pass, bundles.size(), bundles.data());
+        m_stats.executes += bundles.size();
+    }
+}
+
+const std::vector<WGPURenderBundle>& RenderBundleCache::prepare(
+    const RenderBundleTarget& target)
+{
+    if (!(target == m_target)) {
+        m_target = target;
+        markAllDirty();
+    }
+
+    m_prepared.clear();
+    for (Entry& entry : m_entries) {
+        if (!entry.live)
+            continue;
+        uint64_t version = entry.version ? entry.version() : 0;
+        if (entry.dirty || !entry.bundle || version != entry.recordedVersion) {
+            record(entry, version);
+        }
+        if (entry.bundle) {
+            m_prepared.push_back(entry.bundle);
+        }
+    }
+    return m_prepared;
+}
+
+void RenderBundleCache::record(Entry& entry, uint64_t version)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    if (entry.bundle) {
+        wgpuRenderBundleRelease(entry.bundle);
+        entry.bundle = nullptr;
+    }
+
+    WGPURenderBundleEncoderDescriptor encoderDesc =
+        WGPU_RENDER_BUNDLE_ENCODER_DESCRIPTOR_INIT;
+    encoderDesc.label              = {entry.label.data(), entry.label.size()};
+    encoderDesc.colorFormatCount   = m_target.colorFormats.size();
+    encoderDesc.colorFormats       = m_target.colorFormats.data();
+    encoderDesc.depthStencilFormat = m_target.depthStencilFormat;
+    encoderDesc.sampleCount        = m_target.sampleCount;
+    WGPURenderBundleEncoder encoder =
+        wgpuDeviceCreateRenderBundleEncoder(m_device, &encoderDesc);
+
+    entry.record(encoder);
+
+    WGPURenderBundleDescriptor bundleDesc = WGPU_RENDER_BUNDLE_DESCRIPTOR_INIT;
+    bundleDesc.label = {entry.label.data(), entry.label.size()};
+    entry.bundle     = wgpuRenderBundleEncoderFinish(encoder, &bundleDesc);
+    wgpuRenderBundleEncoderRelease(encoder);
+
+    entry.recordedVersion = version;
+    entry.dirty           = false;
+    ++m_stats.records;
+    m_stats.recordMs += std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+}
@@ -0,0 +1,112 @@
+#ifndef RENDER_BUNDLE_CACHE_H
+#define RENDER_BUNDLE_CACHE_H
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Attachment layout a render bundle is recorded for. A bundle can only be
+ * executed in a render pass with the same formats and sample count.
+ */
+struct RenderBundleTarget
+{
+    std::vector<WGPUTextureFormat> colorFormats;
+    WGPUTextureFormat              depthStencilFormat =
+        WGPUTextureFormat_Undefined;
+    uint32_t sampleCount = 1;
+
+    bool operator==(const RenderBundleTarget&) const = default;
+};
+
+/**
+ * Records static draw sequences once into render bundles and replays them
+ * with a single executeBundles call per pass.
+ *
+ *     auto id = bundles.add("Scenery", [&](WGPURenderBundleEncoder e) {
+ *         wgpuRenderBundleEncoderSetPipeline(e, pipeline);
+ *         ...
+ *     });
+ *     bundles.execute(renderPass, target); // every frame
+ *     bundles.markDirty(id);               // when the recorded state changed
+ *
+ * A bundle is recorded again before its next execution when it was marked
+ * dirty, when the target changes, or when the value returned by its version
+ * function changes (e.g. FrameRingAllocator::generation() for bundles that
+ * bind the frame ring).
+ */
+class RenderBundleCache
+{
+public:
+    using Id              = uint32_t;
+    using RecordFunction  = std::function<void(WGPURenderBundleEncoder)>;
+    using VersionFunction = std::function<uint64_t()>;
+
+    struct Stats
+    {
+        uint64_t records   = 0; // bundles (re)recorded
+        uint64_t executes  = 0; // bundles replayed
+        double   recordMs  = 0; // time spent recording
+        uint32_t liveCount = 0;
+    };
+
+    explicit RenderBundleCache(WGPUDevice device);
+    ~RenderBundleCache();
+
+    RenderBundleCache(const RenderBundleCache&)            = delete;
+    RenderBundleCache& operator=(const RenderBundleCache&) = delete;
+
+    // Register a static draw sequence; it is recorded on first execution
+    Id add(
+        std::string     label,
+        RecordFunction  record,
+        VersionFunction version = {});
+
+    void remove(Id id);
+
+    void markDirty(Id id);
+    void markAllDirty();
+
+    // After a device loss: drop the bundles of the previous device. They
+    // are recorded again on `device` by their record functions, which must
+    // not hold on to handles of the previous device.
+    void setDevice(WGPUDevice device);
+
+    // Record the bundles that need it, then execute all of them in `pass`
+    void execute(WGPURenderPassEncoder pass, const RenderBundleTarget& target);
+
+    // Record the bundles that need it and return them, in registration
+    // order, for callers that interleave bundles with their own draws
+    const std::vector<WGPURenderBundle>& prepare(
+        const RenderBundleTarget& target);
+
+    bool empty() const { return m_stats.liveCount == 0; }
+
+    Stats stats() const { return m_stats; }
+
+private:
+    struct Entry
+    {
+        std::string      label;
+        RecordFunction   record;
+        VersionFunction  version;
+        WGPURenderBundle bundle          = nullptr;
+        uint64_t         recordedVersion = 0;
+        bool             dirty           = true;
+        bool             live            = false;
+    };
+
+    void record(Entry& entry, uint64_t version);
+
+    WGPUDevice                    m_device = nullptr;
+    std::vector<Entry>            m_entries;
+    std::vector<Id>               m_freeIds;
+    RenderBundleTarget            m_target;
+    std::vector<WGPURenderBundle> m_prepared;
+    Stats                         m_stats;
+};
+
+#endif // RENDER_BUNDLE_CACHE_H
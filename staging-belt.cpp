@@ -0,0 +1,289 @@
+#include "staging-belt.h"
+
+#include "buffer-allocator.h"
+#include "gpu-resources.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Required alignment of bytesPerRow in buffer to texture copies
+constexpr uint64_t kRowAlignment = 256;
+
+} // namespace
+
+StagingBelt::StagingBelt(
+    WGPUInstance instance,
+    WGPUDevice   device,
+    uint64_t     chunkSize,
+    uint64_t     frameBudget) :
+        m_instance(instance), m_device(device),
+        m_chunkSize(alignUp(std::max<uint64_t>(chunkSize, 4), 4)),
+        m_frameBudget(frameBudget)
+{
+}
+
+StagingBelt::~StagingBelt()
+{
+    if (m_encoder) {
+        // Recorded but never finished: the copies are dropped
+        wgpuCommandEncoderRelease(m_encoder);
+    }
+    for (Chunk& chunk : m_chunks) {
+        if (chunk.state == ChunkState::Submitted ||
+            chunk.state == ChunkState::Mapping) {
+            chunk.pending.wait();
+        }
+        releaseChunk(chunk);
+    }
+}
+
+void StagingBelt::setMemoryTracker(GpuMemoryTracker* memory)
+{
+    for (const Chunk& chunk : m_chunks) {
+        if (m_memory) {
+            m_memory->onReleased(ResourceCategory::Staging, chunk.size);
+        }
+        if (memory) {
+            memory->onAllocated(ResourceCategory::Staging, chunk.size);
+        }
+    }
+    m_memory = memory;
+}
+
+void StagingBelt::beginFrame()
+{
+    recycle(0);
+    m_frameBytes = 0;
+}
+
+UploadResult StagingBelt::uploadBuffer(
+    WGPUBuffer  buffer,
+    uint64_t    offset,
+    const void* data,
+    uint64_t    size)
+{
+    assert(offset % 4 == 0 && size % 4 == 0);
+    if (size == 0)
+        return UploadResult::Recorded;
+
+    uint64_t stagingOffset = 0;
+    Chunk*   chunk         = allocate(size, 4, stagingOffset);
+    if (!chunk)
+        return UploadResult::Throttled;
+    std::memcpy(chunk->data + stagingOffset, data, size);
+    wgpuCommandEncoderCopyBufferToBuffer(
+        encoder(), chunk->buffer, stagingOffset, buffer, offset, size);
+    return UploadResult::Recorded;
+}
+
+UploadResult StagingBelt::uploadTexture(
+    const WGPUTexelCopyTextureInfo&  destination,
+    const void*                      data,
+    const WGPUTexelCopyBufferLayout& layout,
+    const WGPUExtent3D&              size)
+{
+    // Repacking needs the row size, which only the format would tell
+    if (layout.bytesPerRow == WGPU_COPY_STRIDE_UNDEFINED) {
+        std::cerr << "Texture upload without bytesPerRow, skipped\n";
+        return UploadResult::Invalid;
+    }
+    uint32_t rowsPerImage = layout.rowsPerImage == WGPU_COPY_STRIDE_UNDEFINED ?
+                                size.height :
+                                layout.rowsPerImage;
+    uint64_t rowCount = uint64_t(rowsPerImage) * size.depthOrArrayLayers;
+    uint64_t pitch    = alignUp(layout.bytesPerRow, kRowAlignment);
+    if (rowCount == 0 || layout.bytesPerRow == 0)
+        return UploadResult::Recorded;
+
+    uint64_t stagingOffset = 0;
+    Chunk* chunk = allocate(pitch * rowCount, kRowAlignment, stagingOffset);
+    if (!chunk)
+        return UploadResult::Throttled;
+    const uint8_t* source = static_cast<const uint8_t*>(data) + layout.offset;
+    uint8_t*       target = chunk->data + stagingOffset;
+    if (pitch == layout.bytesPerRow) {
+        std::memcpy(target, source, pitch * rowCount);
+    }
+    else {
+        for (uint64_t row = 0; row < rowCount; ++row) {
+            std::memcpy(
+                target + row * pitch,
+                source + row * layout.bytesPerRow,
+                layout.bytesPerRow);
+        }
+    }
+
+    WGPUTexelCopyBufferInfo staging = WGPU_TEXEL_COPY_BUFFER_INFO_INIT;
+    staging.buffer                  = chunk->buffer;
+    staging.layout.offset           = stagingOffset;
+    staging.layout.bytesPerRow      = uint32_t(pitch);
+    staging.layout.rowsPerImage     = rowsPerImage;
+    wgpuCommandEncoderCopyBufferToTexture(
+        encoder(), &staging, &destination, &size);
+    return UploadResult::Recorded;
+}
+
+WGPUCommandBuffer StagingBelt::finish()
+{
+    if (!m_encoder)
+        return nullptr;
+    // The copies can only run once their source is unmapped
+    for (Chunk& chunk : m_chunks) {
+        if (chunk.state == ChunkState::Mapped && chunk.cursor > 0) {
+            wgpuBufferUnmap(chunk.buffer);
+            chunk.data  = nullptr;
+            chunk.state = ChunkState::Recorded;
+        }
+    }
+    WGPUCommandBufferDescriptor desc = WGPU_COMMAND_BUFFER_DESCRIPTOR_INIT;
+    desc.label = {"Staging belt uploads", WGPU_STRLEN};
+    WGPUCommandBuffer commands = wgpuCommandEncoderFinish(m_encoder, &desc);
+    wgpuCommandEncoderRelease(m_encoder);
+    m_encoder = nullptr;
+    return commands;
+}
+
+void StagingBelt::onSubmitted(WGPUQueue queue)
+{
+    // One request covers all the chunks of the submission
+    Future<AsyncStatus> done;
+    for (Chunk& chunk : m_chunks) {
+        if (chunk.state != ChunkState::Recorded)
+            continue;
+        if (!done.valid()) {
+            done = onSubmittedWorkDoneAsync(m_instance, queue);
+            ++m_stats.submits;
+            watch(done);
+        }
+        chunk.pending = done;
+        chunk.state   = ChunkState::Submitted;
+    }
+}
+
+void StagingBelt::submit(WGPUQueue queue)
+{
+    WGPUCommandBuffer commands = finish();
+    if (!commands)
+        return;
+    wgpuQueueSubmit(queue, 1, &commands);
+    countMetric(MetricCounter::Submits);
+    wgpuCommandBufferRelease(commands);
+    onSubmitted(queue);
+}
+
+void StagingBelt::flush()
+{
+    recycle(kInfiniteTimeout);
+}
+
+StagingBelt::Chunk* StagingBelt::allocate(
+    uint64_t  size,
+    uint64_t  alignment,
+    uint64_t& offset)
+{
+    if (m_frameBudget > 0 && m_frameBytes > 0 &&
+        m_frameBytes + size > m_frameBudget) {
+        ++m_stats.throttled;
+        return nullptr;
+    }
+    m_frameBytes += size;
+    ++m_stats.uploads;
+    m_stats.bytes += size;
+    countMetric(MetricCounter::UploadBytes, size);
+
+    for (Chunk& chunk : m_chunks) {
+        if (chunk.state != ChunkState::Mapped)
+            continue;
+        uint64_t start = alignUp(chunk.cursor, alignment);
+        if (start + size <= chunk.size) {
+            chunk.cursor = start + size;
+            offset       = start;
+            return &chunk;
+        }
+    }
+
+    Chunk chunk;
+    chunk.size = std::max(m_chunkSize, alignUp(size, 4));
+    WGPUBufferDescriptor desc = WGPU_BUFFER_DESCRIPTOR_INIT;
+    desc.label                = {"Staging belt chunk", WGPU_STRLEN};
+    desc.usage            = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc;
+    desc.size             = chunk.size;
+    desc.mappedAtCreation = true;
+    chunk.buffer          = wgpuDeviceCreateBuffer(m_device, &desc);
+    chunk.data            = static_cast<uint8_t*>(
+        wgpuBufferGetMappedRange(chunk.buffer, 0, chunk.size));
+    chunk.cursor = size;
+    offset       = 0;
+    ++m_stats.chunksCreated;
+    m_stats.stagingBytes += chunk.size;
+    if (m_memory) {
+        m_memory->onAllocated(ResourceCategory::Staging, chunk.size);
+    }
+    m_chunks.push_back(std::move(chunk));
+    return &m_chunks.back();
+}
+
+WGPUCommandEncoder StagingBelt::encoder()
+{
+    if (!m_encoder) {
+        WGPUCommandEncoderDescriptor desc =
+            WGPU_COMMAND_ENCODER_DESCRIPTOR_INIT;
+        desc.label = {"Staging belt uploads", WGPU_STRLEN};
+        m_encoder  = wgpuDeviceCreateCommandEncoder(m_device, &desc);
+    }
+    return m_encoder;
+}
+
+void StagingBelt::recycle(uint64_t timeoutNs)
+{
+    for (Chunk& chunk : m_chunks) {
+        if (chunk.state == ChunkState::Submitted &&
+            chunk.pending.wait(timeoutNs)) {
+            if (chunk.size > m_chunkSize) {
+                // Dedicated to one large upload, not worth keeping
+                releaseChunk(chunk);
+                continue;
+            }
+            chunk.pending = mapBufferAsync(
+                m_instance, chunk.buffer, WGPUMapMode_Write, 0, chunk.size);
+            chunk.state = ChunkState::Mapping;
+            watch(chunk.pending);
+        }
+        if (chunk.state == ChunkState::Mapping &&
+            chunk.pending.wait(timeoutNs)) {
+            if (!chunk.pending.get().success) {
+                releaseChunk(chunk);
+                continue;
+            }
+            chunk.data = static_cast<uint8_t*>(
+                wgpuBufferGetMappedRange(chunk.buffer, 0, chunk.size));
+            chunk.cursor  = 0;
+            chunk.pending = {};
+            chunk.state   = ChunkState::Mapped;
+            ++m_stats.chunksRecycled;
+        }
+    }
+    std::erase_if(m_chunks, [](const Chunk& chunk) { return !chunk.buffer; });
+}
+
+void StagingBelt::watch(const Future<AsyncStatus>& future)
+{
+    if (m_events) {
+        m_events->watch(future, m_guard.bind([this] { recycle(0); }));
+    }
+}
+
+void StagingBelt::releaseChunk(Chunk& chunk)
+{
+    m_stats.stagingBytes -= chunk.size;
+    if (m_memory) {
+        m_memory->onReleased(ResourceCategory::Staging, chunk.size);
+    }
+    wgpuBufferRelease(chunk.buffer);
+    chunk.buffer = nullptr;
+}
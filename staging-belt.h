@@ -0,0 +1,160 @@
+#ifndef STAGING_BELT_H
+#define STAGING_BELT_H
+
+#include "event-thread.h"
+#include "webgpu-async.h"
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <vector>
+
+class GpuMemoryTracker;
+
+/**
+ * Counters of a StagingBelt since its creation.
+ */
+struct UploadStats
+{
+    uint64_t uploads        = 0; // buffer and texture copies recorded
+    uint64_t bytes          = 0; // staging bytes written, row padding included
+    uint64_t throttled      = 0; // uploads refused by the frame budget
+    uint64_t submits        = 0; // command buffers of copies
+    uint64_t chunksCreated  = 0;
+    uint64_t chunksRecycled = 0; // chunks mapped again after their copies ran
+    uint64_t stagingBytes   = 0; // total size of the live chunks
+};
+
+/**
+ * Outcome of a StagingBelt upload.
+ */
+enum class UploadResult {
+    Recorded,  // the copy is in the command buffer of the next finish()
+    Throttled, // the frame budget is spent: retry in a later frame
+    Invalid,   // the upload cannot be done, the reason is logged
+};
+
+/**
+ * Uploads to buffers and textures through a belt of MapWrite staging chunks.
+ *
+ * Usage, once per frame:
+ *     belt.beginFrame();                         // recycle, reset budget
+ *     belt.uploadBuffer(buffer, 0, data, size);  // any number of uploads
+ *     belt.submit(queue);                        // one command buffer
+ *
+ * Data is written straight into mapped staging memory, unlike writeBuffer
+ * and writeTexture which copy it once more, and all the uploads of a frame
+ * are recorded in one command buffer. A chunk is mapped again, without
+ * blocking, once onSubmittedWorkDone reports that its copies have run.
+ *
+ * The frame budget bounds the bytes staged per frame, so that loading a
+ * large scene is spread over several frames instead of stalling one.
+ */
+class StagingBelt
+{
+public:
+    // `frameBudget` is in bytes, 0 for no limit. Uploads larger than
+    // `chunkSize` get a dedicated chunk, released once its copy is done.
+    StagingBelt(
+        WGPUInstance instance,
+        WGPUDevice   device,
+        uint64_t     chunkSize   = 8 << 20,
+        uint64_t     frameBudget = 0);
+    ~StagingBelt();
+
+    StagingBelt(const StagingBelt&)            = delete;
+    StagingBelt& operator=(const StagingBelt&) = delete;
+
+    // Recycle the chunks whose copies are done and reset the frame budget
+    void beginFrame();
+
+    // Record a copy of `size` bytes of `data` into `buffer` at `offset`,
+    // both multiples of 4. Nothing is recorded if the frame budget is
+    // spent, but the first upload of a frame is always accepted.
+    UploadResult uploadBuffer(
+        WGPUBuffer  buffer,
+        uint64_t    offset,
+        const void* data,
+        uint64_t    size);
+
+    // Record a copy of `data`, laid out as `layout` says, into
+    // `destination`. Rows are repacked to the 256-byte bytesPerRow
+    // alignment of buffer to texture copies, so layout.bytesPerRow must be
+    // given: the upload is Invalid with WGPU_COPY_STRIDE_UNDEFINED. Same
+    // budget rule as uploadBuffer.
+    UploadResult uploadTexture(
+        const WGPUTexelCopyTextureInfo&  destination,
+        const void*                      data,
+        const WGPUTexelCopyBufferLayout& layout,
+        const WGPUExtent3D&              size);
+
+    // The copies recorded since the previous call as one command buffer, or
+    // nullptr if there are none. onSubmitted() must follow its submission.
+    WGPUCommandBuffer finish();
+
+    // Start tracking the chunks of the last finish() for recycling, once
+    // its command buffer has been submitted to `queue`
+    void onSubmitted(WGPUQueue queue);
+
+    // finish(), submit the copies and onSubmitted()
+    void submit(WGPUQueue queue);
+
+    // Wait for the submitted copies and recycle their chunks
+    void flush();
+
+    uint64_t frameBudget() const { return m_frameBudget; }
+    void     setFrameBudget(uint64_t bytes) { m_frameBudget = bytes; }
+
+    // Bytes staged since beginFrame()
+    uint64_t frameBytes() const { return m_frameBytes; }
+
+    UploadStats stats() const { return m_stats; }
+
+    // Account the chunks in `memory`, or stop with nullptr
+    void setMemoryTracker(GpuMemoryTracker* memory);
+
+    // Have `events` watch the copies and the mappings, so that chunks are
+    // recycled from its dispatch() as soon as they can be, rather than at
+    // the next beginFrame() for each of the two steps. Null stops.
+    void setEventThread(EventThread* events) { m_events = events; }
+
+private:
+    enum class ChunkState {
+        Mapped,    // writable, possibly holding uploads of this frame
+        Recorded,  // unmapped, copies not submitted yet
+        Submitted, // waiting for the copies to run
+        Mapping,   // waiting to be writable again
+    };
+
+    struct Chunk
+    {
+        WGPUBuffer          buffer = nullptr;
+        uint64_t            size   = 0;
+        uint64_t            cursor = 0;
+        uint8_t*            data   = nullptr;
+        ChunkState          state  = ChunkState::Mapped;
+        Future<AsyncStatus> pending; // work done, then mapping
+    };
+
+    // Reserve `size` bytes of staging memory aligned to `alignment`; return
+    // nullptr if the frame budget is spent
+    Chunk* allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+    WGPUCommandEncoder encoder();
+    void               recycle(uint64_t timeoutNs);
+    void               watch(const Future<AsyncStatus>& future);
+    void               releaseChunk(Chunk& chunk);
+
+    WGPUInstance       m_instance    = nullptr;
+    WGPUDevice         m_device      = nullptr;
+    GpuMemoryTracker*  m_memory      = nullptr;
+    EventThread*       m_events      = nullptr;
+    WGPUCommandEncoder m_encoder     = nullptr;
+    uint64_t           m_chunkSize   = 0;
+    uint64_t           m_frameBudget = 0;
+    uint64_t           m_frameBytes  = 0;
+    std::vector<Chunk> m_chunks;
+    UploadStats        m_stats;
+    WatchGuard         m_guard; // of the m_events callbacks
+};
+
+#endif // STAGING_BELT_H
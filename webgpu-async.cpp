@@ -0,0 +1,267 @@
+#include "webgpu-async.h"
+
+#include "webgpu-utils.h"
+
+#include <chrono>
+#include <iostream>
+
+WGPUInstance createInstanceWithTimedWait()
+{
+    WGPUInstanceDescriptor desc          = WGPU_INSTANCE_DESCRIPTOR_INIT;
+    desc.capabilities.timedWaitAnyEnable = true;
+    WGPUInstance instance                = wgpuCreateInstance(&desc);
+    if (!instance) {
+        // Some implementations do not support timed waits, in which case
+        // waitForFutures polls with a zero timeout instead.
+        instance = wgpuCreateInstance(nullptr);
+    }
+    return instance;
+}
+
+WaitResult waitForFutures(
+    WGPUInstance        instance,
+    WGPUFutureWaitInfo* futures,
+    size_t              futureCount,
+    uint64_t            timeoutNs)
+{
+    WGPUWaitStatus status =
+        wgpuInstanceWaitAny(instance, futureCount, futures, timeoutNs);
+    if (status == WGPUWaitStatus_Success)
+        return WaitResult::Completed;
+    if (status == WGPUWaitStatus_TimedOut)
+        return WaitResult::TimedOut;
+    if (status != WGPUWaitStatus_UnsupportedTimeout)
+        return WaitResult::Error;
+
+    // The instance was created without timed waits: poll with a zero timeout,
+    // yielding for 1 ms between attempts rather than 200 ms.
+    using Clock         = std::chrono::steady_clock;
+    const auto deadline = timeoutNs == kInfiniteTimeout ?
+                              Clock::time_point::max() :
+                              Clock::now() + std::chrono::nanoseconds(timeoutNs);
+    while (true) {
+        status = wgpuInstanceWaitAny(instance, futureCount, futures, 0);
+        if (status == WGPUWaitStatus_Success)
+            return WaitResult::Completed;
+        if (status != WGPUWaitStatus_TimedOut)
+            return WaitResult::Error;
+        if (Clock::now() >= deadline)
+            return WaitResult::TimedOut;
+        sleepForMilliseconds(1);
+    }
+}
+
+WaitResult waitForFuture(
+    WGPUInstance instance,
+    WGPUFuture   future,
+    uint64_t     timeoutNs)
+{
+    WGPUFutureWaitInfo info = {future, false};
+    return waitForFutures(instance, &info, 1, timeoutNs);
+}
+
+Future<WGPUAdapter> requestAdapterAsync(
+    WGPUInstance                     instance,
+    WGPURequestAdapterOptions const* options)
+{
+    using State = detail::FutureState<WGPUAdapter>;
+    auto state  = std::make_shared<State>();
+
+    auto onAdapterRequestEnded = [](WGPURequestAdapterStatus status,
+                                    WGPUAdapter              adapter,
+                                    WGPUStringView           message,
+                                    void*                    userdata1,
+                                    void* /* userdata2 */) {
+        auto state = detail::adoptState<WGPUAdapter>(userdata1);
+        if (status != WGPURequestAdapterStatus_Success) {
+            std::cerr << "Error while requesting adapter: "
+                      << toStdStringView(message) << std::endl;
+            adapter = nullptr;
+        }
+        if (detail::isAbandoned(state) && adapter) {
+            wgpuAdapterRelease(adapter);
+            adapter = nullptr;
+        }
+        state->resolve(adapter);
+    };
+
+    WGPURequestAdapterCallbackInfo callbackInfo = {
+        /* nextInChain = */ nullptr,
+        /* mode = */ WGPUCallbackMode_WaitAnyOnly,
+        /* callback = */ onAdapterRequestEnded,
+        /* userdata1 = */ detail::retainState(state),
+        /* userdata2 = */ nullptr};
+
+    WGPUFuture future =
+        wgpuInstanceRequestAdapter(instance, options, callbackInfo);
+    return Future<WGPUAdapter>(instance, future, std::move(state));
+}
+
+Future<WGPUDevice> requestDeviceAsync(
+    WGPUInstance                instance,
+    WGPUAdapter                 adapter,
+    WGPUDeviceDescriptor const* descriptor)
+{
+    using State = detail::FutureState<WGPUDevice>;
+    auto state  = std::make_shared<State>();
+
+    auto onDeviceRequestEnded = [](WGPURequestDeviceStatus status,
+                                   WGPUDevice              device,
+                                   WGPUStringView          message,
+                                   void*                   userdata1,
+                                   void* /* userdata2 */) {
+        auto state = detail::adoptState<WGPUDevice>(userdata1);
+        if (status != WGPURequestDeviceStatus_Success) {
+            std::cerr << "Error while requesting device: "
+                      << toStdStringView(message) << std::endl;
+            device = nullptr;
+        }
+        if (detail::isAbandoned(state) && device) {
+            wgpuDeviceRelease(device);
+            device = nullptr;
+        }
+        state->resolve(device);
+    };
+
+    WGPURequestDeviceCallbackInfo callbackInfo = {
+        /* nextInChain = */ nullptr,
+        /* mode = */ WGPUCallbackMode_WaitAnyOnly,
+        /* callback = */ onDeviceRequestEnded,
+        /* userdata1 = */ detail::retainState(state),
+        /* userdata2 = */ nullptr};
+
+    WGPUFuture future =
+        wgpuAdapterRequestDevice(adapter, descriptor, callbackInfo);
+    return Future<WGPUDevice>(instance, future, std::move(state));
+}
+
+Future<AsyncStatus> mapBufferAsync(
+    WGPUInstance instance,
+    WGPUBuffer   buffer,
+    WGPUMapMode  mode,
+    size_t       offset,
+    size_t       size)
+{
+    using State = detail::FutureState<AsyncStatus>;
+    auto state  = std::make_shared<State>();
+
+    auto onBufferMapped = [](WGPUMapAsyncStatus    status,
+                             struct WGPUStringView message,
+                             void*                 userdata1,
+                             void* /* userdata2 */) {
+        auto state = detail::adoptState<AsyncStatus>(userdata1);
+        if (status != WGPUMapAsyncStatus_Success) {
+            std::cerr << "Could not map buffer! Status: " << status
+                      << ", message: " << toStdStringView(message)
+                      << std::endl;
+        }
+        state->resolve({status == WGPUMapAsyncStatus_Success});
+    };
+
+    WGPUBufferMapCallbackInfo callbackInfo = WGPU_BUFFER_MAP_CALLBACK_INFO_INIT;
+    callbackInfo.mode                      = WGPUCallbackMode_WaitAnyOnly;
+    callbackInfo.callback                  = onBufferMapped;
+    callbackInfo.userdata1                 = detail::retainState(state);
+
+    WGPUFuture future =
+        wgpuBufferMapAsync(buffer, mode, offset, size, callbackInfo);
+    return Future<AsyncStatus>(instance, future, std::move(state));
+}
+
+Future<AsyncStatus> onSubmittedWorkDoneAsync(
+    WGPUInstance instance,
+    WGPUQueue    queue)
+{
+    using State = detail::FutureState<AsyncStatus>;
+    auto state  = std::make_shared<State>();
+
+    auto onWorkDone = [](WGPUQueueWorkDoneStatus status,
+                         void*                   userdata1,
+                         void* /* userdata2 */) {
+        auto state = detail::adoptState<AsyncStatus>(userdata1);
+        state->resolve({status == WGPUQueueWorkDoneStatus_Success});
+    };
+
+    WGPUQueueWorkDoneCallbackInfo callbackInfo =
+        WGPU_QUEUE_WORK_DONE_CALLBACK_INFO_INIT;
+    callbackInfo.mode      = WGPUCallbackMode_WaitAnyOnly;
+    callbackInfo.callback  = onWorkDone;
+    callbackInfo.userdata1 = detail::retainState(state);
+
+    WGPUFuture future = wgpuQueueOnSubmittedWorkDone(queue, callbackInfo);
+    return Future<AsyncStatus>(instance, future, std::move(state));
+}
+
+Future<WGPURenderPipeline> createRenderPipelineAsync(
+    WGPUInstance                        instance,
+    WGPUDevice                          device,
+    WGPURenderPipelineDescriptor const* descriptor)
+{
+    using State = detail::FutureState<WGPURenderPipeline>;
+    auto state  = std::make_shared<State>();
+
+    auto onPipelineCreated = [](WGPUCreatePipelineAsyncStatus status,
+                                WGPURenderPipeline            pipeline,
+                                WGPUStringView                message,
+                                void*                         userdata1,
+                                void* /* userdata2 */) {
+        auto state = detail::adoptState<WGPURenderPipeline>(userdata1);
+        if (status != WGPUCreatePipelineAsyncStatus_Success) {
+            std::cerr << "Could not create render pipeline: "
+                      << toStdStringView(message) << std::endl;
+            pipeline = nullptr;
+        }
+        if (detail::isAbandoned(state) && pipeline) {
+            wgpuRenderPipelineRelease(pipeline);
+            pipeline = nullptr;
+        }
+        state->resolve(pipeline);
+    };
+
+    WGPUCreateRenderPipelineAsyncCallbackInfo callbackInfo =
+        WGPU_CREATE_RENDER_PIPELINE_ASYNC_CALLBACK_INFO_INIT;
+    callbackInfo.mode      = WGPUCallbackMode_WaitAnyOnly;
+    callbackInfo.callback  = onPipelineCreated;
+    callbackInfo.userdata1 = detail::retainState(state);
+
+    WGPUFuture future =
+        wgpuDeviceCreateRenderPipelineAsync(device, descriptor, callbackInfo);
+    return Future<WGPURenderPipeline>(instance, future, std::move(state));
+}
+
+Future<WGPUComputePipeline> createComputePipelineAsync(
+    WGPUInstance                         instance,
+    WGPUDevice                           device,
+    WGPUComputePipelineDescriptor const* descriptor)
+{
+    using State = detail::FutureState<WGPUComputePipeline>;
+    auto state  = std::make_shared<State>();
+
+    auto onPipelineCreated = [](WGPUCreatePipelineAsyncStatus status,
+                                WGPUComputePipeline           pipeline,
+                                WGPUStringView                message,
+                                void*                         userdata1,
+                                void* /* userdata2 */) {
+        auto state = detail::adoptState<WGPUComputePipeline>(userdata1);
+        if (status != WGPUCreatePipelineAsyncStatus_Success) {
+            std::cerr << "Could not create compute pipeline: "
+                      << toStdStringView(message) << std::endl;
+            pipeline = nullptr;
+        }
+        if (detail::isAbandoned(state) && pipeline) {
+            wgpuComputePipelineRelease(pipeline);
+            pipeline = nullptr;
+        }
+        state->resolve(pipeline);
+    };
+
+    WGPUCreateComputePipelineAsyncCallbackInfo callbackInfo =
+        WGPU_CREATE_COMPUTE_PIPELINE_ASYNC_CALLBACK_INFO_INIT;
+    callbackInfo.mode      = WGPUCallbackMode_WaitAnyOnly;
+    callbackInfo.callback  = onPipelineCreated;
+    callbackInfo.userdata1 = detail::retainState(state);
+
+    WGPUFuture future =
+        wgpuDeviceCreateComputePipelineAsync(device, descriptor, callbackInfo);
+    return Future<WGPUComputePipeline>(instance, future, std::move(state));
+}
@@ -0,0 +1,238 @@
+#ifndef WEBGPU_ASYNC_H
+#define WEBGPU_ASYNC_H
+
+#include <webgpu/webgpu.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Timeout value meaning "wait until the future completes".
+ */
+constexpr uint64_t kInfiniteTimeout = UINT64_MAX;
+
+/**
+ * Outcome of a wait on one or more WebGPU futures.
+ */
+enum class WaitResult {
+    Completed, // at least one of the awaited futures completed
+    TimedOut,  // the timeout elapsed before any future completed
+    Error,     // the wait itself failed (e.g. unsupported future count)
+};
+
+/**
+ * Create an instance able to block in wgpuInstanceWaitAny with a non-zero
+ * timeout. Instances created without this capability still work with the
+ * helpers below, which then fall back to a short polling loop.
+ */
+WGPUInstance createInstanceWithTimedWait();
+
+/**
+ * Wait for the given futures, created with WGPUCallbackMode_WaitAnyOnly.
+ * The callbacks of completed futures are invoked from within this call and
+ * their `completed` flag is set in `futures`.
+ */
+WaitResult waitForFutures(
+    WGPUInstance        instance,
+    WGPUFutureWaitInfo* futures,
+    size_t              futureCount,
+    uint64_t            timeoutNs);
+
+/**
+ * Wait for a single future, see waitForFutures.
+ */
+WaitResult waitForFuture(
+    WGPUInstance instance,
+    WGPUFuture   future,
+    uint64_t     timeoutNs = kInfiniteTimeout);
+
+namespace detail {
+
+/**
+ * State shared between a Future and the callback that resolves it. The
+ * callback owns a reference until it fires, so dropping a Future before
+ * completion is safe: the state is freed by the callback, at the latest
+ * with CallbackCancelled when the instance is released.
+ */
+template<typename T>
+struct FutureState
+{
+    T                 value {};
+    std::atomic<bool> ready = false;
+    // Set by the last Future when it goes away before completion
+    std::atomic<bool> abandoned = false;
+
+    void resolve(T v)
+    {
+        value = std::move(v);
+        ready.store(true, std::memory_order_release);
+    }
+};
+
+template<typename T>
+void* retainState(const std::shared_ptr<FutureState<T>>& state)
+{
+    return new std::shared_ptr<FutureState<T>>(state);
+}
+
+template<typename T>
+std::shared_ptr<FutureState<T>> adoptState(void* userdata)
+{
+    std::unique_ptr<std::shared_ptr<FutureState<T>>> holder(
+        reinterpret_cast<std::shared_ptr<FutureState<T>>*>(userdata));
+    return std::move(*holder);
+}
+
+// In a callback, after adoptState(): no Future is left to take the value,
+// which the callback must then release itself
+template<typename T>
+bool isAbandoned(const std::shared_ptr<FutureState<T>>& state)
+{
+    return state.use_count() == 1 ||
+           state->abandoned.load(std::memory_order_acquire);
+}
+
+} // namespace detail
+
+/**
+ * A small awaitable wrapping a WGPUFuture and the value its callback
+ * produces, so that
+ *     Future<WGPUAdapter> f = requestAdapterAsync(instance, &options);
+ *     WGPUAdapter adapter = f.get();
+ * blocks exactly as long as the request takes, instead of polling.
+ */
+template<typename T>
+class Future
+{
+    WGPUInstance                             m_instance = nullptr;
+    WGPUFuture                               m_future   = {0};
+    std::shared_ptr<detail::FutureState<T>> m_state    = nullptr;
+
+public:
+    Future() = default;
+
+    Future(
+        WGPUInstance                             instance,
+        WGPUFuture                               future,
+        std::shared_ptr<detail::FutureState<T>> state) :
+            m_instance(instance), m_future(future), m_state(std::move(state))
+    {
+    }
+
+    ~Future() { abandon(); }
+
+    Future(const Future&)     = default;
+    Future(Future&&) noexcept = default;
+
+    Future& operator=(const Future& other)
+    {
+        if (this != &other) {
+            abandon();
+            m_instance = other.m_instance;
+            m_future   = other.m_future;
+            m_state    = other.m_state;
+        }
+        return *this;
+    }
+
+    Future& operator=(Future&& other) noexcept
+    {
+        if (this != &other) {
+            abandon();
+            m_instance = other.m_instance;
+            m_future   = other.m_future;
+            m_state    = std::move(other.m_state);
+        }
+        return *this;
+    }
+
+    bool valid() const { return m_state != nullptr; }
+
+    WGPUFuture handle() const { return m_future; }
+
+    // Return true if the value is available, without waiting
+    bool isReady() const
+    {
+        return m_state && m_state->ready.load(std::memory_order_acquire);
+    }
+
+    // Wait up to `timeoutNs` and return true if the value is available
+    bool wait(uint64_t timeoutNs = kInfiniteTimeout)
+    {
+        if (!m_state)
+            return false;
+        if (isReady())
+            return true;
+        waitForFuture(m_instance, m_future, timeoutNs);
+        return isReady();
+    }
+
+    // Wait for completion and return the value
+    const T& get()
+    {
+        wait();
+        return m_state->value;
+    }
+
+private:
+    // A WaitAnyOnly callback only fires when its future is waited on. When
+    // the last Future of a pending request goes away, give the callback a
+    // chance to run if the GPU is done, so that it frees the state now
+    // rather than when the instance is released. Marked abandoned first:
+    // the callback then releases what it produced instead of storing it.
+    void abandon()
+    {
+        if (m_instance && m_state && m_state.use_count() == 2 &&
+            !isReady()) {
+            m_state->abandoned.store(true, std::memory_order_release);
+            waitForFuture(m_instance, m_future, 0);
+        }
+    }
+};
+
+/**
+ * Result of a buffer mapping or queue completion request.
+ */
+struct AsyncStatus
+{
+    bool success = false;
+};
+
+/**
+ * Asynchronous counterparts of the *Sync helpers of webgpu-utils.h. All of
+ * them use WGPUCallbackMode_WaitAnyOnly: completion is observed by waiting on
+ * the returned future, not by wgpuInstanceProcessEvents.
+ */
+Future<WGPUAdapter> requestAdapterAsync(
+    WGPUInstance                     instance,
+    WGPURequestAdapterOptions const* options);
+
+Future<WGPUDevice> requestDeviceAsync(
+    WGPUInstance                instance,
+    WGPUAdapter                 adapter,
+    WGPUDeviceDescriptor const* descriptor);
+
+Future<AsyncStatus> mapBufferAsync(
+    WGPUInstance instance,
+    WGPUBuffer   buffer,
+    WGPUMapMode  mode,
+    size_t       offset,
+    size_t       size);
+
+Future<AsyncStatus> onSubmittedWorkDoneAsync(
+    WGPUInstance instance,
+    WGPUQueue    queue);
+
+// The pipeline is compiled off the calling thread; null if creation failed
+Future<WGPURenderPipeline> createRenderPipelineAsync(
+    WGPUInstance                        instance,
+    WGPUDevice                          device,
+    WGPURenderPipelineDescriptor const* descriptor);
+
+Future<WGPUComputePipeline> createComputePipelineAsync(
+    WGPUInstance                         instance,
+    WGPUDevice                           device,
+    WGPUComputePipelineDescriptor const* descriptor);
+
+#endif // WEBGPU_ASYNC_H
@@ -49,6 +49,8 @@ void inspectDevice(WGPUDevice device);
  * Fetch data from a GPU buffer back to the CPU.
  * This function blocks until the data is available on CPU, then calls the
  * `processBufferData` callback, and finally unmap the buffer.
+ * For per-frame readbacks prefer ReadbackRing (readback-ring.h), which keeps
+ * several copies in flight instead of stalling on each one.
  */
 void fetchBufferDataSync(
     WGPUInstance instance,
@@ -60,4 +62,26 @@ void fetchBufferDataSync(
  */
 uint32_t divideAndCeil(uint32_t p, uint32_t q);
 
+/**
+ * Create a buffer holding the `size` bytes of `data`, a multiple of 4,
+ * through mappedAtCreation. Parameters that differ between the passes or
+ * dispatches of one encoder each need such a buffer: a queue write would
+ * land before all of them, whatever the order of the calls.
+ */
+WGPUBuffer createBufferWithData(WGPUDevice device, const char* label, WGPUBufferUsage usage, const void* data, uint64_t size);
+
+class BindingCache;
+
+/**
+ * Create binding objects, so that
+ *     WGPUBindGroup bindGroup = createBindGroup(device, &descriptor, cache);
+ * returns the object created earlier for an identical descriptor when a
+ * BindingCache (binding-cache.h) is given. Either way the caller owns the
+ * returned reference and releases it.
+ */
+WGPUBindGroupLayout createBindGroupLayout(WGPUDevice device, WGPUBindGroupLayoutDescriptor const * descriptor, BindingCache* cache = nullptr);
+WGPUBindGroup createBindGroup(WGPUDevice device, WGPUBindGroupDescriptor const * descriptor, BindingCache* cache = nullptr);
+WGPUPipelineLayout createPipelineLayout(WGPUDevice device, WGPUPipelineLayoutDescriptor const * descriptor, BindingCache* cache = nullptr);
+WGPUSampler createSampler(WGPUDevice device, WGPUSamplerDescriptor const * descriptor, BindingCache* cache = nullptr);
+
 #endif // WEBGPU_UTILS_H
@@ -0,0 +1,525 @@
+#ifndef WGSL_LAYOUT_H
+#define WGSL_LAYOUT_H
+
+#include "pipeline-cache.h"
+
+#include <webgpu/webgpu.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Compile-time WGSL memory layout of C++ structs, so that uniform, storage
+ * and vertex data is declared once and uploaded with a single memcpy:
+ *
+ *     struct DrawUniforms
+ *     {
+ *         wgsl::mat4x4f model;
+ *         wgsl::vec3f   tint; // at a multiple of 16, as in WGSL
+ *         float         alpha;
+ *     };
+ *     WGSL_STRUCT(DrawUniforms, model, tint, alpha);
+ *     static_assert(
+ *         wgslLayoutMatches<DrawUniforms, WgslAddressSpace::Uniform>());
+ *
+ *     shaderSource = wgslStructSource<DrawUniforms>() + body;
+ *     ring.write(uniforms);
+ *
+ * The WGSL offsets, alignments and sizes follow the "Memory Layout" section
+ * of the WGSL specification. The C++ members are not moved: the check fails
+ * when they are not where WGSL expects them, which usually means adding
+ * alignas(16) to a vec3f or an explicit padding member.
+ */
+
+/**
+ * Host types with the size and alignment of their WGSL counterparts. A
+ * vec3f is 12 bytes aligned to 4: C++ has no 12-byte type aligned to 16, the
+ * WGSL alignment of its members is verified by wgslLayoutMatches().
+ */
+namespace wgsl {
+
+template<typename S, uint32_t N>
+struct alignas(N == 3 ? alignof(S) : N * sizeof(S)) Vector
+{
+    S data[N] = {};
+
+    constexpr S&       operator[](size_t i) { return data[i]; }
+    constexpr const S& operator[](size_t i) const { return data[i]; }
+};
+
+// Column-major, columns of 3 floats are padded to 4
+template<uint32_t C, uint32_t R>
+struct alignas(R == 2 ? 8 : 16) Matrix
+{
+    float columns[C][R == 3 ? 4 : R] = {};
+};
+
+// Vertex attribute only, read as a vec4f in the shader
+struct Unorm8x4
+{
+    uint8_t data[4] = {};
+};
+
+using vec2f   = Vector<float, 2>;
+using vec3f   = Vector<float, 3>;
+using vec4f   = Vector<float, 4>;
+using vec2i   = Vector<int32_t, 2>;
+using vec3i   = Vector<int32_t, 3>;
+using vec4i   = Vector<int32_t, 4>;
+using vec2u   = Vector<uint32_t, 2>;
+using vec3u   = Vector<uint32_t, 3>;
+using vec4u   = Vector<uint32_t, 4>;
+using mat2x2f = Matrix<2, 2>;
+using mat3x3f = Matrix<3, 3>;
+using mat4x4f = Matrix<4, 4>;
+
+} // namespace wgsl
+
+enum class WgslAddressSpace { Uniform, Storage, Vertex };
+
+/**
+ * A member of a struct described by WGSL_STRUCT.
+ */
+template<typename M>
+struct WgslField
+{
+    using Type = M;
+
+    const char* name       = nullptr;
+    size_t      hostOffset = 0;
+};
+
+/**
+ * Specialized by WGSL_STRUCT with the name and the fields of a struct.
+ */
+template<typename T>
+struct WgslStruct;
+
+template<typename T>
+concept WgslDescribed = requires { WgslStruct<T>::name; };
+
+constexpr uint32_t wgslRoundUp(uint32_t alignment, uint32_t value)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * WGSL layout of a host type: alignment, size, type name, vertex format,
+ * whether the host layout is the WGSL one, and whether the type may be used
+ * in the uniform address space.
+ */
+template<typename T>
+struct WgslType;
+
+template<typename S>
+struct WgslScalar;
+
+template<>
+struct WgslScalar<float>
+{
+    static constexpr char             suffix = 'f';
+    static constexpr WGPUVertexFormat format = WGPUVertexFormat_Float32;
+};
+
+template<>
+struct WgslScalar<int32_t>
+{
+    static constexpr char             suffix = 'i';
+    static constexpr WGPUVertexFormat format = WGPUVertexFormat_Sint32;
+};
+
+template<>
+struct WgslScalar<uint32_t>
+{
+    static constexpr char             suffix = 'u';
+    static constexpr WGPUVertexFormat format = WGPUVertexFormat_Uint32;
+};
+
+// Scalars, vectors and matrices: no nested declarations, valid everywhere
+struct WgslLeafType
+{
+    static constexpr bool composite    = false;
+    static constexpr bool uniformValid = true;
+
+    static void declare(std::string&, std::vector<std::string>&) {}
+};
+
+template<typename S>
+    requires requires { WgslScalar<S>::suffix; }
+struct WgslType<S> : WgslLeafType
+{
+    static constexpr uint32_t         alignment    = 4;
+    static constexpr uint32_t         size         = 4;
+    static constexpr bool             hostMatches  = sizeof(S) == 4;
+    static constexpr WGPUVertexFormat vertexFormat = WgslScalar<S>::format;
+
+    static std::string name()
+    {
+        return WgslScalar<S>::suffix == 'f' ? "f32" :
+               WgslScalar<S>::suffix == 'i' ? "i32" :
+                                              "u32";
+    }
+};
+
+template<typename S, uint32_t N>
+struct WgslType<wgsl::Vector<S, N>> : WgslLeafType
+{
+    static constexpr uint32_t alignment   = N == 2 ? 8 : 16;
+    static constexpr uint32_t size        = 4 * N;
+    static constexpr bool     hostMatches = sizeof(wgsl::Vector<S, N>) == size;
+    // The xN formats follow the scalar one
+    static constexpr WGPUVertexFormat vertexFormat =
+        WGPUVertexFormat(WgslScalar<S>::format + N - 1);
+
+    static std::string name()
+    {
+        return "vec" + std::to_string(N) + WgslScalar<S>::suffix;
+    }
+};
+
+template<uint32_t C, uint32_t R>
+struct WgslType<wgsl::Matrix<C, R>> : WgslLeafType
+{
+    static constexpr uint32_t alignment = R == 2 ? 8 : 16;
+    static constexpr uint32_t size =
+        C * wgslRoundUp(R == 2 ? 8 : 16, 4 * R);
+    static constexpr bool hostMatches =
+        sizeof(wgsl::Matrix<C, R>) == size &&
+        alignof(wgsl::Matrix<C, R>) == alignment;
+    static constexpr WGPUVertexFormat vertexFormat = WGPUVertexFormat(0);
+
+    static std::string name()
+    {
+        return "mat" + std::to_string(C) + "x" + std::to_string(R) + "f";
+    }
+};
+
+template<>
+struct WgslType<wgsl::Unorm8x4> : WgslLeafType
+{
+    static constexpr uint32_t         alignment    = 4;
+    static constexpr uint32_t         size         = 4;
+    static constexpr bool             hostMatches  = false; // vertex only
+    static constexpr WGPUVertexFormat vertexFormat = WGPUVertexFormat_Unorm8x4;
+
+    static std::string name() { return "vec4f"; }
+};
+
+// Fixed-size arrays, as std::array or as C arrays
+template<typename E, size_t N, typename Host>
+struct WgslArrayType
+{
+    using Element = WgslType<E>;
+
+    static constexpr uint32_t alignment = Element::alignment;
+    static constexpr uint32_t stride =
+        wgslRoundUp(Element::alignment, Element::size);
+    static constexpr uint32_t size = uint32_t(N) * stride;
+    static constexpr bool     hostMatches =
+        Element::hostMatches && sizeof(E) == stride && sizeof(Host) == size;
+    static constexpr WGPUVertexFormat vertexFormat = WGPUVertexFormat(0);
+    static constexpr bool             composite    = true;
+    static constexpr bool             uniformValid =
+        Element::uniformValid && stride % 16 == 0;
+
+    static std::string name()
+    {
+        return "array<" + Element::name() + ", " + std::to_string(N) + ">";
+    }
+
+    static void declare(std::string& out, std::vector<std::string>& declared)
+    {
+        Element::declare(out, declared);
+    }
+};
+
+template<typename E, size_t N>
+struct WgslType<std::array<E, N>> : WgslArrayType<E, N, std::array<E, N>>
+{
+};
+
+template<typename E, size_t N>
+struct WgslType<E[N]> : WgslArrayType<E, N, E[N]>
+{
+};
+
+/**
+ * WGSL layout of the members of a struct described by WGSL_STRUCT.
+ */
+template<WgslDescribed T>
+struct WgslStructLayout
+{
+    struct Member
+    {
+        uint32_t         alignment    = 0;
+        uint32_t         size         = 0;
+        uint32_t         offset       = 0; // in WGSL
+        size_t           hostOffset   = 0;
+        bool             hostMatches  = false;
+        bool             composite    = false;
+        bool             uniformValid = false;
+        WGPUVertexFormat vertexFormat = WGPUVertexFormat(0);
+    };
+
+    static constexpr auto   fields = WgslStruct<T>::fields();
+    static constexpr size_t count  = std::tuple_size_v<decltype(fields)>;
+
+    template<typename M>
+    static constexpr Member describe(WgslField<M> field)
+    {
+        Member member;
+        member.alignment    = WgslType<M>::alignment;
+        member.size         = WgslType<M>::size;
+        member.hostOffset   = field.hostOffset;
+        member.hostMatches  = WgslType<M>::hostMatches;
+        member.composite    = WgslType<M>::composite;
+        member.uniformValid = WgslType<M>::uniformValid;
+        member.vertexFormat = WgslType<M>::vertexFormat;
+        return member;
+    }
+
+    static constexpr std::array<Member, count> members = [] {
+        std::array<Member, count> result = {};
+        size_t                    i      = 0;
+        std::apply(
+            [&](auto... field) {
+                ((result[i++] = describe(field)), ...);
+            },
+            fields);
+
+        uint32_t end = 0;
+        for (Member& member : result) {
+            member.offset = wgslRoundUp(member.alignment, end);
+            end           = member.offset + member.size;
+        }
+        return result;
+    }();
+
+    static constexpr uint32_t alignment = [] {
+        uint32_t result = 1;
+        for (const Member& member : members) {
+            result = member.alignment > result ? member.alignment : result;
+        }
+        return result;
+    }();
+
+    static constexpr uint32_t size = wgslRoundUp(
+        alignment,
+        count == 0 ? 0 : members[count - 1].offset + members[count - 1].size);
+};
+
+template<WgslDescribed T>
+struct WgslType<T>
+{
+    using Layout = WgslStructLayout<T>;
+
+    static constexpr uint32_t         alignment    = Layout::alignment;
+    static constexpr uint32_t         size         = Layout::size;
+    static constexpr WGPUVertexFormat vertexFormat = WGPUVertexFormat(0);
+    static constexpr bool             composite    = true;
+
+    static constexpr bool hostMatches = [] {
+        for (const auto& member : Layout::members) {
+            if (!member.hostMatches || member.hostOffset != member.offset) {
+                return false;
+            }
+        }
+        return sizeof(T) == size;
+    }();
+
+    // Nested structs and arrays are aligned to 16 bytes, and what follows a
+    // nested struct starts at least 16-byte rounded size after it
+    static constexpr bool uniformValid = [] {
+        const auto& members = Layout::members;
+        for (size_t i = 0; i < members.size(); ++i) {
+            const auto& member = members[i];
+            if (!member.uniformValid ||
+                (member.composite &&
+                 member.offset % wgslRoundUp(16, member.alignment) != 0)) {
+                return false;
+            }
+            if (member.composite && i + 1 < members.size() &&
+                members[i + 1].offset - member.offset <
+                    wgslRoundUp(16, member.size)) {
+                return false;
+            }
+        }
+        return true;
+    }();
+
+    static std::string name() { return WgslStruct<T>::name; }
+
+    static void declare(std::string& out, std::vector<std::string>& declared)
+    {
+        for (const std::string& previous : declared) {
+            if (previous == name()) {
+                return;
+            }
+        }
+        declared.push_back(name());
+
+        std::string body;
+        std::apply(
+            [&](auto... field) {
+                (declareMember(field, out, declared, body), ...);
+            },
+            Layout::fields);
+        out += "struct " + name() + " {\n" + body + "}\n\n";
+    }
+
+    template<typename M>
+    static void declareMember(
+        WgslField<M>              field,
+        std::string&              out,
+        std::vector<std::string>& declared,
+        std::string&              body)
+    {
+        WgslType<M>::declare(out, declared);
+        body += std::string("    ") + field.name + ": " + WgslType<M>::name() +
+                ",\n";
+    }
+};
+
+/**
+ * Whether the host layout of `T` is what a shader reading it from `Space`
+ * expects, to be checked with static_assert. For vertex buffers, every
+ * member must have a vertex format, at a 4-byte aligned offset; the struct
+ * itself is the array stride.
+ */
+template<WgslDescribed T, WgslAddressSpace Space>
+constexpr bool wgslLayoutMatches()
+{
+    if constexpr (Space == WgslAddressSpace::Vertex) {
+        for (const auto& member : WgslStructLayout<T>::members) {
+            if (member.vertexFormat == WGPUVertexFormat(0) ||
+                member.hostOffset % 4 != 0) {
+                return false;
+            }
+        }
+        return sizeof(T) % 4 == 0;
+    }
+    else {
+        return WgslType<T>::hostMatches &&
+               (Space != WgslAddressSpace::Uniform ||
+                WgslType<T>::uniformValid);
+    }
+}
+
+/**
+ * WGSL declaration of `T` and of the structs it contains, these first.
+ */
+template<WgslDescribed T>
+std::string wgslStructSource()
+{
+    std::string              out;
+    std::vector<std::string> declared;
+    WgslType<T>::declare(out, declared);
+    return out;
+}
+
+/**
+ * WGSL vertex input struct of `T`, its members at consecutive locations
+ * from `firstLocation`, matching wgslVertexBuffer<T>(..., firstLocation).
+ */
+template<WgslDescribed T>
+std::string wgslVertexInputSource(uint32_t firstLocation = 0)
+{
+    static_assert(wgslLayoutMatches<T, WgslAddressSpace::Vertex>());
+
+    std::string out      = "struct " + WgslType<T>::name() + " {\n";
+    uint32_t    location = firstLocation;
+    std::apply(
+        [&](auto... field) {
+            ((out += "    @location(" + std::to_string(location++) + ") " +
+                     field.name + ": " +
+                     WgslType<typename decltype(field)::Type>::name() + ",\n"),
+             ...);
+        },
+        WgslStructLayout<T>::fields);
+    return out + "}\n\n";
+}
+
+/**
+ * Vertex attributes of `T` in a buffer of `T` elements.
+ */
+template<WgslDescribed T>
+std::array<WGPUVertexAttribute, WgslStructLayout<T>::count>
+wgslVertexAttributes(uint32_t firstLocation = 0)
+{
+    static_assert(wgslLayoutMatches<T, WgslAddressSpace::Vertex>());
+
+    std::array<WGPUVertexAttribute, WgslStructLayout<T>::count> attributes;
+    for (size_t i = 0; i < attributes.size(); ++i) {
+        const auto& member = WgslStructLayout<T>::members[i];
+
+        WGPUVertexAttribute attribute = {};
+        attribute.format              = member.vertexFormat;
+        attribute.offset              = member.hostOffset;
+        attribute.shaderLocation      = firstLocation + uint32_t(i);
+        attributes[i]                 = attribute;
+    }
+    return attributes;
+}
+
+/**
+ * The same attributes as a VertexBufferSpec of a RenderPipelineSpec.
+ */
+template<WgslDescribed T>
+VertexBufferSpec wgslVertexBuffer(
+    WGPUVertexStepMode stepMode      = WGPUVertexStepMode_Vertex,
+    uint32_t           firstLocation = 0)
+{
+    VertexBufferSpec spec;
+    spec.arrayStride = sizeof(T);
+    spec.stepMode    = stepMode;
+    for (const WGPUVertexAttribute& attribute :
+         wgslVertexAttributes<T>(firstLocation)) {
+        spec.attributes.push_back(
+            {attribute.format, attribute.offset, attribute.shaderLocation});
+    }
+    return spec;
+}
+
+// WGSL_FOR_EACH(m, T, a, b, c) expands to m(T, a), m(T, b), m(T, c), for
+// up to 64 arguments
+#define WGSL_PARENS ()
+#define WGSL_EXPAND(...) \
+    WGSL_EXPAND3(WGSL_EXPAND3(WGSL_EXPAND3(WGSL_EXPAND3(__VA_ARGS__))))
+#define WGSL_EXPAND3(...) \
+    WGSL_EXPAND2(WGSL_EXPAND2(WGSL_EXPAND2(WGSL_EXPAND2(__VA_ARGS__))))
+#define WGSL_EXPAND2(...) \
+    WGSL_EXPAND1(WGSL_EXPAND1(WGSL_EXPAND1(WGSL_EXPAND1(__VA_ARGS__))))
+#define WGSL_EXPAND1(...) __VA_ARGS__
+#define WGSL_FOR_EACH(macro, type, ...) \
+    __VA_OPT__(WGSL_EXPAND(WGSL_FOR_EACH_STEP(macro, type, __VA_ARGS__)))
+#define WGSL_FOR_EACH_STEP(macro, type, first, ...) \
+    macro(type, first) __VA_OPT__(                  \
+        , WGSL_FOR_EACH_AGAIN WGSL_PARENS(macro, type, __VA_ARGS__))
+#define WGSL_FOR_EACH_AGAIN() WGSL_FOR_EACH_STEP
+
+#define WGSL_FIELD(type, member) \
+    WgslField<decltype(type::member)> { #member, offsetof(type, member) }
+
+/**
+ * Describe the members of `type` that the shader sees, in declaration
+ * order. Must be used at global scope, after the definition of `type`.
+ */
+#define WGSL_STRUCT(type, ...)                                          \
+    template<>                                                          \
+    struct WgslStruct<type>                                             \
+    {                                                                   \
+        static constexpr const char* name = #type;                      \
+                                                                        \
+        static constexpr auto fields()                                  \
+        {                                                               \
+            return std::make_tuple(                                     \
+                WGSL_FOR_EACH(WGSL_FIELD, type, __VA_ARGS__));          \
+        }                                                               \
+    }
+
+#endif // WGSL_LAYOUT_H